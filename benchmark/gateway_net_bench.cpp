@@ -0,0 +1,420 @@
+// loopback order entry through the real gateway: client sockets -> FixGateway -> a stand-in exchange that
+// acks every order -> execution report back on the socket. runs the epoll and the io_uring network backend
+// and reports the network thread's syscalls per order, the ack latency seen by the clients and the resident
+// memory of the process while the gateway is up. --workers runs that many gateway workers, each with its own
+// network thread, gateway thread and stand-in exchange, and --client-threads drives the sessions from that
+// many client threads with one order in flight each, to see how throughput scales with cores. --proto binary
+// sends the same orders over the binary order entry port instead of FIX, --proto both runs them side by side
+// to compare the round trip.
+//
+// cmake --build <build dir> --target GatewayNetBench, or by hand:
+// g++ -std=c++20 -O3 -march=native -I. benchmark/gateway_net_bench.cpp entry_gateway/FixGateway.cpp
+//     entry_gateway/EventLoop.cpp entry_gateway/FixSession.cpp entry_gateway/Client.cpp client/FixClient.cpp
+//     client/BinaryClient.cpp -luring -lpthread -o gateway_net_bench
+
+#include "entry_gateway/FixGateway.h"
+#include "client/BinaryClient.h"
+#include "client/FixClient.h"
+#include "include/InstrumentRegistry.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <charconv>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+namespace {
+    constexpr std::string_view kTrailer = "\x01" "10=";
+
+    struct BenchConfig {
+        size_t orders{200'000};
+        size_t sessions{8};
+        size_t warmup{10'000};
+        size_t workers{1};
+        size_t client_threads{1};
+        bool epoll{true};
+        bool uring{true};
+        bool fix{true};
+        bool binary{false};
+    };
+
+    bool parse_size(std::string_view v, size_t& out) {
+        auto [ptr, ec] = std::from_chars(v.data(), v.data() + v.size(), out);
+        return ec == std::errc{} && ptr == v.data() + v.size();
+    }
+
+    bool parse_args(int argc, char** argv, BenchConfig& cfg) {
+        for (int i = 1; i + 1 < argc; i += 2) {
+            const std::string_view arg(argv[i]);
+            const std::string_view value(argv[i + 1]);
+            if (arg == "--orders") {
+                if (!parse_size(value, cfg.orders) || cfg.orders == 0) return false;
+            }
+            else if (arg == "--sessions") {
+                if (!parse_size(value, cfg.sessions) || cfg.sessions == 0) return false;
+            }
+            else if (arg == "--warmup") {
+                if (!parse_size(value, cfg.warmup)) return false;
+            }
+            else if (arg == "--workers") {
+                if (!parse_size(value, cfg.workers) || cfg.workers == 0 || cfg.workers > jolt::kMaxGatewayWorkers) {
+                    return false;
+                }
+            }
+            else if (arg == "--client-threads") {
+                if (!parse_size(value, cfg.client_threads) || cfg.client_threads == 0) return false;
+            }
+            else if (arg == "--net") {
+                cfg.epoll = value == "epoll" || value == "both";
+                cfg.uring = value == "uring" || value == "both";
+                if (!cfg.epoll && !cfg.uring) return false;
+            }
+            else if (arg == "--proto") {
+                cfg.fix = value == "fix" || value == "both";
+                cfg.binary = value == "binary" || value == "both";
+                if (!cfg.fix && !cfg.binary) return false;
+            }
+            else {
+                return false;
+            }
+        }
+        return (argc % 2) == 1;
+    }
+
+    // blocking client socket, reads whole FIX or binary messages
+    class BenchConn {
+        int fd_{-1};
+        std::vector<char> buf_ = std::vector<char>(64 * 1024);
+        size_t len_{0};
+        size_t off_{0};
+
+    public:
+        jolt::client::FixClient fix;
+        jolt::client::BinaryClient boe;
+
+        bool connect_local(uint16_t port) {
+            fd_ = ::socket(AF_INET, SOCK_STREAM, 0);
+            if (fd_ < 0) {
+                return false;
+            }
+            int one = 1;
+            ::setsockopt(fd_, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+            sockaddr_in addr{};
+            addr.sin_family = AF_INET;
+            addr.sin_port = htons(port);
+            addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+            return ::connect(fd_, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) == 0;
+        }
+
+        ~BenchConn() {
+            if (fd_ >= 0) {
+                ::close(fd_);
+            }
+        }
+
+        bool send(std::string_view msg) const {
+            while (!msg.empty()) {
+                const ssize_t n = ::send(fd_, msg.data(), msg.size(), MSG_NOSIGNAL);
+                if (n <= 0) {
+                    return false;
+                }
+                msg.remove_prefix(static_cast<size_t>(n));
+            }
+            return true;
+        }
+
+        // blocks until a message of msg_type arrives, skipping any other
+        bool wait_for(std::string_view msg_type) {
+            const std::string tag = std::string("\x01" "35=") + std::string(msg_type) + "\x01";
+            for (;;) {
+                const std::string_view view(buf_.data() + off_, len_ - off_);
+                const size_t trailer = view.find(kTrailer);
+                if (trailer != std::string_view::npos && trailer + kTrailer.size() + 4 <= view.size()) {
+                    const size_t end = trailer + kTrailer.size() + 4;
+                    const bool match = view.substr(0, end).find(tag) != std::string_view::npos;
+                    off_ += end;
+                    if (match) {
+                        return true;
+                    }
+                    continue;
+                }
+                if (off_ > 0) {
+                    std::memmove(buf_.data(), buf_.data() + off_, len_ - off_);
+                    len_ -= off_;
+                    off_ = 0;
+                }
+                const ssize_t n = ::recv(fd_, buf_.data() + len_, buf_.size() - len_, 0);
+                if (n <= 0) {
+                    return false;
+                }
+                len_ += static_cast<size_t>(n);
+            }
+        }
+
+        // wait_for for the binary protocol, framed by the header length
+        bool wait_for(jolt::boe::MsgType type) {
+            for (;;) {
+                if (len_ - off_ >= sizeof(jolt::boe::Header)) {
+                    const auto header = jolt::boe::read_msg<jolt::boe::Header>(buf_.data() + off_);
+                    if (header.length < sizeof(jolt::boe::Header)) {
+                        return false;
+                    }
+                    if (len_ - off_ >= header.length) {
+                        off_ += header.length;
+                        if (header.type == type) {
+                            return true;
+                        }
+                        continue;
+                    }
+                }
+                if (off_ > 0) {
+                    std::memmove(buf_.data(), buf_.data() + off_, len_ - off_);
+                    len_ -= off_;
+                    off_ = 0;
+                }
+                const ssize_t n = ::recv(fd_, buf_.data() + len_, buf_.size() - len_, 0);
+                if (n <= 0) {
+                    return false;
+                }
+                len_ += static_cast<size_t>(n);
+            }
+        }
+    };
+
+    // VmRSS of this process in MB
+    double resident_mb() {
+        std::ifstream status("/proc/self/status");
+        std::string line;
+        while (std::getline(status, line)) {
+            if (line.rfind("VmRSS:", 0) == 0) {
+                size_t kb = 0;
+                const size_t digits = line.find_first_of("0123456789");
+                if (digits != std::string::npos) {
+                    const std::string_view v(line.data() + digits, line.size() - digits);
+                    std::from_chars(v.data(), v.data() + v.size(), kb);
+                }
+                return static_cast<double>(kb) / 1024.0;
+            }
+        }
+        return 0.0;
+    }
+
+    // acks every order the gateway forwards, in the exchange's place
+    void run_exchange(jolt::GtwyToExch& in, jolt::ExchToGtwy& out, const std::atomic<bool>& run) {
+        while (run.load(std::memory_order_acquire)) {
+            auto* msg = in.front();
+            if (!msg) {
+                std::this_thread::yield();
+                continue;
+            }
+            auto* ack = out.alloc();
+            if (!ack) {
+                std::this_thread::yield();
+                continue;
+            }
+            ack->client_id = msg->client_id;
+            ack->order_id = msg->order.id;
+            ack->fill_qty = 0;
+            ack->reason = jolt::ob::RejectReason::NotApplicable;
+            ack->type = jolt::ExchToGtwyMsg::Type::Submitted;
+            ack->filled = false;
+            out.push();
+            in.pop();
+        }
+    }
+
+    double percentile(std::vector<uint64_t>& v, size_t per_mille) {
+        if (v.empty()) {
+            return 0.0;
+        }
+        std::sort(v.begin(), v.end());
+        return static_cast<double>(v[std::min(v.size() - 1, v.size() * per_mille / 1000)]);
+    }
+
+    bool run_backend(const BenchConfig& cfg, jolt::gateway::NetBackend backend, const bool binary) {
+        using jolt::gateway::FixGateway;
+        const jolt::InstrumentRegistry instruments = jolt::InstrumentRegistry::make_default(20'000, 100'000);
+        const uint16_t symbol_id = instruments.at(0).symbol_id;
+        const std::string symbol = std::to_string(symbol_id);
+
+        std::vector<std::unique_ptr<jolt::GtwyToExch>> to_exch;
+        std::vector<std::unique_ptr<jolt::ExchToGtwy>> from_exch;
+        std::atomic<bool> exch_run{true};
+        std::vector<std::thread> exchange;
+        for (size_t w = 0; w < cfg.workers; ++w) {
+            to_exch.push_back(std::make_unique<jolt::GtwyToExch>(
+                jolt::worker_queue_name("gateway_net_bench_in", w), SharedRingMode::Create));
+            from_exch.push_back(std::make_unique<jolt::ExchToGtwy>(
+                jolt::worker_queue_name("gateway_net_bench_out", w), SharedRingMode::Create));
+            exchange.emplace_back(run_exchange, std::ref(*to_exch.back()), std::ref(*from_exch.back()),
+                                  std::cref(exch_run));
+        }
+
+        std::vector<uint64_t> lat_ns;
+        lat_ns.reserve(cfg.orders);
+        size_t acked = 0;
+        uint64_t syscalls = 0;
+        double secs = 0;
+        double rss_mb = 0;
+        bool ok = true;
+        jolt::gateway::NetBackend used = backend;
+        {
+            std::vector<jolt::ClientInfo> clients;
+            for (size_t i = 1; i <= cfg.sessions; ++i) {
+                jolt::ClientInfo info{};
+                info.client_id = i;
+                info.max_qty = 1'000'000;
+                info.max_open_orders = std::numeric_limits<int64_t>::max() / 4;
+                info.max_pos = std::numeric_limits<int64_t>::max() / 4;
+                info.max_notional = std::numeric_limits<int64_t>::max() / 4;
+                info.capital = 1e9f;
+                clients.push_back(info);
+            }
+            std::vector<std::unique_ptr<FixGateway>> workers;
+            for (size_t w = 0; w < cfg.workers; ++w) {
+                workers.push_back(std::make_unique<FixGateway>("gateway_net_bench_in", "gateway_net_bench_out",
+                                                               instruments, 0, backend, w, cfg.workers));
+                workers.back()->load_clients(clients);
+                used = workers.back()->net_backend();
+                workers.back()->start();
+            }
+
+            std::vector<std::unique_ptr<BenchConn>> conns;
+            for (size_t i = 0; i < cfg.sessions && ok; ++i) {
+                auto conn = std::make_unique<BenchConn>();
+                const std::string sender = "BENCH_" + std::to_string(i + 1);
+                const size_t worker = FixGateway::worker_of(sender, cfg.workers);
+                if (binary) {
+                    conn->boe.set_session(sender);
+                    conn->boe.set_account(i + 1);
+                    ok = conn->connect_local(FixGateway::binary_listen_port(worker)) &&
+                        conn->send(conn->boe.build_login()) && conn->wait_for(jolt::boe::MsgType::LoginAccepted);
+                }
+                else {
+                    conn->fix.set_session(sender, "JOLT");
+                    conn->fix.set_account(std::to_string(i + 1));
+                    ok = conn->connect_local(FixGateway::listen_port(worker)) &&
+                        conn->send(conn->fix.build_logon(30)) && conn->wait_for("A");
+                }
+                conns.push_back(std::move(conn));
+            }
+
+            // closed loop: client thread t has one order in flight at a time, its sessions t, t + threads, ...
+            // take turns
+            const size_t threads = std::min(cfg.client_threads, conns.size());
+            std::vector<std::vector<uint64_t>> thread_lat(threads);
+            std::vector<size_t> thread_acked(threads, 0);
+            std::atomic<bool> all_ok{ok};
+            const auto t0 = std::chrono::steady_clock::now();
+            std::vector<std::thread> drivers;
+            for (size_t t = 0; t < threads && ok; ++t) {
+                drivers.emplace_back([&, t] {
+                    const size_t mine = (conns.size() - t + threads - 1) / threads;
+                    thread_lat[t].reserve(cfg.orders / threads + 1);
+                    for (size_t k = t; k < cfg.warmup + cfg.orders && all_ok.load(std::memory_order_relaxed);
+                         k += threads) {
+                        BenchConn& conn = *conns[t + ((k / threads) % mine) * threads];
+                        const bool is_buy = (k & 1) != 0;
+                        const auto px = static_cast<jolt::ob::PriceTick>(50'000 + (k % 64));
+                        const auto s0 = std::chrono::steady_clock::now();
+                        bool sent = false;
+                        if (binary) {
+                            sent = conn.send(conn.boe.build_new_order_limit(conn.boe.next_cl_ord_id(), symbol_id,
+                                                                            is_buy, 1, px)) &&
+                                conn.wait_for(jolt::boe::MsgType::Ack);
+                        }
+                        else {
+                            const std::string cl_ord_id = conn.fix.next_cl_ord_id();
+                            sent = conn.send(conn.fix.build_new_order_limit(cl_ord_id, symbol, is_buy, 1, px)) &&
+                                conn.wait_for("8");
+                        }
+                        if (!sent) {
+                            all_ok.store(false, std::memory_order_relaxed);
+                            break;
+                        }
+                        if (k >= cfg.warmup) {
+                            thread_lat[t].push_back(static_cast<uint64_t>(
+                                std::chrono::duration_cast<std::chrono::nanoseconds>(
+                                    std::chrono::steady_clock::now() - s0).count()));
+                            ++thread_acked[t];
+                        }
+                    }
+                });
+            }
+            for (auto& d : drivers) {
+                d.join();
+            }
+            secs = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+            ok = ok && all_ok.load();
+            for (size_t t = 0; t < threads; ++t) {
+                lat_ns.insert(lat_ns.end(), thread_lat[t].begin(), thread_lat[t].end());
+                acked += thread_acked[t];
+            }
+            rss_mb = resident_mb();
+            conns.clear();
+            for (auto& gateway : workers) {
+                gateway->stop();
+                syscalls += gateway->net_syscalls();
+            }
+        }
+        exch_run.store(false, std::memory_order_release);
+        for (auto& t : exchange) {
+            t.join();
+        }
+
+        const size_t total = cfg.warmup + cfg.orders;
+        std::cout << "proto=" << (binary ? "binary" : "fix")
+            << " net=" << (used == jolt::gateway::NetBackend::Uring ? "uring" : "epoll")
+            << " workers=" << cfg.workers
+            << " client_threads=" << cfg.client_threads
+            << " sessions=" << cfg.sessions
+            << " orders=" << acked
+            << " syscalls_per_order=" << static_cast<double>(syscalls) / static_cast<double>(total)
+            << " orders_per_sec=" << (secs > 0 ? static_cast<double>(total) / secs : 0.0)
+            << " ack_p50_us=" << percentile(lat_ns, 500) / 1000.0
+            << " ack_p99_us=" << percentile(lat_ns, 990) / 1000.0
+            << " ack_p999_us=" << percentile(lat_ns, 999) / 1000.0
+            << " rss_mb=" << rss_mb
+            << " ok=" << (ok ? "yes" : "no") << "\n";
+        return ok;
+    }
+}
+
+int main(int argc, char** argv) {
+    BenchConfig cfg{};
+    if (!parse_args(argc, argv, cfg)) {
+        std::cerr << "usage: " << argv[0] << " [--orders N] [--sessions N] [--warmup N] [--net epoll|uring|both]"
+                  << " [--workers N] [--client-threads N] [--proto fix|binary|both]\n";
+        return 1;
+    }
+
+    bool ok = true;
+    for (const bool binary : {false, true}) {
+        if (binary ? !cfg.binary : !cfg.fix) {
+            continue;
+        }
+        if (cfg.epoll) {
+            ok = run_backend(cfg, jolt::gateway::NetBackend::Epoll, binary) && ok;
+        }
+        if (cfg.uring) {
+            ok = run_backend(cfg, jolt::gateway::NetBackend::Uring, binary) && ok;
+        }
+    }
+    return ok ? 0 : 1;
+}
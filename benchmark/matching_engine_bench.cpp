@@ -1,22 +1,36 @@
 #include "exchange/orderbook/matching_orderbook.h"
+#include "exchange/orderbook/shadow_book.h"
+#include "include/SharedMemoryRing.h"
+#include "include/seqlock_table.h"
+#include "include/input_journal.h"
+#include "include/book_checkpoint.h"
+#include "include/mkt_data_writer.h"
+#include "include/l3_store.h"
+#include "include/l3_history.h"
+#include "include/InstrumentRegistry.h"
+#include "include/Types.h"
 
 #include <algorithm>
 #include <array>
+#include <atomic>
 #include <cmath>
 #include <cstdint>
 #include <x86gprintrin.h>
 #include <cstdlib>
+#include <filesystem>
 #include <iostream>
 #include <limits>
 #include <optional>
 #include <random>
 #include <string>
 #include <string_view>
+#include <thread>
 #include <unordered_map>
 #include <vector>
 
 using jolt::ob::BookEvent;
 using jolt::ob::BookEventType;
+using jolt::ob::LadderKind;
 using jolt::ob::MatchingOrderBook;
 using jolt::ob::OrderAction;
 using jolt::ob::OrderId;
@@ -25,6 +39,7 @@ using jolt::ob::OrderType;
 using jolt::ob::PriceTick;
 using jolt::ob::Qty;
 using jolt::ob::Side;
+using jolt::ob::SlotLayout;
 using jolt::ob::TIF;
 
 namespace {
@@ -45,6 +60,29 @@ namespace {
         std::size_t preseed_stops{1'500};
         uint64_t seed{42};
         HawkesParams hawkes{};
+        bool sweep{false};
+        std::size_t sweep_rounds{2'000};
+        bool stop_cascade{false};
+        std::size_t stop_cascade_rounds{2'000};
+        bool cancel_heavy{false};
+        std::size_t cancel_heavy_rounds{20'000};
+        bool batch_sweep{false};
+        bool snapshots{false};
+        std::size_t snapshot_every{5'000};
+        bool depth{false};
+        bool journal{false};
+        uint64_t journal_window_us{200};
+        bool journal_sync{true};
+        bool checkpoint{false};
+        std::size_t checkpoint_orders{1'000'000};
+        bool writer{false};
+        std::size_t writer_records{5'000'000};
+        bool history{false};
+        std::size_t history_gap{1000};
+        bool locator_scale{false};
+        std::size_t locator_max_orders{50'000'000};
+        LadderKind ladder{LadderKind::Dense};
+        SlotLayout layout{SlotLayout::Aos};
     };
 
     enum class OpType : uint8_t {
@@ -153,6 +191,7 @@ namespace {
     struct Counters {
         std::array<std::size_t, static_cast<std::size_t>(OpType::Count)> attempted{};
         std::array<std::size_t, static_cast<std::size_t>(OpType::Count)> accepted{};
+        std::array<uint64_t, static_cast<std::size_t>(OpType::Count)> cycles{};
         std::size_t rejects{0};
     };
 
@@ -175,9 +214,10 @@ namespace {
         return static_cast<Qty>(next);
     }
 
+    template <typename Book>
     class BenchDriver {
     public:
-        BenchDriver(MatchingOrderBook<>& book, uint64_t seed)
+        BenchDriver(Book& book, uint64_t seed)
             : book_(book), rng_(seed), op_dist_(kOpWeights.begin(), kOpWeights.end()) {
             states_.reserve(32'768);
             limit_ids_.reserve(32'768);
@@ -186,19 +226,28 @@ namespace {
         }
 
         void preseed(const BenchConfig& cfg) {
+            preseed(cfg, [](const OrderParams&) {});
+        }
+
+        // on_submit(order) sees every preseed order just before the book does
+        template <typename Fn>
+        void preseed(const BenchConfig& cfg, Fn&& on_submit) {
             uint64_t ts = 1;
             for (std::size_t i = 0; i < cfg.preseed_limits; ++i) {
                 OrderParams p = make_passive_limit(ts++);
+                on_submit(p);
                 const BookEvent ev = book_.submit_order(p);
                 after_submit(p, ev);
             }
 
             for (std::size_t i = 0; i < cfg.preseed_stops; ++i) {
                 OrderParams s = make_stop_market(ts++);
+                on_submit(s);
                 const BookEvent ev1 = book_.submit_order(s);
                 after_submit(s, ev1);
 
                 OrderParams sl = make_stop_limit(ts++);
+                on_submit(sl);
                 const BookEvent ev2 = book_.submit_order(sl);
                 after_submit(sl, ev2);
             }
@@ -265,7 +314,7 @@ namespace {
         }
 
     private:
-        MatchingOrderBook<>& book_;
+        Book& book_;
         std::mt19937_64 rng_;
         std::discrete_distribution<int> op_dist_;
 
@@ -824,6 +873,104 @@ namespace {
                 if (!read_value(v)) return false;
                 cfg.preseed_stops = static_cast<std::size_t>(v);
             }
+            else if (arg == "--ladder") {
+                if (i + 1 >= argc) return false;
+                const std::string_view kind(argv[++i]);
+                if (kind == "dense") {
+                    cfg.ladder = LadderKind::Dense;
+                }
+                else if (kind == "paged") {
+                    cfg.ladder = LadderKind::Paged;
+                }
+                else {
+                    return false;
+                }
+            }
+            else if (arg == "--layout") {
+                if (i + 1 >= argc) return false;
+                const std::string_view kind(argv[++i]);
+                if (kind == "aos") {
+                    cfg.layout = SlotLayout::Aos;
+                }
+                else if (kind == "soa") {
+                    cfg.layout = SlotLayout::Soa;
+                }
+                else {
+                    return false;
+                }
+            }
+            else if (arg == "--sweep") {
+                cfg.sweep = true;
+            }
+            else if (arg == "--sweep-rounds") {
+                if (!read_value(v)) return false;
+                cfg.sweep_rounds = static_cast<std::size_t>(v);
+            }
+            else if (arg == "--stop-cascade") {
+                cfg.stop_cascade = true;
+            }
+            else if (arg == "--stop-cascade-rounds") {
+                if (!read_value(v)) return false;
+                cfg.stop_cascade_rounds = static_cast<std::size_t>(v);
+            }
+            else if (arg == "--cancel-heavy") {
+                cfg.cancel_heavy = true;
+            }
+            else if (arg == "--cancel-heavy-rounds") {
+                if (!read_value(v)) return false;
+                cfg.cancel_heavy_rounds = static_cast<std::size_t>(v);
+            }
+            else if (arg == "--batch-sweep") {
+                cfg.batch_sweep = true;
+            }
+            else if (arg == "--snapshots") {
+                cfg.snapshots = true;
+            }
+            else if (arg == "--snapshot-every") {
+                if (!read_value(v) || v == 0) return false;
+                cfg.snapshot_every = static_cast<std::size_t>(v);
+            }
+            else if (arg == "--depth") {
+                cfg.depth = true;
+            }
+            else if (arg == "--journal") {
+                cfg.journal = true;
+            }
+            else if (arg == "--journal-window-us") {
+                if (!read_value(v)) return false;
+                cfg.journal_window_us = v;
+            }
+            else if (arg == "--journal-nosync") {
+                cfg.journal_sync = false;
+            }
+            else if (arg == "--checkpoint") {
+                cfg.checkpoint = true;
+            }
+            else if (arg == "--checkpoint-orders") {
+                if (!read_value(v) || v == 0) return false;
+                cfg.checkpoint_orders = static_cast<std::size_t>(v);
+            }
+            else if (arg == "--writer") {
+                cfg.writer = true;
+            }
+            else if (arg == "--writer-records") {
+                if (!read_value(v) || v == 0) return false;
+                cfg.writer_records = static_cast<std::size_t>(v);
+            }
+            else if (arg == "--history") {
+                cfg.history = true;
+            }
+            else if (arg == "--history-gap") {
+                if (!read_value(v) || v == 0) return false;
+                cfg.history_gap = static_cast<std::size_t>(v);
+            }
+            else if (arg == "--locator-scale") {
+                cfg.locator_scale = true;
+            }
+            else if (arg == "--locator-max-orders") {
+                if (!read_value(v)) return false;
+                cfg.locator_max_orders = static_cast<std::size_t>(v);
+            }
             else {
                 return false;
             }
@@ -838,7 +985,387 @@ namespace {
     void print_usage(const char* prog) {
         std::cerr
             << "Usage: " << prog << " [--events N] [--warmup N] [--seed N] "
-            << "[--preseed-limits N] [--preseed-stops N]\n";
+            << "[--preseed-limits N] [--preseed-stops N] [--ladder dense|paged] [--layout aos|soa] [--sweep] [--sweep-rounds N] "
+            << "[--stop-cascade] [--stop-cascade-rounds N] [--cancel-heavy] [--cancel-heavy-rounds N] "
+            << "[--batch-sweep] [--snapshots] [--snapshot-every N] [--depth] [--journal] [--journal-window-us N] [--journal-nosync] "
+            << "[--checkpoint] [--checkpoint-orders N] [--writer] [--writer-records N] [--history] [--history-gap N] [--locator-scale] [--locator-max-orders N]\n";
+    }
+
+    struct SweepScenario {
+        const char* name;
+        std::size_t levels;
+        PriceTick gap;
+    };
+
+    // production-sized ladder so best-price recovery has to cross wide empty regions
+    constexpr PriceTick kSweepMaxTick = 100'000;
+    constexpr PriceTick kSweepStartPx = 1'000;
+
+    // rests one lot per level on the ask side, then times a market buy that clears every level
+    void run_sweep_scenario(const SweepScenario& sc, std::size_t rounds) {
+        MatchingOrderBook<> book(kMinTick, kSweepMaxTick);
+        OrderId next_id = 1;
+        uint64_t ts = 1;
+        std::vector<uint64_t> samples;
+        samples.reserve(rounds);
+
+        for (std::size_t r = 0; r < rounds; ++r) {
+            for (std::size_t l = 0; l < sc.levels; ++l) {
+                OrderParams p{};
+                p.id = next_id++;
+                p.ts = ts++;
+                p.action = OrderAction::New;
+                p.type = OrderType::Limit;
+                p.side = Side::Sell;
+                p.price = static_cast<PriceTick>(kSweepStartPx + l * sc.gap);
+                p.qty = 1;
+                book.submit_order(p);
+            }
+
+            OrderParams m{};
+            m.id = next_id++;
+            m.ts = ts++;
+            m.action = OrderAction::New;
+            m.type = OrderType::Market;
+            m.side = Side::Buy;
+            m.qty = static_cast<Qty>(sc.levels);
+
+            const uint64_t t0 = __rdtsc();
+            book.submit_order(m);
+            const uint64_t t1 = __rdtsc();
+            samples.push_back(t1 - t0);
+        }
+
+        std::sort(samples.begin(), samples.end());
+        uint64_t total = 0;
+        for (uint64_t c : samples) {
+            total += c;
+        }
+        const double avg_ns = samples.empty() ? 0.0 : cycles_to_ns(total) / static_cast<double>(samples.size());
+        const double p50_ns = samples.empty() ? 0.0 : cycles_to_ns(samples[samples.size() / 2]);
+        const double p99_ns = samples.empty() ? 0.0 : cycles_to_ns(samples[(samples.size() * 99) / 100]);
+
+        std::cout << "sweep[" << sc.name << "] levels=" << sc.levels
+            << " gap_ticks=" << sc.gap
+            << " rounds=" << samples.size()
+            << " avg_ns_per_sweep=" << avg_ns
+            << " p50_ns=" << p50_ns
+            << " p99_ns=" << p99_ns
+            << " avg_ns_per_level=" << (sc.levels ? avg_ns / static_cast<double>(sc.levels) : 0.0)
+            << "\n";
+    }
+
+    void run_sweep_bench(const BenchConfig& cfg) {
+        constexpr std::array<SweepScenario, 2> scenarios = {{
+            {"dense", 256, 1},
+            {"sparse", 24, 4'000},
+        }};
+        for (const auto& sc : scenarios) {
+            run_sweep_scenario(sc, cfg.sweep_rounds);
+        }
+    }
+
+    struct LatencyStats {
+        double avg_ns{0.0};
+        double p50_ns{0.0};
+        double p99_ns{0.0};
+        double p999_ns{0.0};
+    };
+
+    [[nodiscard]] LatencyStats latency_stats(std::vector<uint64_t>& samples) {
+        LatencyStats st{};
+        if (samples.empty()) {
+            return st;
+        }
+        std::sort(samples.begin(), samples.end());
+        uint64_t total = 0;
+        for (uint64_t c : samples) {
+            total += c;
+        }
+        st.avg_ns = cycles_to_ns(total) / static_cast<double>(samples.size());
+        st.p50_ns = cycles_to_ns(samples[samples.size() / 2]);
+        st.p99_ns = cycles_to_ns(samples[(samples.size() * 99) / 100]);
+        st.p999_ns = cycles_to_ns(samples[(samples.size() * 999) / 1000]);
+        return st;
+    }
+
+    struct CascadeScenario {
+        const char* name;
+        std::size_t stops;
+        PriceTick gap;
+    };
+
+    constexpr PriceTick kCascadeMid = 50'000;
+
+    // each round rests one lot and one stop market per step `gap` ticks apart away from the last trade,
+    // then times the one-lot market order whose trade fires the first stop. every stop trades into the
+    // next level and fires the next one, so one submit runs the whole chain. rounds alternate buy stops
+    // up / sell stops down so the price returns to the mid
+    void run_stop_cascade_scenario(const CascadeScenario& sc, std::size_t rounds) {
+        MatchingOrderBook<> book(kMinTick, kSweepMaxTick);
+        OrderId next_id = 1;
+        uint64_t ts = 1;
+        std::vector<uint64_t> samples;
+        samples.reserve(rounds);
+
+        auto submit = [&](OrderType type, Side side, PriceTick px, PriceTick trigger) {
+            OrderParams p{};
+            p.id = next_id++;
+            p.ts = ts++;
+            p.action = OrderAction::New;
+            p.type = type;
+            p.side = side;
+            p.price = px;
+            p.trigger = trigger;
+            p.qty = 1;
+            if (type == OrderType::Market || type == OrderType::StopMarket) {
+                p.tif = TIF::IOC;
+            }
+            return p;
+        };
+
+        // first trade only sets the last trade price
+        book.submit_order(submit(OrderType::Limit, Side::Sell, kCascadeMid, 0));
+        book.submit_order(submit(OrderType::Market, Side::Buy, 0, 0));
+
+        std::size_t fired = 0;
+        for (std::size_t r = 0; r < rounds; ++r) {
+            const bool up = (r % 2) == 0;
+            const Side taker = up ? Side::Buy : Side::Sell;
+            const Side maker = up ? Side::Sell : Side::Buy;
+            const auto step = [&](std::size_t k) {
+                const int64_t d = static_cast<int64_t>(k * sc.gap);
+                return static_cast<PriceTick>(up ? kCascadeMid + d : kCascadeMid + (sc.stops + 1) * sc.gap - d);
+            };
+            const std::size_t before = book.active_stop_order_count();
+            for (std::size_t k = 1; k <= sc.stops + 1; ++k) {
+                book.submit_order(submit(OrderType::Limit, maker, step(k), 0));
+            }
+            for (std::size_t k = 1; k <= sc.stops; ++k) {
+                book.submit_order(submit(OrderType::StopMarket, taker, 0, step(k)));
+            }
+
+            const OrderParams m = submit(OrderType::Market, taker, 0, 0);
+            const uint64_t t0 = __rdtsc();
+            book.submit_order(m);
+            const uint64_t t1 = __rdtsc();
+            samples.push_back(t1 - t0);
+            fired += before + sc.stops - book.active_stop_order_count();
+        }
+
+        const LatencyStats st = latency_stats(samples);
+        std::cout << "stop_cascade[" << sc.name << "] stops=" << sc.stops
+            << " gap_ticks=" << sc.gap
+            << " rounds=" << samples.size()
+            << " fired=" << fired
+            << " avg_ns_per_cascade=" << st.avg_ns
+            << " p50_ns=" << st.p50_ns
+            << " p99_ns=" << st.p99_ns
+            << " avg_ns_per_stop=" << (sc.stops ? st.avg_ns / static_cast<double>(sc.stops) : 0.0)
+            << "\n";
+    }
+
+    void run_stop_cascade_bench(const BenchConfig& cfg) {
+        constexpr std::array<CascadeScenario, 2> scenarios = {{
+            {"dense", 256, 1},
+            {"gapped", 16, 2'000},
+        }};
+        for (const auto& sc : scenarios) {
+            run_stop_cascade_scenario(sc, cfg.stop_cascade_rounds);
+        }
+    }
+
+    constexpr std::size_t kQuoteLevels = 8;
+    constexpr std::size_t kQuotesPerRound = 64;
+    // 1 in kQuoteKeepOneIn quotes survives its round, the rest are cancelled (~97% cancel rate)
+    constexpr uint64_t kQuoteKeepOneIn = 32;
+
+    // quote-stuffing flow: each round rests a burst of one-lot asks over a few levels, cancels ~97% of
+    // them in random order and times a two-lot market buy, about what survives a round. the survivors keep
+    // the fifo blocks mostly dead, which is the case block compaction targets
+    void run_cancel_heavy_scenario(bool compaction, std::size_t rounds, uint64_t seed) {
+        MatchingOrderBook<> book(kMinTick, kMaxTick);
+        book.set_compaction(compaction);
+        std::mt19937_64 rng(seed);
+        OrderId next_id = 1;
+        uint64_t ts = 1;
+        std::vector<OrderId> burst;
+        burst.reserve(kQuotesPerRound);
+        std::vector<uint64_t> match_samples;
+        std::vector<uint64_t> cancel_samples;
+        match_samples.reserve(rounds);
+        cancel_samples.reserve(rounds * kQuotesPerRound);
+        std::size_t peak_block_bytes = 0;
+
+        for (std::size_t r = 0; r < rounds; ++r) {
+            burst.clear();
+            for (std::size_t q = 0; q < kQuotesPerRound; ++q) {
+                OrderParams p{};
+                p.id = next_id++;
+                p.ts = ts++;
+                p.action = OrderAction::New;
+                p.type = OrderType::Limit;
+                p.side = Side::Sell;
+                p.price = static_cast<PriceTick>(kStartMid + rng() % kQuoteLevels);
+                p.qty = 1;
+                book.submit_order(p);
+                if (rng() % kQuoteKeepOneIn != 0) {
+                    burst.push_back(p.id);
+                }
+            }
+            std::shuffle(burst.begin(), burst.end(), rng);
+            for (OrderId id : burst) {
+                OrderParams c{};
+                c.id = id;
+                c.ts = ts++;
+                c.action = OrderAction::Cancel;
+                const uint64_t t0 = __rdtsc();
+                book.submit_order(c);
+                const uint64_t t1 = __rdtsc();
+                cancel_samples.push_back(t1 - t0);
+            }
+            peak_block_bytes = std::max(peak_block_bytes, book.block_bytes());
+
+            OrderParams m{};
+            m.id = next_id++;
+            m.ts = ts++;
+            m.action = OrderAction::New;
+            m.type = OrderType::Market;
+            m.side = Side::Buy;
+            m.qty = 2;
+            const uint64_t t0 = __rdtsc();
+            book.submit_order(m);
+            const uint64_t t1 = __rdtsc();
+            match_samples.push_back(t1 - t0);
+        }
+
+        const LatencyStats match = latency_stats(match_samples);
+        const LatencyStats cancel = latency_stats(cancel_samples);
+        std::size_t resting = 0;
+        for (std::size_t l = 0; l < kQuoteLevels; ++l) {
+            resting += book.level_order_count(Side::Sell, static_cast<PriceTick>(kStartMid + l));
+        }
+        std::cout << "cancel_heavy[" << (compaction ? "compact" : "no_compact") << "] rounds=" << rounds
+            << " resting=" << resting
+            << " block_bytes=" << book.block_bytes()
+            << " peak_block_bytes=" << peak_block_bytes
+            << " match_avg_ns=" << match.avg_ns
+            << " match_p50_ns=" << match.p50_ns
+            << " match_p99_ns=" << match.p99_ns
+            << " cancel_avg_ns=" << cancel.avg_ns
+            << " cancel_p99_ns=" << cancel.p99_ns
+            << "\n";
+    }
+
+    void run_cancel_heavy_bench(const BenchConfig& cfg) {
+        run_cancel_heavy_scenario(false, cfg.cancel_heavy_rounds, cfg.seed);
+        run_cancel_heavy_scenario(true, cfg.cancel_heavy_rounds, cfg.seed);
+    }
+
+    // steady book of kLocatorLive resting orders: every new order is followed by a cancel of a random
+    // live one, every fourth also by a qty-down modify. 1 in kLocatorKeepOneIn orders is never cancelled,
+    // so old ids keep resting while the lifetime order count grows
+    constexpr std::size_t kLocatorLive = 100'000;
+    constexpr uint64_t kLocatorKeepOneIn = 1'000;
+    constexpr std::size_t kLocatorSamples = 1 << 20;
+
+    void run_locator_scale_scenario(std::size_t lifetime, uint64_t seed) {
+        MatchingOrderBook<> book(kMinTick, kMaxTick);
+        std::mt19937_64 rng(seed);
+        OrderId next_id = 1;
+        uint64_t ts = 1;
+        struct LiveOrder {
+            OrderId id;
+            PriceTick price;
+        };
+        std::vector<LiveOrder> live;
+        live.reserve(kLocatorLive + 1);
+        std::size_t kept = 0;
+        // sample a bounded number of ops so the sample buffers do not grow with lifetime
+        const std::size_t stride = std::max<std::size_t>(1, lifetime / kLocatorSamples);
+        std::vector<uint64_t> cancel_samples;
+        std::vector<uint64_t> modify_samples;
+        cancel_samples.reserve(kLocatorSamples + 1);
+        modify_samples.reserve(kLocatorSamples / 4 + 1);
+
+        auto place = [&] {
+            OrderParams p{};
+            p.id = next_id++;
+            p.ts = ts++;
+            p.action = OrderAction::New;
+            p.type = OrderType::Limit;
+            p.side = (p.id & 1) ? Side::Buy : Side::Sell;
+            const auto off = static_cast<PriceTick>(1 + rng() % 200);
+            p.price = p.side == Side::Buy ? kStartMid - off : kStartMid + off;
+            p.qty = 1'000'000;
+            book.submit_order(p);
+            if (rng() % kLocatorKeepOneIn == 0) {
+                ++kept;
+            }
+            else {
+                live.push_back(LiveOrder{p.id, p.price});
+            }
+        };
+
+        while (live.size() < kLocatorLive) {
+            place();
+        }
+        for (std::size_t i = 0; next_id <= lifetime; ++i) {
+            place();
+            const bool sample = i % stride == 0;
+            if ((i & 3) == 0) {
+                const LiveOrder& o = live[rng() % live.size()];
+                OrderParams m{};
+                m.id = o.id;
+                m.ts = ts++;
+                m.action = OrderAction::Modify;
+                // same price, one lot less: stays in place
+                m.price = o.price;
+                m.qty = static_cast<Qty>(book.order_qty(o.id) - 1);
+                const uint64_t t0 = __rdtsc();
+                book.submit_order(m);
+                const uint64_t t1 = __rdtsc();
+                if (sample) {
+                    modify_samples.push_back(t1 - t0);
+                }
+            }
+            const std::size_t k = rng() % live.size();
+            OrderParams c{};
+            c.id = live[k].id;
+            c.ts = ts++;
+            c.action = OrderAction::Cancel;
+            live[k] = live.back();
+            live.pop_back();
+            const uint64_t t0 = __rdtsc();
+            book.submit_order(c);
+            const uint64_t t1 = __rdtsc();
+            if (sample) {
+                cancel_samples.push_back(t1 - t0);
+            }
+        }
+
+        const LatencyStats cancel = latency_stats(cancel_samples);
+        const LatencyStats modify = latency_stats(modify_samples);
+        std::cout << "locator_scale lifetime_orders=" << lifetime
+            << " resting=" << book.active_limit_order_count()
+            << " long_lived=" << kept
+            << " locator_bytes=" << book.locator_bytes()
+            << " cancel_avg_ns=" << cancel.avg_ns
+            << " cancel_p50_ns=" << cancel.p50_ns
+            << " cancel_p99_ns=" << cancel.p99_ns
+            << " modify_avg_ns=" << modify.avg_ns
+            << " modify_p50_ns=" << modify.p50_ns
+            << " modify_p99_ns=" << modify.p99_ns
+            << "\n";
+    }
+
+    void run_locator_scale_bench(const BenchConfig& cfg) {
+        for (std::size_t lifetime : {std::size_t{1'000'000}, std::size_t{10'000'000}, std::size_t{50'000'000}}) {
+            if (lifetime > cfg.locator_max_orders) {
+                break;
+            }
+            run_locator_scale_scenario(lifetime, cfg.seed);
+        }
     }
 
     void print_summary(
@@ -846,6 +1373,9 @@ namespace {
         const Counters& counters,
         std::size_t measured_events,
         double submit_only_ns,
+        double p50_ns,
+        double p99_ns,
+        std::size_t ladder_bytes,
         std::size_t tracked_limits,
         std::size_t tracked_stops) {
         const double branching_ratio = cfg.hawkes.alpha / cfg.hawkes.beta;
@@ -874,19 +1404,825 @@ namespace {
             << " tracked_stops=" << tracked_stops
             << "\n";
 
+        std::cout << "ladder=" << (cfg.ladder == LadderKind::Dense ? "dense" : "paged")
+            << " layout=" << (cfg.layout == SlotLayout::Aos ? "aos" : "soa")
+            << " ladder_bytes=" << ladder_bytes
+            << " p50_ns=" << p50_ns
+            << " p99_ns=" << p99_ns
+            << "\n";
+
         std::cout << "realized_mix(% of measured):\n";
         for (std::size_t i = 0; i < static_cast<std::size_t>(OpType::Count); ++i) {
             const double pct = (measured_events > 0)
                                    ? (100.0 * static_cast<double>(counters.attempted[i]) / static_cast<double>(
                                        measured_events))
                                    : 0.0;
+            const double op_avg_ns = counters.attempted[i] > 0
+                                         ? cycles_to_ns(counters.cycles[i]) / static_cast<double>(counters.attempted[i])
+                                         : 0.0;
             std::cout << "  " << kOpNames[i]
                 << "=" << pct
                 << "% accepted=" << counters.accepted[i]
                 << "/" << counters.attempted[i]
+                << " avg_ns=" << op_avg_ns
                 << "\n";
         }
     }
+
+    template <typename Book>
+    int run_bench(const BenchConfig& cfg) {
+        Book book(kMinTick, kMaxTick);
+        BenchDriver<Book> driver(book, cfg.seed);
+
+        driver.preseed(cfg);
+
+        std::mt19937_64 hawkes_rng(cfg.seed ^ 0x9e3779b97f4a7c15ULL);
+        std::vector<uint64_t> timestamps = build_hawkes_timestamps(cfg.events, cfg.hawkes, hawkes_rng);
+        std::vector<OpType> ops = build_operation_plan(cfg.events, cfg.seed ^ 0xbf58476d1ce4e5b9ULL);
+
+        for (std::size_t i = 0; i < cfg.warmup; ++i) {
+            const OrderParams p = driver.make_order(ops[i], timestamps[i]);
+            const BookEvent ev = book.submit_order(p);
+            driver.apply(p, ev);
+        }
+
+        Counters counters{};
+        uint64_t submit_cycles = 0;
+        std::vector<uint64_t> samples;
+        samples.reserve(cfg.events - cfg.warmup);
+        for (std::size_t i = cfg.warmup; i < cfg.events; ++i) {
+            const OpType op = ops[i];
+            const OrderParams p = driver.make_order(op, timestamps[i]);
+            const uint64_t t2 = __rdtsc();
+            const BookEvent ev = book.submit_order(p);
+            const uint64_t t3 = __rdtsc();
+            submit_cycles += (t3 - t2);
+            samples.push_back(t3 - t2);
+            counters.cycles[static_cast<std::size_t>(op)] += t3 - t2;
+            driver.apply(p, ev);
+            driver.update_counters(op, ev, counters);
+        }
+        const double submit_only_ns = cycles_to_ns(submit_cycles);
+
+        std::sort(samples.begin(), samples.end());
+        const double p50_ns = samples.empty() ? 0.0 : cycles_to_ns(samples[samples.size() / 2]);
+        const double p99_ns = samples.empty() ? 0.0 : cycles_to_ns(samples[(samples.size() * 99) / 100]);
+
+        const std::size_t measured = cfg.events - cfg.warmup;
+
+        print_summary(
+            cfg,
+            counters,
+            measured,
+            submit_only_ns,
+            p50_ns,
+            p99_ns,
+            book.ladder_bytes(),
+            driver.tracked_limits(),
+            driver.tracked_stops());
+
+        return 0;
+    }
+
+    // replays the mixed workload in chunks of batch orders, either through submit_batch or through a
+    // plain submit_order loop over the same chunk. a chunk is generated up front from the book state at
+    // its start, so later orders in it may target ids an earlier one already filled, the same as a
+    // drained ring. only the book's time is counted, the driver's bookkeeping between orders is not
+    template <typename Book>
+    void run_batch_scenario(const BenchConfig& cfg, std::size_t batch, bool batched) {
+        Book book(kMinTick, kMaxTick);
+        BenchDriver<Book> driver(book, cfg.seed);
+        driver.preseed(cfg);
+
+        std::mt19937_64 hawkes_rng(cfg.seed ^ 0x9e3779b97f4a7c15ULL);
+        std::vector<uint64_t> timestamps = build_hawkes_timestamps(cfg.events, cfg.hawkes, hawkes_rng);
+        std::vector<OpType> ops = build_operation_plan(cfg.events, cfg.seed ^ 0xbf58476d1ce4e5b9ULL);
+
+        for (std::size_t i = 0; i < cfg.warmup; ++i) {
+            const OrderParams p = driver.make_order(ops[i], timestamps[i]);
+            driver.apply(p, book.submit_order(p));
+        }
+
+        uint64_t book_cycles = 0;
+        uint64_t mark = 0;
+        auto on_event = [&](const OrderParams& p, const BookEvent& ev) {
+            book_cycles += __rdtsc() - mark;
+            driver.apply(p, ev);
+            mark = __rdtsc();
+        };
+        std::vector<OrderParams> chunk;
+        chunk.reserve(batch);
+        for (std::size_t i = cfg.warmup; i < cfg.events;) {
+            chunk.clear();
+            for (; chunk.size() < batch && i < cfg.events; ++i) {
+                chunk.push_back(driver.make_order(ops[i], timestamps[i]));
+            }
+            mark = __rdtsc();
+            if (batched) {
+                book.submit_batch(chunk, on_event);
+            }
+            else {
+                for (const OrderParams& p : chunk) {
+                    on_event(p, book.submit_order(p));
+                }
+            }
+            book_cycles += __rdtsc() - mark;
+        }
+
+        const std::size_t measured = cfg.events - cfg.warmup;
+        const double avg_ns = measured > 0 ? cycles_to_ns(book_cycles) / static_cast<double>(measured) : 0.0;
+        std::cout << "batch_sweep batch=" << batch
+            << " mode=" << (batched ? "submit_batch" : "submit_order")
+            << " measured=" << measured
+            << " avg_ns_per_op=" << avg_ns
+            << " tracked_limits=" << driver.tracked_limits()
+            << " tracked_stops=" << driver.tracked_stops()
+            << "\n";
+    }
+
+    void run_batch_sweep(const BenchConfig& cfg) {
+        for (std::size_t batch : {1, 2, 4, 8, 16, 32, 64, 128}) {
+            run_batch_scenario<MatchingOrderBook<>>(cfg, batch, false);
+            run_batch_scenario<MatchingOrderBook<>>(cfg, batch, true);
+        }
+    }
+
+    enum class SnapshotMode : uint8_t { Off, Sync, Shadow };
+
+    // the exchange's delta path: deltas are written in place into the ring and published once per order
+    // with the last one flagged, as Exchange::stream_delta / flush_deltas do
+    struct DeltaStream {
+        using Ring = SharedSpscQueue<jolt::SnapshotDeltaMsg, 1 << 16>;
+        Ring* ring{nullptr};
+        std::size_t pending{0};
+
+        static void on_delta(void* ctx, const jolt::ob::BookDelta& d) {
+            auto& s = *static_cast<DeltaStream*>(ctx);
+            jolt::SnapshotDeltaMsg* rec = s.ring->alloc(s.pending);
+            // the exchange drops on a full ring, here the reader is waited for so the shadow stays whole
+            while (!rec) {
+                if (s.pending > 0) {
+                    s.ring->push(s.pending);
+                    s.pending = 0;
+                }
+                std::this_thread::yield();
+                rec = s.ring->alloc(0);
+            }
+            *rec = jolt::SnapshotDeltaMsg{d.id, d.seq, d.qty, d.price, 0, d.side, d.type, 0};
+            ++s.pending;
+        }
+
+        void flush() {
+            if (pending == 0) {
+                return;
+            }
+            ring->alloc(pending - 1)->flags = jolt::SnapshotDeltaMsg::kLastInOrder;
+            ring->push(pending);
+            pending = 0;
+        }
+    };
+
+    // matching thread latency of the mixed workload with a snapshot every `snapshot_every` orders: none,
+    // cut inline with get_snapshot (the old exchange path), or cut by a reader thread from a ShadowBook fed
+    // through the delta ring. the matching thread pays for the deltas it streams, not for the snapshots
+    template <typename Book>
+    void run_snapshot_scenario(const BenchConfig& cfg, SnapshotMode mode) {
+        Book book(kMinTick, kMaxTick);
+        BenchDriver<Book> driver(book, cfg.seed);
+
+        DeltaStream::Ring ring("matching_engine_bench_deltas", SharedRingMode::Create);
+        DeltaStream stream{&ring};
+        std::atomic<uint64_t> requested{0};
+        std::atomic<bool> done{false};
+        std::size_t served = 0;
+        jolt::ob::BookSnapshot shadow_final{};
+        std::thread reader;
+        if (mode == SnapshotMode::Shadow) {
+            book.set_delta_sink({&stream, &DeltaStream::on_delta});
+            reader = std::thread([&] {
+                jolt::ob::ShadowBook shadow(kMinTick, kMaxTick);
+                jolt::ob::BookSnapshot snap{};
+                bool mid_order = false;
+                uint64_t answered = 0;
+                while (true) {
+                    const bool finished = done.load(std::memory_order_acquire);
+                    const std::size_t n = ring.drain([&](const jolt::SnapshotDeltaMsg& m) {
+                        mid_order = !m.last_in_order();
+                        shadow.apply(jolt::ob::BookDelta{m.id, m.seq, m.qty, m.price, m.side, m.type});
+                    });
+                    const uint64_t want = requested.load(std::memory_order_acquire);
+                    if (!mid_order && answered < want) {
+                        shadow.snapshot(snap);
+                        answered = want;
+                        ++served;
+                    }
+                    if (finished && n == 0) {
+                        break;
+                    }
+                    if (n == 0) {
+                        std::this_thread::yield();
+                    }
+                }
+                shadow.snapshot(shadow_final);
+            });
+        }
+
+        driver.preseed(cfg);
+        stream.flush();
+
+        std::mt19937_64 hawkes_rng(cfg.seed ^ 0x9e3779b97f4a7c15ULL);
+        std::vector<uint64_t> timestamps = build_hawkes_timestamps(cfg.events, cfg.hawkes, hawkes_rng);
+        std::vector<OpType> ops = build_operation_plan(cfg.events, cfg.seed ^ 0xbf58476d1ce4e5b9ULL);
+
+        for (std::size_t i = 0; i < cfg.warmup; ++i) {
+            const OrderParams p = driver.make_order(ops[i], timestamps[i]);
+            driver.apply(p, book.submit_order(p));
+            stream.flush();
+        }
+
+        jolt::ob::BookSnapshot snap{};
+        std::vector<uint64_t> samples;
+        samples.reserve(cfg.events - cfg.warmup);
+        std::size_t since = 0;
+        for (std::size_t i = cfg.warmup; i < cfg.events; ++i) {
+            const OrderParams p = driver.make_order(ops[i], timestamps[i]);
+            const uint64_t t0 = __rdtsc();
+            const BookEvent ev = book.submit_order(p);
+            if (mode == SnapshotMode::Shadow) {
+                stream.flush();
+            }
+            const bool due = ++since >= cfg.snapshot_every;
+            if (due && mode == SnapshotMode::Sync) {
+                book.get_snapshot(snap);
+                ++served;
+            }
+            const uint64_t t1 = __rdtsc();
+            samples.push_back(t1 - t0);
+            if (due) {
+                since = 0;
+                // the request reaches the reader without passing the matching thread in the exchange
+                requested.fetch_add(1, std::memory_order_release);
+            }
+            driver.apply(p, ev);
+        }
+
+        bool consistent = true;
+        if (mode == SnapshotMode::Shadow) {
+            done.store(true, std::memory_order_release);
+            reader.join();
+            book.get_snapshot(snap);
+            consistent = snap.orders.size() == shadow_final.orders.size();
+            for (std::size_t k = 0; consistent && k < snap.orders.size(); ++k) {
+                consistent = snap.orders[k].id == shadow_final.orders[k].id &&
+                             snap.orders[k].qty == shadow_final.orders[k].qty;
+            }
+        }
+
+        constexpr std::array<const char*, 3> kModeNames = {"off", "sync", "shadow"};
+        const LatencyStats st = latency_stats(samples);
+        std::cout << "snapshots mode=" << kModeNames[static_cast<std::size_t>(mode)]
+            << " every=" << cfg.snapshot_every
+            << " measured=" << samples.size()
+            << " snapshots=" << served
+            << " avg_ns=" << st.avg_ns
+            << " p50_ns=" << st.p50_ns
+            << " p99_ns=" << st.p99_ns
+            << " p999_ns=" << st.p999_ns
+            << " max_ns=" << (samples.empty() ? 0.0 : cycles_to_ns(samples.back()))
+            << " resting=" << book.active_limit_order_count();
+        if (mode == SnapshotMode::Shadow) {
+            std::cout << " shadow_matches_book=" << (consistent ? "yes" : "no");
+        }
+        std::cout << "\n";
+    }
+
+    void run_snapshot_bench(const BenchConfig& cfg) {
+        for (SnapshotMode mode : {SnapshotMode::Off, SnapshotMode::Sync, SnapshotMode::Shadow}) {
+            run_snapshot_scenario<MatchingOrderBook<>>(cfg, mode);
+        }
+    }
+
+    using DepthArray = std::array<jolt::ob::DepthLevel, jolt::kL2Levels>;
+
+    // top of a side the way it had to be read before the depth cache: tick by tick out from the best
+    // price, probing every level of the ladder
+    template <typename Book>
+    std::size_t probe_top(const Book& book, Side side, DepthArray& out) {
+        std::size_t n = 0;
+        PriceTick px = side == Side::Buy ? book.best_bid() : book.best_ask();
+        while (px != 0 && n < out.size() && px >= kMinTick && px <= kMaxTick) {
+            if (const Qty q = book.level_active_qty(side, px)) {
+                out[n++] = jolt::ob::DepthLevel{px, q, static_cast<uint32_t>(book.level_order_count(side, px))};
+            }
+            px = side == Side::Buy ? px - 1 : px + 1;
+        }
+        return n;
+    }
+
+    // cost of reading top-10 depth after every order of the mixed workload: probing the ladder vs copying
+    // book_top, plus writing and reading the result through the exchange's L2 seqlock table
+    template <typename Book>
+    void run_depth_bench(const BenchConfig& cfg) {
+        Book book(kMinTick, kMaxTick);
+        BenchDriver<Book> driver(book, cfg.seed);
+        driver.preseed(cfg);
+
+        std::optional<SeqlockTable<jolt::L2Frame>> table;
+        try {
+            table.emplace("matching_engine_bench_l2", SeqlockMode::Create, 1);
+        }
+        catch (const std::exception& e) {
+            std::cout << "depth l2 table unavailable: " << e.what() << "\n";
+        }
+
+        std::mt19937_64 hawkes_rng(cfg.seed ^ 0x9e3779b97f4a7c15ULL);
+        std::vector<uint64_t> timestamps = build_hawkes_timestamps(cfg.events, cfg.hawkes, hawkes_rng);
+        std::vector<OpType> ops = build_operation_plan(cfg.events, cfg.seed ^ 0xbf58476d1ce4e5b9ULL);
+        for (std::size_t i = 0; i < cfg.warmup; ++i) {
+            const OrderParams p = driver.make_order(ops[i], timestamps[i]);
+            driver.apply(p, book.submit_order(p));
+        }
+
+        std::vector<uint64_t> probe_samples;
+        std::vector<uint64_t> cache_samples;
+        std::vector<uint64_t> publish_samples;
+        std::vector<uint64_t> read_samples;
+        probe_samples.reserve(cfg.events - cfg.warmup);
+        cache_samples.reserve(cfg.events - cfg.warmup);
+        std::size_t mismatches = 0;
+        std::size_t republished = 0;
+        uint64_t published_version = 0;
+        uint64_t sink = 0;
+        DepthArray probed_bids{};
+        DepthArray probed_asks{};
+        jolt::L2Frame frame{};
+        jolt::L2Frame read_back{};
+        for (std::size_t i = cfg.warmup; i < cfg.events; ++i) {
+            const OrderParams p = driver.make_order(ops[i], timestamps[i]);
+            driver.apply(p, book.submit_order(p));
+
+            const uint64_t t0 = __rdtsc();
+            const std::size_t nb = probe_top(book, Side::Buy, probed_bids);
+            const std::size_t na = probe_top(book, Side::Sell, probed_asks);
+            const uint64_t t1 = __rdtsc();
+            const auto bids = book.book_top(Side::Buy, jolt::kL2Levels);
+            const auto asks = book.book_top(Side::Sell, jolt::kL2Levels);
+            std::copy(bids.begin(), bids.end(), frame.bids.begin());
+            std::copy(asks.begin(), asks.end(), frame.asks.begin());
+            frame.bid_ct = static_cast<uint8_t>(bids.size());
+            frame.ask_ct = static_cast<uint8_t>(asks.size());
+            const uint64_t t2 = __rdtsc();
+            probe_samples.push_back(t1 - t0);
+            cache_samples.push_back(t2 - t1);
+            sink += nb + na + frame.bids[0].qty;
+
+            if (table && book.depth_version() != published_version) {
+                published_version = book.depth_version();
+                const uint64_t t3 = __rdtsc();
+                table->write(0, [&](jolt::L2Frame& f) { f = frame; });
+                const uint64_t t4 = __rdtsc();
+                table->read(0, read_back);
+                const uint64_t t5 = __rdtsc();
+                publish_samples.push_back(t4 - t3);
+                read_samples.push_back(t5 - t4);
+                ++republished;
+            }
+
+            bool same = nb == bids.size() && na == asks.size();
+            for (std::size_t k = 0; same && k < nb; ++k) {
+                same = probed_bids[k].px == bids[k].px && probed_bids[k].qty == bids[k].qty &&
+                    probed_bids[k].orders == bids[k].orders;
+            }
+            for (std::size_t k = 0; same && k < na; ++k) {
+                same = probed_asks[k].px == asks[k].px && probed_asks[k].qty == asks[k].qty &&
+                    probed_asks[k].orders == asks[k].orders;
+            }
+            mismatches += same ? 0 : 1;
+        }
+
+        const auto print = [](const char* name, std::vector<uint64_t>& samples) {
+            const LatencyStats st = latency_stats(samples);
+            std::cout << "depth read=" << name
+                << " samples=" << samples.size()
+                << " avg_ns=" << st.avg_ns
+                << " p50_ns=" << st.p50_ns
+                << " p99_ns=" << st.p99_ns
+                << " p999_ns=" << st.p999_ns << "\n";
+        };
+        print("probe", probe_samples);
+        print("book_top", cache_samples);
+        if (table) {
+            print("l2_publish", publish_samples);
+            print("l2_read", read_samples);
+        }
+        std::cout << "depth levels=" << jolt::kL2Levels
+            << " republished=" << republished
+            << " mismatches=" << mismatches
+            << " resting=" << book.active_limit_order_count()
+            << " sink=" << (sink & 1) << "\n";
+    }
+
+    bool same_snapshot(const jolt::ob::BookSnapshot& a, const jolt::ob::BookSnapshot& b) {
+        if (a.orders.size() != b.orders.size() || a.bid_ct != b.bid_ct || a.seq != b.seq) {
+            return false;
+        }
+        for (std::size_t k = 0; k < a.orders.size(); ++k) {
+            if (a.orders[k].id != b.orders[k].id || a.orders[k].qty != b.orders[k].qty ||
+                a.orders[k].px != b.orders[k].px) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // matching thread cost of journaling every order the way the exchange does: append before the book
+    // sees it, tick once per drained batch of Exchange::kDrainBatch orders. then rebuilds a fresh book from
+    // the journal file and checks it against the live one
+    template <typename Book>
+    void run_journal_bench(const BenchConfig& cfg, bool journaled) {
+        constexpr std::size_t kTickEvery = 32;
+        const std::string path = (std::filesystem::temp_directory_path() / "matching_engine_bench.wal").string();
+        std::filesystem::remove(path);
+
+        Book book(kMinTick, kMaxTick);
+        BenchDriver<Book> driver(book, cfg.seed);
+        std::optional<InputJournal> journal;
+        if (journaled) {
+            JournalOptions opts{};
+            opts.window = std::chrono::microseconds(cfg.journal_window_us);
+            opts.sync = cfg.journal_sync;
+            journal.emplace(path, opts);
+        }
+        const auto submit = [&](const OrderParams& p) {
+            if (journal) {
+                journal->append(p);
+            }
+            return book.submit_order(p);
+        };
+
+        driver.preseed(cfg, [&](const OrderParams& p) {
+            if (journal) {
+                journal->append(p);
+            }
+        });
+
+        std::mt19937_64 hawkes_rng(cfg.seed ^ 0x9e3779b97f4a7c15ULL);
+        std::vector<uint64_t> timestamps = build_hawkes_timestamps(cfg.events, cfg.hawkes, hawkes_rng);
+        std::vector<OpType> ops = build_operation_plan(cfg.events, cfg.seed ^ 0xbf58476d1ce4e5b9ULL);
+        for (std::size_t i = 0; i < cfg.warmup; ++i) {
+            const OrderParams p = driver.make_order(ops[i], timestamps[i]);
+            driver.apply(p, submit(p));
+        }
+
+        std::vector<uint64_t> samples;
+        samples.reserve(cfg.events - cfg.warmup);
+        for (std::size_t i = cfg.warmup; i < cfg.events; ++i) {
+            const OrderParams p = driver.make_order(ops[i], timestamps[i]);
+            const uint64_t t0 = __rdtsc();
+            const BookEvent ev = submit(p);
+            if (journal && (i % kTickEvery) == 0) {
+                journal->tick();
+            }
+            const uint64_t t1 = __rdtsc();
+            samples.push_back(t1 - t0);
+            driver.apply(p, ev);
+        }
+
+        const LatencyStats st = latency_stats(samples);
+        std::cout << "journal mode=" << (journaled ? (cfg.journal_sync ? "sync" : "nosync") : "off")
+            << " window_us=" << cfg.journal_window_us
+            << " measured=" << samples.size()
+            << " avg_ns=" << st.avg_ns
+            << " p50_ns=" << st.p50_ns
+            << " p99_ns=" << st.p99_ns
+            << " p999_ns=" << st.p999_ns
+            << " max_ns=" << (samples.empty() ? 0.0 : cycles_to_ns(samples.back()));
+        if (!journal) {
+            std::cout << "\n";
+            return;
+        }
+        journal->sync_all();
+        std::cout << " durable_lsn=" << journal->durable_lsn() << "\n";
+
+        Book rebuilt(kMinTick, kMaxTick);
+        JournalReader reader(path);
+        const auto r0 = std::chrono::steady_clock::now();
+        const JournalReader::Stats rs = reader.replay(0, [&](const jolt::JournalRecord& r) {
+            rebuilt.submit_order(r.order);
+        });
+        const auto r1 = std::chrono::steady_clock::now();
+        const double secs = std::chrono::duration<double>(r1 - r0).count();
+
+        jolt::ob::BookSnapshot live{};
+        jolt::ob::BookSnapshot replayed{};
+        book.get_snapshot(live);
+        rebuilt.get_snapshot(replayed);
+        std::cout << "journal replay records=" << rs.records
+            << " bytes=" << rs.end_offset
+            << " secs=" << secs
+            << " events_per_sec=" << (secs > 0 ? static_cast<double>(rs.records) / secs : 0.0)
+            << " book_orders=" << live.orders.size()
+            << " replay_matches_book=" << (same_snapshot(live, replayed) ? "yes" : "no") << "\n";
+        std::filesystem::remove(path);
+    }
+
+    // warm restart of a book holding cfg.checkpoint_orders resting orders (plus a stop and a take-profit
+    // per 16 limits): building it through submit_order, which is what a journal replay costs at best,
+    // against save_image on the matching thread, the checkpoint write on the writer thread, and mapping the
+    // file and load_image into a fresh book. recapture is the next save_image into the same image after
+    // cancels of 1% of the orders within 20 ticks of the mid, which only copies the levels they touched
+    template <typename Book>
+    void run_checkpoint_bench(const BenchConfig& cfg) {
+        using clock = std::chrono::steady_clock;
+        const auto ms_since = [](clock::time_point t0) {
+            return std::chrono::duration<double, std::milli>(clock::now() - t0).count();
+        };
+        const std::string path = (std::filesystem::temp_directory_path() / "matching_engine_bench.ckpt").string();
+        std::filesystem::remove(path);
+
+        // non crossing limits spread over 2000 ticks a side, stops and take-profits away from the market
+        std::mt19937_64 rng(cfg.seed);
+        std::vector<OrderParams> orders;
+        orders.reserve(cfg.checkpoint_orders + cfg.checkpoint_orders / 8);
+        uint64_t id = 1;
+        for (std::size_t i = 0; i < cfg.checkpoint_orders; ++i) {
+            OrderParams p{};
+            p.id = id++;
+            p.client_id = 1 + rng() % 1000;
+            p.qty = static_cast<Qty>(1 + rng() % 100);
+            p.side = (rng() & 1) ? Side::Buy : Side::Sell;
+            p.type = OrderType::Limit;
+            const auto off = static_cast<PriceTick>(1 + rng() % 2000);
+            p.price = p.side == Side::Buy ? kStartMid - off : kStartMid + off;
+            orders.push_back(p);
+            if (i % 16 == 0) {
+                OrderParams sp = p;
+                sp.id = id++;
+                sp.type = OrderType::StopLimit;
+                sp.trigger = p.side == Side::Buy ? kStartMid + off : kStartMid - off;
+                sp.limit_px = sp.trigger;
+                orders.push_back(sp);
+                OrderParams tp = p;
+                tp.id = id++;
+                tp.type = OrderType::TakeProfit;
+                tp.side = p.side == Side::Buy ? Side::Sell : Side::Buy;
+                tp.trigger = p.side == Side::Buy ? kStartMid + off : kStartMid - off;
+                tp.limit_px = tp.trigger;
+                orders.push_back(tp);
+            }
+        }
+
+        auto live = std::make_unique<Book>(kMinTick, kMaxTick);
+        auto t0 = clock::now();
+        for (const OrderParams& p : orders) {
+            live->submit_order(p);
+        }
+        const double replay_ms = ms_since(t0);
+
+        double capture_ms = 0;
+        double recapture_ms = 0;
+        std::size_t recopied_runs = 0;
+        double write_ms = 0;
+        {
+            CheckpointOptions opts{};
+            CheckpointWriter writer(path, opts, nullptr);
+            writer.books().resize(1);
+            t0 = clock::now();
+            live->save_image(writer.books()[0].image);
+            capture_ms = ms_since(t0);
+            for (std::size_t i = 0, n = 0; i < orders.size() && n < orders.size() / 100; ++i) {
+                const PriceTick px = orders[i].price;
+                if (orders[i].type != OrderType::Limit || px + 20 < kStartMid || px > kStartMid + 20) {
+                    continue;
+                }
+                OrderParams c{};
+                c.action = OrderAction::Cancel;
+                c.id = orders[i].id;
+                live->submit_order(c);
+                ++n;
+            }
+            t0 = clock::now();
+            live->save_image(writer.books()[0].image);
+            recapture_ms = ms_since(t0);
+            recopied_runs = writer.books()[0].image.copied_runs;
+            t0 = clock::now();
+            writer.submit(orders.size(), 0);
+            writer.wait_idle();
+            write_ms = ms_since(t0);
+        }
+        const uint64_t file_bytes = std::filesystem::file_size(path);
+
+        auto loaded = std::make_unique<Book>(kMinTick, kMaxTick);
+        t0 = clock::now();
+        {
+            const CheckpointFile file(path);
+            loaded->load_image(file.books().at(0).view);
+        }
+        const double load_ms = ms_since(t0);
+
+        jolt::ob::BookSnapshot a{};
+        jolt::ob::BookSnapshot b{};
+        live->get_snapshot(a);
+        loaded->get_snapshot(b);
+        const bool same = same_snapshot(a, b) && live->active_stop_order_count() == loaded->active_stop_order_count();
+        std::cout << "checkpoint resting=" << live->active_limit_order_count()
+            << " stops=" << live->active_stop_order_count()
+            << " file_mb=" << static_cast<double>(file_bytes) / (1 << 20)
+            << " submit_ms=" << replay_ms
+            << " capture_ms=" << capture_ms
+            << " recapture_ms=" << recapture_ms
+            << " recopied_runs=" << recopied_runs
+            << " write_ms=" << write_ms
+            << " load_ms=" << load_ms
+            << " load_orders_per_sec=" << (load_ms > 0 ? static_cast<double>(orders.size()) / (load_ms / 1000.0) : 0.0)
+            << " load_matches_book=" << (same ? "yes" : "no") << "\n";
+        std::filesystem::remove(path);
+    }
+
+    // l3 writer as the matching thread drives it: one append per book event spread over the default symbols,
+    // a tick per drained batch of Exchange::kDrainBatch orders. reports the matching thread's cost per record
+    // and the records/s that reach disk including the final flush, then reads the files back: full decode
+    // throughput and the cost of a seq seek
+    void run_writer_bench(const BenchConfig& cfg) {
+        constexpr std::size_t kTickEvery = 32;
+        const std::filesystem::path root = std::filesystem::temp_directory_path() / "matching_engine_bench_l3";
+        std::filesystem::remove_all(root);
+        const jolt::InstrumentRegistry instruments = jolt::InstrumentRegistry::make_default(kMinTick, kMaxTick);
+
+        std::mt19937_64 rng(cfg.seed);
+        std::vector<uint16_t> symbols(cfg.writer_records);
+        for (auto& s : symbols) {
+            s = static_cast<uint16_t>(rng() % instruments.size());
+        }
+
+        std::vector<uint64_t> samples;
+        samples.reserve(cfg.writer_records / kTickEvery + 1);
+        double flush_ms = 0;
+        const auto t0 = std::chrono::steady_clock::now();
+        {
+            L3DataWriter writer(root.string(), instruments);
+            std::cout << "writer fixed_buffers=" << (writer.fixed_buffers() ? "yes" : "no")
+                << " fixed_files=" << (writer.fixed_files() ? "yes" : "no") << "\n";
+            jolt::ob::L3Data data{};
+            data.event_type = BookEventType::New;
+            for (std::size_t i = 0; i < cfg.writer_records; i += kTickEvery) {
+                const std::size_t end = std::min(i + kTickEvery, cfg.writer_records);
+                const uint64_t c0 = __rdtsc();
+                for (std::size_t j = i; j < end; ++j) {
+                    const size_t idx = symbols[j];
+                    data.id = j + 1;
+                    data.seq = j + 1;
+                    data.symbol_id = instruments.at(idx).symbol_id;
+                    data.price = static_cast<PriceTick>(kStartMid + static_cast<PriceTick>(j % 64));
+                    data.qty = static_cast<Qty>(1 + j % 100);
+                    data.ts = 1'000'000'000ull + j * 250;
+                    writer.append(idx, data);
+                }
+                writer.tick();
+                samples.push_back(__rdtsc() - c0);
+            }
+            const auto f0 = std::chrono::steady_clock::now();
+            writer.flush();
+            flush_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - f0).count();
+        }
+        const double secs = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+
+        uint64_t cycles = 0;
+        for (const uint64_t c : samples) {
+            cycles += c;
+        }
+        std::sort(samples.begin(), samples.end());
+        std::uintmax_t bytes = 0;
+        std::vector<std::string> files;
+        for (const auto& e : std::filesystem::recursive_directory_iterator(root)) {
+            if (e.is_regular_file()) {
+                bytes += e.file_size();
+                files.push_back(e.path().string());
+            }
+        }
+
+        // read side: every file decoded front to back, then random seq seeks
+        uint64_t decoded = 0;
+        uint64_t seq_breaks = 0;
+        // seeks that landed on a block starting after the seq asked for
+        uint64_t seek_misses = 0;
+        double decode_secs = 0;
+        double seek_ns = 0;
+        constexpr std::size_t kSeeks = 100'000;
+        std::vector<jolt::ob::L3Data> buf;
+        for (const std::string& f : files) {
+            const jolt::l3::Reader reader(f);
+            const auto d0 = std::chrono::steady_clock::now();
+            uint64_t prev = 0;
+            for (std::size_t b = 0; b < reader.blocks(); ++b) {
+                buf.resize(reader.index()[b].count);
+                reader.decode(b, buf.data());
+                for (const auto& r : buf) {
+                    seq_breaks += r.seq < prev;
+                    prev = r.seq;
+                }
+                decoded += buf.size();
+            }
+            decode_secs += std::chrono::duration<double>(std::chrono::steady_clock::now() - d0).count();
+
+            if (reader.blocks() == 0) {
+                continue;
+            }
+            const auto& index = reader.index();
+            const uint64_t s0 = __rdtsc();
+            for (std::size_t k = 0; k < kSeeks; ++k) {
+                const uint64_t seq = 1 + rng() % cfg.writer_records;
+                const std::size_t b = reader.seek_seq(seq);
+                seek_misses += seq >= index[0].first_seq && index[b].first_seq > seq;
+            }
+            seek_ns += cycles_to_ns(__rdtsc() - s0) / kSeeks;
+        }
+
+        std::cout << "writer records=" << cfg.writer_records
+            << " symbols=" << instruments.size()
+            << " ns_per_record=" << cycles_to_ns(cycles) / static_cast<double>(cfg.writer_records)
+            << " p99_tick_batch_ns=" << (samples.empty() ? 0.0 : cycles_to_ns(samples[samples.size() * 99 / 100]))
+            << " flush_ms=" << flush_ms
+            << " records_per_sec=" << (secs > 0 ? static_cast<double>(cfg.writer_records) / secs : 0.0)
+            << " file_bytes_per_record=" << static_cast<double>(bytes) / static_cast<double>(cfg.writer_records)
+            << " raw_bytes_per_record=" << sizeof(jolt::ob::L3Data) << "\n";
+        std::cout << "l3 read decoded=" << decoded
+            << " decode_records_per_sec=" << (decode_secs > 0 ? static_cast<double>(decoded) / decode_secs : 0.0)
+            << " decode_mb_per_sec="
+            << (decode_secs > 0 ? static_cast<double>(decoded * sizeof(jolt::ob::L3Data)) / decode_secs / (1 << 20) : 0.0)
+            << " seek_seq_ns=" << (files.empty() ? 0.0 : seek_ns / static_cast<double>(files.size()))
+            << " read_ok=" << (decoded == cfg.writer_records && seq_breaks == 0 && seek_misses == 0 ? "yes" : "no")
+            << "\n";
+        std::filesystem::remove_all(root);
+    }
+
+    // the gateway side of gap recovery: published batches appended to the history ring, then gap requests
+    // located and gathered from it the way the recovery server hands them to writev
+    void run_history_bench(const BenchConfig& cfg) {
+        constexpr std::size_t kBatch = 38;
+        constexpr uint32_t kCapacity = 1 << 16;
+        constexpr std::size_t kRequests = 20'000;
+        const std::size_t gap = std::min<std::size_t>(cfg.history_gap, kCapacity / 2);
+        const std::size_t records = std::max<std::size_t>(cfg.writer_records / 4, kCapacity * 2);
+
+        L3History writer("jolt_bench_l3_history", HistoryMode::Create, {1}, kCapacity);
+        const L3History reader("jolt_bench_l3_history", HistoryMode::Attach);
+
+        std::vector<jolt::ob::L3Data> batch(kBatch);
+        std::vector<uint64_t> append_samples;
+        append_samples.reserve(records / kBatch + 1);
+        uint64_t seq = 0;
+        for (std::size_t i = 0; i < records; i += kBatch) {
+            for (auto& r : batch) {
+                r.seq = ++seq;
+                r.id = seq;
+                r.symbol_id = 1;
+            }
+            const uint64_t c0 = __rdtsc();
+            writer.append(0, batch.data(), batch.size());
+            append_samples.push_back(__rdtsc() - c0);
+        }
+
+        // a gap anywhere in the ring's second half, copied out as the socket would take it
+        std::mt19937_64 rng(cfg.seed);
+        std::vector<char> sink(gap * sizeof(jolt::ob::L3Data));
+        std::vector<uint64_t> gap_samples;
+        gap_samples.reserve(kRequests);
+        std::size_t served = 0;
+        for (std::size_t k = 0; k < kRequests; ++k) {
+            const uint64_t start = seq - kCapacity / 2 + rng() % (kCapacity / 2 - gap);
+            const uint64_t c0 = __rdtsc();
+            L3History::Range range{};
+            if (!reader.locate(0, start, start + gap - 1, range) || !range.complete) {
+                continue;
+            }
+            const jolt::ob::L3Data* ptr[2];
+            size_t count[2];
+            const size_t n = reader.spans(0, range.from, range.to, ptr, count);
+            size_t off = 0;
+            for (size_t i = 0; i < n; ++i) {
+                std::memcpy(sink.data() + off, ptr[i], count[i] * sizeof(jolt::ob::L3Data));
+                off += count[i] * sizeof(jolt::ob::L3Data);
+            }
+            if (reader.still_valid(0, range.from) && off == sink.size()) {
+                ++served;
+            }
+            gap_samples.push_back(__rdtsc() - c0);
+        }
+
+        const auto pct = [](std::vector<uint64_t>& v, std::size_t p) {
+            if (v.empty()) {
+                return 0.0;
+            }
+            std::sort(v.begin(), v.end());
+            return cycles_to_ns(v[std::min(v.size() - 1, v.size() * p / 100)]);
+        };
+        std::cout << "history records=" << records << " capacity=" << kCapacity << " batch=" << kBatch
+            << " append_p50_ns=" << pct(append_samples, 50) << " append_p99_ns=" << pct(append_samples, 99) << "\n";
+        std::cout << "history gap=" << gap << " requests=" << kRequests << " served=" << served
+            << " gap_p50_us=" << pct(gap_samples, 50) / 1000.0 << " gap_p99_us=" << pct(gap_samples, 99) / 1000.0
+            << "\n";
+    }
 } // namespace
 
 int main(int argc, char** argv) {
@@ -896,44 +2232,70 @@ int main(int argc, char** argv) {
         return 1;
     }
 
-    MatchingOrderBook<> book(kMinTick, kMaxTick);
-    BenchDriver driver(book, cfg.seed);
+    if (cfg.sweep) {
+        run_sweep_bench(cfg);
+        return 0;
+    }
 
-    driver.preseed(cfg);
+    if (cfg.stop_cascade) {
+        run_stop_cascade_bench(cfg);
+        return 0;
+    }
 
-    std::mt19937_64 hawkes_rng(cfg.seed ^ 0x9e3779b97f4a7c15ULL);
-    std::vector<uint64_t> timestamps = build_hawkes_timestamps(cfg.events, cfg.hawkes, hawkes_rng);
-    std::vector<OpType> ops = build_operation_plan(cfg.events, cfg.seed ^ 0xbf58476d1ce4e5b9ULL);
+    if (cfg.cancel_heavy) {
+        run_cancel_heavy_bench(cfg);
+        return 0;
+    }
 
-    for (std::size_t i = 0; i < cfg.warmup; ++i) {
-        const OrderParams p = driver.make_order(ops[i], timestamps[i]);
-        const BookEvent ev = book.submit_order(p);
-        driver.apply(p, ev);
+    if (cfg.batch_sweep) {
+        run_batch_sweep(cfg);
+        return 0;
     }
 
-    Counters counters{};
-    uint64_t submit_cycles = 0;
-    for (std::size_t i = cfg.warmup; i < cfg.events; ++i) {
-        const OpType op = ops[i];
-        const OrderParams p = driver.make_order(op, timestamps[i]);
-        const uint64_t t2 = __rdtsc();
-        const BookEvent ev = book.submit_order(p);
-        const uint64_t t3 = __rdtsc();
-        submit_cycles += (t3 - t2);
-        driver.apply(p, ev);
-        driver.update_counters(op, ev, counters);
+    if (cfg.snapshots) {
+        run_snapshot_bench(cfg);
+        return 0;
     }
-    const double submit_only_ns = cycles_to_ns(submit_cycles);
 
-    const std::size_t measured = cfg.events - cfg.warmup;
+    if (cfg.depth) {
+        run_depth_bench<MatchingOrderBook<>>(cfg);
+        return 0;
+    }
 
-    print_summary(
-        cfg,
-        counters,
-        measured,
-        submit_only_ns,
-        driver.tracked_limits(),
-        driver.tracked_stops());
+    if (cfg.journal) {
+        run_journal_bench<MatchingOrderBook<>>(cfg, false);
+        run_journal_bench<MatchingOrderBook<>>(cfg, true);
+        return 0;
+    }
+
+    if (cfg.checkpoint) {
+        run_checkpoint_bench<MatchingOrderBook<>>(cfg);
+        return 0;
+    }
 
-    return 0;
+    if (cfg.writer) {
+        run_writer_bench(cfg);
+        return 0;
+    }
+
+    if (cfg.history) {
+        run_history_bench(cfg);
+        return 0;
+    }
+
+    if (cfg.locator_scale) {
+        run_locator_scale_bench(cfg);
+        return 0;
+    }
+
+    if (cfg.layout == SlotLayout::Soa) {
+        if (cfg.ladder == LadderKind::Paged) {
+            return run_bench<MatchingOrderBook<128, LadderKind::Paged, SlotLayout::Soa>>(cfg);
+        }
+        return run_bench<MatchingOrderBook<128, LadderKind::Dense, SlotLayout::Soa>>(cfg);
+    }
+    if (cfg.ladder == LadderKind::Paged) {
+        return run_bench<MatchingOrderBook<128, LadderKind::Paged>>(cfg);
+    }
+    return run_bench<MatchingOrderBook<>>(cfg);
 }
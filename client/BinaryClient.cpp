@@ -0,0 +1,224 @@
+#include "BinaryClient.h"
+#include "../include/async_logger.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <netdb.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+namespace {
+    bool send_all(int fd, const char* data, size_t len) {
+        size_t off = 0;
+        while (off < len) {
+            ssize_t n = ::send(fd, data + off, len - off, 0);
+            if (n <= 0) {
+                return false;
+            }
+            off += static_cast<size_t>(n);
+        }
+        return true;
+    }
+}
+
+namespace jolt::client {
+    BinaryClient::~BinaryClient() {
+        disconnect();
+    }
+
+    bool BinaryClient::connect_tcp(const std::string& host, const std::string& port) {
+        disconnect();
+
+        addrinfo hints{};
+        hints.ai_family = AF_UNSPEC;
+        hints.ai_socktype = SOCK_STREAM;
+
+        addrinfo* res = nullptr;
+        if (::getaddrinfo(host.c_str(), port.c_str(), &hints, &res) != 0) {
+            return false;
+        }
+
+        int fd = -1;
+        for (addrinfo* p = res; p; p = p->ai_next) {
+            fd = ::socket(p->ai_family, p->ai_socktype, p->ai_protocol);
+            if (fd == -1) {
+                continue;
+            }
+            if (::connect(fd, p->ai_addr, p->ai_addrlen) == 0) {
+                break;
+            }
+            ::close(fd);
+            fd = -1;
+        }
+        ::freeaddrinfo(res);
+
+        if (fd == -1) {
+            return false;
+        }
+
+        int one = 1;
+        ::setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+        fd_ = fd;
+        return true;
+    }
+
+    void BinaryClient::disconnect() {
+        if (fd_ != -1) {
+            ::close(fd_);
+            fd_ = -1;
+        }
+        recv_off_ = recv_len_ = 0;
+        inbound_.clear();
+    }
+
+    bool BinaryClient::is_connected() const {
+        return fd_ != -1;
+    }
+
+    void BinaryClient::set_session(const std::string& session) {
+        session_ = session.substr(0, boe::kSessionNameLen);
+    }
+
+    void BinaryClient::set_account(const uint64_t account) {
+        account_ = account;
+    }
+
+    uint64_t BinaryClient::next_cl_ord_id() {
+        return cl_ord_seq_++;
+    }
+
+    bool BinaryClient::send_raw(std::string_view msg) {
+        if (fd_ == -1) {
+            log_error("[client] binary client send failed: socket is not connected session=" + session_);
+            return false;
+        }
+        if (!send_all(fd_, msg.data(), msg.size())) {
+            log_error("[client] binary client failed sending message to gateway session=" + session_ +
+                      " bytes=" + std::to_string(msg.size()));
+            return false;
+        }
+        return true;
+    }
+
+    std::string_view BinaryClient::build_login() {
+        boe::Login login{boe::header_of(boe::MsgType::Login), {}, account_};
+        std::memcpy(login.session, session_.data(), session_.size());
+        return build(login);
+    }
+
+    std::string_view BinaryClient::build_new_order_limit(const uint64_t cl_ord_id,
+                                                         const uint16_t symbol_id,
+                                                         const bool is_buy,
+                                                         const ob::Qty qty,
+                                                         const ob::PriceTick price,
+                                                         const ob::TIF tif) {
+        return build(boe::NewOrder{boe::header_of(boe::MsgType::NewOrder), cl_ord_id, qty, price, 0, 0, symbol_id,
+                                   is_buy ? ob::Side::Buy : ob::Side::Sell, ob::OrderType::Limit, tif});
+    }
+
+    std::string_view BinaryClient::build_new_order_market(const uint64_t cl_ord_id,
+                                                          const uint16_t symbol_id,
+                                                          const bool is_buy,
+                                                          const ob::Qty qty,
+                                                          const ob::TIF tif) {
+        return build(boe::NewOrder{boe::header_of(boe::MsgType::NewOrder), cl_ord_id, qty, 0, 0, 0, symbol_id,
+                                   is_buy ? ob::Side::Buy : ob::Side::Sell, ob::OrderType::Market, tif});
+    }
+
+    std::string_view BinaryClient::build_cancel(const uint64_t cl_ord_id, const uint64_t order_id) {
+        return build(boe::Cancel{boe::header_of(boe::MsgType::Cancel), cl_ord_id, order_id});
+    }
+
+    std::string_view BinaryClient::build_replace(const uint64_t cl_ord_id,
+                                                 const uint64_t order_id,
+                                                 const ob::Qty qty,
+                                                 const ob::PriceTick price) {
+        return build(boe::Replace{boe::header_of(boe::MsgType::Replace), cl_ord_id, order_id, qty, price, 0, 0});
+    }
+
+    bool BinaryClient::poll() {
+        const bool socket_ok = read_socket();
+        std::string msg;
+        bool extracted_any = false;
+        while (extract_message(msg)) {
+            inbound_.push_back(std::move(msg));
+            extracted_any = true;
+        }
+        if (!socket_ok && !extracted_any) {
+            log_error("[client] binary client poll failed while reading from gateway session=" + session_);
+        }
+        return socket_ok || extracted_any;
+    }
+
+    std::optional<std::string_view> BinaryClient::next_message() {
+        if (inbound_.empty()) {
+            return std::nullopt;
+        }
+        last_message_ = std::move(inbound_.front());
+        inbound_.pop_front();
+        return std::string_view(last_message_);
+    }
+
+    bool BinaryClient::read_socket() {
+        if (fd_ == -1) {
+            return false;
+        }
+
+        if (recv_off_ > 0) {
+            const size_t remaining = recv_len_ - recv_off_;
+            std::memmove(recv_buf_.data(), recv_buf_.data() + recv_off_, remaining);
+            recv_len_ = remaining;
+            recv_off_ = 0;
+        }
+
+        const size_t space = recv_buf_.size() - recv_len_;
+        if (space == 0) {
+            return true;
+        }
+
+        ssize_t n = recv(fd_, recv_buf_.data() + recv_len_, space, MSG_DONTWAIT);
+        if (n < 0) {
+            if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                return true;
+            }
+            log_error("[client] binary client recv failed from gateway session=" + session_);
+            ::close(fd_);
+            fd_ = -1;
+            return false;
+        }
+        if (n == 0) {
+            log_warn("[client] binary client socket closed by gateway session=" + session_);
+            ::close(fd_);
+            fd_ = -1;
+            return false;
+        }
+
+        recv_len_ += static_cast<size_t>(n);
+        return true;
+    }
+
+    bool BinaryClient::extract_message(std::string& out) {
+        const size_t avail = recv_len_ - recv_off_;
+        if (avail < sizeof(boe::Header)) {
+            return false;
+        }
+        const auto header = boe::read_msg<boe::Header>(recv_buf_.data() + recv_off_);
+        if (header.length != boe::msg_size(header.type) || header.version != boe::kVersion) {
+            // no way to find the next message boundary, the gateway only sends whole messages
+            log_error("[client] binary client received a malformed header, dropping buffered bytes session=" +
+                      session_ + " type=" + std::to_string(static_cast<unsigned>(header.type)) +
+                      " length=" + std::to_string(header.length));
+            recv_off_ = recv_len_ = 0;
+            return false;
+        }
+        if (avail < header.length) {
+            return false;
+        }
+        out.assign(recv_buf_.data() + recv_off_, header.length);
+        recv_off_ += header.length;
+        return true;
+    }
+}
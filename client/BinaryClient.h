@@ -0,0 +1,71 @@
+#pragma once
+#include <array>
+#include <cstdint>
+#include <deque>
+#include <optional>
+#include <string>
+#include <string_view>
+
+#include "entry_gateway/BinaryProtocol.h"
+
+namespace jolt::client {
+    // order entry over the gateway's binary port, see entry_gateway/BinaryProtocol.h. messages are framed
+    // by their header length, next_message hands back one whole message to read with boe::read_msg
+    class BinaryClient {
+        int fd_{-1};
+        std::deque<std::string> inbound_{};
+        std::string last_message_{};
+        std::string session_{};
+        uint64_t account_{0};
+        uint64_t cl_ord_seq_{1};
+        std::array<char, boe::kMaxMsg> buffer_{};
+        std::array<char, 64 * 1024> recv_buf_;
+        size_t recv_len_{0};
+        size_t recv_off_{0};
+
+        bool read_socket();
+        bool extract_message(std::string& out);
+
+        template <typename Msg>
+        std::string_view build(const Msg& msg) {
+            return {buffer_.data(), boe::write_msg(buffer_.data(), buffer_.size(), msg)};
+        }
+
+    public:
+        BinaryClient() = default;
+        ~BinaryClient();
+
+        BinaryClient(const BinaryClient&) = delete;
+        BinaryClient& operator=(const BinaryClient&) = delete;
+
+        bool connect_tcp(const std::string& host, const std::string& port);
+        void disconnect();
+        bool is_connected() const;
+
+        // session is the SenderCompID it logs on as, at most boe::kSessionNameLen bytes
+        void set_session(const std::string& session);
+        void set_account(uint64_t account);
+        uint64_t next_cl_ord_id();
+
+        bool send_raw(std::string_view msg);
+
+        std::string_view build_login();
+        std::string_view build_new_order_limit(uint64_t cl_ord_id,
+                                               uint16_t symbol_id,
+                                               bool is_buy,
+                                               ob::Qty qty,
+                                               ob::PriceTick price,
+                                               ob::TIF tif = ob::TIF::GTC);
+        std::string_view build_new_order_market(uint64_t cl_ord_id,
+                                                uint16_t symbol_id,
+                                                bool is_buy,
+                                                ob::Qty qty,
+                                                ob::TIF tif = ob::TIF::IOC);
+        // order_id is the one the order's Ack carried
+        std::string_view build_cancel(uint64_t cl_ord_id, uint64_t order_id);
+        std::string_view build_replace(uint64_t cl_ord_id, uint64_t order_id, ob::Qty qty, ob::PriceTick price);
+
+        bool poll();
+        std::optional<std::string_view> next_message();
+    };
+}
@@ -96,7 +96,8 @@ namespace {
         std::cerr
             << "Usage: " << prog << " [options]\n"
             << "  --host <ip-or-host>          default: 127.0.0.1\n"
-            << "  --port <port>                default: 8080\n"
+            << "  --port <port>                default: 8080, the port of gateway worker 0\n"
+            << "  --gateway-workers <n>        default: 1, the entry gateway's --workers\n"
             << "  --clients <n>                default: 50\n"
             << "  --total-orders <n>           default: 250000\n"
             << "  --orders-per-client <n>      optional override (total = clients*n)\n"
@@ -162,6 +163,10 @@ namespace {
                 if (cfg.port.empty()) {
                     return ParseResult::Error;
                 }
+            } else if (arg == "--gateway-workers") {
+                if (!parse_usize_opt("--gateway-workers", cfg.gateway_workers, [](size_t v) { return v > 0; })) {
+                    return ParseResult::Error;
+                }
             } else if (arg == "--clients") {
                 if (!parse_usize_opt("--clients", cfg.clients, [](size_t v) { return v > 0; })) {
                     return ParseResult::Error;
@@ -256,6 +261,13 @@ namespace {
             return ParseResult::Error;
         }
 
+        // each session connects to port + its worker, so the port has to be a number
+        uint64_t port = 0;
+        if (cfg.gateway_workers > 1 && (!parse_u64(cfg.port, port) || port + cfg.gateway_workers - 1 > 65535)) {
+            std::cerr << "--port must be a port number with --gateway-workers\n";
+            return ParseResult::Error;
+        }
+
         if (cfg.orders_per_client_override > 0) {
             const uint64_t max_safe = std::numeric_limits<uint64_t>::max() / static_cast<uint64_t>(cfg.clients);
             if (cfg.orders_per_client_override > max_safe) {
@@ -285,6 +297,7 @@ int main(int argc, char** argv) {
     std::cout
         << "[client] host=" << cfg.host
         << " port=" << cfg.port
+        << " gateway_workers=" << cfg.gateway_workers
         << " clients=" << cfg.clients
         << " total_orders=" << cfg.total_orders
         << " symbols=" << cfg.symbols.size()
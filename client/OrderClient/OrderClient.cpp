@@ -8,6 +8,8 @@
 #include <thread>
 #include <utility>
 
+#include "../../include/Types.h"
+
 namespace jolt::client {
     namespace {
         enum class ScenarioOp : uint8_t {
@@ -283,6 +285,10 @@ namespace jolt::client {
           target_stop_per_client_(target_stop_per_client),
           rng_((static_cast<uint64_t>(client_idx_) + 1) * 0x9E3779B97F4A7C15ULL),
           id_("CLIENT_" + std::to_string(client_idx_ + 1)) {
+        // a gateway worker only logs on the sessions it owns, the port is picked the way it picks them
+        port_ = cfg_.gateway_workers <= 1
+            ? cfg_.port
+            : std::to_string(std::stoul(cfg_.port) + session_worker_of(id_, cfg_.gateway_workers));
         fix_.set_session(id_, "ENTRY_GATEWAY");
         fix_.set_account(id_);
     }
@@ -308,7 +314,7 @@ namespace jolt::client {
         price_model.pareto_scale = cfg_.pareto_scale;
         price_model.dir = ((rng_() & 1ULL) == 0ULL) ? 1 : -1;
 
-        if (!fix_.connect_tcp(cfg_.host, cfg_.port)) {
+        if (!fix_.connect_tcp(cfg_.host, port_)) {
             ++stats_.connected_fail;
             return;
         }
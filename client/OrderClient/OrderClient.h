@@ -12,7 +12,10 @@
 namespace jolt::client {
     struct ClientConfig {
         std::string host{"3.133.154.91"};
+        // FIX port of gateway worker 0, a session connects to port + its worker
         std::string port{"8080"};
+        // the entry gateway's --workers, sessions are spread over them by SenderCompID
+        size_t gateway_workers{1};
         size_t clients{10};
         uint64_t total_orders{500'000};
         uint64_t orders_per_client_override{0};
@@ -62,5 +65,7 @@ namespace jolt::client {
         FixClient fix_{};
         std::mt19937_64 rng_;
         std::string id_{};
+        // the port of the worker that owns id_
+        std::string port_{};
     };
 }
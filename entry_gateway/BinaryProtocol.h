@@ -0,0 +1,150 @@
+#pragma once
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+#include "../exchange/orderbook/ob_types.h"
+
+namespace jolt::boe {
+    // binary order entry: fixed layout little endian messages with no padding, served next to FIX on the
+    // gateway's binary port. every message starts with a Header whose length is the size of the whole
+    // message. a session sends Login once, then NewOrder/Cancel/Replace; the gateway answers with
+    // LoginAccepted, then Ack, Fill and Reject. order fields are the ob::OrderParams ones as they are, and
+    // Cancel/Replace name the order by the order_id its Ack carried
+    static_assert(std::endian::native == std::endian::little, "binary order entry is sent in host byte order");
+
+    inline constexpr uint8_t kVersion = 1;
+    inline constexpr size_t kSessionNameLen = 16;
+
+    enum class MsgType : uint8_t {
+        Login = 'L',
+        NewOrder = 'O',
+        Cancel = 'X',
+        Replace = 'U',
+        LoginAccepted = 'A',
+        Ack = 'a',
+        Fill = 'f',
+        Reject = 'j'
+    };
+
+    // what an Ack confirms
+    enum class AckStatus : uint8_t { New = 0, Cancelled = 1, Replaced = 2 };
+
+#pragma pack(push, 1)
+    struct Header {
+        uint16_t length;
+        MsgType type;
+        uint8_t version;
+    };
+
+    struct Login {
+        Header header;
+        // SenderCompID of the session, NUL padded
+        char session[kSessionNameLen];
+        uint64_t account;
+    };
+
+    struct LoginAccepted {
+        Header header;
+        uint64_t session_id;
+    };
+
+    struct NewOrder {
+        Header header;
+        uint64_t cl_ord_id;
+        ob::Qty qty;
+        ob::PriceTick price;
+        ob::PriceTick trigger;
+        ob::PriceTick limit_px;
+        uint16_t symbol_id;
+        ob::Side side;
+        ob::OrderType type;
+        ob::TIF tif;
+    };
+
+    struct Cancel {
+        Header header;
+        uint64_t cl_ord_id;
+        uint64_t order_id;
+    };
+
+    // price, trigger and limit_px of zero keep the order's
+    struct Replace {
+        Header header;
+        uint64_t cl_ord_id;
+        uint64_t order_id;
+        ob::Qty qty;
+        ob::PriceTick price;
+        ob::PriceTick trigger;
+        ob::PriceTick limit_px;
+    };
+
+    struct Ack {
+        Header header;
+        uint64_t cl_ord_id;
+        uint64_t order_id;
+        uint64_t exec_id;
+        uint64_t ts;
+        AckStatus status;
+    };
+
+    struct Fill {
+        Header header;
+        uint64_t cl_ord_id;
+        uint64_t order_id;
+        uint64_t exec_id;
+        uint64_t ts;
+        ob::Qty fill_qty;
+        ob::Qty leaves_qty;
+    };
+
+    struct Reject {
+        Header header;
+        uint64_t cl_ord_id;
+        uint64_t order_id;
+        uint64_t exec_id;
+        uint64_t ts;
+        ob::RejectReason reason;
+    };
+#pragma pack(pop)
+
+    // size of a message of the given type, 0 for an unknown type. the framer checks a header against it
+    // before waiting for the body
+    inline constexpr size_t msg_size(const MsgType type) {
+        switch (type) {
+        case MsgType::Login: return sizeof(Login);
+        case MsgType::NewOrder: return sizeof(NewOrder);
+        case MsgType::Cancel: return sizeof(Cancel);
+        case MsgType::Replace: return sizeof(Replace);
+        case MsgType::LoginAccepted: return sizeof(LoginAccepted);
+        case MsgType::Ack: return sizeof(Ack);
+        case MsgType::Fill: return sizeof(Fill);
+        case MsgType::Reject: return sizeof(Reject);
+        }
+        return 0;
+    }
+
+    inline constexpr size_t kMaxMsg = sizeof(Fill);
+
+    inline constexpr Header header_of(const MsgType type) {
+        return Header{static_cast<uint16_t>(msg_size(type)), type, kVersion};
+    }
+
+    // messages sit at any offset of a receive buffer, so they are copied out rather than cast
+    template <typename Msg>
+    Msg read_msg(const char* p) {
+        Msg msg;
+        std::memcpy(&msg, p, sizeof(Msg));
+        return msg;
+    }
+
+    template <typename Msg>
+    size_t write_msg(char* out, const size_t cap, const Msg& msg) {
+        if (cap < sizeof(Msg)) {
+            return 0;
+        }
+        std::memcpy(out, &msg, sizeof(Msg));
+        return sizeof(Msg);
+    }
+}
@@ -10,6 +10,7 @@
 #include <limits>
 #include <stdexcept>
 
+#include <fcntl.h>
 #include <netinet/in.h>
 #include <netinet/tcp.h>
 #include <sys/eventfd.h>
@@ -22,13 +23,39 @@
 namespace jolt::gateway {
     namespace {
         constexpr uint64_t kListenId = 1ull << 63;
+        constexpr uint64_t kBinaryListenId = kListenId + 1;
         constexpr uint64_t kWakeupId = (1ull << 63) - 1;
+
+        // uring user_data: op in the top byte, session id below
+        enum class UringOp : uint64_t { Accept = 1, Wake = 2, Recv = 3, Send = 4, AcceptBinary = 5 };
+        constexpr unsigned kOpShift = 56;
+        constexpr uint64_t kIdMask = (1ull << kOpShift) - 1;
+
+        constexpr uint64_t uring_tag(UringOp op, uint64_t id) {
+            return (static_cast<uint64_t>(op) << kOpShift) | id;
+        }
     }
 
-    EventLoop::EventLoop(int listen_fd)
-        : ready_sessions_(std::make_unique<LockFreeQueue<uint64_t, 1 << 20>>()),
+    EventLoop::EventLoop(int listen_fd, NetBackend backend, int binary_listen_fd)
+        : backend_(backend),
+          ready_sessions_(std::make_unique<LockFreeQueue<uint64_t, 1 << 20>>()),
           socket_events_(std::make_unique<LockFreeQueue<SocketEvent, 1 << 15>>()) {
         listen_fd_ = listen_fd;
+        binary_listen_fd_ = binary_listen_fd;
+        active_sessions_.resize(kMaxSessions + 1);
+        session_view_ = std::make_unique<std::atomic<FixSession*>[]>(kMaxSessions + 1);
+        for (size_t i = 0; i <= kMaxSessions; ++i) {
+            session_view_[i].store(nullptr, std::memory_order_relaxed);
+        }
+
+        if (backend_ == NetBackend::Uring && !init_uring()) {
+            std::cerr << "[event_loop] io_uring networking unavailable, using epoll\n";
+            backend_ = NetBackend::Epoll;
+        }
+        if (backend_ == NetBackend::Uring) {
+            return;
+        }
+
         epoll_fd_ = epoll_create1(0);
         if (epoll_fd_ < 0) {
             throw std::runtime_error("epoll_create1() failed");
@@ -45,6 +72,13 @@ namespace jolt::gateway {
         if (epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, listen_fd_, &ev) < 0) {
             throw std::runtime_error("epoll_ctl() failed for listen socket");
         }
+        if (binary_listen_fd_ >= 0) {
+            ev.events = EPOLLIN;
+            ev.data.u64 = kBinaryListenId;
+            if (epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, binary_listen_fd_, &ev) < 0) {
+                throw std::runtime_error("epoll_ctl() failed for binary listen socket");
+            }
+        }
 
         ev.events = EPOLLIN;
         ev.data.u64 = kWakeupId;
@@ -53,102 +87,180 @@ namespace jolt::gateway {
         }
 
         events_.resize(1 << 15);
-        active_sessions_.resize(kMaxSessions + 1);
-        session_view_ = std::make_unique<std::atomic<FixSession*>[]>(kMaxSessions + 1);
-        for (size_t i = 0; i <= kMaxSessions; ++i) {
-            session_view_[i].store(nullptr, std::memory_order_relaxed);
+    }
+
+    bool EventLoop::init_uring() {
+        if (io_uring_queue_init(kUringEntries, &ring_, 0) != 0) {
+            return false;
+        }
+        int ret = 0;
+        buf_ring_ = io_uring_setup_buf_ring(&ring_, kRecvBufs, kRecvGroup, 0, &ret);
+        if (!buf_ring_) {
+            io_uring_queue_exit(&ring_);
+            return false;
+        }
+
+        // blocking, so io_uring parks the wake read and the accept instead of completing them with EAGAIN
+        wake_fd_ = eventfd(0, EFD_CLOEXEC);
+        if (wake_fd_ < 0) {
+            throw std::runtime_error("eventfd() failed");
+        }
+        for (const int fd : {listen_fd_, binary_listen_fd_}) {
+            if (fd >= 0) {
+                fcntl(fd, F_SETFL, fcntl(fd, F_GETFL, 0) & ~O_NONBLOCK);
+            }
+        }
+
+        rx_pool_.lend(kRecvBufs);
+        for (unsigned bid = 0; bid < kRecvBufs; ++bid) {
+            recycle(static_cast<uint16_t>(bid));
         }
+        io_uring_buf_ring_advance(buf_ring_, recycled_);
+        recycled_ = 0;
+
+        uring_sessions_.resize(kMaxSessions + 1);
+        rx_backlog_.reserve(1024);
+        rx_retry_.reserve(1024);
+        rearm_recv_.reserve(1024);
+        arm_accept(false);
+        if (binary_listen_fd_ >= 0) {
+            arm_accept(true);
+        }
+        arm_wake();
+        return true;
     }
 
     void EventLoop::set_gateway(FixGateway* gateway) {
         gateway_ = gateway;
     }
 
-    void EventLoop::accept_sessions() {
+    void EventLoop::accept_sessions(const int listen_fd, const bool binary) {
         for (;;) {
             sockaddr_in addr{};
             socklen_t len = sizeof(addr);
+            ++syscalls_;
             const int session_fd = accept4(
-                listen_fd_, reinterpret_cast<sockaddr*>(&addr), &len, SOCK_NONBLOCK | SOCK_CLOEXEC);
+                listen_fd, reinterpret_cast<sockaddr*>(&addr), &len, SOCK_NONBLOCK | SOCK_CLOEXEC);
             if (session_fd < 0) {
                 if (errno == EAGAIN || errno == EWOULDBLOCK) {
                     break;
                 }
                 break;
             }
+            add_session(session_fd, binary);
+        }
+    }
 
-            int one = 1;
-            if (::setsockopt(session_fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one)) != 0) {
-                std::cerr << "[event_loop] failed to set TCP_NODELAY on session fd=" << session_fd << "\n";
-            }
+    uint64_t EventLoop::add_session(const int session_fd, const bool binary) {
+        int one = 1;
+        if (::setsockopt(session_fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one)) != 0) {
+            std::cerr << "[event_loop] failed to set TCP_NODELAY on session fd=" << session_fd << "\n";
+        }
 
-            int buf = 4 * 1024 * 1024;
-            if (::setsockopt(session_fd, SOL_SOCKET, SO_RCVBUF, &buf, sizeof(buf)) != 0) {
-                std::cerr << "[event_loop] failed to set SO_RCVBUF on session fd=" << session_fd << "\n";
-            }
+        int buf = 4 * 1024 * 1024;
+        if (::setsockopt(session_fd, SOL_SOCKET, SO_RCVBUF, &buf, sizeof(buf)) != 0) {
+            std::cerr << "[event_loop] failed to set SO_RCVBUF on session fd=" << session_fd << "\n";
+        }
 
-            if (::setsockopt(session_fd, SOL_SOCKET, SO_SNDBUF, &buf, sizeof(buf)) != 0) {
-                std::cerr << "[event_loop] failed to set SO_SNDBUF on session fd=" << session_fd << "\n";
-            }
+        if (::setsockopt(session_fd, SOL_SOCKET, SO_SNDBUF, &buf, sizeof(buf)) != 0) {
+            std::cerr << "[event_loop] failed to set SO_SNDBUF on session fd=" << session_fd << "\n";
+        }
+        syscalls_ += 3;
 
-            const uint64_t id = ++session_id_assign_;
-            if (id > kMaxSessions || id > std::numeric_limits<uint32_t>::max()) {
-                ::close(session_fd);
-                continue;
-            }
+        const uint64_t id = ++session_id_assign_;
+        if (id > kMaxSessions || id > std::numeric_limits<uint32_t>::max()) {
+            ::close(session_fd);
+            return 0;
+        }
 
-            auto session = std::make_unique<FixSession>("0", "0", session_fd);
-            session.get()->gateway_ = gateway_;
-            session.get()->conn_id = id;
+        auto session = std::make_unique<FixSession>("0", "0", session_fd);
+        session.get()->gateway_ = gateway_;
+        session.get()->conn_id = id;
+        session.get()->rx_pool_ = &rx_pool_;
+        session.get()->binary_ = binary;
 
-            active_sessions_[id] = std::move(session);
+        active_sessions_[id] = std::move(session);
 
-            epoll_event ev{};
-            ev.events = EPOLLIN | EPOLLRDHUP | EPOLLERR;
-            ev.data.u64 = id;
-            if (epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, session_fd, &ev) < 0) {
-                std::cerr << "[event_loop] failed adding accepted session to epoll id=" << id
-                          << " fd=" << session_fd << " errno=" << errno << "\n";
-                ::close(session_fd);
-                active_sessions_[id]->closed_.store(true, std::memory_order_release);
-                active_sessions_[id]->fd_ = -1;
-                session_view_[id].store(nullptr, std::memory_order_release);
-                continue;
-            }
+        if (backend_ == NetBackend::Uring) {
+            uring_sessions_[id] = std::make_unique<UringSession>();
             session_view_[id].store(active_sessions_[id].get(), std::memory_order_release);
+            arm_recv(id);
+            return id;
+        }
+
+        epoll_event ev{};
+        ev.events = EPOLLIN | EPOLLRDHUP | EPOLLERR;
+        ev.data.u64 = id;
+        ++syscalls_;
+        if (epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, session_fd, &ev) < 0) {
+            std::cerr << "[event_loop] failed adding accepted session to epoll id=" << id
+                      << " fd=" << session_fd << " errno=" << errno << "\n";
+            ::close(session_fd);
+            active_sessions_[id]->closed_.store(true, std::memory_order_release);
+            active_sessions_[id]->fd_ = -1;
+            session_view_[id].store(nullptr, std::memory_order_release);
+            return 0;
         }
+        session_view_[id].store(active_sessions_[id].get(), std::memory_order_release);
+        return id;
     }
 
-    bool EventLoop::enqueue_outbound(const FixMessage& msg) {
-        const uint64_t id = msg.conn_id;
+    FixSession* EventLoop::outbound_session(const uint64_t id) const {
         if (id == 0 || id > kMaxSessions) {
-            return false;
+            return nullptr;
         }
-
         auto* session = session_view_[id].load(std::memory_order_acquire);
         if (!session || session->closed_.load(std::memory_order_acquire)) {
-            return false;
+            return nullptr;
         }
+        return session;
+    }
 
-        if (!session->queue_message({msg.data, msg.len})) {
+    void EventLoop::arm_outbound(const uint64_t id, FixSession* session) {
+        if (session->tx_armed_.exchange(true, std::memory_order_acq_rel)) {
+            return;
+        }
+        while (true) {
+            auto* slot = ready_sessions_->get_tail_ptr();
+            if (slot) {
+                *slot = id;
+                ready_sessions_->write();
+                break;
+            }
+            if (session->closed_.load(std::memory_order_acquire)) {
+                return;
+            }
+        }
+        notify();
+    }
+
+    bool EventLoop::enqueue_outbound(const uint64_t id, const std::string_view bytes) {
+        FixSession* session = outbound_session(id);
+        if (!session || !session->queue_message(bytes)) {
             return false;
         }
+        arm_outbound(id, session);
+        return true;
+    }
 
-        if (!session->tx_armed_.exchange(true, std::memory_order_acq_rel)) {
-            while (true) {
-                auto* slot = ready_sessions_->get_tail_ptr();
-                if (slot) {
-                    *slot = id;
-                    ready_sessions_->write();
-                    break;
-                }
-                if (session->closed_.load(std::memory_order_acquire)) {
-                    return false;
-                }
+    void EventLoop::request_close(const uint64_t id) {
+        FixSession* session = outbound_session(id);
+        if (!session || session->close_requested_.exchange(true, std::memory_order_acq_rel)) {
+            return;
+        }
+        // past tx_armed_, a session with a full ring is armed already
+        while (true) {
+            auto* slot = ready_sessions_->get_tail_ptr();
+            if (slot) {
+                *slot = id;
+                ready_sessions_->write();
+                break;
+            }
+            if (session->closed_.load(std::memory_order_acquire)) {
+                return;
             }
-            notify();
         }
-        return true;
+        notify();
     }
 
     void EventLoop::drain_ready_sessions() {
@@ -166,6 +278,21 @@ namespace jolt::gateway {
             if (!session || session->closed_.load(std::memory_order_acquire)) {
                 continue;
             }
+            if (session->close_requested_.load(std::memory_order_acquire)) {
+                if (backend_ == NetBackend::Uring) {
+                    close_uring_session(id);
+                    continue;
+                }
+                const int fd = session->fd_;
+                session->close();
+                remove_session(id, fd);
+                publish_disconnect(id);
+                continue;
+            }
+            if (backend_ == NetBackend::Uring) {
+                arm_send(id);
+                continue;
+            }
 
             const int fd = session->fd_;
             if (!update_interest(session, fd, id, true)) {
@@ -190,7 +317,25 @@ namespace jolt::gateway {
         }
     }
 
+    void EventLoop::publish_disconnect(const uint64_t id) {
+        auto* slot = socket_events_->get_tail_ptr();
+        if (slot) {
+            slot->session_id = id;
+            socket_events_->write();
+        }
+    }
+
     void EventLoop::poll_once(int timeout_ms) {
+        if (backend_ == NetBackend::Uring) {
+            poll_uring(timeout_ms);
+        }
+        else {
+            poll_epoll(timeout_ms);
+        }
+    }
+
+    void EventLoop::poll_epoll(int timeout_ms) {
+        ++syscalls_;
         const int n = epoll_wait(epoll_fd_, events_.data(), static_cast<int>(events_.size()), timeout_ms);
         if (n <= 0) {
             return;
@@ -200,14 +345,17 @@ namespace jolt::gateway {
             const uint64_t id = events_[i].data.u64;
             const uint32_t mask = events_[i].events;
 
-            if (id == kListenId) {
-                accept_sessions();
+            if (id == kListenId || id == kBinaryListenId) {
+                const bool binary = id == kBinaryListenId;
+                accept_sessions(binary ? binary_listen_fd_ : listen_fd_, binary);
                 continue;
             }
 
             if (id == kWakeupId) {
                 uint64_t value = 0;
-                while (::read(wake_fd_, &value, sizeof(value)) == sizeof(value)) {}
+                do {
+                    ++syscalls_;
+                } while (::read(wake_fd_, &value, sizeof(value)) == sizeof(value));
                 wake_pending_.store(false, std::memory_order_release);
                 drain_ready_sessions();
                 continue;
@@ -227,13 +375,7 @@ namespace jolt::gateway {
             if (mask & (EPOLLHUP | EPOLLRDHUP | EPOLLERR)) {
                 session->close();
                 remove_session(id, fd);
-                SocketEvent event{};
-                event.session_id = id;
-                auto* slot = socket_events_->get_tail_ptr();
-                if (slot) {
-                    slot->session_id = event.session_id;
-                    socket_events_->write();
-                }
+                publish_disconnect(id);
                 continue;
             }
 
@@ -244,13 +386,7 @@ namespace jolt::gateway {
             session = (id < active_sessions_.size()) ? active_sessions_[id].get() : nullptr;
             if (!session || session->closed_.load(std::memory_order_acquire)) {
                 remove_session(id, fd);
-                SocketEvent event{};
-                event.session_id = id;
-                auto* slot = socket_events_->get_tail_ptr();
-                if (slot) {
-                    slot->session_id = event.session_id;
-                    socket_events_->write();
-                }
+                publish_disconnect(id);
                 continue;
             }
 
@@ -261,13 +397,7 @@ namespace jolt::gateway {
             session = (id < active_sessions_.size()) ? active_sessions_[id].get() : nullptr;
             if (!session || session->closed_.load(std::memory_order_acquire)) {
                 remove_session(id, fd);
-                SocketEvent event{};
-                event.session_id = id;
-                auto* slot = socket_events_->get_tail_ptr();
-                if (slot) {
-                    slot->session_id = event.session_id;
-                    socket_events_->write();
-                }
+                publish_disconnect(id);
                 continue;
             }
 
@@ -284,13 +414,7 @@ namespace jolt::gateway {
             if (!update_interest(session, fd, id, want_write)) {
                 session->close();
                 remove_session(id, fd);
-                SocketEvent event{};
-                event.session_id = id;
-                auto* slot = socket_events_->get_tail_ptr();
-                if (slot) {
-                    slot->session_id = event.session_id;
-                    socket_events_->write();
-                }
+                publish_disconnect(id);
 
             }
         }
@@ -312,6 +436,7 @@ namespace jolt::gateway {
         }
 
         ev.data.u64 = id;
+        ++syscalls_;
         if (epoll_ctl(epoll_fd_, EPOLL_CTL_MOD, fd, &ev) != 0) {
             std::cerr << "[event_loop] epoll_ctl MOD failed for session id=" << id
                       << " fd=" << fd << " errno=" << errno << "\n";
@@ -322,7 +447,10 @@ namespace jolt::gateway {
     }
 
     void EventLoop::remove_session(uint64_t id, int fd) {
-        epoll_ctl(epoll_fd_, EPOLL_CTL_DEL, fd, nullptr);
+        if (epoll_fd_ >= 0) {
+            ++syscalls_;
+            epoll_ctl(epoll_fd_, EPOLL_CTL_DEL, fd, nullptr);
+        }
         if (id < active_sessions_.size()) {
             session_view_[id].store(nullptr, std::memory_order_release);
             if (active_sessions_[id]) {
@@ -332,6 +460,272 @@ namespace jolt::gateway {
         }
     }
 
+    io_uring_sqe* EventLoop::next_sqe() {
+        io_uring_sqe* sqe = io_uring_get_sqe(&ring_);
+        if (!sqe) {
+            // sq full: hand it to the kernel early, which frees every entry
+            ++syscalls_;
+            io_uring_submit(&ring_);
+            sqe = io_uring_get_sqe(&ring_);
+        }
+        if (!sqe) {
+            throw std::runtime_error("io_uring_get_sqe() failed");
+        }
+        return sqe;
+    }
+
+    void EventLoop::arm_accept(const bool binary) {
+        io_uring_sqe* sqe = next_sqe();
+        io_uring_prep_multishot_accept(sqe, binary ? binary_listen_fd_ : listen_fd_, nullptr, nullptr, SOCK_CLOEXEC);
+        io_uring_sqe_set_data64(sqe, uring_tag(binary ? UringOp::AcceptBinary : UringOp::Accept, 0));
+    }
+
+    void EventLoop::arm_wake() {
+        io_uring_sqe* sqe = next_sqe();
+        io_uring_prep_read(sqe, wake_fd_, &wake_value_, sizeof(wake_value_), 0);
+        io_uring_sqe_set_data64(sqe, uring_tag(UringOp::Wake, 0));
+    }
+
+    void EventLoop::arm_recv(const uint64_t id) {
+        auto& us = *uring_sessions_[id];
+        io_uring_sqe* sqe = next_sqe();
+        io_uring_prep_recv_multishot(sqe, active_sessions_[id]->fd_, nullptr, 0, 0);
+        io_uring_sqe_set_flags(sqe, IOSQE_BUFFER_SELECT);
+        sqe->buf_group = kRecvGroup;
+        io_uring_sqe_set_data64(sqe, uring_tag(UringOp::Recv, id));
+        us.recv_armed = true;
+    }
+
+    void EventLoop::arm_send(const uint64_t id) {
+        auto* session = active_sessions_[id].get();
+        auto& us = *uring_sessions_[id];
+        if (us.send_inflight || session->closed_.load(std::memory_order_acquire)) {
+            return;
+        }
+        const size_t iovcnt = session->fill_tx_iov(us.iov.data());
+        if (iovcnt == 0) {
+            return;
+        }
+        us.msg = msghdr{};
+        us.msg.msg_iov = us.iov.data();
+        us.msg.msg_iovlen = iovcnt;
+        io_uring_sqe* sqe = next_sqe();
+        io_uring_prep_sendmsg(sqe, session->fd_, &us.msg, MSG_NOSIGNAL);
+        io_uring_sqe_set_data64(sqe, uring_tag(UringOp::Send, id));
+        us.send_inflight = true;
+    }
+
+    void EventLoop::recycle(const uint16_t bid) {
+        io_uring_buf_ring_add(buf_ring_, rx_pool_.data(bid), kRecvBufBytes, bid, io_uring_buf_ring_mask(kRecvBufs),
+                              recycled_++);
+    }
+
+    void EventLoop::recycle_returned() {
+        rx_pool_.reclaim();
+        auto& freed = rx_pool_.to_kernel();
+        for (const uint32_t bid : freed) {
+            recycle(static_cast<uint16_t>(bid));
+        }
+        freed.clear();
+    }
+
+    void EventLoop::feed_session(const uint64_t id) {
+        auto* session = active_sessions_[id].get();
+        auto& us = *uring_sessions_[id];
+        // messages the gateway had no room for go first, newer bytes queue up behind them
+        bool drained = session->dispatch();
+        while (drained && !us.held.empty()) {
+            RxSlice& slice = us.held.front();
+            const size_t took = session->take_rx(slice.bid, slice.off, slice.len);
+            if (took == 0) {
+                // the bytes finish a message that straddles buffers and no spare segment is free to join them in
+                break;
+            }
+            slice.off += static_cast<uint32_t>(took);
+            slice.len -= static_cast<uint32_t>(took);
+            if (slice.len == 0) {
+                rx_pool_.drop(slice.bid);
+                us.held.pop_front();
+            }
+            drained = session->dispatch();
+        }
+        if (session->protocol_error_) {
+            close_uring_session(id);
+            return;
+        }
+        if ((!drained || !us.held.empty()) && !us.backlogged) {
+            us.backlogged = true;
+            rx_backlog_.push_back(id);
+        }
+    }
+
+    void EventLoop::on_recv(const uint64_t id, const io_uring_cqe* cqe) {
+        auto& us = *uring_sessions_[id];
+        const bool more = (cqe->flags & IORING_CQE_F_MORE) != 0;
+        if (!more) {
+            us.recv_armed = false;
+        }
+        auto* session = active_sessions_[id].get();
+        const bool closed = session->closed_.load(std::memory_order_acquire);
+        if (cqe->flags & IORING_CQE_F_BUFFER) {
+            const auto bid = static_cast<uint16_t>(cqe->flags >> IORING_CQE_BUFFER_SHIFT);
+            rx_pool_.received(bid);
+            if (cqe->res > 0 && !closed) {
+                us.held.push_back(RxSlice{bid, 0, static_cast<uint32_t>(cqe->res)});
+            }
+            else {
+                rx_pool_.drop(bid);
+            }
+        }
+        if (closed) {
+            return;
+        }
+
+        if (cqe->res > 0) {
+            feed_session(id);
+            if (!more && !session->closed_.load(std::memory_order_acquire)) {
+                arm_recv(id);
+            }
+        }
+        else if (cqe->res == -ENOBUFS) {
+            // every buffer is queued in some session, armed again once buffers come back
+            rearm_recv_.push_back(id);
+        }
+        else {
+            close_uring_session(id);
+        }
+    }
+
+    void EventLoop::on_send(const uint64_t id, const io_uring_cqe* cqe) {
+        auto* session = active_sessions_[id].get();
+        auto& us = *uring_sessions_[id];
+        us.send_inflight = false;
+        if (session->closed_.load(std::memory_order_acquire)) {
+            return;
+        }
+        if (cqe->res <= 0 && cqe->res != -EINTR && cqe->res != -EAGAIN) {
+            close_uring_session(id);
+            return;
+        }
+        if (cqe->res > 0) {
+            session->consume_tx(static_cast<size_t>(cqe->res));
+        }
+
+        if (!session->want_write()) {
+            session->tx_armed_.store(false, std::memory_order_release);
+            if (!session->want_write()) {
+                return;
+            }
+            session->tx_armed_.store(true, std::memory_order_release);
+        }
+        arm_send(id);
+    }
+
+    void EventLoop::close_uring_session(const uint64_t id) {
+        auto* session = active_sessions_[id].get();
+        auto& us = *uring_sessions_[id];
+        // shutdown completes the multishot recv and any send still holding the socket, close alone would not
+        ::shutdown(session->fd_, SHUT_RDWR);
+        session->close();
+        syscalls_ += 2;
+        for (const RxSlice& slice : us.held) {
+            rx_pool_.drop(slice.bid);
+        }
+        us.held.clear();
+        remove_session(id, -1);
+        publish_disconnect(id);
+    }
+
+    void EventLoop::poll_uring(int timeout_ms) {
+        // backlogged sessions retry and recvs starved of buffers wait for the gateway to release some
+        if ((!rx_backlog_.empty() || !rearm_recv_.empty()) && (timeout_ms < 0 || timeout_ms > 1)) {
+            timeout_ms = 1;
+        }
+        // one enter per poll: the sqes prepared since the last one go in with the wait
+        io_uring_cqe* first = nullptr;
+        ++syscalls_;
+        if (timeout_ms < 0) {
+            io_uring_submit_and_wait(&ring_, 1);
+        }
+        else if (timeout_ms == 0) {
+            io_uring_submit(&ring_);
+        }
+        else {
+            __kernel_timespec ts{};
+            ts.tv_sec = timeout_ms / 1000;
+            ts.tv_nsec = static_cast<long long>(timeout_ms % 1000) * 1'000'000;
+            io_uring_submit_and_wait_timeout(&ring_, &first, 1, &ts, nullptr);
+        }
+
+        unsigned head = 0;
+        unsigned seen = 0;
+        io_uring_cqe* cqe = nullptr;
+        io_uring_for_each_cqe(&ring_, head, cqe) {
+            ++seen;
+            const uint64_t data = io_uring_cqe_get_data64(cqe);
+            const uint64_t id = data & kIdMask;
+            switch (static_cast<UringOp>(data >> kOpShift)) {
+            case UringOp::Accept:
+            case UringOp::AcceptBinary:
+                {
+                    const bool binary = static_cast<UringOp>(data >> kOpShift) == UringOp::AcceptBinary;
+                    if (cqe->res >= 0) {
+                        add_session(cqe->res, binary);
+                    }
+                    if (!(cqe->flags & IORING_CQE_F_MORE) && running_.load(std::memory_order_acquire)) {
+                        arm_accept(binary);
+                    }
+                    break;
+                }
+            case UringOp::Wake:
+                wake_pending_.store(false, std::memory_order_release);
+                drain_ready_sessions();
+                arm_wake();
+                break;
+            case UringOp::Recv:
+                on_recv(id, cqe);
+                break;
+            case UringOp::Send:
+                on_send(id, cqe);
+                break;
+            }
+        }
+        io_uring_cq_advance(&ring_, seen);
+
+        if (!rx_backlog_.empty()) {
+            rx_retry_.swap(rx_backlog_);
+            for (const uint64_t id : rx_retry_) {
+                uring_sessions_[id]->backlogged = false;
+                if (!active_sessions_[id]->closed_.load(std::memory_order_acquire)) {
+                    feed_session(id);
+                }
+            }
+            rx_retry_.clear();
+        }
+
+        recycle_returned();
+        if (recycled_ > 0) {
+            io_uring_buf_ring_advance(buf_ring_, recycled_);
+            recycled_ = 0;
+            for (const uint64_t id : rearm_recv_) {
+                if (!active_sessions_[id]->closed_.load(std::memory_order_acquire) && !uring_sessions_[id]->recv_armed) {
+                    arm_recv(id);
+                }
+            }
+            rearm_recv_.clear();
+        }
+    }
+
+    uint64_t EventLoop::syscalls() const {
+        uint64_t total = syscalls_;
+        for (const auto& session : active_sessions_) {
+            if (session) {
+                total += session->syscalls_;
+            }
+        }
+        return total;
+    }
+
     void EventLoop::start() {
         running_ = true;
         run_thread = std::thread(&EventLoop::run, this);
@@ -383,9 +777,17 @@ namespace jolt::gateway {
             ::close(epoll_fd_);
             epoll_fd_ = -1;
         }
+        if (backend_ == NetBackend::Uring) {
+            io_uring_free_buf_ring(&ring_, buf_ring_, kRecvBufs, kRecvGroup);
+            io_uring_queue_exit(&ring_);
+        }
         if (listen_fd_ >= 0) {
             ::close(listen_fd_);
             listen_fd_ = -1;
         }
+        if (binary_listen_fd_ >= 0) {
+            ::close(binary_listen_fd_);
+            binary_listen_fd_ = -1;
+        }
     }
 }
@@ -3,35 +3,110 @@
 #include <cstddef>
 #include <cstdint>
 #include <memory>
+#include <array>
+#include <deque>
 #include <optional>
+#include <string_view>
 #include <thread>
 #include <vector>
 
+#include <liburing.h>
 #include <sys/epoll.h>
+#include <sys/socket.h>
 #include "../include/spsc_new.h"
 #include "Client.h"
 #include "FixSession.h"
+#include "RxSegmentPool.h"
 
 namespace jolt::gateway {
     class FixGateway;
 
+    // epoll: readiness events, recv/writev per session. uring: multishot accept and recv into a provided
+    // buffer ring, one sendmsg sqe per session with output, every sqe of a poll submitted together with the
+    // wait for the next completions. both receive into RxSegmentPool segments the gateway parses in place
+    enum class NetBackend : uint8_t { Epoll = 0, Uring = 1 };
+
     class EventLoop {
+        // a filled provided buffer, or what the session has not taken of it yet
+        struct RxSlice {
+            uint16_t bid{0};
+            uint32_t off{0};
+            uint32_t len{0};
+        };
+
+        // per session state of the uring backend. msg/iov stay put while the send is in flight
+        struct UringSession {
+            std::deque<RxSlice> held{};
+            msghdr msg{};
+            std::array<iovec, kTxIov> iov{};
+            bool recv_armed{false};
+            bool send_inflight{false};
+            bool backlogged{false};
+        };
+
+        static constexpr unsigned kUringEntries = 4096;
+        static constexpr unsigned kRecvBufs = 4096;
+        static constexpr size_t kRecvBufBytes = RxSegmentPool::kSegmentBytes;
+        static constexpr int kRecvGroup = 0;
+
         std::thread run_thread;
-        void accept_sessions();
+        void accept_sessions(int listen_fd, bool binary);
+        uint64_t add_session(int session_fd, bool binary);
         void drain_ready_sessions();
         bool update_interest(FixSession* session, int fd, uint64_t id, bool want_write);
+        void publish_disconnect(uint64_t id);
+        // open session of an outbound message, nullptr when it is gone
+        FixSession* outbound_session(uint64_t id) const;
+        // queues the session for the loop to send from, once until the loop has drained it
+        void arm_outbound(uint64_t id, FixSession* session);
+        void poll_epoll(int timeout_ms);
+
+        bool init_uring();
+        void poll_uring(int timeout_ms);
+        io_uring_sqe* next_sqe();
+        void arm_accept(bool binary);
+        void arm_wake();
+        void arm_recv(uint64_t id);
+        void arm_send(uint64_t id);
+        void on_recv(uint64_t id, const io_uring_cqe* cqe);
+        void on_send(uint64_t id, const io_uring_cqe* cqe);
+        void feed_session(uint64_t id);
+        void recycle(uint16_t bid);
+        // provided buffers whose last reference went away go back into the recv ring
+        void recycle_returned();
+        void close_uring_session(uint64_t id);
+
+        NetBackend backend_{NetBackend::Epoll};
+        // syscalls made by the loop thread, read once it has stopped
+        uint64_t syscalls_{0};
         std::atomic<bool> running_{false};
         std::atomic<bool> wake_pending_{false};
         int epoll_fd_{-1};
         int listen_fd_{-1};
+        // boe sessions, -1 when the gateway serves FIX only
+        int binary_listen_fd_{-1};
         int wake_fd_{-1};
         FixGateway* gateway_{nullptr};
         std::unique_ptr<std::atomic<FixSession*>[]> session_view_;
         std::unique_ptr<LockFreeQueue<uint64_t, 1 << 20>> ready_sessions_;
         std::vector<epoll_event> events_{};
         std::unique_ptr<LockFreeQueue<SocketEvent, 1 << 15>> socket_events_;
+
+        io_uring ring_{};
+        io_uring_buf_ring* buf_ring_{nullptr};
+        RxSegmentPool rx_pool_{};
+        // buffers handed back since the last io_uring_buf_ring_advance
+        int recycled_{0};
+        uint64_t wake_value_{0};
+        std::vector<std::unique_ptr<UringSession>> uring_sessions_{};
+        // sessions holding received bytes they could not take yet, or whose recv ran out of buffers
+        std::vector<uint64_t> rx_backlog_{};
+        std::vector<uint64_t> rx_retry_{};
+        std::vector<uint64_t> rearm_recv_{};
     public:
-        explicit EventLoop(int listen_fd);
+        // a uring backend the kernel refuses falls back to epoll. sessions accepted on binary_listen_fd speak
+        // boe instead of FIX
+        explicit EventLoop(int listen_fd, NetBackend backend = NetBackend::Epoll, int binary_listen_fd = -1);
         ~EventLoop();
 
         EventLoop(const EventLoop&) = delete;
@@ -42,12 +117,42 @@ namespace jolt::gateway {
         void set_gateway(FixGateway* gateway);
         void remove_session(uint64_t id, int fd);
         void poll_once(int timeout_ms);
-        bool enqueue_outbound(const FixMessage& msg);
+        // gateway thread. encode(out, cap) writes one message of at most cap bytes in place in the session's tx
+        // ring and returns its length, 0 if it could not. false when the session is gone or the ring has no room
+        // for a whole message, encode is not called then
+        template <typename Encode>
+        bool enqueue_outbound(uint64_t id, Encode&& encode) {
+            FixSession* session = outbound_session(id);
+            if (!session || !session->tx_ring_.has_room(kFixMaxMsg)) {
+                return false;
+            }
+            size_t room = 0;
+            if (char* out = session->tx_ring_.contiguous(kFixMaxMsg, room)) {
+                session->tx_ring_.commit(encode(out, room));
+            }
+            else {
+                // too close to the wrap to encode in place
+                FixMessage scratch;
+                const size_t len = encode(scratch.data, sizeof(scratch.data));
+                session->tx_ring_.write({scratch.data, len});
+            }
+            arm_outbound(id, session);
+            return true;
+        }
+        // an already encoded message
+        bool enqueue_outbound(uint64_t id, std::string_view bytes);
+        // asks the loop to close a session the gateway gave up on, its disconnect comes back as a socket event
+        void request_close(uint64_t id);
         void notify();
         void run();
         void stop();
         void start();
         size_t connection_count() const;
+        [[nodiscard]] NetBackend backend() const { return backend_; }
+        // segments the gateway thread releases the messages it parsed back to
+        [[nodiscard]] RxSegmentPool& rx_pool() { return rx_pool_; }
+        // loop and session syscalls so far, only meaningful once the loop has stopped
+        [[nodiscard]] uint64_t syscalls() const;
         std::optional<SocketEvent> dequeue_socket_event();
         uint64_t session_id_assign_{0};
         static constexpr uint64_t kMaxSessions = 1u << 16;
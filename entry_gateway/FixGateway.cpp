@@ -14,6 +14,7 @@
 #include <cstdlib>
 #include <cstring>
 #include <limits>
+#include <stdexcept>
 #include <string>
 #include <thread>
 #include <utility>
@@ -68,6 +69,8 @@ namespace {
             return "NotFillable";
         case jolt::ob::RejectReason::InvalidType:
             return "InvalidType";
+        case jolt::ob::RejectReason::DuplicateId:
+            return "DuplicateId";
         case jolt::ob::RejectReason::NotApplicable:
         default:
             return "Rejected";
@@ -118,9 +121,6 @@ namespace {
 
         uint32_t numeric = 0;
         if (parse_uint32(s, numeric) && numeric <= std::numeric_limits<uint16_t>::max()) {
-            if (!jolt::is_valid_symbol_id(numeric)) {
-                return false;
-            }
             out = static_cast<uint16_t>(numeric);
             return true;
         }
@@ -137,9 +137,6 @@ namespace {
         if (!parse_uint32(digits, numeric) || numeric > std::numeric_limits<uint16_t>::max()) {
             return false;
         }
-        if (!jolt::is_valid_symbol_id(numeric)) {
-            return false;
-        }
         out = static_cast<uint16_t>(numeric);
         return true;
     }
@@ -469,6 +466,8 @@ namespace {
             return "Modify";
         case jolt::ob::OrderAction::Cancel:
             return "Cancel";
+        case jolt::ob::OrderAction::MassCancel:
+            return "MassCancel";
         }
         return "Unknown";
     }
@@ -481,6 +480,8 @@ namespace {
             return "Rejected";
         case jolt::ExchToGtwyMsg::Type::Filled:
             return "Filled";
+        case jolt::ExchToGtwyMsg::Type::Cancelled:
+            return "Cancelled";
         }
         return "Unknown";
     }
@@ -521,32 +522,58 @@ static int make_listen_socket(uint16_t port) {
 
 
 namespace jolt::gateway {
-    FixGateway::FixGateway(const std::string& gtwy_to_exch_name, const std::string& exch_to_gtwy_name)
-        : gtwy_exch_(gtwy_to_exch_name, SharedRingMode::Attach),
-          exch_gtwy_(exch_to_gtwy_name, SharedRingMode::Attach),
-          cl_ord_id_to_order_id_(2'000'000, ClOrdMapKey::empty(), ClOrdMapKey::tombstone(), 0.80f),
-          event_loop_(make_listen_socket(8080)),
-          slot_ids(std::make_unique<LockFreeQueue<size_t, 1 << 20>>()),
-          client_ingress_q_(std::make_unique<LockFreeQueue<ClientFixMsg, 1 << 20>>()) {
+    FixGateway::FixGateway(const std::string& gtwy_to_exch_name, const std::string& exch_to_gtwy_name,
+                           const InstrumentRegistry& instruments, size_t num_shards, NetBackend backend,
+                           size_t worker, size_t num_workers)
+        : instruments_(instruments),
+          // each worker holds the orders of its own sessions only
+          cl_ord_id_to_order_id_(2'000'000 / std::max<size_t>(num_workers, 1), ClOrdMapKey::empty(),
+                                 ClOrdMapKey::tombstone(), 0.80f),
+          worker_(worker), num_workers_(num_workers), next_order_id_(worker + 1), first_order_id_(worker + 1),
+          order_ids_("../data/gateway/" + worker_queue_name(gtwy_to_exch_name, worker) + ".ids"),
+          event_loop_(make_listen_socket(listen_port(worker)), backend,
+                      make_listen_socket(binary_listen_port(worker))),
+          client_ingress_q_(std::make_unique<LockFreeQueue<ClientFixMsg, 1 << 16>>()) {
+        if (num_workers == 0 || num_workers > kMaxGatewayWorkers || worker >= num_workers) {
+            throw std::runtime_error("gateway worker " + std::to_string(worker) + " of " +
+                                     std::to_string(num_workers) + " out of range");
+        }
+        if (num_shards != 0 && num_shards < instruments_.num_shards()) {
+            throw std::runtime_error("instrument registry assigns more shards than configured");
+        }
+        // orders of an earlier run may still rest in the books, start at this worker's first id past all of them
+        if (order_ids_.reserved() > first_order_id_) {
+            const uint64_t floor = order_ids_.reserved();
+            first_order_id_ = floor + (worker_ + num_workers_ - (floor - 1) % num_workers_) % num_workers_;
+            next_order_id_ = first_order_id_;
+        }
+        order_ids_.reserve(first_order_id_ + kOrderIdBlock * num_workers_);
+        if (num_shards == 0) {
+            gtwy_exch_.push_back(std::make_unique<GtwyToExch>(worker_queue_name(gtwy_to_exch_name, worker),
+                                                              SharedRingMode::Attach));
+            exch_gtwy_.push_back(std::make_unique<ExchToGtwy>(worker_queue_name(exch_to_gtwy_name, worker),
+                                                              SharedRingMode::Attach));
+        }
+        for (size_t i = 0; i < num_shards; ++i) {
+            gtwy_exch_.push_back(std::make_unique<GtwyToExch>(
+                worker_queue_name(shard_queue_name(gtwy_to_exch_name, i), worker), SharedRingMode::Attach));
+            exch_gtwy_.push_back(std::make_unique<ExchToGtwy>(
+                worker_queue_name(shard_queue_name(exch_to_gtwy_name, i), worker), SharedRingMode::Attach));
+        }
         event_loop_.set_gateway(this);
         sessions_.resize(1);
         clients_.reserve(2048);
         client_traffic_.reserve(2048);
         sender_to_logical_session_.reserve(2048);
         next_client_traffic_log_ = std::chrono::steady_clock::now() + std::chrono::seconds(1);
-        order_state_pool_.reserve(1'000'000);
+        order_state_pool_.reserve(1'000'000 / num_workers_);
         logical_to_conn_.resize(1, 0);
         pending_outbound_.resize(1);
         conn_to_logical_.resize(EventLoop::kMaxSessions + 1, 0);
-        for (int i = 0; i < 1 << 20; i++) {
-            auto* slot = slot_ids->get_tail_ptr();
-            if (!slot) {
-                break;
-            }
-            *slot = static_cast<size_t>(i);
-            slot_ids->write();
-        }
+    }
 
+    size_t FixGateway::worker_of(const std::string_view sender_comp_id, const size_t num_workers) {
+        return session_worker_of(sender_comp_id, num_workers);
     }
 
     void FixGateway::load_clients(const std::vector<ClientInfo>& clients) {
@@ -576,7 +603,15 @@ namespace jolt::gateway {
         msg.order = order;
         msg.client_id = order.client_id;
 
-        auto ptr = gtwy_exch_.alloc();
+        // cancels/modifies carry the symbol of the original order, so they reach the same shard
+        const size_t symbol_idx = instruments_.index_of(order.symbol_id);
+        if (symbol_idx == InstrumentRegistry::npos) {
+            reason = ob::RejectReason::InvalidPrice;
+            return false;
+        }
+        const size_t shard = gtwy_exch_.size() == 1 ? 0 : instruments_.at(symbol_idx).shard;
+        auto& ring = *gtwy_exch_[shard];
+        auto ptr = ring.alloc();
         if (!ptr) {
             // log err
             return false;
@@ -584,7 +619,7 @@ namespace jolt::gateway {
 
         ptr->order = order;
         ptr->client_id = order.client_id;
-        gtwy_exch_.push();
+        ring.push();
 
         // if (!gtwy_exch_.enqueue(msg)) {
         //     reason = ob::RejectReason::NotApplicable;
@@ -667,13 +702,14 @@ namespace jolt::gateway {
         return &session;
     }
 
-    bool FixGateway::build_exec_report(FixMessage& out,
-                                       SessionState* session,
-                                       const OrderState& state,
-                                       uint64_t exec_id,
-                                       bool accepted,
-                                       ob::RejectReason reason) {
-        FixBuffer msg{out.data, 0, sizeof(out.data)};
+    size_t FixGateway::build_exec_report(char* out,
+                                         const size_t cap,
+                                         SessionState* session,
+                                         const OrderState& state,
+                                         uint64_t exec_id,
+                                         bool accepted,
+                                         ob::RejectReason reason) {
+        FixBuffer msg{out, 0, cap};
 
         auto append_raw = [](FixBuffer& dst, const char* src, size_t n) -> bool {
             if (dst.len + n > dst.cap) {
@@ -712,27 +748,27 @@ namespace jolt::gateway {
         };
 
         if (!append_raw(msg, "8=FIX.4.4\x01", 10)) {
-            return false;
+            return 0;
         }
 
         constexpr char kBodyLenPlaceholder[] = "9=0000000000\x01";
         const size_t body_len_digits_offset = msg.len + 2; // after "9="
         if (!append_raw(msg, kBodyLenPlaceholder, sizeof(kBodyLenPlaceholder) - 1)) {
-            return false;
+            return 0;
         }
         const size_t body_start = msg.len;
 
         if (!append_raw(msg, "35=8\x01", 5)) {
-            return false;
+            return 0;
         }
         if (!append_sv_field(msg, "49=", sizeof("49=") - 1, session->target_comp_id)) {
-            return false;
+            return 0;
         }
         if (!append_sv_field(msg, "56=", sizeof("56=") - 1, session->sender_comp_id)) {
-            return false;
+            return 0;
         }
         if (!append_u64_field(msg, "34=", sizeof("34=") - 1, session->seq++)) {
-            return false;
+            return 0;
         }
 
         char ts_buf[32];
@@ -740,11 +776,11 @@ namespace jolt::gateway {
             std::chrono::system_clock::now().time_since_epoch()).count();
         auto [ts_ptr, ts_ec] = std::to_chars(ts_buf, ts_buf + sizeof(ts_buf), now_ns);
         if (ts_ec != std::errc{}) {
-            return false;
+            return 0;
         }
         const size_t ts_len = static_cast<size_t>(ts_ptr - ts_buf);
         if (!append_sv_field(msg, "52=", sizeof("52=") - 1, std::string_view(ts_buf, ts_len))) {
-            return false;
+            return 0;
         }
 
         std::string_view exec_type = "0";
@@ -779,77 +815,77 @@ namespace jolt::gateway {
         }
 
         if (!append_sv_field(msg, "150=", sizeof("150=") - 1, exec_type)) {
-            return false;
+            return 0;
         }
         if (!append_sv_field(msg, "39=", sizeof("39=") - 1, ord_status)) {
-            return false;
+            return 0;
         }
         const std::string_view cl_ord_id = fixed_field_view(state.cl_ord_id);
         const std::string_view orig_cl_ord_id = fixed_field_view(state.orig_cl_ord_id);
 
         if (!append_sv_field(msg, "11=", sizeof("11=") - 1, cl_ord_id)) {
-            return false;
+            return 0;
         }
         if (!orig_cl_ord_id.empty()) {
             if (!append_sv_field(msg, "41=", sizeof("41=") - 1, orig_cl_ord_id)) {
-                return false;
+                return 0;
             }
         }
         if (!append_u64_field(msg, "37=", sizeof("37=") - 1, state.params.id)) {
-            return false;
+            return 0;
         }
         if (!append_u64_field(msg, "17=", sizeof("17=") - 1, exec_id)) {
-            return false;
+            return 0;
         }
         if (!append_sv_field(
             msg,
             "54=",
             sizeof("54=") - 1,
             state.params.side == ob::Side::Buy ? "1" : "2")) {
-            return false;
+            return 0;
         }
         if (!append_u64_field(msg, "38=", sizeof("38=") - 1, state.params.qty)) {
-            return false;
+            return 0;
         }
         if (!append_sv_field(msg, "40=", sizeof("40=") - 1, fix_ord_type(state.params.type))) {
-            return false;
+            return 0;
         }
         if (state.params.type == ob::OrderType::Limit) {
             if (!append_u64_field(msg, "44=", sizeof("44=") - 1, state.params.price)) {
-                return false;
+                return 0;
             }
         }
         else if (state.params.type == ob::OrderType::StopLimit) {
             if (!append_u64_field(msg, "44=", sizeof("44=") - 1, state.params.limit_px)) {
-                return false;
+                return 0;
             }
             if (state.params.trigger != 0) {
                 if (!append_u64_field(msg, "99=", sizeof("99=") - 1, state.params.trigger)) {
-                    return false;
+                    return 0;
                 }
             }
         }
         else if (state.params.type == ob::OrderType::StopMarket) {
             if (state.params.trigger != 0) {
                 if (!append_u64_field(msg, "99=", sizeof("99=") - 1, state.params.trigger)) {
-                    return false;
+                    return 0;
                 }
             }
         }
         if (!append_sv_field(msg, "59=", sizeof("59=") - 1, fix_tif(state.params.tif))) {
-            return false;
+            return 0;
         }
         if (!append_sv_field(msg, "60=", sizeof("60=") - 1, std::string_view(ts_buf, ts_len))) {
-            return false;
+            return 0;
         }
         if (!accepted) {
             if (!append_sv_field(msg, "58=", sizeof("58=") - 1, reject_reason_text(reason))) {
-                return false;
+                return 0;
             }
         }
         if (state.params.symbol_id != 0) {
             if (!append_u64_field(msg, "55=", sizeof("55=") - 1, state.params.symbol_id)) {
-                return false;
+                return 0;
             }
         }
 
@@ -860,7 +896,7 @@ namespace jolt::gateway {
             body_len_value /= 10;
         }
         if (body_len_value != 0) {
-            return false;
+            return 0;
         }
         std::memcpy(msg.data + body_len_digits_offset, body_len_digits, sizeof(body_len_digits));
 
@@ -870,18 +906,17 @@ namespace jolt::gateway {
         }
         checksum %= 256;
         if (!append_checksum(msg, checksum)) {
-            return false;
+            return 0;
         }
 
-        out.len = msg.len;
-        out.conn_id = state.session_id;
-        return true;
+        return msg.len;
     }
 
-    bool FixGateway::build_logon(FixMessage& out,
-                                 SessionState* session,
-                                 uint32_t heartbeat_int,
-                                 bool reset_seq) {
+    size_t FixGateway::build_logon(char* out,
+                                   const size_t cap,
+                                   SessionState* session,
+                                   uint32_t heartbeat_int,
+                                   bool reset_seq) {
         FixMessage body_msg;
         FixBuffer body{body_msg.data, 0, sizeof(body_msg.data)};
 
@@ -922,16 +957,16 @@ namespace jolt::gateway {
         };
 
         if (!append_raw(body, "35=A\x01", 5)) {
-            return false;
+            return 0;
         }
         if (!append_sv_field(body, "49=", sizeof("49=") - 1, session->target_comp_id)) {
-            return false;
+            return 0;
         }
         if (!append_sv_field(body, "56=", sizeof("56=") - 1, session->sender_comp_id)) {
-            return false;
+            return 0;
         }
         if (!append_u64_field(body, "34=", sizeof("34=") - 1, session->seq++)) {
-            return false;
+            return 0;
         }
 
         char ts_buf[32];
@@ -939,33 +974,142 @@ namespace jolt::gateway {
             std::chrono::system_clock::now().time_since_epoch()).count();
         auto [ts_ptr, ts_ec] = std::to_chars(ts_buf, ts_buf + sizeof(ts_buf), now_ns);
         if (ts_ec != std::errc{}) {
-            return false;
+            return 0;
         }
         const size_t ts_len = static_cast<size_t>(ts_ptr - ts_buf);
         if (!append_sv_field(body, "52=", sizeof("52=") - 1, std::string_view(ts_buf, ts_len))) {
-            return false;
+            return 0;
         }
         if (!append_sv_field(body, "98=", sizeof("98=") - 1, "0")) {
-            return false;
+            return 0;
         }
         if (!append_u64_field(body, "108=", sizeof("108=") - 1, heartbeat_int)) {
-            return false;
+            return 0;
         }
         if (reset_seq) {
             if (!append_sv_field(body, "141=", sizeof("141=") - 1, "Y")) {
+                return 0;
+            }
+        }
+
+        FixBuffer msg{out, 0, cap};
+        if (!append_raw(msg, "8=FIX.4.4\x01", 10)) {
+            return 0;
+        }
+        if (!append_u64_field(msg, "9=", sizeof("9=") - 1, body.len)) {
+            return 0;
+        }
+        if (!append_raw(msg, body_msg.data, body.len)) {
+            return 0;
+        }
+
+        uint32_t checksum = 0;
+        for (size_t i = 0; i < msg.len; ++i) {
+            checksum += static_cast<unsigned char>(msg.data[i]);
+        }
+        checksum %= 256;
+        if (!append_checksum(msg, checksum)) {
+            return 0;
+        }
+
+        return msg.len;
+    }
+
+    size_t FixGateway::build_mass_cancel_report(char* out,
+                                                const size_t cap,
+                                                SessionState* session,
+                                                std::string_view cl_ord_id,
+                                                std::string_view request_type,
+                                                bool accepted) {
+        FixMessage body_msg;
+        FixBuffer body{body_msg.data, 0, sizeof(body_msg.data)};
+
+        auto append_raw = [](FixBuffer& dst, const char* src, size_t n) -> bool {
+            if (dst.len + n > dst.cap) {
+                return false;
+            }
+            std::memcpy(dst.data + dst.len, src, n);
+            dst.len += n;
+            return true;
+        };
+        auto append_sv_field =
+            [&](FixBuffer& dst, const char* tag_eq, size_t tag_len, std::string_view value) -> bool {
+            if (dst.len + tag_len + value.size() + 1 > dst.cap) {
                 return false;
             }
+            std::memcpy(dst.data + dst.len, tag_eq, tag_len);
+            dst.len += tag_len;
+            if (!value.empty()) {
+                std::memcpy(dst.data + dst.len, value.data(), value.size());
+                dst.len += value.size();
+            }
+            dst.data[dst.len++] = kFixDelim;
+            return true;
+        };
+        auto append_u64_field =
+            [&](FixBuffer& dst, const char* tag_eq, size_t tag_len, uint64_t value) -> bool {
+            char num_buf[32];
+            auto [num_ptr, num_ec] = std::to_chars(num_buf, num_buf + sizeof(num_buf), value);
+            if (num_ec != std::errc{}) {
+                return false;
+            }
+            return append_sv_field(
+                dst,
+                tag_eq,
+                tag_len,
+                std::string_view(num_buf, static_cast<size_t>(num_ptr - num_buf)));
+        };
+
+        if (!append_raw(body, "35=r\x01", 5)) {
+            return 0;
+        }
+        if (!append_sv_field(body, "49=", sizeof("49=") - 1, session->target_comp_id)) {
+            return 0;
+        }
+        if (!append_sv_field(body, "56=", sizeof("56=") - 1, session->sender_comp_id)) {
+            return 0;
+        }
+        if (!append_u64_field(body, "34=", sizeof("34=") - 1, session->seq++)) {
+            return 0;
+        }
+
+        char ts_buf[32];
+        const auto now_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::system_clock::now().time_since_epoch()).count();
+        auto [ts_ptr, ts_ec] = std::to_chars(ts_buf, ts_buf + sizeof(ts_buf), now_ns);
+        if (ts_ec != std::errc{}) {
+            return 0;
+        }
+        const size_t ts_len = static_cast<size_t>(ts_ptr - ts_buf);
+        if (!append_sv_field(body, "52=", sizeof("52=") - 1, std::string_view(ts_buf, ts_len))) {
+            return 0;
+        }
+        if (!cl_ord_id.empty()) {
+            if (!append_sv_field(body, "11=", sizeof("11=") - 1, cl_ord_id)) {
+                return 0;
+            }
+        }
+        // the orders themselves are reported one by one as they are cancelled
+        if (!append_sv_field(body, "37=", sizeof("37=") - 1, "NONE")) {
+            return 0;
+        }
+        if (!append_sv_field(body, "530=", sizeof("530=") - 1, request_type)) {
+            return 0;
+        }
+        // 531=0 rejected, otherwise echoes the request type
+        if (!append_sv_field(body, "531=", sizeof("531=") - 1, accepted ? request_type : "0")) {
+            return 0;
         }
 
-        FixBuffer msg{out.data, 0, sizeof(out.data)};
+        FixBuffer msg{out, 0, cap};
         if (!append_raw(msg, "8=FIX.4.4\x01", 10)) {
-            return false;
+            return 0;
         }
         if (!append_u64_field(msg, "9=", sizeof("9=") - 1, body.len)) {
-            return false;
+            return 0;
         }
         if (!append_raw(msg, body_msg.data, body.len)) {
-            return false;
+            return 0;
         }
 
         uint32_t checksum = 0;
@@ -974,11 +1118,54 @@ namespace jolt::gateway {
         }
         checksum %= 256;
         if (!append_checksum(msg, checksum)) {
-            return false;
+            return 0;
         }
 
-        out.len = msg.len;
-        return true;
+        return msg.len;
+    }
+
+    size_t FixGateway::build_report(char* out,
+                                    const size_t cap,
+                                    SessionState* session,
+                                    const OrderState& state,
+                                    const uint64_t exec_id,
+                                    const bool accepted,
+                                    const ob::RejectReason reason,
+                                    const uint64_t fill_qty) {
+        if (session->binary) {
+            return build_binary_report(out, cap, state, exec_id, accepted, reason, fill_qty);
+        }
+        return build_exec_report(out, cap, session, state, exec_id, accepted, reason);
+    }
+
+    size_t FixGateway::build_binary_report(char* out,
+                                           const size_t cap,
+                                           const OrderState& state,
+                                           const uint64_t exec_id,
+                                           const bool accepted,
+                                           const ob::RejectReason reason,
+                                           const uint64_t fill_qty) {
+        const auto ts = static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::system_clock::now().time_since_epoch()).count());
+        if (!accepted) {
+            return boe::write_msg(out, cap, boe::Reject{boe::header_of(boe::MsgType::Reject), state.binary_cl_ord_id,
+                                                        state.params.id, exec_id, ts, reason});
+        }
+        if (fill_qty != 0) {
+            const ob::Qty leaves = state.state == State::Filled ? 0 : state.params.qty;
+            return boe::write_msg(out, cap, boe::Fill{boe::header_of(boe::MsgType::Fill), state.binary_cl_ord_id,
+                                                      state.params.id, exec_id, ts,
+                                                      static_cast<ob::Qty>(fill_qty), leaves});
+        }
+        boe::AckStatus status = boe::AckStatus::New;
+        if (state.state == State::Cancelled) {
+            status = boe::AckStatus::Cancelled;
+        }
+        else if (state.state == State::Replaced) {
+            status = boe::AckStatus::Replaced;
+        }
+        return boe::write_msg(out, cap, boe::Ack{boe::header_of(boe::MsgType::Ack), state.binary_cl_ord_id,
+                                                 state.params.id, exec_id, ts, status});
     }
 
     bool FixGateway::resolve_session_and_client(const uint64_t conn_id,
@@ -1000,8 +1187,9 @@ namespace jolt::gateway {
         }
 
         if (is_logon) {
-            logical_session_id = resolve_logical_session_id(sender);
-            bind_logical_session(logical_session_id, conn_id);
+            if (!bind_logon(conn_id, sender, logical_session_id)) {
+                return false;
+            }
         } else {
             logical_session_id = conn_to_logical_[conn_id];
             if (logical_session_id == 0) {
@@ -1027,6 +1215,23 @@ namespace jolt::gateway {
 
         const auto account = get_tag(msg, 1);
         client_id = id_from_cl_ord_id(account);
+        attach_client(client_id, logical_session_id);
+        return true;
+    }
+
+    bool FixGateway::bind_logon(const uint64_t conn_id, const std::string_view sender, uint64_t& logical_session_id) {
+        if (worker_of(sender, num_workers_) != worker_) {
+            log_error("[gtwy] gateway worker=" + std::to_string(worker_) + " refused logon of sender=" +
+                std::string(sender) + " owned by worker=" + std::to_string(worker_of(sender, num_workers_)) +
+                " conn_id=" + std::to_string(conn_id));
+            return false;
+        }
+        logical_session_id = resolve_logical_session_id(sender);
+        bind_logical_session(logical_session_id, conn_id);
+        return true;
+    }
+
+    void FixGateway::attach_client(const uint64_t client_id, const uint64_t logical_session_id) {
         auto client_it = clients_.find(client_id);
         if (client_it == clients_.end()) {
             auto client = std::make_unique<Client>(client_id);
@@ -1036,7 +1241,6 @@ namespace jolt::gateway {
         } else {
             client_it->second->set_session_id(logical_session_id);
         }
-        return true;
     }
 
     bool FixGateway::handle_logon_message(const uint64_t conn_id, const FixMsg& msg) {
@@ -1048,17 +1252,19 @@ namespace jolt::gateway {
         }
         (void)client_id;
 
-        FixMessage out;
-        if (!build_logon(out, session, 30, false)) {
-            log_error("[gtwy] failed to build logon msg conn_id=" + std::to_string(conn_id));
+        size_t built = 0;
+        if (!event_loop_.enqueue_outbound(conn_id, [&](char* out, size_t cap) {
+                built = build_logon(out, cap, session, 30, false);
+                return built;
+            })) {
+            log_error("[gtwy] failed to enqueue logon msg conn_id=" + std::to_string(conn_id));
             return false;
         }
-        session->logged_on = true;
-        out.conn_id = conn_id;
-        if (!event_loop_.enqueue_outbound(out)) {
-            log_error("[gtwy] failed to enqueue logon msg conn_id=" + std::to_string(conn_id));
+        if (built == 0) {
+            log_error("[gtwy] failed to build logon msg conn_id=" + std::to_string(conn_id));
             return false;
         }
+        session->logged_on = true;
         flush_pending_for_logical_session(logical_session_id);
         return true;
     }
@@ -1078,7 +1284,7 @@ namespace jolt::gateway {
     }
 
     bool FixGateway::handle_order_message(const uint64_t conn_id,
-                                          const FixMessage& fix,
+                                          const std::string_view message,
                                           const FixMsg& msg,
                                           const char order_msg_type) {
         uint64_t logical_session_id = 0;
@@ -1088,7 +1294,6 @@ namespace jolt::gateway {
             return false;
         }
         const uint64_t session_id = logical_session_id;
-        const std::string_view message(fix.data, fix.len);
         const std::string_view msg_type(&order_msg_type, 1);
 
         OrderState* state = nullptr;
@@ -1139,7 +1344,7 @@ namespace jolt::gateway {
                     " session=" + std::to_string(session_id));
                 return false;
             }
-            state = order_state_pool_.get(*mapped_order_id);
+            state = order_state_pool_.get(order_slot(*mapped_order_id));
             if (!state) {
                 log_error("[gtwy] gateway " + std::string(action_name) +
                     " resolved unmapped order_id=" + std::to_string(*mapped_order_id) +
@@ -1192,7 +1397,7 @@ namespace jolt::gateway {
                 return false;
             }
             uint16_t symbol_id = 0;
-            if (!parse_symbol_id(symbol, symbol_id)) {
+            if (!parse_symbol_id(symbol, symbol_id) || !instruments_.contains(symbol_id)) {
                 log_error("[gtwy] gateway failed parsing symbol tag55 value=" + std::string(symbol) +
                     " order_id=" + std::to_string(state->params.id) +
                     " client_id=" + std::to_string(state->params.client_id) +
@@ -1309,8 +1514,8 @@ namespace jolt::gateway {
         switch (order_msg_type) {
         case 'D':
             {
-                const uint64_t order_id = next_order_id_++;
-                state = order_state_pool_.acquire(order_id);
+                const uint64_t order_id = take_order_id();
+                state = order_state_pool_.acquire(order_slot(order_id));
                 if (!state) {
                     log_error("[gtwy] gateway failed to acquire order state slot order_id=" +
                         std::to_string(order_id) +
@@ -1342,6 +1547,9 @@ namespace jolt::gateway {
                 } else if (state->params.type == ob::OrderType::StopLimit &&
                     (state->params.trigger == 0 || state->params.limit_px == 0)) {
                     reason = ob::RejectReason::InvalidPrice;
+                } else if (!instruments_.at(instruments_.index_of(state->params.symbol_id))
+                                .prices_in_range(state->params)) {
+                    reason = ob::RejectReason::InvalidPrice;
                 }
                 state->state = State::PendingNew;
                 upsert_cl_ord(cl_ord_key, state->params.id);
@@ -1389,6 +1597,9 @@ namespace jolt::gateway {
                     reason = ob::RejectReason::InvalidType;
                 } else if (state->params.qty == 0) {
                     reason = ob::RejectReason::InvalidQty;
+                } else if (!instruments_.at(instruments_.index_of(state->params.symbol_id))
+                                .prices_in_range(state->params)) {
+                    reason = ob::RejectReason::InvalidPrice;
                 }
                 state->state = State::PendingReplace;
                 upsert_cl_ord(cl_ord_key, state->params.id);
@@ -1401,6 +1612,11 @@ namespace jolt::gateway {
             return false;
         }
 
+        return submit_or_reject(logical_session_id, session, state, reason);
+    }
+
+    bool FixGateway::submit_or_reject(const uint64_t session_id, SessionState* session, OrderState* state,
+                                      ob::RejectReason reason) {
         if (reason != ob::RejectReason::NotApplicable) {
             log_warn("[gtwy] gateway local reject order_id=" + std::to_string(state->params.id) +
                 " client_id=" + std::to_string(state->params.client_id) +
@@ -1408,15 +1624,15 @@ namespace jolt::gateway {
                 " action=" + std::string(order_action_text(state->params.action)) +
                 " reason=" + std::string(reject_reason_text(reason)));
             state->state = State::Rejected;
-            FixMessage reject;
-            if (!build_exec_report(reject, session, *state, next_exec_id_++, false, reason)) {
+            if (!route_outbound_or_queue(session_id, [&](char* out, size_t cap) {
+                    return build_report(out, cap, session, *state, next_exec_id_++, false, reason);
+                })) {
                 log_error("[gtwy] gateway failed building local-reject ExecReport order_id=" +
                     std::to_string(state->params.id) +
                     " client_id=" + std::to_string(state->params.client_id) +
                     " session=" + std::to_string(session_id));
                 return false;
             }
-            route_outbound_or_queue(logical_session_id, reject);
             return false;
         }
 
@@ -1426,24 +1642,22 @@ namespace jolt::gateway {
                 " session=" + std::to_string(session_id) +
                 " reason=" + std::string(reject_reason_text(reason)));
             state->state = State::Rejected;
-            FixMessage reject;
-            if (!build_exec_report(reject, session, *state, next_exec_id_++, false, reason)) {
+            if (!route_outbound_or_queue(session_id, [&](char* out, size_t cap) {
+                    return build_report(out, cap, session, *state, next_exec_id_++, false, reason);
+                })) {
                 log_error("[gtwy] gateway failed building submit-failed ExecReport order_id=" +
                     std::to_string(state->params.id) +
                     " client_id=" + std::to_string(state->params.client_id) +
                     " session=" + std::to_string(session_id));
                 return false;
             }
-            route_outbound_or_queue(logical_session_id, reject);
             return false;
         }
 
         return true;
     }
 
-    bool FixGateway::on_fix_message(const FixMessage& fix) {
-        const uint64_t conn_id = fix.conn_id;
-        const std::string_view message(fix.data, fix.len);
+    bool FixGateway::on_fix_message(const uint64_t conn_id, const std::string_view message) {
         thread_local FixMsg msg;
         if (!parse_fix_simd(message, msg) /*&& !parse_fix_message(message, msg)*/) {
             log_error("[gtwy] gateway failed to parse FIX from client conn_id=" + std::to_string(conn_id) +
@@ -1469,7 +1683,9 @@ namespace jolt::gateway {
         case 'D':
         case 'F':
         case 'G':
-            return handle_order_message(conn_id, fix, msg, msg_type[0]);
+            return handle_order_message(conn_id, message, msg, msg_type[0]);
+        case 'q':
+            return handle_mass_cancel_message(conn_id, msg);
         case '0':
         case '1':
         case '5':
@@ -1481,6 +1697,187 @@ namespace jolt::gateway {
         }
     }
 
+    bool FixGateway::on_binary_message(const uint64_t conn_id, const std::string_view message) {
+        // the network thread framed it, so the size matches the type
+        const auto header = boe::read_msg<boe::Header>(message.data());
+        switch (header.type) {
+        case boe::MsgType::Login:
+            return handle_binary_login(conn_id, boe::read_msg<boe::Login>(message.data()));
+        case boe::MsgType::NewOrder:
+            return handle_binary_new(conn_id, boe::read_msg<boe::NewOrder>(message.data()));
+        case boe::MsgType::Cancel:
+            {
+                const auto cancel = boe::read_msg<boe::Cancel>(message.data());
+                return handle_binary_amend(conn_id, cancel.cl_ord_id, cancel.order_id, nullptr);
+            }
+        case boe::MsgType::Replace:
+            {
+                const auto replace = boe::read_msg<boe::Replace>(message.data());
+                return handle_binary_amend(conn_id, replace.cl_ord_id, replace.order_id, &replace);
+            }
+        default:
+            log_warn("[gtwy] gateway ignoring binary msg type=" + std::to_string(static_cast<unsigned>(header.type)) +
+                " conn_id=" + std::to_string(conn_id));
+            return true;
+        }
+    }
+
+    bool FixGateway::handle_binary_login(const uint64_t conn_id, const boe::Login& login) {
+        const std::string_view sender(login.session, strnlen(login.session, boe::kSessionNameLen));
+        if (sender.empty() || conn_id == 0 || conn_id >= conn_to_logical_.size()) {
+            log_error("[gtwy] gateway received binary login without a session name conn_id=" +
+                std::to_string(conn_id));
+            return false;
+        }
+        uint64_t logical_session_id = 0;
+        if (!bind_logon(conn_id, sender, logical_session_id)) {
+            return false;
+        }
+        SessionState* session = get_or_create_session(logical_session_id);
+        if (!session) {
+            return false;
+        }
+        session->sender_comp_id = std::string(sender);
+        session->client_id = login.account;
+        session->binary = true;
+        attach_client(login.account, logical_session_id);
+
+        if (!event_loop_.enqueue_outbound(conn_id, [&](char* out, size_t cap) {
+                return boe::write_msg(out, cap, boe::LoginAccepted{boe::header_of(boe::MsgType::LoginAccepted),
+                                                                   logical_session_id});
+            })) {
+            log_error("[gtwy] failed to enqueue binary login reply conn_id=" + std::to_string(conn_id));
+            return false;
+        }
+        session->logged_on = true;
+        flush_pending_for_logical_session(logical_session_id);
+        return true;
+    }
+
+    SessionState* FixGateway::binary_session(const uint64_t conn_id, uint64_t& logical_session_id) {
+        logical_session_id = conn_id < conn_to_logical_.size() ? conn_to_logical_[conn_id] : 0;
+        SessionState* session = logical_session_id == 0 ? nullptr : get_or_create_session(logical_session_id);
+        if (!session || !session->binary || !session->logged_on) {
+            log_error("[gtwy] gateway dropped binary order for a conn that has not logged in conn_id=" +
+                std::to_string(conn_id));
+            return nullptr;
+        }
+        return session;
+    }
+
+    // hands out ids from the block reserved in order_ids_, the write of the next block stalls this thread once
+    // per kOrderIdBlock orders
+    uint64_t FixGateway::take_order_id() {
+        const uint64_t id = next_order_id_;
+        if (id >= order_ids_.reserved()) {
+            order_ids_.reserve(id + kOrderIdBlock * num_workers_);
+        }
+        next_order_id_ += num_workers_;
+        return id;
+    }
+
+    bool FixGateway::handle_binary_new(const uint64_t conn_id, const boe::NewOrder& order) {
+        uint64_t session_id = 0;
+        SessionState* session = binary_session(conn_id, session_id);
+        if (!session) {
+            return false;
+        }
+
+        const uint64_t order_id = take_order_id();
+        OrderState* state = order_state_pool_.acquire(order_slot(order_id));
+        if (!state) {
+            log_error("[gtwy] gateway failed to acquire order state slot order_id=" + std::to_string(order_id) +
+                " session=" + std::to_string(session_id));
+            return false;
+        }
+        *state = OrderState{};
+        state->session_id = session_id;
+        state->binary_cl_ord_id = order.cl_ord_id;
+        state->state = State::PendingNew;
+        ob::OrderParams& params = state->params;
+        params.id = order_id;
+        params.client_id = session->client_id;
+        params.ts = static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::system_clock::now().time_since_epoch()).count());
+        params.action = ob::OrderAction::New;
+        params.qty = order.qty;
+        params.price = order.price;
+        params.trigger = order.trigger;
+        params.limit_px = order.limit_px;
+        params.symbol_id = order.symbol_id;
+        params.side = order.side;
+        params.type = order.type;
+        params.tif = order.tif;
+
+        ob::RejectReason reason = ob::RejectReason::NotApplicable;
+        if (static_cast<uint8_t>(order.side) > static_cast<uint8_t>(ob::Side::Sell) ||
+            static_cast<uint8_t>(order.type) > static_cast<uint8_t>(ob::OrderType::StopLimit) ||
+            static_cast<uint8_t>(order.tif) > static_cast<uint8_t>(ob::TIF::FOK)) {
+            reason = ob::RejectReason::InvalidType;
+        } else if (params.qty == 0) {
+            reason = ob::RejectReason::InvalidQty;
+        } else if (!instruments_.contains(params.symbol_id) ||
+            (params.type == ob::OrderType::Limit && params.price == 0) ||
+            (params.type == ob::OrderType::StopMarket && params.trigger == 0) ||
+            (params.type == ob::OrderType::StopLimit && (params.trigger == 0 || params.limit_px == 0)) ||
+            !instruments_.at(instruments_.index_of(params.symbol_id)).prices_in_range(params)) {
+            reason = ob::RejectReason::InvalidPrice;
+        }
+        if ((params.type == ob::OrderType::StopMarket || params.type == ob::OrderType::StopLimit) &&
+            params.trigger != 0) {
+            params.price = params.trigger;
+        }
+        return submit_or_reject(session_id, session, state, reason);
+    }
+
+    bool FixGateway::handle_binary_amend(const uint64_t conn_id, const uint64_t cl_ord_id, const uint64_t order_id,
+                                         const boe::Replace* replace) {
+        uint64_t session_id = 0;
+        SessionState* session = binary_session(conn_id, session_id);
+        if (!session) {
+            return false;
+        }
+        OrderState* state = gateway_worker_of(order_id, num_workers_) == worker_
+            ? order_state_pool_.get(order_slot(order_id))
+            : nullptr;
+        if (!state || state->params.id != order_id || state->session_id != session_id) {
+            log_error("[gtwy] gateway binary " + std::string(replace ? "replace" : "cancel") +
+                " references unknown order_id=" + std::to_string(order_id) +
+                " session=" + std::to_string(session_id));
+            return false;
+        }
+        if (state->state == State::PendingNew || state->state == State::PendingCancel ||
+            state->state == State::PendingReplace) {
+            return false;
+        }
+        state->binary_cl_ord_id = cl_ord_id;
+        ob::RejectReason reason = ob::RejectReason::NotApplicable;
+        if (!replace) {
+            state->params.action = ob::OrderAction::Cancel;
+            state->state = State::PendingCancel;
+            return submit_or_reject(session_id, session, state, reason);
+        }
+
+        ob::OrderParams& params = state->params;
+        params.action = ob::OrderAction::Modify;
+        params.qty = replace->qty;
+        params.price = replace->price != 0 ? replace->price : params.price;
+        params.trigger = replace->trigger != 0 ? replace->trigger : params.trigger;
+        params.limit_px = replace->limit_px != 0 ? replace->limit_px : params.limit_px;
+        if ((params.type == ob::OrderType::StopMarket || params.type == ob::OrderType::StopLimit) &&
+            params.trigger != 0) {
+            params.price = params.trigger;
+        }
+        if (params.qty == 0) {
+            reason = ob::RejectReason::InvalidQty;
+        }
+        else if (!instruments_.at(instruments_.index_of(params.symbol_id)).prices_in_range(params)) {
+            reason = ob::RejectReason::InvalidPrice;
+        }
+        state->state = State::PendingReplace;
+        return submit_or_reject(session_id, session, state, reason);
+    }
+
     // void FixGateway::exchange_rx_loop() {
     //     while (running_.load(std::memory_order_acquire)) {
     //         ExchToGtwyMsg msg{};
@@ -1490,35 +1887,47 @@ namespace jolt::gateway {
     //     }
     // }
 
-    bool FixGateway::route_outbound_or_queue(const uint64_t logical_session_id, FixMessage& msg) {
+    template <typename Encode>
+    bool FixGateway::route_outbound_or_queue(const uint64_t logical_session_id, Encode&& encode) {
         if (logical_session_id == 0) {
             return false;
         }
         ensure_logical_session_capacity(logical_session_id);
 
-        auto enqueue_pending = [&]() {
-            auto& pending = pending_outbound_[logical_session_id];
-            if (pending.size() >= kPendingReplayLimit) {
-                pending.pop_front();
-            }
-            FixMessage queued = msg;
-            queued.conn_id = logical_session_id;
-            pending.push_back(queued);
-        };
-
         const uint64_t conn_id = logical_to_conn_[logical_session_id];
-        if (conn_id == 0 || conn_id >= conn_to_logical_.size()) {
-            enqueue_pending();
-            return true;
+        const bool connected = conn_id != 0 && conn_id < conn_to_logical_.size();
+        auto& pending = pending_outbound_[logical_session_id];
+        // behind what is already queued, reports go out in the order they were made
+        if (connected && pending.empty()) {
+            size_t built = 0;
+            if (event_loop_.enqueue_outbound(conn_id, [&](char* out, size_t cap) {
+                    built = encode(out, cap);
+                    return built;
+                })) {
+                return built != 0;
+            }
         }
 
-        msg.conn_id = conn_id;
-        if (event_loop_.enqueue_outbound(msg)) {
-            return true;
+        // a full tx ring is backpressure, not a disconnect: the report waits here and poll_ingress sends it as
+        // the ring drains. for a session that is gone it is replayed once the session logs on again
+        FixMessage queued;
+        queued.len = encode(queued.data, sizeof(queued.data));
+        if (queued.len == 0) {
+            return false;
         }
-
-        on_disconnect(conn_id);
-        enqueue_pending();
+        if (pending.size() >= kPendingReplayLimit) {
+            // a client that stopped reading: the network thread closes its socket, and the disconnect it
+            // reports back cancels the session's orders like any other
+            if (connected) {
+                event_loop_.request_close(conn_id);
+            }
+            pending.pop_front();
+        }
+        queued.conn_id = logical_session_id;
+        if (connected && pending.empty()) {
+            tx_backlog_.push_back(logical_session_id);
+        }
+        pending.push_back(queued);
         return true;
     }
 
@@ -1533,16 +1942,45 @@ namespace jolt::gateway {
                 break;
             }
 
-            FixMessage next = pending.front();
-            next.conn_id = conn_id;
-            if (!event_loop_.enqueue_outbound(next)) {
-                on_disconnect(conn_id);
+            const FixMessage& next = pending.front();
+            if (!event_loop_.enqueue_outbound(conn_id, std::string_view(next.data, next.len))) {
+                // ring full, the rest goes once it drains
+                if (std::find(tx_backlog_.begin(), tx_backlog_.end(), logical_session_id) == tx_backlog_.end()) {
+                    tx_backlog_.push_back(logical_session_id);
+                }
                 break;
             }
             pending.pop_front();
         }
     }
 
+    bool FixGateway::flush_tx_backlog() {
+        bool sent = false;
+        size_t kept = 0;
+        for (size_t i = 0; i < tx_backlog_.size(); ++i) {
+            const uint64_t logical_session_id = tx_backlog_[i];
+            auto& pending = pending_outbound_[logical_session_id];
+            const size_t before = pending.size();
+            const uint64_t conn_id = logical_to_conn_[logical_session_id];
+            if (conn_id != 0 && conn_id < conn_to_logical_.size()) {
+                while (!pending.empty()) {
+                    const FixMessage& next = pending.front();
+                    if (!event_loop_.enqueue_outbound(conn_id, std::string_view(next.data, next.len))) {
+                        break;
+                    }
+                    pending.pop_front();
+                }
+                if (!pending.empty()) {
+                    tx_backlog_[kept++] = logical_session_id;
+                }
+            }
+            // a session that went away keeps its queue for the next logon
+            sent = sent || pending.size() != before;
+        }
+        tx_backlog_.resize(kept);
+        return sent;
+    }
+
     void FixGateway::on_disconnect(const uint64_t disconnected_conn_id) {
         if (disconnected_conn_id == 0 || disconnected_conn_id >= conn_to_logical_.size()) {
             return;
@@ -1554,7 +1992,90 @@ namespace jolt::gateway {
         }
         if (logical_to_conn_[logical_session_id] == disconnected_conn_id) {
             logical_to_conn_[logical_session_id] = 0;
+            // cancel on disconnect: pull every resting order of the accounts trading on this session,
+            // one mass cancel per shard instead of a cancel per order
+            for (const auto& [client_id, client] : clients_) {
+                if (client->get_session_id() == logical_session_id) {
+                    submit_mass_cancel(client_id, 0, std::nullopt);
+                }
+            }
+        }
+    }
+
+    bool FixGateway::submit_mass_cancel(const uint64_t client_id, const uint16_t symbol_id,
+                                        const std::optional<ob::Side> side) {
+        ob::OrderParams order{};
+        order.client_id = client_id;
+        order.symbol_id = symbol_id;
+        order.action = ob::OrderAction::MassCancel;
+        order.side = side.value_or(ob::Side::Buy);
+        order.one_side = side.has_value();
+        order.ts = static_cast<uint64_t>(
+            std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::system_clock::now().time_since_epoch()).count());
+
+        if (symbol_id != 0) {
+            ob::RejectReason reason = ob::RejectReason::NotApplicable;
+            return submit_order(order, reason);
+        }
+        // every shard sweeps the books it owns
+        bool ok = true;
+        for (auto& ring : gtwy_exch_) {
+            auto* ptr = ring->alloc();
+            if (!ptr) {
+                log_error("[gtwy] gateway->exchange ring full, mass cancel dropped client_id=" +
+                    std::to_string(client_id));
+                ok = false;
+                continue;
+            }
+            ptr->order = order;
+            ptr->client_id = client_id;
+            ring->push();
+        }
+        return ok;
+    }
+
+    bool FixGateway::handle_mass_cancel_message(const uint64_t conn_id, const FixMsg& msg) {
+        uint64_t logical_session_id = 0;
+        uint64_t client_id = 0;
+        SessionState* session = nullptr;
+        if (!resolve_session_and_client(conn_id, msg, false, logical_session_id, client_id, session)) {
+            return false;
+        }
+
+        // 530=1 cancels one security (55), 530=7 cancels everything, 54 optionally narrows to a side
+        const auto cl_ord_id = get_tag(msg, 11);
+        const auto request_type = get_tag(msg, 530);
+        uint16_t symbol_id = 0;
+        bool valid = request_type == "7";
+        if (request_type == "1") {
+            valid = parse_symbol_id(get_tag(msg, 55), symbol_id) && instruments_.contains(symbol_id);
+        }
+        std::optional<ob::Side> side;
+        const auto side_tag = get_tag(msg, 54);
+        if (side_tag == "1") {
+            side = ob::Side::Buy;
+        }
+        else if (side_tag == "2") {
+            side = ob::Side::Sell;
+        }
+
+        if (valid) {
+            valid = submit_mass_cancel(client_id, symbol_id, side);
         }
+        log_info("[gtwy] gateway mass cancel client_id=" + std::to_string(client_id) +
+            " session=" + std::to_string(logical_session_id) +
+            " type=" + std::string(request_type) +
+            " accepted=" + std::to_string(valid));
+
+        if (!route_outbound_or_queue(logical_session_id, [&](char* out, size_t cap) {
+                return build_mass_cancel_report(out, cap, session, cl_ord_id, request_type, valid);
+            })) {
+            log_error("[gtwy] gateway failed building OrderMassCancelReport session=" +
+                std::to_string(logical_session_id));
+            return false;
+        }
+        return valid;
     }
 
     bool FixGateway::risk_check(const ClientInfo& client, const ob::OrderParams& order,
@@ -1592,7 +2113,12 @@ namespace jolt::gateway {
 
     void FixGateway::handle_exchange_msg(const ExchToGtwyMsg& msg) {
         const uint64_t state_order_id = msg.order_id;
-        auto* state = order_state_pool_.get(state_order_id);
+        if (gateway_worker_of(state_order_id, num_workers_) != worker_) {
+            log_warn("[gtwy] gateway worker=" + std::to_string(worker_) + " got exchange response for order_id=" +
+                std::to_string(state_order_id) + " of another worker");
+            return;
+        }
+        auto* state = order_state_pool_.get(order_slot(state_order_id));
         if (!state) {
             log_warn("[gtwy] gateway got exchange response for unknown order_id=" +
                 std::to_string(state_order_id) +
@@ -1632,35 +2158,30 @@ namespace jolt::gateway {
                     break;
                 }
 
-                FixMessage fix_submit;
-
-                if (!build_exec_report(fix_submit, sess, *state, next_exec_id_++, true, msg.reason)) {
+                if (!route_outbound_or_queue(logical_session_id, [&](char* out, size_t cap) {
+                        return build_report(out, cap, sess, *state, next_exec_id_++, true, msg.reason);
+                    })) {
                     log_error("[gtwy] gateway failed building submit ExecReport order_id=" +
                         std::to_string(state_order_id) +
                         " client_id=" + std::to_string(state->params.client_id) +
                         " logical_session_id=" + std::to_string(logical_session_id));
                     return;
                 }
-
-                route_outbound_or_queue(logical_session_id, fix_submit);
-
                 break;
             }
 
         case ExchToGtwyMsg::Type::Rejected:
             {
                 state->state = State::Rejected;
-                FixMessage fix_reject;
-
-                if (!build_exec_report(fix_reject, sess, *state, next_exec_id_++, false, msg.reason)) {
+                if (!route_outbound_or_queue(logical_session_id, [&](char* out, size_t cap) {
+                        return build_report(out, cap, sess, *state, next_exec_id_++, false, msg.reason);
+                    })) {
                     log_error("[gtwy] gateway failed building reject ExecReport order_id=" +
                         std::to_string(state_order_id) +
                         " client_id=" + std::to_string(state->params.client_id) +
                         " logical_session_id=" + std::to_string(logical_session_id));
                     return;
                 }
-
-                route_outbound_or_queue(logical_session_id, fix_reject);
                 break;
             }
         case ExchToGtwyMsg::Type::Filled:
@@ -1671,16 +2192,30 @@ namespace jolt::gateway {
                 else {
                     state->params.qty -= msg.fill_qty;
                 }
-                FixMessage fix_fill;
-
-                if (!build_exec_report(fix_fill, sess, *state, next_exec_id_++, true, msg.reason)) {
+                if (!route_outbound_or_queue(logical_session_id, [&](char* out, size_t cap) {
+                        return build_report(out, cap, sess, *state, next_exec_id_++, true, msg.reason, msg.fill_qty);
+                    })) {
                     log_error("[gtwy] gateway failed building fill ExecReport order_id=" +
                         std::to_string(state_order_id) +
                         " client_id=" + std::to_string(state->params.client_id) +
                         " logical_session_id=" + std::to_string(logical_session_id));
                     return;
                 }
-                route_outbound_or_queue(logical_session_id, fix_fill);
+                break;
+            }
+        case ExchToGtwyMsg::Type::Cancelled:
+            {
+                // unsolicited cancel from a mass cancel or cancel-on-disconnect
+                state->state = State::Cancelled;
+                if (!route_outbound_or_queue(logical_session_id, [&](char* out, size_t cap) {
+                        return build_report(out, cap, sess, *state, next_exec_id_++, true, msg.reason);
+                    })) {
+                    log_error("[gtwy] gateway failed building cancel ExecReport order_id=" +
+                        std::to_string(state_order_id) +
+                        " client_id=" + std::to_string(state->params.client_id) +
+                        " logical_session_id=" + std::to_string(logical_session_id));
+                    return;
+                }
                 break;
             }
         default: break;
@@ -1705,20 +2240,25 @@ namespace jolt::gateway {
         while (running_.load(std::memory_order_acquire)) {
             bool did_work = false;
 
+            RxSegmentPool& rx_pool = event_loop_.rx_pool();
             const size_t client_drained = client_ingress_q_->drain([&](const ClientFixMsg& ev) {
-                auto& fix = fix_messages_[ev.slot_id];
-                fix.conn_id = ev.session_id;
-                on_fix_message(fix);
-                auto* slot = slot_ids->get_tail_ptr();
-                if (slot) {
-                    *slot = ev.slot_id;
-                    slot_ids->write();
+                const std::string_view message(rx_pool.data(ev.segment) + ev.offset, ev.len);
+                if (ev.binary) {
+                    on_binary_message(ev.session_id, message);
                 }
+                else {
+                    on_fix_message(ev.session_id, message);
+                }
+                rx_pool.release(ev.segment);
             }, kClientBudget);
             if (client_drained > 0) {
                 did_work = true;
             }
 
+            if (!tx_backlog_.empty() && flush_tx_backlog()) {
+                did_work = true;
+            }
+
             for (int n = 0; n < kSocketBudget; ++n) {
                 auto socket_ev = event_loop_.dequeue_socket_event();
                 if (!socket_ev) {
@@ -1728,11 +2268,13 @@ namespace jolt::gateway {
                 did_work = true;
             }
 
-            const size_t exch_drained = exch_gtwy_.drain([&](const ExchToGtwyMsg& msg) {
-                handle_exchange_msg(msg);
-            }, kExchBudget);
-            if (exch_drained > 0) {
-                did_work = true;
+            for (auto& ring : exch_gtwy_) {
+                const size_t exch_drained = ring->drain([&](const ExchToGtwyMsg& msg) {
+                    handle_exchange_msg(msg);
+                }, kExchBudget);
+                if (exch_drained > 0) {
+                    did_work = true;
+                }
             }
 
             if (!did_work) {
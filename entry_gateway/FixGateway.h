@@ -7,6 +7,7 @@
 #include <functional>
 #include <memory>
 #include <mutex>
+#include <optional>
 #include <string>
 #include <string_view>
 #include <thread>
@@ -16,11 +17,14 @@
 #include "../exchange/orderbook/flat_map.h"
 #include "../include/SharedMemoryRing.h"
 #include "../include/Types.h"
+#include "../include/InstrumentRegistry.h"
 #include "../include/orderstatepool.h"
 #include "../include/spsc_new.h"
+#include "BinaryProtocol.h"
 #include "Client.h"
 #include "EventLoop.h"
 #include "GatewayTypes.h"
+#include "OrderIdReserve.h"
 
 namespace jolt::gateway {
     struct FixMsg;
@@ -85,8 +89,19 @@ namespace jolt::gateway {
         uint64_t resolve_logical_session_id(std::string_view sender_comp_id);
         void ensure_logical_session_capacity(uint64_t logical_session_id);
         void bind_logical_session(uint64_t logical_session_id, uint64_t conn_id);
-        bool route_outbound_or_queue(uint64_t logical_session_id, FixMessage& msg);
+        // encode(out, cap) writes one message of at most cap bytes and returns its length, 0 if it could not. it
+        // writes in place into the session's tx ring while the session is connected, into the replay queue
+        // otherwise. false when nothing was encoded
+        template <typename Encode>
+        bool route_outbound_or_queue(uint64_t logical_session_id, Encode&& encode);
         void flush_pending_for_logical_session(uint64_t logical_session_id);
+        // retries the queued reports of connected sessions whose tx ring was full, true if any went out
+        bool flush_tx_backlog();
+        // slot 0, which holds nothing, for ids of an earlier run
+        [[nodiscard]] uint64_t order_slot(uint64_t order_id) const {
+            return order_id < first_order_id_ ? 0 : (order_id - first_order_id_) / num_workers_ + 1;
+        }
+        uint64_t take_order_id();
         void exchange_rx_loop();
         bool resolve_session_and_client(uint64_t conn_id,
                                         const FixMsg& msg,
@@ -94,30 +109,81 @@ namespace jolt::gateway {
                                         uint64_t& logical_session_id,
                                         uint64_t& client_id,
                                         SessionState*& session);
+        // worker check, then binds conn_id to the logical session of sender
+        bool bind_logon(uint64_t conn_id, std::string_view sender, uint64_t& logical_session_id);
+        void attach_client(uint64_t client_id, uint64_t logical_session_id);
         bool handle_logon_message(uint64_t conn_id, const FixMsg& msg);
         bool handle_order_message(uint64_t conn_id,
-                                  const FixMessage& fix,
+                                  std::string_view message,
                                   const FixMsg& msg,
                                   char order_msg_type);
         bool handle_control_message(uint64_t conn_id, const FixMsg& msg, char msg_type);
-
-        static bool build_exec_report(FixMessage& out,
-                                      SessionState* session,
-                                      const OrderState& state,
-                                      uint64_t exec_id,
-                                      bool accepted,
-                                      ob::RejectReason reason);
-        static bool build_logon(FixMessage& out,
-                                SessionState* session,
-                                uint32_t heartbeat_int,
-                                bool reset_seq);
-
-        GtwyToExch gtwy_exch_;
-        ExchToGtwy exch_gtwy_;
+        // OrderMassCancelRequest (35=q)
+        bool handle_mass_cancel_message(uint64_t conn_id, const FixMsg& msg);
+        // sends a local reject when reason is set, otherwise forwards the order and rejects it if that fails
+        bool submit_or_reject(uint64_t session_id, SessionState* session, OrderState* state,
+                              ob::RejectReason reason);
+        bool handle_binary_login(uint64_t conn_id, const boe::Login& login);
+        // logged on binary session of conn_id, nullptr otherwise
+        SessionState* binary_session(uint64_t conn_id, uint64_t& logical_session_id);
+        bool handle_binary_new(uint64_t conn_id, const boe::NewOrder& order);
+        // a cancel when replace is null
+        bool handle_binary_amend(uint64_t conn_id, uint64_t cl_ord_id, uint64_t order_id, const boe::Replace* replace);
+        // symbol_id 0 cancels across all symbols, side narrows to one side when set
+        bool submit_mass_cancel(uint64_t client_id, uint16_t symbol_id, std::optional<ob::Side> side);
+
+        // builders write one message into out and return its length, 0 when it does not fit in cap
+        // execution report in the session's protocol, fill_qty is only set for fills
+        static size_t build_report(char* out,
+                                   size_t cap,
+                                   SessionState* session,
+                                   const OrderState& state,
+                                   uint64_t exec_id,
+                                   bool accepted,
+                                   ob::RejectReason reason,
+                                   uint64_t fill_qty = 0);
+        static size_t build_binary_report(char* out,
+                                          size_t cap,
+                                          const OrderState& state,
+                                          uint64_t exec_id,
+                                          bool accepted,
+                                          ob::RejectReason reason,
+                                          uint64_t fill_qty);
+        static size_t build_exec_report(char* out,
+                                        size_t cap,
+                                        SessionState* session,
+                                        const OrderState& state,
+                                        uint64_t exec_id,
+                                        bool accepted,
+                                        ob::RejectReason reason);
+        static size_t build_logon(char* out,
+                                  size_t cap,
+                                  SessionState* session,
+                                  uint32_t heartbeat_int,
+                                  bool reset_seq);
+        static size_t build_mass_cancel_report(char* out,
+                                               size_t cap,
+                                               SessionState* session,
+                                               std::string_view cl_ord_id,
+                                               std::string_view request_type,
+                                               bool accepted);
+
+        InstrumentRegistry instruments_;
+        // one ring pair per matching shard, a single pair when the exchange is unsharded
+        std::vector<std::unique_ptr<GtwyToExch>> gtwy_exch_;
+        std::vector<std::unique_ptr<ExchToGtwy>> exch_gtwy_;
         ob::FlatMap<uint64_t, ClientInfo> client_infos_;
         ob::FlatMap<ClOrdMapKey, uint64_t, ClOrdMapKeyHash> cl_ord_id_to_order_id_;
+        // indexed by order_slot(order_id), this worker's ids are dense in it
         SlabPool<OrderState> order_state_pool_;
+        size_t worker_{0};
+        size_t num_workers_{1};
         uint64_t next_order_id_{1};
+        // the first id of this run, every id an earlier run handed out is below it
+        uint64_t first_order_id_{1};
+        OrderIdReserve order_ids_;
+        // ids reserved per write of order_ids_
+        static constexpr uint64_t kOrderIdBlock = 1 << 20;
         uint64_t next_exec_id_{1};
         EventLoop event_loop_;
         std::unordered_map<uint64_t, ClientTrafficStats> client_traffic_;
@@ -129,24 +195,47 @@ namespace jolt::gateway {
         std::vector<uint64_t> logical_to_conn_;
         std::vector<uint64_t> conn_to_logical_;
         std::vector<std::deque<FixMessage>> pending_outbound_;
+        // logical sessions, still connected, with reports in pending_outbound_ waiting for tx ring room
+        std::vector<uint64_t> tx_backlog_;
         uint64_t next_logical_session_id_{1};
         static constexpr size_t kPendingReplayLimit = 16'384;
         void poll_ingress();
 
     public:
-        FixGateway(const std::string& gtwy_to_exch_name, const std::string& exch_to_gtwy_name);
+        static constexpr uint16_t kListenPort = 8080;
+        // boe sessions, see BinaryProtocol.h
+        static constexpr uint16_t kBinaryListenPort = 8180;
+
+        // num_shards == 0 attaches the unsharded rings, otherwise <name>_<shard> for every shard. FIX sessions
+        // connect to listen_port(worker), boe ones to binary_listen_port(worker). with
+        // num_workers > 1 this is worker `worker`: it only logs on the sessions
+        // worker_of assigns it, attaches the rings named with worker_queue_name and hands out the order ids
+        // gateway_worker_of maps back to it
+        FixGateway(const std::string& gtwy_to_exch_name, const std::string& exch_to_gtwy_name,
+                   const InstrumentRegistry& instruments, size_t num_shards = 0,
+                   NetBackend backend = NetBackend::Epoll, size_t worker = 0, size_t num_workers = 1);
+        // the worker a logical session (its SenderCompID) belongs to
+        static size_t worker_of(std::string_view sender_comp_id, size_t num_workers);
+        static uint16_t listen_port(size_t worker) { return static_cast<uint16_t>(kListenPort + worker); }
+        static uint16_t binary_listen_port(size_t worker) { return static_cast<uint16_t>(kBinaryListenPort + worker); }
+        [[nodiscard]] size_t worker() const { return worker_; }
         void start();
         void stop();
+        [[nodiscard]] NetBackend net_backend() const { return event_loop_.backend(); }
+        // syscalls of the network thread, read after stop()
+        [[nodiscard]] uint64_t net_syscalls() const { return event_loop_.syscalls(); }
         void load_clients(const std::vector<ClientInfo>& clients);
         bool submit_order(const ob::OrderParams& order, ob::RejectReason& reason);
-        bool on_fix_message(const FixMessage& fix);
+        // message points into a receive segment and is only valid for the call
+        bool on_fix_message(uint64_t conn_id, std::string_view message);
+        // one framed boe message, same lifetime as on_fix_message's
+        bool on_binary_message(uint64_t conn_id, std::string_view message);
         void on_disconnect(uint64_t conn_id);
         std::unordered_map<uint64_t, std::unique_ptr<Client>> clients_;
         void clear_session_for_client(uint64_t client_id);
         std::vector<SessionState> sessions_;
-        std::unique_ptr<LockFreeQueue<size_t, 1 << 20>> slot_ids;
-        std::vector<FixMessage> fix_messages_{1 << 20};
-        std::unique_ptr<LockFreeQueue<ClientFixMsg, 1 << 20>> client_ingress_q_;
+        // messages framed in place by the network thread, in flight bytes are bounded by RxSegmentPool
+        std::unique_ptr<LockFreeQueue<ClientFixMsg, 1 << 16>> client_ingress_q_;
 
     };
 }
@@ -6,6 +6,7 @@
 #include "FixGateway.h"
 #include "../include/async_logger.h"
 
+#include <algorithm>
 #include <stdexcept>
 #include <sys/uio.h>
 #include <unistd.h>
@@ -51,7 +52,6 @@ namespace jolt::gateway {
     FixSession::FixSession(const std::string& sender_comp_id, const std::string& target_comp_id, int fd) {
         sender_comp_id_ = sender_comp_id;
         target_comp_id_ = target_comp_id;
-        rx_buf_ = {};
         fd_ = fd;
         clients_.reserve(64);
     }
@@ -72,33 +72,86 @@ namespace jolt::gateway {
             ::close(fd_);
             fd_ = -1;
             write_interest_enabled_ = false;
-            tx_batch_head_ = 0;
-            tx_batch_size_ = 0;
             tx_armed_.store(false, std::memory_order_release);
+            if (rx_seg_ != RxSegmentPool::kNone) {
+                rx_pool_->drop(rx_seg_);
+                rx_seg_ = RxSegmentPool::kNone;
+            }
             rx_len_ = 0;
             rx_off_ = 0;
-            tx_off_ = 0;
-            while (tx_queue_.get_head_ptr()) {
-                tx_queue_.read();
-            }
+            tx_ring_.clear();
         }
     }
 
-    void FixSession::recv_pending() {
-        if (rx_off_ >= rx_len_) {
+    bool FixSession::reserve_rx() {
+        if (rx_seg_ != RxSegmentPool::kNone && RxSegmentPool::kSegmentBytes - rx_len_ >= kFixMaxMsg) {
+            return true;
+        }
+        uint32_t seg = 0;
+        if (!rx_pool_->acquire(seg)) {
+            return rx_seg_ != RxSegmentPool::kNone && rx_len_ < RxSegmentPool::kSegmentBytes;
+        }
+        const size_t rem = rx_len_ - rx_off_;
+        if (rx_seg_ != RxSegmentPool::kNone) {
+            std::memcpy(rx_pool_->data(seg), rx_pool_->data(rx_seg_) + rx_off_, rem);
+            rx_pool_->drop(rx_seg_);
+        }
+        rx_seg_ = seg;
+        rx_off_ = 0;
+        rx_len_ = rem;
+        return true;
+    }
+
+    void FixSession::release_rx() {
+        if (rx_seg_ != RxSegmentPool::kNone && rx_off_ == rx_len_) {
+            rx_pool_->drop(rx_seg_);
+            rx_seg_ = RxSegmentPool::kNone;
             rx_off_ = rx_len_ = 0;
-        } else if (rx_off_ > 0 && (rx_len_ == kRxCap || rx_off_ > kRxCap / 2)) {
-            const size_t rem = rx_len_ - rx_off_;
-            memmove(rx_buf_.data(), rx_buf_.data() + rx_off_, rem);
-            rx_len_ = rem;
-            rx_off_ = 0;
         }
+    }
 
+    size_t FixSession::rx_needed() const {
+        // enough to reach BodyLength when the header is not all here yet
+        constexpr size_t kHeaderProbe = 32;
+        const std::string_view view(rx_pool_->data(rx_seg_) + rx_off_, rx_len_ - rx_off_);
+        if (binary_) {
+            if (view.size() < sizeof(boe::Header)) {
+                return sizeof(boe::Header) - view.size();
+            }
+            const auto header = boe::read_msg<boe::Header>(view.data());
+            return header.length > view.size() ? header.length - view.size() : boe::kMaxMsg;
+        }
+        const size_t soh = view.find(kFixDelim);
+        if (soh == std::string_view::npos || soh + 3 > view.size()) {
+            return kHeaderProbe;
+        }
+        if (view[0] != '8' || view[soh + 1] != '9' || view[soh + 2] != '=') {
+            // extract_message resyncs on it
+            return kFixMaxMsg;
+        }
+        const size_t len_end = view.find(kFixDelim, soh + 3);
+        if (len_end == std::string_view::npos) {
+            return kHeaderProbe;
+        }
+        size_t body_len = 0;
+        auto [ptr, ec] = std::from_chars(view.data() + soh + 3, view.data() + len_end, body_len);
+        // header, body and the 7 byte trailer "10=ccc<SOH>"
+        const size_t total = len_end + 1 + body_len + 7;
+        if (ec != std::errc() || total <= view.size()) {
+            return kFixMaxMsg;
+        }
+        return std::min(total - view.size(), kFixMaxMsg);
+    }
+
+    void FixSession::recv_pending() {
         for (;;) {
-            if (rx_len_ >= kRxCap) {
+            if (!reserve_rx()) {
+                // every segment is in flight to the gateway, level triggered epoll comes back to the rest
                 break;
             }
-            const ssize_t n = recv(fd_, rx_buf_.data() + rx_len_, kRxCap - rx_len_, 0);
+            ++syscalls_;
+            const ssize_t n =
+                recv(fd_, rx_pool_->data(rx_seg_) + rx_len_, RxSegmentPool::kSegmentBytes - rx_len_, 0);
             if (n < 0) {
                 if (errno == EAGAIN || errno == EWOULDBLOCK) {
                     break;
@@ -113,91 +166,98 @@ namespace jolt::gateway {
             }
 
             rx_len_ += static_cast<size_t>(n);
+            const bool drained = dispatch();
+            if (protocol_error_) {
+                close();
+                return;
+            }
+            if (!drained) {
+                // the gateway is behind, the rest stays in the socket
+                break;
+            }
         }
     }
 
+    size_t FixSession::take_rx(uint32_t seg, size_t off, size_t len) {
+        if (rx_off_ == rx_len_) {
+            release_rx();
+            rx_pool_->ref(seg);
+            rx_seg_ = seg;
+            rx_off_ = off;
+            rx_len_ = off + len;
+            return len;
+        }
+        // a message straddles two receives, only its missing bytes are copied after it
+        if (!reserve_rx()) {
+            return 0;
+        }
+        const size_t n = std::min({len, rx_needed(), RxSegmentPool::kSegmentBytes - rx_len_});
+        std::memcpy(rx_pool_->data(rx_seg_) + rx_len_, rx_pool_->data(seg) + off, n);
+        rx_len_ += n;
+        return n;
+    }
 
     void FixSession::on_readable() {
         recv_pending();
-        if (!gateway_) {
-            return;
+        release_rx();
+    }
+
+    bool FixSession::dispatch() {
+        if (!gateway_ || rx_seg_ == RxSegmentPool::kNone) {
+            return true;
         }
 
-        while (true) {
-            auto* free_slot = gateway_->slot_ids->get_head_ptr();
-            if (!free_slot) {
-                break;
-            }
-            const size_t slot_id = *free_slot;
-            gateway_->slot_ids->read();
-
-            auto [ok, msg_len] = extract_message(slot_id);
-            if (!ok) {
-                auto* ret_slot = gateway_->slot_ids->get_tail_ptr();
-                if (ret_slot) {
-                    *ret_slot = slot_id;
-                    gateway_->slot_ids->write();
+        for (;;) {
+            const size_t before = rx_off_;
+            size_t msg_off = 0;
+            size_t msg_len = 0;
+            if (!extract_message(msg_off, msg_len)) {
+                // skipped garbage up to the next "8=", try again from there
+                if (rx_off_ != before && rx_off_ < rx_len_) {
+                    continue;
                 }
                 break;
             }
 
             auto* ingress_slot = gateway_->client_ingress_q_->get_tail_ptr();
             if (!ingress_slot) {
-                auto* ret_slot = gateway_->slot_ids->get_tail_ptr();
-                if (ret_slot) {
-                    *ret_slot = slot_id;
-                    gateway_->slot_ids->write();
-                }
-                break;
+                rx_off_ = msg_off;
+                return false;
             }
-            ingress_slot->slot_id = static_cast<uint32_t>(slot_id);
-            ingress_slot->len = msg_len;
+            rx_pool_->ref(rx_seg_);
+            ingress_slot->segment = rx_seg_;
+            ingress_slot->offset = static_cast<uint16_t>(msg_off);
+            ingress_slot->len = static_cast<uint16_t>(msg_len);
             ingress_slot->rx_ts_nsl = std::chrono::duration_cast<std::chrono::nanoseconds>(
             std::chrono::system_clock::now().time_since_epoch()).count();
             ingress_slot->session_id = conn_id;
+            ingress_slot->binary = binary_;
             gateway_->client_ingress_q_->write();
         }
+        release_rx();
+        return true;
     }
 
 
 
-    bool FixSession::send_pending() {
-        while (true) {
-            while (tx_batch_size_ < kTxWritevBatch) {
-                Message* queued = tx_queue_.get_head_ptr();
-                if (!queued) {
-                    break;
-                }
-                tx_batch_[(tx_batch_head_ + tx_batch_size_) % kTxWritevBatch] = std::move(*queued);
-                tx_queue_.read();
-                ++tx_batch_size_;
-            }
-
-            if (tx_batch_size_ == 0) {
-                return true;
-            }
+    size_t FixSession::fill_tx_iov(iovec* iov) {
+        return tx_ring_.readable(iov);
+    }
 
-            iovec iov[kTxWritevBatch]{};
-            int iovcnt = 0;
-            for (size_t index = 0; index < tx_batch_size_ && iovcnt < static_cast<int>(kTxWritevBatch); ++index) {
-                const Message& m = tx_batch_[(tx_batch_head_ + index) % kTxWritevBatch];
-                const size_t start = (index == 0) ? tx_off_ : 0;
-                if (start >= m.len) {
-                    continue;
-                }
-                iov[iovcnt].iov_base = const_cast<char*>(m.buf.data() + start);
-                iov[iovcnt].iov_len = m.len - start;
-                ++iovcnt;
-            }
+    void FixSession::consume_tx(size_t consumed) {
+        tx_ring_.consume(consumed);
+    }
 
+    bool FixSession::send_pending() {
+        while (true) {
+            iovec iov[kTxIov]{};
+            const size_t iovcnt = fill_tx_iov(iov);
             if (iovcnt == 0) {
-                tx_batch_head_ = 0;
-                tx_batch_size_ = 0;
-                tx_off_ = 0;
                 return true;
             }
 
-            const ssize_t n = ::writev(fd_, iov, iovcnt);
+            ++syscalls_;
+            const ssize_t n = ::writev(fd_, iov, static_cast<int>(iovcnt));
             if (n < 0) {
                 if (errno == EAGAIN || errno == EWOULDBLOCK) {
                     return true;
@@ -210,21 +270,7 @@ namespace jolt::gateway {
                 return false;
             }
 
-            size_t consumed = static_cast<size_t>(n);
-            while (consumed > 0 && tx_batch_size_ != 0) {
-                Message& front = tx_batch_[tx_batch_head_];
-                const size_t remaining = front.len - tx_off_;
-                if (consumed >= remaining) {
-                    consumed -= remaining;
-                    tx_batch_head_ = (tx_batch_head_ + 1) % kTxWritevBatch;
-                    --tx_batch_size_;
-                    tx_off_ = 0;
-                }
-                else {
-                    tx_off_ += consumed;
-                    consumed = 0;
-                }
-            }
+            consume_tx(static_cast<size_t>(n));
         }
     }
 
@@ -234,92 +280,114 @@ namespace jolt::gateway {
     }
 
     bool FixSession::want_write() {
-        return tx_batch_size_ != 0 || !tx_queue_.empty();
+        return !tx_ring_.empty();
     }
 
-    std::pair<bool, size_t> FixSession::extract_message(size_t slot_id) {
-        auto fail = []() -> std::pair<bool, size_t> { return {false, 0}; };
-        if (!gateway_) {
-            return fail();
+    bool FixSession::extract_binary(size_t& msg_off, size_t& msg_len) {
+        const size_t avail = rx_len_ - rx_off_;
+        if (avail < sizeof(boe::Header)) {
+            return false;
+        }
+        const auto header = boe::read_msg<boe::Header>(rx_pool_->data(rx_seg_) + rx_off_);
+        const size_t len = boe::msg_size(header.type);
+        if (len == 0 || header.length != len || header.version != boe::kVersion) {
+            log_error("[gtwy] binary session sent a bad header conn_id=" + std::to_string(conn_id) +
+                      " type=" + std::to_string(static_cast<unsigned>(header.type)) +
+                      " length=" + std::to_string(header.length));
+            protocol_error_ = true;
+            rx_off_ = rx_len_;
+            return false;
         }
-        if (slot_id >= gateway_->fix_messages_.size()) {
-            return fail();
+        if (avail < len) {
+            return false;
         }
-        FixMessage* out = &gateway_->fix_messages_[slot_id];
+        msg_off = rx_off_;
+        msg_len = len;
+        rx_off_ += len;
+        return true;
+    }
 
-        std::string_view view(rx_buf_.data() + rx_off_, rx_len_ - rx_off_);
+    bool FixSession::extract_message(size_t& msg_off, size_t& msg_len) {
+        if (binary_) {
+            return extract_binary(msg_off, msg_len);
+        }
+        const char* rx = rx_pool_->data(rx_seg_);
+        std::string_view view(rx + rx_off_, rx_len_ - rx_off_);
         auto preserve_partial_fix_prefix = [this, &view]() {
-            if (!view.empty() && view.back() == '8') {
-                rx_buf_[0] = '8';
-                rx_off_ = 0;
-                rx_len_ = 1;
-                return;
-            }
-            rx_off_ = rx_len_ = 0;
+            rx_off_ = (!view.empty() && view.back() == '8') ? rx_len_ - 1 : rx_len_;
         };
         if (view.size() < 2) {
-            return fail();
+            return false;
         }
 
         if (view[0] != '8' || view[1] != '=') {
             size_t pos = view.find("8=");
             if (pos == std::string::npos) {
                 preserve_partial_fix_prefix();
-                return fail();
+                return false;
             }
             rx_off_ += pos;
-            return fail();
+            return false;
         }
 
-        const char* base = rx_buf_.data() + rx_off_;
-        const char* end = rx_buf_.data() + rx_len_;
+        const char* base = rx + rx_off_;
+        const char* end = rx + rx_len_;
         const char* soh = static_cast<const char*>(memchr(base, '\x01', end - base));
         if (!soh) {
-            return fail();
+            return false;
         }
 
         const char* body_len_start = soh + 1;
         if (body_len_start + 2 > end) {
-            return fail();
+            return false;
         }
         if (body_len_start[0] != '9' || body_len_start[1] != '=') {
             size_t rel = static_cast<size_t>(soh - base + 1);
             size_t pos = view.find("8=", rel);
             if (pos == std::string::npos) {
                 preserve_partial_fix_prefix();
-                return fail();
+                return false;
             }
             rx_off_ += pos;
-            return fail();
+            return false;
         }
 
         const char* body_len_end = static_cast<const char*>(memchr(body_len_start + 2, '\x01', end - (body_len_start + 2)));
         if (!body_len_end) {
-            return fail();
+            return false;
         }
 
         size_t body_len = 0;
         auto [ptr, ec] = std::from_chars(body_len_start + 2, body_len_end, body_len);
         if (ec != std::errc() || ptr != body_len_end) {
             preserve_partial_fix_prefix();
-            return fail();
+            return false;
+        }
+        if (body_len > kFixMaxMsg) {
+            size_t pos = view.find("8=", 1);
+            if (pos == std::string::npos) {
+                preserve_partial_fix_prefix();
+                return false;
+            }
+            rx_off_ += pos;
+            return false;
         }
 
         size_t body_start = (body_len_end - base) + 1;
         size_t body_end = body_start + body_len;
 
         if (body_end + 7 > static_cast<size_t>(end - base)) {
-            return fail();
+            return false;
         }
 
         if (base[body_end] != '1' || base[body_end + 1] != '0' || base[body_end + 2] != '=') {
             size_t pos = view.find("8=", 1);
             if (pos == std::string::npos) {
                 preserve_partial_fix_prefix();
-                return fail();
+                return false;
             }
             rx_off_ += pos;
-            return fail();
+            return false;
         }
 
         size_t trailer_end = body_end + 6;
@@ -327,10 +395,10 @@ namespace jolt::gateway {
             size_t pos = view.find("8=", 1);
             if (pos == std::string::npos) {
                 preserve_partial_fix_prefix();
-                return fail();
+                return false;
             }
             rx_off_ += pos;
-            return fail();
+            return false;
         }
 
         const std::string_view checksum_digits(base + body_end + 3, 3);
@@ -339,10 +407,10 @@ namespace jolt::gateway {
             size_t pos = view.find("8=", 1);
             if (pos == std::string::npos) {
                 preserve_partial_fix_prefix();
-                return fail();
+                return false;
             }
             rx_off_ += pos;
-            return fail();
+            return false;
         }
 
         uint32_t computed_checksum = 0;
@@ -354,32 +422,26 @@ namespace jolt::gateway {
             size_t pos = view.find("8=", 1);
             if (pos == std::string::npos) {
                 preserve_partial_fix_prefix();
-                return fail();
+                return false;
             }
             rx_off_ += pos;
-            return fail();
+            return false;
         }
 
-        const size_t msg_len = trailer_end + 1;
-        if (msg_len > kFixMaxMsg) {
+        if (trailer_end + 1 > kFixMaxMsg) {
             size_t pos = view.find("8=", 1);
             if (pos == std::string::npos) {
                 preserve_partial_fix_prefix();
-                return fail();
+                return false;
             }
             rx_off_ += pos;
-            return fail();
+            return false;
         }
 
-        std::memcpy(out->data, base, msg_len);
-        out->len = msg_len;
-        out->conn_id = this->conn_id;
-        rx_off_ += trailer_end + 1;
-
-        if (rx_off_ == rx_len_) {
-            rx_off_ = rx_len_ = 0;
-        }
-        return {true, msg_len};
+        msg_off = rx_off_;
+        msg_len = trailer_end + 1;
+        rx_off_ += msg_len;
+        return true;
     }
 
     bool FixSession::queue_message(std::string_view msg) {
@@ -389,13 +451,6 @@ namespace jolt::gateway {
         if (msg.size() > kTxCap) {
             throw std::runtime_error("msg too big for client tx");
         }
-        Message* slot = tx_queue_.get_tail_ptr();
-        if (!slot) {
-            return false;
-        }
-        slot->len = msg.size();
-        std::memcpy(slot->buf.data(), msg.data(), slot->len);
-        tx_queue_.write();
-        return true;
+        return tx_ring_.write(msg);
     }
 }
@@ -18,15 +18,22 @@
 #include <utility>
 #include <vector>
 
+#include <sys/uio.h>
+
+#include "BinaryProtocol.h"
 #include "GatewayTypes.h"
+#include "RxSegmentPool.h"
+#include "TxByteRing.h"
 #include "../include/spsc_new.h"
 
 
 namespace jolt::gateway {
-    static constexpr size_t kRxCap = 8192;
     static constexpr size_t kTxCap = 1024;
-    static constexpr size_t kTxQueueSlots = 8192;
-    static constexpr size_t kTxWritevBatch = 16;
+    // the reports one inbound message can fan out to before the socket takes any: a 4000 order mass cancel or
+    // sweep, at about 220 bytes a report and kFixMaxMsg kept free for the one being encoded. pages the session
+    // never writes to stay unmapped, and what does not fit waits in the gateway's pending queue
+    static constexpr size_t kTxRingBytes = 1 << 20;
+    static constexpr size_t kTxIov = 2;
 
     class Client;
     class FixGateway;
@@ -34,11 +41,6 @@ namespace jolt::gateway {
     class FixSession {
     public:
 
-        struct Message {
-            std::array<char, 1024> buf{};
-            size_t len{0};
-        };
-
         std::string sender_comp_id_{0};
         std::string target_comp_id_{0};
         std::unordered_map<uint64_t, Client*> clients_;
@@ -58,26 +60,49 @@ namespace jolt::gateway {
         bool want_write();
         bool queue_message(std::string_view message);
         void recv_pending();
+        // bytes the io_uring loop received into segment seg. with nothing pending the session frames them in
+        // place, otherwise it copies what the pending message still lacks. returns the count taken, the caller
+        // keeps its own reference on seg
+        size_t take_rx(uint32_t seg, size_t off, size_t len);
+        // hands every complete message in the rx segment to the gateway, false when the ingress queue is full
+        bool dispatch();
+        // points iov (kTxIov entries) at the unsent bytes, consume_tx then drops what the socket took
+        size_t fill_tx_iov(iovec* iov);
+        void consume_tx(size_t consumed);
 
         void send_to_gateway(FixMessage msg);
 
-        std::pair<bool, size_t> extract_message(size_t slot_id);
+        bool extract_message(size_t& msg_off, size_t& msg_len);
+        // frames by the boe header, a header that does not match its type sets protocol_error_
+        bool extract_binary(size_t& msg_off, size_t& msg_len);
         bool handle_message(std::string_view& msg);
-        std::array<char, kRxCap> rx_buf_;
-        LockFreeQueue<Message, kTxQueueSlots> tx_queue_{};
-        std::array<Message, kTxWritevBatch> tx_batch_{};
-        size_t tx_batch_head_{0};
-        size_t tx_batch_size_{0};
+        // rx window [rx_off_, rx_len_) of segment rx_seg_, messages before rx_off_ belong to the gateway
+        RxSegmentPool* rx_pool_{nullptr};
+        uint32_t rx_seg_{RxSegmentPool::kNone};
+        // the gateway thread writes outbound messages, the network thread sends them
+        TxByteRing<kTxRingBytes> tx_ring_{};
         size_t rx_len_{0};
         size_t rx_off_{0};
-        size_t tx_off_{0};
+        // recv/writev calls made on this session by the epoll loop
+        uint64_t syscalls_{0};
 
         FixGateway* gateway_{nullptr};
 
         std::atomic<bool> closed_{false};
         std::atomic<bool> tx_armed_{false};
+        // set by the gateway thread, the network thread closes the session when it sees it
+        std::atomic<bool> close_requested_{false};
         bool write_interest_enabled_{false};
+        // accepted on the binary port, speaks boe instead of FIX
+        bool binary_{false};
+        // a binary stream cannot be resynced, the network thread closes the session
+        bool protocol_error_{false};
         void close();
+        // a segment with room to receive into, the unframed tail of a full one moves along
+        bool reserve_rx();
+        void release_rx();
+        // what the pending message still lacks, as far as its header tells
+        size_t rx_needed() const;
 
         uint64_t conn_id{0};
         std::vector<uint64_t> client_ids_{};
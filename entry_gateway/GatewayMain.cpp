@@ -12,6 +12,7 @@
 #include <cstdint>
 #include <iostream>
 #include <limits>
+#include <memory>
 #include <string>
 #include <thread>
 #include <vector>
@@ -53,14 +54,54 @@ namespace {
     }
 }
 
-int main() {
+// usage: entrygateway [--instruments FILE] [--shards N] [--net epoll|uring] [--workers W]
+// instruments and shards must match what the exchange was started with, and W its --gateway-workers. worker w
+// runs its own network and gateway thread on port 8080 + w and serves the sessions FixGateway::worker_of
+// assigns it
+int main(int argc, char** argv) {
+    uint64_t num_shards = 0;
+    uint64_t num_workers = 1;
+    std::string instruments_path;
+    jolt::gateway::NetBackend net = jolt::gateway::NetBackend::Epoll;
+    for (int i = 1; i + 1 < argc; i += 2) {
+        const std::string arg(argv[i]);
+        const std::string value(argv[i + 1]);
+        bool ok = (arg == "--shards" && parse_u64(value, num_shards)) ||
+                  (arg == "--workers" && parse_u64(value, num_workers) && num_workers > 0 &&
+                   num_workers <= jolt::kMaxGatewayWorkers);
+        if (arg == "--instruments") {
+            instruments_path = value;
+            ok = true;
+        }
+        if (arg == "--net" && (value == "epoll" || value == "uring")) {
+            net = value == "uring" ? jolt::gateway::NetBackend::Uring : jolt::gateway::NetBackend::Epoll;
+            ok = true;
+        }
+        if (!ok) {
+            std::cerr << "usage: " << argv[0]
+                      << " [--instruments FILE] [--shards N] [--net epoll|uring] [--workers W]\n";
+            return 1;
+        }
+    }
+
     // constexpr int kGatewayMainCpuId = 4;
     // (void)jolt::threading::pin_current_thread_to_cpu(kGatewayMainCpuId, "entrygateway-main");
 
     std::signal(SIGINT, on_signal);
     std::signal(SIGTERM, on_signal);
 
-    jolt::gateway::FixGateway gateway("order_entry_q", "order_ack_q");
+    constexpr jolt::ob::PriceTick kMinTick = 20'000;
+    constexpr jolt::ob::PriceTick kMaxTick = 100'000;
+    const jolt::InstrumentRegistry instruments = instruments_path.empty()
+        ? jolt::InstrumentRegistry::make_default(kMinTick, kMaxTick, static_cast<size_t>(num_shards))
+        : jolt::InstrumentRegistry::load(instruments_path);
+
+    std::vector<std::unique_ptr<jolt::gateway::FixGateway>> workers;
+    for (size_t w = 0; w < num_workers; ++w) {
+        workers.push_back(std::make_unique<jolt::gateway::FixGateway>(
+            "order_entry_q", "order_ack_q", instruments, static_cast<size_t>(num_shards), net, w,
+            static_cast<size_t>(num_workers)));
+    }
 
     std::vector<jolt::ClientInfo> clients;
     clients.reserve(1024);
@@ -77,14 +118,17 @@ int main() {
         info.capital = 1e9f;
         clients.push_back(info);
     }
-    gateway.load_clients(clients);
-
-    gateway.start();
+    for (auto& gateway : workers) {
+        gateway->load_clients(clients);
+        gateway->start();
+    }
 
     while (g_run.load(std::memory_order_acquire)) {
         std::this_thread::sleep_for(std::chrono::milliseconds(10));
     }
 
-    gateway.stop();
+    for (auto& gateway : workers) {
+        gateway->stop();
+    }
     return 0;
 }
@@ -30,6 +30,8 @@ namespace jolt {
         std::array<char, kOrderStateTextBufLen> orig_cl_ord_id{};
         ob::OrderParams params{};
         uint64_t session_id{0};
+        // ClOrdID of a binary session's last request on the order
+        uint64_t binary_cl_ord_id{0};
         State state{State::PendingNew};
     };
 
@@ -38,8 +40,11 @@ namespace jolt {
         std::string target_comp_id{};
         uint64_t session_id{0};
         uint64_t seq{1};
+        // binary sessions carry their account at login instead of on every message
+        uint64_t client_id{0};
         bool logged_on{false};
         bool initialized{false};
+        bool binary{false};
 
         SessionState() = default;
 
@@ -52,18 +57,24 @@ namespace jolt {
             target_comp_id.clear();
             session_id = n;
             seq = 1;
+            client_id = 0;
             logged_on = false;
             initialized = true;
+            binary = false;
         }
     };
 
     enum class IngressKind : uint8_t { ClientFix = 0, ExchMsg = 1, Disconnect = 2};
 
+    // a framed message in place in its receive segment, holds one reference on the segment
     struct ClientFixMsg {
         uint64_t session_id;
         uint64_t rx_ts_nsl;
-        uint32_t slot_id;
+        uint32_t segment;
+        uint16_t offset;
         uint16_t len;
+        // boe rather than FIX
+        bool binary;
     };
 
     struct IngressEvent {
@@ -0,0 +1,74 @@
+#pragma once
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <stdexcept>
+#include <string>
+#include <fcntl.h>
+#include <unistd.h>
+
+namespace jolt::gateway {
+    // the order ids a gateway worker may have handed out, kept in a file so a restarted worker starts past
+    // every id the exchange could still hold. the worker reserves a block of ids here before it hands out the
+    // first of them, so the file is written once per block and not per order. each write goes to a temp file
+    // that is synced and renamed over the last one, a crash mid write leaves the previous reservation
+    class OrderIdReserve {
+        std::string path_;
+        uint64_t reserved_{0};
+
+        static std::runtime_error errno_error(const char* what, const std::string& path) {
+            return std::runtime_error(std::string(what) + ": " + path + ": " + std::strerror(errno));
+        }
+
+    public:
+        // a missing file reserves nothing, the worker starts at its first id
+        explicit OrderIdReserve(std::string path) : path_(std::move(path)) {
+            const std::filesystem::path parent = std::filesystem::path(path_).parent_path();
+            if (!parent.empty()) {
+                std::filesystem::create_directories(parent);
+            }
+            const int fd = ::open(path_.c_str(), O_RDONLY | O_CLOEXEC);
+            if (fd < 0) {
+                if (errno != ENOENT) {
+                    throw errno_error("order id reserve open failed", path_);
+                }
+                return;
+            }
+            const ssize_t n = ::pread(fd, &reserved_, sizeof(reserved_), 0);
+            ::close(fd);
+            if (n != static_cast<ssize_t>(sizeof(reserved_))) {
+                throw std::runtime_error("order id reserve is truncated: " + path_);
+            }
+        }
+
+        const std::string& path() const { return path_; }
+        // every id below this may have been handed out
+        uint64_t reserved() const { return reserved_; }
+
+        // records that ids below `through` may be handed out, returns once that is durable
+        void reserve(const uint64_t through) {
+            const std::string tmp = path_ + ".tmp";
+            const int fd = ::open(tmp.c_str(), O_CREAT | O_TRUNC | O_WRONLY | O_CLOEXEC, 0644);
+            if (fd < 0) {
+                throw errno_error("order id reserve open failed", tmp);
+            }
+            const bool ok = ::pwrite(fd, &through, sizeof(through), 0) == static_cast<ssize_t>(sizeof(through)) &&
+                ::fdatasync(fd) == 0;
+            ::close(fd);
+            if (!ok) {
+                throw errno_error("order id reserve write failed", tmp);
+            }
+            if (::rename(tmp.c_str(), path_.c_str()) != 0) {
+                throw errno_error("order id reserve rename failed", path_);
+            }
+            const std::filesystem::path parent = std::filesystem::path(path_).parent_path();
+            const int dfd = ::open(parent.empty() ? "." : parent.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+            if (dfd >= 0) {
+                (void)::fsync(dfd);
+                ::close(dfd);
+            }
+            reserved_ = through;
+        }
+    };
+}
@@ -0,0 +1,120 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <stdexcept>
+#include <vector>
+
+#include "../include/spsc_new.h"
+
+namespace jolt::gateway {
+    // fixed size receive segments shared by the network thread and the gateway thread. sessions receive into
+    // a segment and frame messages in place, every message handed to the gateway holds a reference on its
+    // segment and the segment is reused once the last one is dropped. with io_uring the first lent() segments
+    // are the provided buffers of the recv ring, the kernel owns them while they sit in it
+    class RxSegmentPool {
+    public:
+        static constexpr size_t kSegmentBytes = 4096;
+        static constexpr uint32_t kSegments = 1 << 13;
+        static constexpr uint32_t kNone = ~uint32_t{0};
+
+    private:
+        // not value initialised, pages become resident as segments are first used
+        std::unique_ptr<char[]> bytes_{new char[kSegmentBytes * kSegments]};
+        std::unique_ptr<std::atomic<uint32_t>[]> refs_{new std::atomic<uint32_t>[kSegments]};
+        // network thread only
+        std::vector<uint32_t> spare_{};
+        std::vector<uint32_t> to_kernel_{};
+        // segments the gateway thread dropped to zero, drained by the network thread
+        std::unique_ptr<LockFreeQueue<uint32_t, kSegments * 2>> returned_{
+            std::make_unique<LockFreeQueue<uint32_t, kSegments * 2>>()};
+        uint32_t lent_{0};
+
+        void put_back(uint32_t id) {
+            if (id < lent_) {
+                to_kernel_.push_back(id);
+            }
+            else {
+                spare_.push_back(id);
+            }
+        }
+
+    public:
+        RxSegmentPool() {
+            spare_.reserve(kSegments);
+            to_kernel_.reserve(kSegments);
+            for (uint32_t id = kSegments; id-- > 0;) {
+                refs_[id].store(0, std::memory_order_relaxed);
+                spare_.push_back(id);
+            }
+        }
+
+        RxSegmentPool(const RxSegmentPool&) = delete;
+        RxSegmentPool& operator=(const RxSegmentPool&) = delete;
+
+        [[nodiscard]] char* data(uint32_t id) { return bytes_.get() + static_cast<size_t>(id) * kSegmentBytes; }
+        [[nodiscard]] const char* data(uint32_t id) const {
+            return bytes_.get() + static_cast<size_t>(id) * kSegmentBytes;
+        }
+
+        [[nodiscard]] uint32_t lent() const { return lent_; }
+
+        // before the loop starts: segments [0, count) become provided buffers, the caller hands them to the
+        // kernel
+        void lend(uint32_t count) {
+            if (count >= kSegments) {
+                throw std::runtime_error("rx segment pool too small for the recv ring");
+            }
+            lent_ = count;
+            spare_.clear();
+            for (uint32_t id = kSegments; id-- > count;) {
+                spare_.push_back(id);
+            }
+        }
+
+        // network thread: a spare segment holding one reference, false when every segment is in use. the
+        // most recently freed goes out first, it is the one most likely still in cache
+        bool acquire(uint32_t& id) {
+            reclaim();
+            if (spare_.empty()) {
+                return false;
+            }
+            id = spare_.back();
+            spare_.pop_back();
+            refs_[id].store(1, std::memory_order_relaxed);
+            return true;
+        }
+
+        // network thread: the kernel filled provided buffer id, the caller holds its only reference
+        void received(uint32_t id) { refs_[id].store(1, std::memory_order_relaxed); }
+
+        // network thread: one more reference on a segment it already holds one on
+        void ref(uint32_t id) { refs_[id].fetch_add(1, std::memory_order_relaxed); }
+
+        // network thread
+        void drop(uint32_t id) {
+            if (refs_[id].fetch_sub(1, std::memory_order_acq_rel) == 1) {
+                put_back(id);
+            }
+        }
+
+        // gateway thread
+        void release(uint32_t id) {
+            if (refs_[id].fetch_sub(1, std::memory_order_acq_rel) == 1) {
+                uint32_t* slot = returned_->get_tail_ptr();
+                // every segment is in the queue at most once, it cannot fill up
+                *slot = id;
+                returned_->write();
+            }
+        }
+
+        // network thread: takes back what the gateway thread released
+        void reclaim() {
+            returned_->drain([this](const uint32_t id) { put_back(id); });
+        }
+
+        // network thread: freed provided buffers waiting to go back into the recv ring
+        [[nodiscard]] std::vector<uint32_t>& to_kernel() { return to_kernel_; }
+    };
+}
@@ -0,0 +1,110 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <string_view>
+
+#include <sys/uio.h>
+
+namespace jolt::gateway {
+    // spsc byte stream of whole FIX messages back to back. the gateway thread encodes straight into it, the
+    // network thread sends what is readable with at most two iovecs, the second one when the bytes wrap
+    template <size_t Bytes>
+    class TxByteRing {
+        static_assert((Bytes & (Bytes - 1)) == 0, "tx ring size must be a power of two");
+        static constexpr uint64_t kMask = Bytes - 1;
+
+        // not value initialised, a session only makes resident the part of its ring it has used
+        std::unique_ptr<char[]> buf_{new char[Bytes]};
+
+        struct alignas(64) WriterLine {
+            std::atomic<uint64_t> write{0};
+            uint64_t read_cache{0};
+        } writer_;
+
+        struct alignas(64) ReaderLine {
+            std::atomic<uint64_t> read{0};
+        } reader_;
+
+        [[nodiscard]] size_t free_bytes(uint64_t w) const {
+            return Bytes - static_cast<size_t>(w - writer_.read_cache);
+        }
+
+    public:
+        TxByteRing() = default;
+        TxByteRing(const TxByteRing&) = delete;
+        TxByteRing& operator=(const TxByteRing&) = delete;
+
+        // producer: true when n more bytes fit
+        bool has_room(size_t n) {
+            const uint64_t w = writer_.write.load(std::memory_order_relaxed);
+            if (free_bytes(w) >= n) {
+                return true;
+            }
+            writer_.read_cache = reader_.read.load(std::memory_order_acquire);
+            return free_bytes(w) >= n;
+        }
+
+        // producer, after has_room(min_room): where to encode the next message in place and how much room
+        // there is, nullptr when fewer than min_room bytes are left before the wrap
+        char* contiguous(size_t min_room, size_t& room) {
+            const uint64_t w = writer_.write.load(std::memory_order_relaxed);
+            const size_t at = static_cast<size_t>(w & kMask);
+            room = std::min(Bytes - at, free_bytes(w));
+            return room >= min_room ? buf_.get() + at : nullptr;
+        }
+
+        // producer: publishes n bytes written at contiguous()
+        void commit(size_t n) {
+            writer_.write.store(writer_.write.load(std::memory_order_relaxed) + n, std::memory_order_release);
+        }
+
+        // producer: copies bytes in, across the wrap when needed. false when they do not fit
+        bool write(std::string_view bytes) {
+            if (!has_room(bytes.size())) {
+                return false;
+            }
+            const uint64_t w = writer_.write.load(std::memory_order_relaxed);
+            const size_t at = static_cast<size_t>(w & kMask);
+            const size_t first = std::min(bytes.size(), Bytes - at);
+            std::memcpy(buf_.get() + at, bytes.data(), first);
+            std::memcpy(buf_.get(), bytes.data() + first, bytes.size() - first);
+            commit(bytes.size());
+            return true;
+        }
+
+        // consumer: points iov (two entries) at the readable bytes, returns how many it used
+        size_t readable(iovec* iov) const {
+            const uint64_t r = reader_.read.load(std::memory_order_relaxed);
+            const size_t avail = static_cast<size_t>(writer_.write.load(std::memory_order_acquire) - r);
+            if (avail == 0) {
+                return 0;
+            }
+            const size_t at = static_cast<size_t>(r & kMask);
+            const size_t first = std::min(avail, Bytes - at);
+            iov[0].iov_base = buf_.get() + at;
+            iov[0].iov_len = first;
+            if (first == avail) {
+                return 1;
+            }
+            iov[1].iov_base = buf_.get();
+            iov[1].iov_len = avail - first;
+            return 2;
+        }
+
+        // consumer: drops n bytes the socket took
+        void consume(size_t n) {
+            reader_.read.store(reader_.read.load(std::memory_order_relaxed) + n, std::memory_order_release);
+        }
+
+        [[nodiscard]] bool empty() const {
+            return reader_.read.load(std::memory_order_relaxed) == writer_.write.load(std::memory_order_acquire);
+        }
+
+        // consumer: drops everything not sent yet
+        void clear() { reader_.read.store(writer_.write.load(std::memory_order_acquire), std::memory_order_release); }
+    };
+}
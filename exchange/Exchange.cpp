@@ -1,7 +1,9 @@
 
 #include "Exchange.h"
 #include "../include/async_logger.h"
+#include "../include/thread_affinity.h"
 
+#include <algorithm>
 #include <cstring>
 #include <limits>
 #include <vector>
@@ -9,18 +11,29 @@
 
 namespace jolt::exchange {
     namespace {
-        bool symbol_id_to_index(const uint64_t symbol_id, size_t& out_idx) {
-            if (!jolt::is_valid_symbol_id(symbol_id)) {
-                return false;
-            }
-            out_idx = static_cast<size_t>(symbol_id - jolt::kFirstSymbolId);
-            return true;
+        // input journals and checkpoints sit next to the l3 files, one of each per matching thread
+        std::string thread_file(const std::string& dir, int shard, const char* ext) {
+            const std::string base = "../data/" + dir + "/exchange";
+            return (shard < 0 ? base : shard_queue_name(base, static_cast<size_t>(shard))) + ext;
         }
 
+        std::string journal_path(int shard) { return thread_file("journal", shard, ".wal"); }
+        std::string checkpoint_path(int shard) { return thread_file("checkpoint", shard, ".ckpt"); }
+
+        // next in-place slot of a batch, publishing what is pending first when the ring has no room left
+        template <typename Q>
+        auto* stream_slot(Q& q, size_t& pending) {
+            auto* slot = q.alloc(pending);
+            if (!slot && pending > 0) {
+                q.push(pending);
+                pending = 0;
+                slot = q.alloc(0);
+            }
+            return slot;
+        }
     }
 
-    Exchange::Exchange(ob::PriceTick min_tick,
-                     ob::PriceTick max_tick,
+    Exchange::Exchange(const InstrumentRegistry& instruments,
                      const std::string& inbound_name,
                      const std::string& book_name,
                      const std::string& exch_name,
@@ -28,83 +41,396 @@ namespace jolt::exchange {
                      const std::string& exch_to_risk_name,
                      const std::string& blob_name,
                      const std::string& meta_name,
-                     const std::string& request_name)
-        : snapshots_(), gtwy_exch(inbound_name, SharedRingMode::Create),
+                     const std::string& request_name,
+                     const JournalOptions& journal_opts,
+                     const CheckpointOptions& checkpoint_opts)
+        : instruments_(instruments),
+          gtwy_exch(inbound_name, SharedRingMode::Create),
           mkt_data_gtwy(book_name, SharedRingMode::Create),
           exch_gtwy(exch_name, SharedRingMode::Create),
           exch_risk(risk_name, SharedRingMode::Create),
           risk_exch(exch_to_risk_name, SharedRingMode::Create),
           snapshot_pool_(blob_name, PoolMode::Create),
           snapshot_meta(meta_name, SharedRingMode::Create),
-          requests_(request_name, SharedRingMode::Attach), writer_("../data") {
-        orderbooks_.reserve(4);
-        orderbook_seqs_.resize(4);
-
-        for (auto& s : orderbook_seqs_) {
-            s = 0;
+          requests_(request_name, SharedRingMode::Attach), deltas_(book_name + "_deltas", SharedRingMode::Create),
+          snapshots_(instruments, snapshot_pool_, snapshot_meta, requests_),
+          l2_(book_name + "_l2", SeqlockMode::Create, static_cast<uint32_t>(instruments.size())),
+          writer_("../data", instruments), journal_opts_(journal_opts), journal_(journal_path(-1), journal_opts),
+          checkpoint_opts_(checkpoint_opts), checkpoints_(checkpoint_path(-1), checkpoint_opts, &journal_),
+          io_{{&exch_gtwy}, &mkt_data_gtwy, &exch_risk, &writer_, &deltas_, &journal_, &checkpoints_},
+          inbound_name_(inbound_name), book_name_(book_name), exch_name_(exch_name), risk_name_(risk_name),
+          exch_to_risk_name_(exch_to_risk_name) {
+        orderbooks_.reserve(instruments_.size());
+        l2_versions_.assign(instruments_.size(), 0);
+        delta_drops_.assign(instruments_.size(), 0);
+        delta_resynced_.assign(instruments_.size(), 0);
+        inbound_.push_back(&gtwy_exch);
+
+        for (const auto& inst : instruments_.instruments()) {
+            orderbooks_.emplace_back(std::make_unique<Book>(inst.min_tick, inst.max_tick));
         }
+    }
 
-        for (auto m : mkt_data_) {
-            m.reserve(1 << 10);
-        }
 
-        for (size_t i = 0; i < 4; ++i) {
-            orderbooks_.emplace_back(std::make_unique<ob::MatchingOrderBook<>>(min_tick, max_tick));
-        }
 
-        for (auto& snapshot : snapshots_) {
-            snapshot.orders.reserve(50'000);
+    void Exchange::configure_gateway_workers(size_t num_workers) {
+        if (running.load(std::memory_order_acquire)) {
+            throw std::runtime_error("gateway workers must be configured before start");
         }
+        if (!shards_.empty()) {
+            throw std::runtime_error("gateway workers must be configured before shards");
+        }
+        if (num_workers == 0 || num_workers > kMaxGatewayWorkers) {
+            throw std::runtime_error("gateway workers must be between 1 and " + std::to_string(kMaxGatewayWorkers));
+        }
+        num_workers_ = num_workers;
+        worker_inbound_.clear();
+        worker_acks_.clear();
+        inbound_.assign(1, &gtwy_exch);
+        io_.acks = {};
+        io_.acks[0] = &exch_gtwy;
+        for (size_t w = 1; w < num_workers; ++w) {
+            worker_inbound_.push_back(std::make_unique<GtwyToExch>(worker_queue_name(inbound_name_, w),
+                                                                   SharedRingMode::Create));
+            worker_acks_.push_back(std::make_unique<ExchToGtwy>(worker_queue_name(exch_name_, w),
+                                                                SharedRingMode::Create));
+            inbound_.push_back(worker_inbound_.back().get());
+            io_.acks[w] = worker_acks_.back().get();
+        }
+        io_.num_workers = num_workers;
     }
 
-
+    void Exchange::configure_shards(size_t num_shards, int first_cpu) {
+        if (running.load(std::memory_order_acquire)) {
+            throw std::runtime_error("shards must be configured before start");
+        }
+        if (num_shards < instruments_.num_shards()) {
+            throw std::runtime_error("instrument registry assigns more shards than configured");
+        }
+        shards_.clear();
+        shards_.reserve(num_shards);
+        for (size_t i = 0; i < num_shards; ++i) {
+            auto shard = std::make_unique<Shard>();
+            shard->id = i;
+            shard->cpu_id = first_cpu < 0 ? -1 : first_cpu + static_cast<int>(i);
+            for (size_t w = 0; w < num_workers_; ++w) {
+                shard->inbound.push_back(std::make_unique<GtwyToExch>(
+                    worker_queue_name(shard_queue_name(inbound_name_, i), w), SharedRingMode::Create));
+                shard->acks.push_back(std::make_unique<ExchToGtwy>(
+                    worker_queue_name(shard_queue_name(exch_name_, i), w), SharedRingMode::Create));
+            }
+            shard->from_risk = std::make_unique<RiskToExch>(shard_queue_name(exch_to_risk_name_, i),
+                                                            SharedRingMode::Create);
+            shard->mkt_data = std::make_unique<MktDataQueue>(shard_queue_name(book_name_, i), SharedRingMode::Create);
+            shard->to_risk = std::make_unique<ExchToRisk>(shard_queue_name(risk_name_, i), SharedRingMode::Create);
+            shard->writer = std::make_unique<L3DataWriter>("../data", instruments_);
+            shard->deltas = std::make_unique<DeltaQ>(shard_queue_name(book_name_ + "_deltas", i),
+                                                     SharedRingMode::Create);
+            shard->journal = std::make_unique<InputJournal>(journal_path(static_cast<int>(i)), journal_opts_);
+            shard->checkpoints = std::make_unique<CheckpointWriter>(checkpoint_path(static_cast<int>(i)),
+                                                                    checkpoint_opts_, shard->journal.get());
+            shard->io = ShardIo{{}, shard->mkt_data.get(), shard->to_risk.get(), shard->writer.get(),
+                                shard->deltas.get(), shard->journal.get(), shard->checkpoints.get(),
+                                static_cast<int>(i)};
+            for (size_t w = 0; w < num_workers_; ++w) {
+                shard->io.acks[w] = shard->acks[w].get();
+            }
+            shard->io.num_workers = num_workers_;
+            shards_.push_back(std::move(shard));
+        }
+    }
 
     void Exchange::submit_order_direct(const ob::OrderParams& order) {
-        handle_order(order);
+        const size_t symbol_idx = instruments_.index_of(order.symbol_id);
+        if (!shards_.empty() && symbol_idx != InstrumentRegistry::npos) {
+            auto& shard = *shards_[instruments_.at(symbol_idx).shard];
+            handle_order(order, shard.io);
+            return;
+        }
+        if (!shards_.empty() && order.action == ob::OrderAction::MassCancel) {
+            // each shard sweeps and journals its own books
+            for (auto& shard : shards_) {
+                handle_order(order, shard->io);
+            }
+            return;
+        }
+        handle_order(order, io_);
+    }
+
+    template <typename Rings>
+    size_t Exchange::drain_inbound(Rings& rings, size_t& next, InboundBatch& batch) {
+        size_t n = 0;
+        for (size_t k = 0; k < rings.size() && n < kDrainBatch; ++k) {
+            auto& ring = *rings[(next + k) % rings.size()];
+            ring.drain([&](const GtwyToExchMsg& msg) {
+                batch[n++] = msg.order;
+            }, kDrainBatch - n);
+        }
+        if (++next == rings.size()) {
+            next = 0;
+        }
+        return n;
     }
 
     bool Exchange::poll_once() {
         const uint64_t day = day_ticker_.day_id_atomic().load(std::memory_order_acquire);
         if (day != curr_day_) [[unlikely]] {
             curr_day_ = day;
-
-            for (auto& book : orderbooks_) {
-                book.get()->seq = 0;
-            }
+            reset_day(-1);
+            journal_.append_day(day);
+            writer_.roll_day(day);
         }
 
 
         bool did_work = false;
-        const size_t gtwy_drained = gtwy_exch.drain([&](const GtwyToExchMsg& msg) {
+        const size_t gtwy_drained = drain_inbound(inbound_, next_inbound_, batch_);
+        for (size_t i = 0; i < gtwy_drained; ++i) {
             log_info("[exch] exchange received order from gateway order_id=" +
-                     std::to_string(msg.order.id) +
-                     " client_id=" + std::to_string(msg.order.client_id) +
-                     " action=" + std::string(order_action_text(msg.order.action)) +
-                     " symbol_id=" + std::to_string(msg.order.symbol_id));
-            handle_order(msg.order);
-        });
+                     std::to_string(batch_[i].id) +
+                     " client_id=" + std::to_string(batch_[i].client_id) +
+                     " action=" + std::string(order_action_text(batch_[i].action)) +
+                     " symbol_id=" + std::to_string(batch_[i].symbol_id));
+        }
+        handle_batch(batch_.data(), gtwy_drained, io_);
 
         did_work = did_work || (gtwy_drained > 0);
+        did_work = resync_shadows(io_) || did_work;
 
         const bool poll_risk_now = (gtwy_drained == 0) || ((++risk_poll_tick_ & 0x7u) == 0);
         if (poll_risk_now) {
             const size_t risk_drained = risk_exch.drain([&](const RiskToExchMsg& msg) {
-                handle_order(msg.order);
+                handle_order(msg.order, io_);
+            });
+            did_work = did_work || (risk_drained > 0);
+        }
+        journal_.tick();
+        writer_.tick();
+        if (checkpoints_.due()) [[unlikely]] {
+            take_checkpoint(io_, curr_day_);
+        }
+
+        return did_work;
+    }
+
+    bool Exchange::poll_shard(Shard& shard) {
+        const uint64_t day = day_ticker_.day_id_atomic().load(std::memory_order_acquire);
+        if (day != shard.curr_day) [[unlikely]] {
+            shard.curr_day = day;
+            reset_day(static_cast<int>(shard.id));
+            shard.journal->append_day(day);
+            shard.writer->roll_day(day);
+        }
+
+        const size_t gtwy_drained = drain_inbound(shard.inbound, shard.next_inbound, shard.batch);
+        handle_batch(shard.batch.data(), gtwy_drained, shard.io);
+        bool did_work = gtwy_drained > 0;
+        did_work = resync_shadows(shard.io) || did_work;
+
+        const bool poll_risk_now = (gtwy_drained == 0) || ((++shard.risk_poll_tick & 0x7u) == 0);
+        if (poll_risk_now) {
+            const size_t risk_drained = shard.from_risk->drain([&](const RiskToExchMsg& msg) {
+                handle_order(msg.order, shard.io);
             });
             did_work = did_work || (risk_drained > 0);
         }
+        shard.journal->tick();
+        shard.writer->tick();
+        if (shard.checkpoints->due()) [[unlikely]] {
+            take_checkpoint(shard.io, shard.curr_day);
+        }
 
         return did_work;
     }
 
-    void Exchange::start() {
+    void Exchange::reset_day(int shard) {
+        // only touch books owned by this shard
+        for (size_t i = 0; i < orderbooks_.size(); ++i) {
+            if (shard < 0 || instruments_.at(i).shard == static_cast<size_t>(shard)) {
+                orderbooks_[i]->seq = 0;
+            }
+        }
+    }
+
+    uint64_t Exchange::recover() {
+        if (running.load(std::memory_order_acquire)) {
+            throw std::runtime_error("recover must run before start");
+        }
+        uint64_t replayed = 0;
+        if (shards_.empty()) {
+            const uint64_t lsn = load_checkpoint(checkpoints_.path(), -1, curr_day_);
+            replayed += replay_journal(journal_.path(), -1, lsn, curr_day_);
+        }
+        for (auto& shard : shards_) {
+            const int id = static_cast<int>(shard->id);
+            const uint64_t lsn = load_checkpoint(shard->checkpoints->path(), id, shard->curr_day);
+            replayed += replay_journal(shard->journal->path(), id, lsn, shard->curr_day);
+        }
+
+        // the snapshot service and the L2 channel start from the rebuilt books
+        ob::BookSnapshot snap{};
+        for (size_t i = 0; i < orderbooks_.size(); ++i) {
+            orderbooks_[i]->get_snapshot(snap);
+            snapshots_.seed(i, snap);
+            publish_depth(i);
+        }
+        log_info("[exch] recovered records=" + std::to_string(replayed));
+        return replayed;
+    }
+
+    uint64_t Exchange::load_checkpoint(const std::string& path, int shard, uint64_t& curr_day) {
+        const CheckpointFile file(path);
+        if (file.empty()) {
+            return 0;
+        }
+        for (const CheckpointFile::Book& b : file.books()) {
+            const size_t i = instruments_.index_of(b.symbol_id);
+            if (i == InstrumentRegistry::npos ||
+                (shard >= 0 && instruments_.at(i).shard != static_cast<size_t>(shard))) {
+                throw std::runtime_error("checkpoint " + path + " holds symbol_id " + std::to_string(b.symbol_id) +
+                                         " which this matching thread does not own");
+            }
+            orderbooks_[i]->load_image(b.view);
+        }
+        curr_day = file.day();
+        log_info("[exch] loaded checkpoint " + path + " lsn=" + std::to_string(file.lsn()) +
+                 " books=" + std::to_string(file.books().size()));
+        return file.lsn();
+    }
+
+    uint64_t Exchange::replay_journal(const std::string& path, int shard, uint64_t after_lsn, uint64_t& curr_day) {
+        JournalReader reader(path);
+        const JournalReader::Stats st = reader.replay(after_lsn, [&](const JournalRecord& r) {
+            if (r.kind == JournalRecord::Kind::DayRoll) {
+                curr_day = r.day;
+                reset_day(shard);
+                return;
+            }
+            replay_order(r.order, shard);
+        });
+        // a checkpoint is only written once the journal is durable through its lsn
+        if (st.last_lsn < after_lsn) {
+            throw std::runtime_error("journal " + path + " ends at lsn " + std::to_string(st.last_lsn) +
+                                     " before its checkpoint at lsn " + std::to_string(after_lsn));
+        }
+        return st.records;
+    }
+
+    void Exchange::take_checkpoint(ShardIo& io, uint64_t curr_day) {
+        CheckpointWriter& writer = *io.checkpoints;
+        writer.wait_idle();
+        std::vector<CheckpointBook>& books = writer.books();
+        size_t n = 0;
+        for (size_t i = 0; i < orderbooks_.size(); ++i) {
+            if (io.shard >= 0 && instruments_.at(i).shard != static_cast<size_t>(io.shard)) {
+                continue;
+            }
+            if (books.size() == n) {
+                books.emplace_back();
+            }
+            books[n].symbol_id = instruments_.at(i).symbol_id;
+            orderbooks_[i]->save_image(books[n].image);
+            ++n;
+        }
+        books.resize(n);
+        // every record appended so far has been applied
+        writer.submit(io.journal->next_lsn() - 1, curr_day);
+    }
+
+    void Exchange::replay_order(const ob::OrderParams& order, int shard) {
+        // the journal only holds orders that passed handle_order's checks. what is checked here can only fail
+        // for a journal written by another configuration
+        if (order.action == ob::OrderAction::MassCancel) {
+            if (order.kill) {
+                (shard < 0 ? io_ : shards_[static_cast<size_t>(shard)]->io).killed.insert(order.client_id, 1);
+            }
+            for (size_t i = 0; i < orderbooks_.size(); ++i) {
+                if (!mass_cancel_hits(order, i, shard)) {
+                    continue;
+                }
+                auto& book = *orderbooks_[i];
+                ++book.seq;
+                book.cancel_all(order.client_id, order.one_side, order.side, order.ts, [](const ob::BookEvent&) {});
+            }
+            return;
+        }
+        const size_t i = instruments_.index_of(order.symbol_id);
+        if (i == InstrumentRegistry::npos || (shard >= 0 && instruments_.at(i).shard != static_cast<size_t>(shard))) {
+            throw std::runtime_error("journal holds an order for symbol_id " + std::to_string(order.symbol_id) +
+                                     " which this matching thread does not own");
+        }
+        auto& book = *orderbooks_[i];
+        // handle_order rejects a live id before journaling it, a repeat here means the journal is not this book's
+        if (order.action == ob::OrderAction::New && book.contains(order.id)) {
+            throw std::runtime_error("journal replays order_id " + std::to_string(order.id) +
+                                     " while it is still live in symbol_id " + std::to_string(order.symbol_id));
+        }
+        book.submit_order(order);
+    }
+
+    bool Exchange::mass_cancel_hits(const ob::OrderParams& order, size_t i, int shard) const {
+        const Instrument& inst = instruments_.at(i);
+        // symbol_id 0 sweeps every book this thread owns
+        return (order.symbol_id == 0 || inst.symbol_id == order.symbol_id) &&
+            (shard < 0 || inst.shard == static_cast<size_t>(shard));
+    }
+
+    void Exchange::shard_loop(Shard& shard) {
+        while (running.load(std::memory_order_acquire)) {
+            if (!poll_shard(shard)) {
+                _mm_pause();
+            }
+        }
+    }
+
+    void Exchange::start(int snapshot_cpu) {
         running.store(true, std::memory_order_release);
         day_ticker_.start();
+        // source i is shard i, or the single unsharded ring
+        if (shards_.empty()) {
+            snapshots_.add_source(deltas_);
+        }
+        for (auto& shard : shards_) {
+            snapshots_.add_source(*shard->deltas);
+        }
+        snapshots_.start(snapshot_cpu);
+        for (auto& shard : shards_) {
+            Shard* s = shard.get();
+            s->thread = std::thread([this, s] {
+                (void)threading::pin_current_thread_to_cpu(s->cpu_id, "exchange-shard");
+                shard_loop(*s);
+            });
+        }
     }
 
     void Exchange::stop() {
         running.store(false, std::memory_order_release);
+        for (auto& shard : shards_) {
+            if (shard->thread.joinable()) {
+                shard->thread.join();
+            }
+        }
+        snapshots_.stop();
         day_ticker_.stop();
+        for (auto& shard : shards_) {
+            shard->journal->sync_all();
+            shard->writer->flush();
+        }
+        journal_.sync_all();
+        writer_.flush();
+
+        // a clean stop leaves a checkpoint at the end of every journal, so the next start replays nothing
+        if (checkpoints_.enabled()) {
+            if (shards_.empty()) {
+                take_checkpoint(io_, curr_day_);
+                checkpoints_.wait_idle();
+            }
+            for (auto& shard : shards_) {
+                take_checkpoint(shard->io, shard->curr_day);
+            }
+            for (auto& shard : shards_) {
+                shard->checkpoints->wait_idle();
+            }
+        }
     }
 
     void Exchange::process_loop() {
@@ -115,85 +441,206 @@ namespace jolt::exchange {
         }
     }
 
-    void Exchange::handle_order(const ob::OrderParams& order) {
+    void Exchange::reject_invalid_symbol(const ob::OrderParams& order, ShardIo& io) {
+        log_error("[exch] exchange received invalid symbol_id from gateway symbol_id=" +
+                  std::to_string(order.symbol_id) + " order_id=" + std::to_string(order.id) +
+                  " client_id=" + std::to_string(order.client_id));
+        ExchToGtwyMsg rej{};
+        rej.type = ExchToGtwyMsg::Type::Rejected;
+        rej.client_id = order.client_id;
+        rej.order_id = order.id;
+        rej.reason = ob::RejectReason::InvalidPrice;
+        publish_exchange_msg(io, rej);
+    }
+
+    void Exchange::handle_mass_cancel(const ob::OrderParams& order, ShardIo& io) {
+        size_t total = 0;
+        io.journal->append(order);
+        if (order.kill) {
+            io.killed.insert(order.client_id, 1);
+        }
+        for (size_t i = 0; i < orderbooks_.size(); ++i) {
+            if (!mass_cancel_hits(order, i, io.shard)) {
+                continue;
+            }
+            const Instrument& inst = instruments_.at(i);
+            auto& book = *orderbooks_[i];
+            const uint64_t seq = ++book.seq;
+            io.fill_symbol = inst.symbol_id;
+            io.fill_symbol_idx = i;
+            book.set_delta_sink(delta_sink(i, io));
+            // the symbol's cancels, their risk events and acks are written in place and published together
+            // below, or in parts when a ring fills up, the same as streamed fills
+            total += book.cancel_all(order.client_id, order.one_side, order.side, order.ts, [&](const ob::BookEvent& e) {
+                ob::L3Data data{};
+                data.id = e.id;
+                data.ts = e.ts;
+                data.seq = seq;
+                data.qty = e.qty;
+                data.price = e.price;
+                data.symbol_id = inst.symbol_id;
+                data.side = e.side;
+                data.event_type = ob::BookEventType::Cancel;
+                if (auto* slot = stream_slot(*io.mkt_data, io.l3_pending)) {
+                    *slot = data;
+                    ++io.l3_pending;
+                }
+                else {
+                    log_error("[exch] exchange->market data ring full, dropped mass cancel order_id=" +
+                              std::to_string(e.id));
+                }
+                io.writer->append(i, data);
+
+                auto* rec = io.to_risk->alloc(io.risk_pending);
+                if (!rec && io.risk_pending > 0) {
+                    flush_risk_batch(io);
+                    rec = io.to_risk->alloc(0);
+                }
+                if (rec) {
+                    *rec = ExchangeToRiskMsg{};
+                    rec->maker_order_id = e.id;
+                    rec->maker_client_id = order.client_id;
+                    rec->seq = seq;
+                    rec->ts = e.ts;
+                    rec->price = e.price;
+                    rec->qty = e.qty;
+                    rec->symbol_id = inst.symbol_id;
+                    rec->side = e.side;
+                    rec->type = ExchangeToRiskMsg::Type::Cancel;
+                    if (++io.risk_pending == std::numeric_limits<uint16_t>::max()) {
+                        flush_risk_batch(io);
+                    }
+                }
+                else {
+                    log_error("[exch] exchange->risk ring full, dropped mass cancel order_id=" + std::to_string(e.id));
+                }
+
+                const size_t worker = gateway_worker_of(e.id, io.num_workers);
+                if (auto* out = stream_slot(*io.acks[worker], io.acks_pending[worker])) {
+                    out->client_id = order.client_id;
+                    out->order_id = e.id;
+                    out->fill_qty = 0;
+                    out->type = ExchToGtwyMsg::Type::Cancelled;
+                    out->reason = ob::RejectReason::NotApplicable;
+                    out->filled = false;
+                    ++io.acks_pending[worker];
+                }
+                else {
+                    log_error("[exch] exchange->gateway ring full, dropped mass cancel ack order_id=" +
+                              std::to_string(e.id));
+                }
+            });
+            flush_fills(io);
+            flush_deltas(io);
+            note_dropped_deltas(i, io);
+            publish_depth(i);
+        }
+        log_info("[exch] mass cancel client_id=" + std::to_string(order.client_id) +
+                 " symbol_id=" + std::to_string(order.symbol_id) +
+                 " cancelled=" + std::to_string(total));
+    }
+
+    void Exchange::handle_batch(const ob::OrderParams* orders, size_t n, ShardIo& io) {
+        // same two stage pipeline as MatchingOrderBook::submit_batch, the orders may hit different books
+        constexpr size_t kAhead = Book::kPrefetchAhead;
+        for (size_t i = 0; i < n && i < kAhead; ++i) {
+            prefetch_order(orders[i], false);
+        }
+        for (size_t i = 0; i < n && i < kAhead / 2; ++i) {
+            prefetch_order(orders[i], true);
+        }
+        for (size_t i = 0; i < n; ++i) {
+            if (i + kAhead < n) {
+                prefetch_order(orders[i + kAhead], false);
+            }
+            if (i + kAhead / 2 < n) {
+                prefetch_order(orders[i + kAhead / 2], true);
+            }
+            handle_order(orders[i], io);
+        }
+    }
+
+    void Exchange::prefetch_order(const ob::OrderParams& order, bool deep) const {
+        const size_t symbol_idx = instruments_.index_of(order.symbol_id);
+        if (symbol_idx == InstrumentRegistry::npos || order.action == ob::OrderAction::MassCancel) {
+            return;
+        }
+        const auto& book = *orderbooks_[symbol_idx];
+        if (deep) {
+            book.prefetch_deep(order);
+        }
+        else {
+            book.prefetch(order);
+        }
+    }
+
+    void Exchange::handle_order(const ob::OrderParams& order, ShardIo& io) {
+        if (order.action == ob::OrderAction::MassCancel) {
+            handle_mass_cancel(order, io);
+            return;
+        }
         const uint16_t symbol_id = order.symbol_id;
-        size_t symbol_idx = 0;
-        if (!symbol_id_to_index(symbol_id, symbol_idx)) {
-            log_error("[exch] exchange received invalid symbol_id from gateway symbol_id=" +
-                      std::to_string(symbol_id) + " order_id=" + std::to_string(order.id) +
-                      " client_id=" + std::to_string(order.client_id));
+        const size_t symbol_idx = instruments_.index_of(symbol_id);
+        if (symbol_idx == InstrumentRegistry::npos) {
+            reject_invalid_symbol(order, io);
+            return;
+        }
+        const Instrument& inst = instruments_.at(symbol_idx);
+        ob::RejectReason reason = ob::RejectReason::NotApplicable;
+        if (inst.lot_size > 1 && order.action != ob::OrderAction::Cancel && order.qty % inst.lot_size != 0) {
+            reason = ob::RejectReason::InvalidQty;
+        }
+        else if (!inst.prices_in_range(order)) {
+            // the book indexes its ladders by these, nothing outside the range may reach it
+            reason = ob::RejectReason::InvalidPrice;
+        }
+        else if (order.action == ob::OrderAction::New && orderbooks_[symbol_idx]->contains(order.id)) {
+            // never journaled, so replay can hold every id it applies to be unique
+            reason = ob::RejectReason::DuplicateId;
+        }
+        else if (order.action == ob::OrderAction::New && !io.killed.empty() && io.killed.find(order.client_id)) {
+            reason = ob::RejectReason::NotFillable;
+        }
+        if (reason != ob::RejectReason::NotApplicable) {
             ExchToGtwyMsg rej{};
             rej.type = ExchToGtwyMsg::Type::Rejected;
             rej.client_id = order.client_id;
             rej.order_id = order.id;
-            rej.reason = ob::RejectReason::InvalidPrice;
-            publish_exchange_msg(rej);
+            rej.reason = reason;
+            publish_exchange_msg(io, rej);
             return;
         }
         auto& book = *orderbooks_[symbol_idx];
+        // journaled as it reaches the book, replay applies exactly these
+        io.journal->append(order);
+        io.fill_symbol = symbol_id;
+        io.fill_symbol_idx = symbol_idx;
+        book.set_fill_sink({&io, &Exchange::stream_fill});
+        book.set_delta_sink(delta_sink(symbol_idx, io));
+        book.set_rest_sink({&io, &Exchange::stream_rest});
         ob::BookEvent event = book.submit_order(order);
+        flush_fills(io);
+        flush_deltas(io);
+        note_dropped_deltas(symbol_idx, io);
+        publish_depth(symbol_idx);
         auto seq = book.seq;
 
         event.seq = seq;
-        if (orderbook_seqs_[symbol_idx] == 0) {
-            orderbook_seqs_[symbol_idx] = seq;
-        }
-
-        if (seq - orderbook_seqs_[symbol_idx] >= 5'000) {
-            auto& snapshot = snapshots_[snapshot_head_];
-            book.get_snapshot(snapshot);
-            snapshot_head_ = (snapshot_head_ + 1) % 4;
-            orderbook_seqs_[symbol_idx] = seq;
-        }
 
         if (event.event_type == ob::BookEventType::Reject) {
             ExchToGtwyMsg rej{};
             rej.type = ExchToGtwyMsg::Type::Rejected;
             rej.client_id = order.client_id;
             rej.order_id = order.id;
-            publish_exchange_msg(rej);
+            publish_exchange_msg(io, rej);
             return;
         }
 
-        const auto& fills = book.match_result.fills;
-        if (!fills.empty()) {
-            ob::Bbo b{book.get_best_bid(), book.get_best_ask()};
-            ExchangeToRiskMsg risk_msg{};
-            risk_msg.order = order;
-            risk_msg.bid = b.best_bid;
-            risk_msg.ask = b.best_ask;
-            risk_msg.ts = order.ts;
-            const auto fill_limit = risk_msg.fill_events_.size();
-            const auto fills_to_copy = fills.size() < fill_limit ? fills.size() : fill_limit;
-            risk_msg.num_fills = static_cast<uint64_t>(fills_to_copy);
-            if (fills_to_copy > 0) {
-                std::memcpy(
-                    risk_msg.fill_events_.data(),
-                    fills.data(),
-                    fills_to_copy * sizeof(risk_msg.fill_events_[0]));
-            }
-
-            update_risk(risk_msg);
-            for (const auto& fill_event : book.match_result.fills) {
-                ob::L3Data data{};
-                data.qty = fill_event.qty;
-                data.id = fill_event.id;
-                data.price = fill_event.price;
-                data.event_type = fill_event.event_type;
-                data.seq = fill_event.seq;
-                data.symbol_id = symbol_id;
-                data.side = fill_event.side;
-                publish_book_event(data);
-
-                ExchToGtwyMsg out{};
-                out.filled = true;
-                out.order_id = fill_event.id;
-                out.fill_qty = fill_event.qty;
-                out.type = ExchToGtwyMsg::Type::Filled;
-                publish_exchange_msg(out);
-            }
-
-            book.match_result.fills.clear();
+        // rests reached risk through stream_rest. a modify that cancels the order or fills all of it on
+        // its new price takes it out of the book without a fill that names it as maker
+        if (event.event_type == ob::BookEventType::Cancel ||
+            (event.event_type == ob::BookEventType::Modify && !book.contains(order.id))) {
+            update_risk(io, order, event, ExchangeToRiskMsg::Type::Cancel);
         }
 
         ExchToGtwyMsg ack{};
@@ -201,7 +648,7 @@ namespace jolt::exchange {
         ack.reason = ob::RejectReason::NotApplicable;
         ack.client_id = order.client_id;
         ack.order_id = order.id;
-        publish_exchange_msg(ack);
+        publish_exchange_msg(io, ack);
 
         ob::L3Data data{};
         data.qty = event.qty;
@@ -211,20 +658,242 @@ namespace jolt::exchange {
         data.price = event.price;
         data.event_type = event.event_type;
         data.symbol_id = symbol_id;
-        publish_book_event(data);
+        publish_book_event(io, data);
+
+        io.writer->append(symbol_idx, data);
+    }
+
+    void Exchange::stream_fill(void* ctx, const ob::BookEvent& fill, ob::OrderId taker_id, ob::UserId taker_owner) {
+        auto& io = *static_cast<ShardIo*>(ctx);
+
+        // a risk batch is only framed (count + last flag) when it is published
+        auto* rec = io.to_risk->alloc(io.risk_pending);
+        if (!rec && io.risk_pending > 0) {
+            flush_risk_batch(io);
+            rec = io.to_risk->alloc(0);
+        }
+        if (rec) {
+            rec->maker_order_id = fill.id;
+            rec->taker_order_id = taker_id;
+            rec->maker_client_id = fill.owner;
+            rec->taker_client_id = taker_owner;
+            rec->seq = fill.seq;
+            rec->ts = fill.ts;
+            rec->price = fill.price;
+            rec->qty = fill.qty;
+            rec->symbol_id = io.fill_symbol;
+            rec->side = fill.side == ob::Side::Buy ? ob::Side::Sell : ob::Side::Buy;
+            rec->type = ExchangeToRiskMsg::Type::Fill;
+            rec->flags = fill.leaves == 0 ? ExchangeToRiskMsg::kMakerDone : 0;
+            if (++io.risk_pending == std::numeric_limits<uint16_t>::max()) {
+                flush_risk_batch(io);
+            }
+        }
+        else {
+            log_error("[exch] exchange->risk ring full, dropped fill maker_id=" + std::to_string(fill.id) +
+                      " taker_id=" + std::to_string(taker_id));
+        }
 
-        mkt_data_[symbol_idx].push_back(data);
-        if (mkt_data_[symbol_idx].size() >= 1 << 10) {
-            writer_.write_batch(symbol_id, mkt_data_[symbol_idx].data(), mkt_data_[symbol_idx].size());
-            mkt_data_[symbol_idx].clear();
+        ob::L3Data data{};
+        data.id = fill.id;
+        data.ts = fill.ts;
+        data.seq = fill.seq;
+        data.qty = fill.qty;
+        data.price = fill.price;
+        data.symbol_id = io.fill_symbol;
+        data.side = fill.side;
+        data.event_type = fill.event_type;
+        if (auto* slot = stream_slot(*io.mkt_data, io.l3_pending)) {
+            *slot = data;
+            ++io.l3_pending;
+        }
+        // the file holds every record the feed does, retransmissions past the history ring are served from it
+        io.writer->append(io.fill_symbol_idx, data);
+
+        const size_t worker = gateway_worker_of(fill.id, io.num_workers);
+        if (auto* out = stream_slot(*io.acks[worker], io.acks_pending[worker])) {
+            out->client_id = fill.owner;
+            out->order_id = fill.id;
+            out->fill_qty = fill.qty;
+            out->type = ExchToGtwyMsg::Type::Filled;
+            out->reason = ob::RejectReason::NotApplicable;
+            out->filled = true;
+            ++io.acks_pending[worker];
         }
     }
 
-    void Exchange::update_risk(const ExchangeToRiskMsg& msg) {
-        exch_risk.enqueue(msg);
+    void Exchange::stream_rest(void* ctx, const ob::OrderId id, const ob::UserId owner, const bool resting) {
+        auto& io = *static_cast<ShardIo*>(ctx);
+
+        // part of the current risk batch, between the fills that made the order rest or fire
+        auto* rec = io.to_risk->alloc(io.risk_pending);
+        if (!rec && io.risk_pending > 0) {
+            flush_risk_batch(io);
+            rec = io.to_risk->alloc(0);
+        }
+        if (!rec) {
+            log_error("[exch] exchange->risk ring full, dropped order event order_id=" + std::to_string(id));
+            return;
+        }
+        *rec = ExchangeToRiskMsg{};
+        rec->maker_order_id = id;
+        rec->maker_client_id = owner;
+        rec->symbol_id = io.fill_symbol;
+        rec->type = resting ? ExchangeToRiskMsg::Type::Accept : ExchangeToRiskMsg::Type::Cancel;
+        if (++io.risk_pending == std::numeric_limits<uint16_t>::max()) {
+            flush_risk_batch(io);
+        }
+    }
+
+    void Exchange::flush_risk_batch(ShardIo& io) {
+        const size_t n = io.risk_pending;
+        if (n == 0) {
+            return;
+        }
+        for (size_t i = 0; i < n; ++i) {
+            auto* rec = io.to_risk->alloc(i);
+            rec->batch_count = static_cast<uint16_t>(n);
+            if (i + 1 == n) {
+                rec->flags |= ExchangeToRiskMsg::kLastInBatch;
+            }
+        }
+        io.to_risk->push(n);
+        io.risk_pending = 0;
     }
 
-    void Exchange::publish_exchange_msg(const ExchToGtwyMsg& msg) {
+    void Exchange::stream_delta(void* ctx, const ob::BookDelta& delta) {
+        auto& io = *static_cast<ShardIo*>(ctx);
+        auto* rec = stream_slot(*io.deltas, io.deltas_pending);
+        if (!rec) {
+            log_error("[exch] exchange->snapshot ring full, dropped delta order_id=" + std::to_string(delta.id));
+            io.delta_dropped = true;
+            return;
+        }
+        rec->id = delta.id;
+        rec->seq = delta.seq;
+        rec->qty = delta.qty;
+        rec->price = delta.price;
+        rec->symbol_id = io.fill_symbol;
+        rec->side = delta.side;
+        rec->type = delta.type;
+        rec->flags = 0;
+        ++io.deltas_pending;
+    }
+
+    void Exchange::flush_deltas(ShardIo& io) {
+        const size_t n = io.deltas_pending;
+        if (n == 0) {
+            return;
+        }
+        io.deltas->alloc(n - 1)->flags = SnapshotDeltaMsg::kLastInOrder;
+        io.deltas->push(n);
+        io.deltas_pending = 0;
+    }
+
+    ob::DeltaSink Exchange::delta_sink(size_t symbol_idx, ShardIo& io) {
+        // a resync rebuilds the shadow book from the book anyway, so nothing is streamed until then
+        if (delta_drops_[symbol_idx] != delta_resynced_[symbol_idx]) {
+            return {};
+        }
+        return {&io, &Exchange::stream_delta};
+    }
+
+    void Exchange::note_dropped_deltas(size_t symbol_idx, ShardIo& io) {
+        if (!io.delta_dropped) [[likely]] {
+            return;
+        }
+        io.delta_dropped = false;
+        if (delta_drops_[symbol_idx]++ == delta_resynced_[symbol_idx]) {
+            ++io.resyncs_due;
+        }
+        snapshots_.mark_stale(symbol_idx, delta_drops_[symbol_idx]);
+    }
+
+    bool Exchange::resync_shadows(ShardIo& io) {
+        if (io.resyncs_due == 0) [[likely]] {
+            return false;
+        }
+        bool resynced = false;
+        ob::BookSnapshot snap{};
+        for (size_t i = 0; i < orderbooks_.size() && io.resyncs_due > 0; ++i) {
+            if (delta_drops_[i] == delta_resynced_[i] ||
+                (io.shard >= 0 && instruments_.at(i).shard != static_cast<size_t>(io.shard))) {
+                continue;
+            }
+            orderbooks_[i]->get_snapshot(snap);
+            const uint16_t symbol_id = instruments_.at(i).symbol_id;
+            if (!SnapshotService::write_resync(*io.deltas, symbol_id, delta_drops_[i], snap)) {
+                // tried again on the next poll, a book larger than the ring never gets through
+                if (snap.orders.size() + 1 > io.deltas->capacity()) {
+                    log_error("[exch] book does not fit the snapshot ring, cannot resync symbol_id=" +
+                              std::to_string(symbol_id) + " orders=" + std::to_string(snap.orders.size()));
+                }
+                continue;
+            }
+            log_warn("[exch] resynced snapshot book after dropped deltas symbol_id=" + std::to_string(symbol_id) +
+                     " orders=" + std::to_string(snap.orders.size()));
+            delta_resynced_[i] = delta_drops_[i];
+            --io.resyncs_due;
+            resynced = true;
+        }
+        return resynced;
+    }
+
+    void Exchange::publish_depth(size_t symbol_idx) {
+        const auto& book = *orderbooks_[symbol_idx];
+        if (book.depth_version() == l2_versions_[symbol_idx]) {
+            return;
+        }
+        l2_versions_[symbol_idx] = book.depth_version();
+        const auto bids = book.book_top(ob::Side::Buy, kL2Levels);
+        const auto asks = book.book_top(ob::Side::Sell, kL2Levels);
+        l2_.write(static_cast<uint32_t>(symbol_idx), [&](L2Frame& f) {
+            f.seq = book.seq;
+            f.symbol_id = instruments_.at(symbol_idx).symbol_id;
+            f.bid_ct = static_cast<uint8_t>(bids.size());
+            f.ask_ct = static_cast<uint8_t>(asks.size());
+            std::copy(bids.begin(), bids.end(), f.bids.begin());
+            std::copy(asks.begin(), asks.end(), f.asks.begin());
+        });
+    }
+
+    void Exchange::flush_fills(ShardIo& io) {
+        flush_risk_batch(io);
+        if (io.l3_pending > 0) {
+            io.mkt_data->push(io.l3_pending);
+            io.l3_pending = 0;
+        }
+        for (size_t w = 0; w < io.num_workers; ++w) {
+            if (io.acks_pending[w] > 0) {
+                io.acks[w]->push(io.acks_pending[w]);
+                io.acks_pending[w] = 0;
+            }
+        }
+    }
+
+    void Exchange::update_risk(ShardIo& io, const ob::OrderParams& order, const ob::BookEvent& event,
+                               ExchangeToRiskMsg::Type type) {
+        auto* rec = io.to_risk->alloc();
+        if (!rec) {
+            log_error("[exch] exchange->risk ring full, dropped order event order_id=" + std::to_string(order.id));
+            return;
+        }
+        *rec = ExchangeToRiskMsg{};
+        rec->maker_order_id = order.id;
+        rec->maker_client_id = order.client_id;
+        rec->seq = event.seq;
+        rec->ts = event.ts;
+        rec->price = event.price;
+        rec->qty = event.qty;
+        rec->symbol_id = order.symbol_id;
+        rec->batch_count = 1;
+        rec->side = order.side;
+        rec->type = type;
+        rec->flags = ExchangeToRiskMsg::kLastInBatch;
+        io.to_risk->push();
+    }
+
+    void Exchange::publish_exchange_msg(ShardIo& io, const ExchToGtwyMsg& msg) {
         // if (!exch_gtwy.enqueue(msg)) {
         //     log_error("[exch] exchange->gateway enqueue failed type=" +
         //               std::string(exchange_msg_type_text(msg.type)) +
@@ -233,7 +902,8 @@ namespace jolt::exchange {
         //     return;
         // }
 
-        auto ptr = exch_gtwy.alloc();
+        ExchToGtwy& acks = *io.acks[gateway_worker_of(msg.order_id, io.num_workers)];
+        auto ptr = acks.alloc();
         if (!ptr) {
             // log err
             return;
@@ -246,7 +916,7 @@ namespace jolt::exchange {
         ptr->reason = msg.reason;
         ptr->filled = msg.filled;
 
-        exch_gtwy.push();
+        acks.push();
         log_info("[exch] exchange responded to gateway type=" +
                  std::string(exchange_msg_type_text(msg.type)) +
                  " order_id=" + std::to_string(msg.order_id) +
@@ -255,8 +925,8 @@ namespace jolt::exchange {
         // exch_gtwy.enqueue(msg);
     }
 
-    void Exchange::publish_book_event(const ob::L3Data& data) {
-        auto ptr = mkt_data_gtwy.alloc();
+    void Exchange::publish_book_event(ShardIo& io, const ob::L3Data& data) {
+        auto ptr = io.mkt_data->alloc();
         if (!ptr) {
             return;
         }
@@ -269,60 +939,7 @@ namespace jolt::exchange {
         ptr->side = data.side;
         ptr->symbol_id = data.symbol_id;
         ptr->ts = data.ts;
+        io.mkt_data->push();
     }
 
-    void Exchange::handle_snapshot_request(uint64_t symbol_id, uint64_t request_seq, uint64_t request_id, uint64_t session_id)  {
-        (void)request_seq;
-        size_t symbol_idx = 0;
-        if (!symbol_id_to_index(symbol_id, symbol_idx)) {
-            md::SnapshotMeta meta{};
-            meta.accepted = false;
-            meta.request_id = request_id;
-            meta.session_id = session_id;
-            if (symbol_id <= std::numeric_limits<uint16_t>::max()) {
-                meta.symbol_id = static_cast<uint16_t>(symbol_id);
-            }
-            snapshot_meta.enqueue(meta);
-            return;
-        }
-
-        auto& book = orderbooks_[symbol_idx];
-        ob::BookSnapshot snapshot{};
-        book->get_snapshot(snapshot);
-        md::SnapshotMeta meta{};
-        meta.ask_ct = snapshot.ask_ct;
-        meta.bid_ct = snapshot.bid_ct;
-        meta.accepted = true;
-        meta.snapshot_seq = snapshot.seq;
-        meta.bytes = (snapshot.ask_ct + snapshot.bid_ct) * sizeof(ob::SnapshotOrder);
-        meta.request_id = request_id;
-        meta.symbol_id = static_cast<uint16_t>(symbol_id);
-        meta.session_id = session_id;
-        BlobHandle handle{};
-        if (!snapshot_pool_.try_acquire(handle)) {
-            meta.accepted = false;
-            snapshot_meta.enqueue(meta);
-            return;
-        }
-
-        auto& slot = snapshot_pool_.writer_slot(handle);
-        std::memcpy(slot.payload.data(), snapshot.orders.data(), meta.bytes);
-        if (!snapshot_pool_.publish_ready(handle)) {
-            meta.accepted = false;
-            snapshot_meta.enqueue(meta);
-            return;
-        }
-        meta.slot_id = static_cast<uint16_t>(handle.idx);
-        meta.slot_gen = handle.gen;
-        meta.symbol_id = static_cast<uint16_t>(symbol_id);
-        snapshot_meta.enqueue(meta);
-    }
-
-    void Exchange::poll_requests() {
-        (void)requests_.drain([&](const md::DataRequest& req) {
-            handle_snapshot_request(req.symbol_id, 0, req.request_id, req.session_id);
-        });
-    }
-
-
 }
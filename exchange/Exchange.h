@@ -3,62 +3,199 @@
 //
 
 #pragma once
+#include <array>
 #include <atomic>
 #include <cstdint>
+#include <memory>
 #include <string>
+#include <thread>
+#include <vector>
 
 #include "DayTicker.h"
+#include "SnapshotService.h"
 #include "orderbook/matching_orderbook.h"
 #include "../include/Types.h"
+#include "../include/InstrumentRegistry.h"
 #include "../entry_gateway/FixGateway.h"
 #include "../risk/RiskEngine.h"
 #include "../include/SharedMemoryRing.h"
 #include "../include/shared_mem_blob.h"
+#include "../include/seqlock_table.h"
 #include "../include/mkt_data_writer.h"
+#include "../include/input_journal.h"
+#include "../include/book_checkpoint.h"
+#include "../include/spsc_new.h"
 #include "market_data_gateway/MarketDataTypes.h"
 
 namespace jolt::exchange {
 
-    static constexpr size_t NUM_SHARDS = 4;
     class Exchange {
     public:
         using GtwyToExch = SharedSpscQueue<GtwyToExchMsg, 1 << 20>;
         using MktDataQueue = SharedSpscQueue<ob::L3Data, 1 << 15>;
         using ExchToGtwy = SharedSpscQueue<ExchToGtwyMsg, 1 << 20>;
-        using ExchToRisk = SharedSpscQueue<ExchangeToRiskMsg, 1 << 15>;
+        // 64 byte fill records, 4MB ring
+        using ExchToRisk = SharedSpscQueue<ExchangeToRiskMsg, 1 << 16>;
         using RiskToExch = SharedSpscQueue<RiskToExchMsg, 1 << 15>;
-        using SnapshotMetaQ = SharedSpscQueue<md::SnapshotMeta, 1 << 8>;
+        using SnapshotMetaQ = SnapshotService::SnapshotMetaQ;
         using SnapshotChunkQ = SharedSpscQueue<SnapshotChunk, 1 << 15>;
-        using SnapshotBlob = SlotPool<64, Page<1 << 20>>;
-        using RequestQ = SharedSpscQueue<md::DataRequest, 1 << 8>;
+        using SnapshotBlob = SnapshotService::SnapshotBlob;
+        using RequestQ = SnapshotService::RequestQ;
+        using DeltaQ = SnapshotService::DeltaQ;
+        // L2 channel, slot i holds the top of the book of registry index i
+        using L2Table = SeqlockTable<L2Frame>;
+#ifdef JOLT_PAGED_LADDER
+        // level pointers paged around the populated prices and freed as they empty, for wide price bands
+        using Book = ob::MatchingOrderBook<128, ob::LadderKind::Paged>;
+#else
+        using Book = ob::MatchingOrderBook<>;
+#endif
 
 
-        Exchange(ob::PriceTick min_tick, ob::PriceTick max_tick, const std::string& inbound_name,
+        Exchange(const InstrumentRegistry& instruments, const std::string& inbound_name,
                  const std::string& book_name,
                  const std::string& exch_name, const std::string& risk_name, const std::string& exch_to_risk_name,
-                 const std::string& blob_name, const std::string& meta_name, const std::string& request_name);
+                 const std::string& blob_name, const std::string& meta_name, const std::string& request_name,
+                 const JournalOptions& journal_opts = {}, const CheckpointOptions& checkpoint_opts = {});
         void submit_order_direct(const ob::OrderParams& order);
         bool poll_once();
         void process_loop();
-        void start();
+        // snapshot requests are answered by a SnapshotService thread, pinned to snapshot_cpu when >= 0
+        void start(int snapshot_cpu = -1);
         void stop();
-        void handle_snapshot_request(uint64_t symbol_id, uint64_t request_seq, uint64_t request_id, uint64_t session_id);
-        void poll_requests();
+        // takes orders from num_workers entry gateway workers, must be called before configure_shards and
+        // start(). every matching thread gets an inbound and an ack ring per worker, named with
+        // worker_queue_name, and acks go to the worker that handed out the order id
+        void configure_gateway_workers(size_t num_workers);
+        // switches to sharded matching, must be called before start(). creates rings named
+        // <base>_<shard> for every shard, symbols run on the shard the instrument registry assigns
+        void configure_shards(size_t num_shards, int first_cpu = -1);
+        // rebuilds the books of the current shard layout from each matching thread's last checkpoint and
+        // the journal records after it, so it must come after configure_shards and before start(). returns
+        // the number of journal records replayed
+        uint64_t recover();
+        size_t num_shards() const { return shards_.size(); }
+        size_t num_gateway_workers() const { return num_workers_; }
 
     private:
-        void handle_order(const ob::OrderParams& order);
-        void update_risk(const ExchangeToRiskMsg& msg);
-        void publish_exchange_msg(const ExchToGtwyMsg& msg);
-        void publish_book_event(const ob::L3Data& data);
+        // gateway orders taken off the inbound ring per poll, picked with matching_engine_bench --batch-sweep
+        static constexpr size_t kDrainBatch = 32;
+        using InboundBatch = std::array<ob::OrderParams, kDrainBatch>;
+
+        // outbound rings + writer a matching thread publishes to
+        struct ShardIo {
+            // indexed by gateway worker
+            std::array<ExchToGtwy*, kMaxGatewayWorkers> acks{};
+            MktDataQueue* mkt_data{nullptr};
+            ExchToRisk* to_risk{nullptr};
+            L3DataWriter* writer{nullptr};
+            DeltaQ* deltas{nullptr};
+            InputJournal* journal{nullptr};
+            CheckpointWriter* checkpoints{nullptr};
+            // shard whose books this io serves, -1 for all books (unsharded)
+            int shard{-1};
+            // fills and deltas of the order being matched, written in place and not yet published
+            uint16_t fill_symbol{0};
+            // registry index of fill_symbol, the l3 writer's batches are kept by it
+            size_t fill_symbol_idx{0};
+            size_t risk_pending{0};
+            size_t l3_pending{0};
+            std::array<size_t, kMaxGatewayWorkers> acks_pending{};
+            size_t deltas_pending{0};
+            size_t num_workers{1};
+            // a delta of the order being matched did not fit the snapshot ring
+            bool delta_dropped{false};
+            // books of this io whose shadow book waits for a resync
+            size_t resyncs_due{0};
+            // clients risk killed, their new orders are rejected before they reach a book
+            ob::FlatMap<uint64_t, uint8_t> killed{64};
+        };
+
+        // one pinned matching thread owning a disjoint set of symbols with private rings
+        struct Shard {
+            size_t id{0};
+            int cpu_id{-1};
+            // one inbound and one ack ring per gateway worker
+            std::vector<std::unique_ptr<GtwyToExch>> inbound;
+            std::unique_ptr<RiskToExch> from_risk;
+            std::vector<std::unique_ptr<ExchToGtwy>> acks;
+            std::unique_ptr<MktDataQueue> mkt_data;
+            std::unique_ptr<ExchToRisk> to_risk;
+            std::unique_ptr<L3DataWriter> writer;
+            std::unique_ptr<DeltaQ> deltas;
+            std::unique_ptr<InputJournal> journal;
+            std::unique_ptr<CheckpointWriter> checkpoints;
+            ShardIo io{};
+            InboundBatch batch{};
+            size_t next_inbound{0};
+            uint64_t curr_day{0};
+            uint32_t risk_poll_tick{0};
+            std::thread thread;
+        };
+
+        // fills batch from the gateway workers' rings in turn, starting one worker further on each poll so a
+        // busy worker cannot starve the rest. the merged order is the order the orders are journaled in
+        template <typename Rings>
+        static size_t drain_inbound(Rings& rings, size_t& next, InboundBatch& batch);
+        void handle_order(const ob::OrderParams& order, ShardIo& io);
+        // handles drained orders in ring order, prefetching the book lines of the orders coming up
+        void handle_batch(const ob::OrderParams* orders, size_t n, ShardIo& io);
+        void prefetch_order(const ob::OrderParams& order, bool deep) const;
+        // cancels every resting order of order.client_id, limited to order.symbol_id when non zero and to
+        // order.side when one_side is set
+        void handle_mass_cancel(const ob::OrderParams& order, ShardIo& io);
+        // FillSink callback, ctx is the ShardIo. writes the fill into the risk, l3 and ack rings in place
+        static void stream_fill(void* ctx, const ob::BookEvent& fill, ob::OrderId taker_id, ob::UserId taker_owner);
+        // publishes whatever stream_fill wrote for the current order
+        static void flush_fills(ShardIo& io);
+        // RestSink callback, ctx is the ShardIo. adds the order to the risk batch as an Accept when it rests
+        // and as a Cancel when a stop or take-profit fires, so risk tracks every order the book holds
+        static void stream_rest(void* ctx, ob::OrderId id, ob::UserId owner, bool resting);
+        static void flush_risk_batch(ShardIo& io);
+        // DeltaSink callback, ctx is the ShardIo. writes the delta into the snapshot ring in place
+        static void stream_delta(void* ctx, const ob::BookDelta& delta);
+        // publishes the deltas of the current order, marking the last one as closing it
+        static void flush_deltas(ShardIo& io);
+        // the book's delta sink, none while its shadow book waits for a resync
+        ob::DeltaSink delta_sink(size_t symbol_idx, ShardIo& io);
+        // after flush_deltas: if a delta was dropped the symbol's snapshots stop until it is resynced
+        void note_dropped_deltas(size_t symbol_idx, ShardIo& io);
+        // reseeds the shadow books of the io's symbols that dropped deltas from their books, once the
+        // snapshot ring has room. returns whether it wrote any
+        bool resync_shadows(ShardIo& io);
+        // rewrites the symbol's L2 frame if the top of its book changed since the last publish
+        void publish_depth(size_t symbol_idx);
+        void update_risk(ShardIo& io, const ob::OrderParams& order, const ob::BookEvent& event,
+                         ExchangeToRiskMsg::Type type);
+        void publish_exchange_msg(ShardIo& io, const ExchToGtwyMsg& msg);
+        void publish_book_event(ShardIo& io, const ob::L3Data& data);
+        void reject_invalid_symbol(const ob::OrderParams& order, ShardIo& io);
+        // whether a mass cancel reaches book i when run by the given shard (-1 for all books)
+        bool mass_cancel_hits(const ob::OrderParams& order, size_t i, int shard) const;
+        // resets the seqs of the shard's books (-1 for all books) on a new day
+        void reset_day(int shard);
+        // captures the books the io serves into its checkpoint writer, as of the last journaled record
+        void take_checkpoint(ShardIo& io, uint64_t curr_day);
+        // loads the books of a checkpoint file into the shard's books (-1 for all), returns its lsn
+        uint64_t load_checkpoint(const std::string& path, int shard, uint64_t& curr_day);
+        // applies the journal records after after_lsn to the books with no outputs, curr_day follows its
+        // day rolls
+        uint64_t replay_journal(const std::string& path, int shard, uint64_t after_lsn, uint64_t& curr_day);
+        void replay_order(const ob::OrderParams& order, int shard);
+        bool poll_shard(Shard& shard);
+        void shard_loop(Shard& shard);
 
         uint64_t seq_{0};
         uint64_t curr_day_{0};
         std::atomic<bool> running{false};
-        std::vector<std::unique_ptr<ob::MatchingOrderBook<>>> orderbooks_;
-        std::vector<uint64_t> orderbook_seqs_;
-        std::array<ob::BookSnapshot, 4> snapshots_;
-        std::array<std::vector<ob::L3Data>, 4> mkt_data_;
-        size_t snapshot_head_{0};
+        InstrumentRegistry instruments_;
+        // all indexed by the instrument's dense registry index
+        std::vector<std::unique_ptr<Book>> orderbooks_;
+        // depth_version of each book when its L2 frame was last written
+        std::vector<uint64_t> l2_versions_;
+        // deltas of each book dropped on a full snapshot ring, and how many of those a resync made up for
+        std::vector<uint64_t> delta_drops_;
+        std::vector<uint64_t> delta_resynced_;
 
         ob::PriceTick prev_bid_{0};
         ob::PriceTick prev_ask_{0};
@@ -70,9 +207,30 @@ namespace jolt::exchange {
         SnapshotBlob snapshot_pool_;
         SnapshotMetaQ snapshot_meta;
         RequestQ requests_;
+        DeltaQ deltas_;
+        SnapshotService snapshots_;
+        L2Table l2_;
         uint32_t risk_poll_tick_{0};
         ob::FlatMap<uint64_t, ClientInfo> clients_;
         L3DataWriter writer_;
+        JournalOptions journal_opts_;
+        InputJournal journal_;
+        CheckpointOptions checkpoint_opts_;
+        CheckpointWriter checkpoints_;
         DayTicker day_ticker_;
+        ShardIo io_{};
+        InboundBatch batch_{};
+        size_t num_workers_{1};
+        // unsharded rings of gateway workers 1.., worker 0 uses gtwy_exch / exch_gtwy
+        std::vector<std::unique_ptr<GtwyToExch>> worker_inbound_;
+        std::vector<std::unique_ptr<ExchToGtwy>> worker_acks_;
+        std::vector<GtwyToExch*> inbound_;
+        size_t next_inbound_{0};
+        std::vector<std::unique_ptr<Shard>> shards_;
+        std::string inbound_name_;
+        std::string book_name_;
+        std::string exch_name_;
+        std::string risk_name_;
+        std::string exch_to_risk_name_;
     };
 }
@@ -7,10 +7,15 @@
 
 #include <array>
 #include <atomic>
+#include <charconv>
+#include <chrono>
 #include <csignal>
 #include <cstdint>
 #include <iostream>
 #include <memory>
+#include <string>
+#include <string_view>
+#include <thread>
 #include <xmmintrin.h>
 
 namespace {
@@ -19,9 +24,56 @@ namespace {
     void on_signal(int) {
         g_run.store(false, std::memory_order_release);
     }
+
+    bool parse_int(std::string_view s, int& out) {
+        auto [ptr, ec] = std::from_chars(s.data(), s.data() + s.size(), out);
+        return ec == std::errc{} && ptr == s.data() + s.size();
+    }
 }
 
-int main() {
+// usage: exchange [--instruments FILE] [--shards N] [--first-cpu C] [--snapshot-cpu S] [--journal-window-us W]
+//                 [--checkpoint-secs K] [--gateway-workers G]
+// with --shards each shard matches its symbols on a thread pinned to cpu C + shard. snapshot requests are
+// answered by their own thread, pinned to cpu S when given. every matching thread journals its input and
+// commits it at least every W microseconds, and checkpoints its books every K seconds and on a clean stop
+// (K = 0 turns checkpoints off). on start the books are loaded from the checkpoints and the journal
+// records after them. G must match the entry gateway's --workers
+int main(int argc, char** argv) {
+    int num_shards = 0;
+    int first_cpu = -1;
+    int snapshot_cpu = -1;
+    int journal_window_us = -1;
+    int checkpoint_secs = -1;
+    int gateway_workers = 1;
+    std::string instruments_path;
+    for (int i = 1; i + 1 < argc; i += 2) {
+        const std::string_view arg(argv[i]);
+        bool ok = (arg == "--shards" && parse_int(argv[i + 1], num_shards)) ||
+                  (arg == "--first-cpu" && parse_int(argv[i + 1], first_cpu)) ||
+                  (arg == "--snapshot-cpu" && parse_int(argv[i + 1], snapshot_cpu)) ||
+                  (arg == "--journal-window-us" && parse_int(argv[i + 1], journal_window_us) &&
+                   journal_window_us >= 0) ||
+                  (arg == "--checkpoint-secs" && parse_int(argv[i + 1], checkpoint_secs) && checkpoint_secs >= 0) ||
+                  (arg == "--gateway-workers" && parse_int(argv[i + 1], gateway_workers) && gateway_workers > 0);
+        if (arg == "--instruments") {
+            instruments_path = argv[i + 1];
+            ok = true;
+        }
+        if (!ok) {
+            std::cerr << "usage: " << argv[0]
+                      << " [--instruments FILE] [--shards N] [--first-cpu C] [--snapshot-cpu S]"
+                      << " [--journal-window-us W] [--checkpoint-secs K] [--gateway-workers G]\n";
+            return 1;
+        }
+    }
+
+    constexpr jolt::ob::PriceTick kMinTick = 20'000;
+    constexpr jolt::ob::PriceTick kMaxTick = 100'000;
+
+    const jolt::InstrumentRegistry instruments = instruments_path.empty()
+        ? jolt::InstrumentRegistry::make_default(kMinTick, kMaxTick, static_cast<size_t>(num_shards))
+        : jolt::InstrumentRegistry::load(instruments_path);
+
     // constexpr int kExchangeCpuId = 10;
     // (void)jolt::threading::pin_current_thread_to_cpu(kExchangeCpuId, "exchange-main");
 
@@ -33,12 +85,17 @@ int main() {
         req_q_owner = std::make_unique<jolt::exchange::Exchange::RequestQ>(kReqQ, SharedRingMode::Attach);
     }
 
-    constexpr jolt::ob::PriceTick kMinTick = 20'000;
-    constexpr jolt::ob::PriceTick kMaxTick = 100'000;
+    JournalOptions journal_opts{};
+    if (journal_window_us >= 0) {
+        journal_opts.window = std::chrono::microseconds(journal_window_us);
+    }
+    CheckpointOptions checkpoint_opts{};
+    if (checkpoint_secs >= 0) {
+        checkpoint_opts.interval = std::chrono::seconds(checkpoint_secs);
+    }
 
     jolt::exchange::Exchange exchange(
-        kMinTick,
-        kMaxTick,
+        instruments,
         "order_entry_q",
         "book_events_q",
         "order_ack_q",
@@ -46,20 +103,33 @@ int main() {
         "risk_to_exch_q",
         "snapshot_blob_pool",
         "snapshot_meta_q",
-        kReqQ);
+        kReqQ,
+        journal_opts,
+        checkpoint_opts);
 
 
     std::signal(SIGINT, on_signal);
     std::signal(SIGTERM, on_signal);
 
-    exchange.start();
-    uint32_t request_poll_tick = 0;
-    while (g_run.load(std::memory_order_acquire)) {
-        const bool did_work = exchange.poll_once();
-        if (!did_work || ((++request_poll_tick & 0x3Fu) == 0)) {
-            exchange.poll_requests();
+    exchange.configure_gateway_workers(static_cast<size_t>(gateway_workers));
+    if (num_shards > 0) {
+        exchange.configure_shards(static_cast<size_t>(num_shards), first_cpu);
+    }
+
+    (void)exchange.recover();
+
+    exchange.start(snapshot_cpu);
+    if (exchange.num_shards() > 0) {
+        // matching runs on the shard threads, the main thread only waits for a signal
+        while (g_run.load(std::memory_order_acquire)) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
         }
-        if (!did_work) {
+        exchange.stop();
+        return 0;
+    }
+
+    while (g_run.load(std::memory_order_acquire)) {
+        if (!exchange.poll_once()) {
             _mm_pause();
         }
     }
@@ -0,0 +1,187 @@
+//
+// Created by djaiswal on 2/11/26.
+//
+
+#include "SnapshotService.h"
+#include "../include/async_logger.h"
+#include "../include/thread_affinity.h"
+
+#include <cstring>
+#include <limits>
+#include <string>
+#include <xmmintrin.h>
+
+namespace jolt::exchange {
+    SnapshotService::SnapshotService(const InstrumentRegistry& instruments, SnapshotBlob& pool, SnapshotMetaQ& meta,
+                                     RequestQ& requests)
+        : instruments_(instruments), dropped_(instruments.size()), resynced_(instruments.size(), 0), pool_(pool),
+          meta_(meta), requests_(requests) {
+        books_.reserve(instruments_.size());
+        for (const auto& inst : instruments_.instruments()) {
+            books_.emplace_back(std::make_unique<ob::ShadowBook>(inst.min_tick, inst.max_tick));
+        }
+        pending_.reserve(1 << 8);
+        scratch_.orders.reserve(50'000);
+    }
+
+    SnapshotService::~SnapshotService() {
+        stop();
+    }
+
+    void SnapshotService::add_source(DeltaQ& deltas) {
+        if (running_.load(std::memory_order_acquire)) {
+            throw std::runtime_error("snapshot sources must be added before start");
+        }
+        sources_.push_back(Source{&deltas, false});
+    }
+
+    void SnapshotService::seed(size_t symbol_idx, const ob::BookSnapshot& snap) {
+        if (running_.load(std::memory_order_acquire)) {
+            throw std::runtime_error("snapshot books must be seeded before start");
+        }
+        // adds in snapshot order rebuild each level's time priority
+        for (const ob::SnapshotOrder& o : snap.orders) {
+            books_[symbol_idx]->apply(ob::BookDelta{o.id, snap.seq, o.qty, o.px, o.side, ob::DeltaType::Add});
+        }
+    }
+
+    void SnapshotService::start(int cpu_id) {
+        running_.store(true, std::memory_order_release);
+        thread_ = std::thread([this, cpu_id] {
+            (void)threading::pin_current_thread_to_cpu(cpu_id, "exchange-snapshot");
+            while (running_.load(std::memory_order_acquire)) {
+                if (!poll_once()) {
+                    _mm_pause();
+                }
+            }
+        });
+    }
+
+    void SnapshotService::stop() {
+        running_.store(false, std::memory_order_release);
+        if (thread_.joinable()) {
+            thread_.join();
+        }
+    }
+
+    bool SnapshotService::poll_once() {
+        bool did_work = false;
+        for (auto& src : sources_) {
+            const size_t applied = src.deltas->drain([&](const SnapshotDeltaMsg& msg) {
+                src.mid_order = !msg.last_in_order();
+                const size_t symbol_idx = instruments_.index_of(msg.symbol_id);
+                if (symbol_idx == InstrumentRegistry::npos) {
+                    return;
+                }
+                if (msg.resync()) {
+                    books_[symbol_idx]->clear();
+                    resynced_[symbol_idx] = msg.id;
+                    return;
+                }
+                books_[symbol_idx]->apply(ob::BookDelta{msg.id, msg.seq, msg.qty, msg.price, msg.side, msg.type});
+            });
+            did_work = did_work || (applied > 0);
+        }
+
+        did_work = (requests_.drain([&](const md::DataRequest& req) { pending_.push_back(req); }) > 0) || did_work;
+
+        size_t kept = 0;
+        for (const md::DataRequest& req : pending_) {
+            const size_t symbol_idx = instruments_.index_of(req.symbol_id);
+            if (symbol_idx == InstrumentRegistry::npos || sources_.empty()) {
+                reject(req);
+                continue;
+            }
+            if (sources_[source_of(symbol_idx)].mid_order || stale(symbol_idx)) {
+                pending_[kept++] = req;
+                continue;
+            }
+            serve(req, symbol_idx);
+            did_work = true;
+        }
+        pending_.resize(kept);
+        return did_work;
+    }
+
+    void SnapshotService::mark_stale(size_t symbol_idx, uint64_t drops) {
+        dropped_[symbol_idx].store(drops, std::memory_order_release);
+    }
+
+    bool SnapshotService::stale(size_t symbol_idx) const {
+        return dropped_[symbol_idx].load(std::memory_order_acquire) != resynced_[symbol_idx];
+    }
+
+    bool SnapshotService::write_resync(DeltaQ& deltas, uint16_t symbol_id, uint64_t drops,
+                                       const ob::BookSnapshot& snap) {
+        const size_t n = snap.orders.size() + 1;
+        // one push, the service sees the cleared book only together with all of its orders
+        if (!deltas.alloc(n - 1)) {
+            return false;
+        }
+        SnapshotDeltaMsg* rec = deltas.alloc(0);
+        *rec = SnapshotDeltaMsg{drops, snap.seq, 0, 0, symbol_id, ob::Side::Buy, ob::DeltaType::Remove,
+                                SnapshotDeltaMsg::kResync};
+        for (size_t i = 1; i < n; ++i) {
+            const ob::SnapshotOrder& o = snap.orders[i - 1];
+            rec = deltas.alloc(i);
+            *rec = SnapshotDeltaMsg{o.id, snap.seq, o.qty, o.px, symbol_id, o.side, ob::DeltaType::Add, 0};
+        }
+        rec->flags |= SnapshotDeltaMsg::kLastInOrder;
+        deltas.push(n);
+        return true;
+    }
+
+    size_t SnapshotService::source_of(size_t symbol_idx) const {
+        return sources_.size() == 1 ? 0 : instruments_.at(symbol_idx).shard;
+    }
+
+    void SnapshotService::serve(const md::DataRequest& req, size_t symbol_idx) {
+        books_[symbol_idx]->snapshot(scratch_);
+        md::SnapshotMeta meta{};
+        meta.ask_ct = static_cast<uint32_t>(scratch_.ask_ct);
+        meta.bid_ct = static_cast<uint32_t>(scratch_.bid_ct);
+        meta.accepted = true;
+        meta.snapshot_seq = scratch_.seq;
+        meta.bytes = static_cast<uint32_t>(scratch_.orders.size() * sizeof(ob::SnapshotOrder));
+        meta.request_id = req.request_id;
+        meta.symbol_id = static_cast<uint16_t>(req.symbol_id);
+        meta.session_id = req.session_id;
+
+        if (meta.bytes > sizeof(SnapshotPage::payload)) {
+            log_error("[snap] snapshot does not fit a blob slot symbol_id=" + std::to_string(req.symbol_id) +
+                      " bytes=" + std::to_string(meta.bytes));
+            meta.accepted = false;
+            meta_.enqueue(meta);
+            return;
+        }
+        BlobHandle handle{};
+        if (!pool_.try_acquire(handle)) {
+            meta.accepted = false;
+            meta_.enqueue(meta);
+            return;
+        }
+
+        auto& slot = pool_.writer_slot(handle);
+        std::memcpy(slot.payload.data(), scratch_.orders.data(), meta.bytes);
+        slot.bytes = meta.bytes;
+        if (!pool_.publish_ready(handle)) {
+            meta.accepted = false;
+            meta_.enqueue(meta);
+            return;
+        }
+        meta.slot_id = static_cast<uint16_t>(handle.idx);
+        meta.slot_gen = handle.gen;
+        meta_.enqueue(meta);
+    }
+
+    void SnapshotService::reject(const md::DataRequest& req) {
+        md::SnapshotMeta meta{};
+        meta.accepted = false;
+        meta.request_id = req.request_id;
+        meta.session_id = req.session_id;
+        if (req.symbol_id <= std::numeric_limits<uint16_t>::max()) {
+            meta.symbol_id = static_cast<uint16_t>(req.symbol_id);
+        }
+        meta_.enqueue(meta);
+    }
+}
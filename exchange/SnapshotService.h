@@ -0,0 +1,93 @@
+//
+// Created by djaiswal on 2/11/26.
+//
+
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include "orderbook/shadow_book.h"
+#include "../include/Types.h"
+#include "../include/InstrumentRegistry.h"
+#include "../include/SharedMemoryRing.h"
+#include "../include/shared_mem_blob.h"
+#include "market_data_gateway/MarketDataTypes.h"
+
+namespace jolt::exchange {
+
+    // serves book snapshot requests off the matching threads. every matching thread streams the resting
+    // order deltas of its books into a ring, this service replays them into one ShadowBook per symbol
+    // and cuts snapshots from those. runs on its own thread and is the only writer of the snapshot blob
+    // pool and meta ring
+    class SnapshotService {
+    public:
+        using DeltaQ = SharedSpscQueue<SnapshotDeltaMsg, 1 << 16>;
+        using SnapshotMetaQ = SharedSpscQueue<md::SnapshotMeta, 1 << 8>;
+        using SnapshotPage = Page<1 << 20>;
+        using SnapshotBlob = SlotPool<64, SnapshotPage>;
+        using RequestQ = SharedSpscQueue<md::DataRequest, 1 << 8>;
+
+        SnapshotService(const InstrumentRegistry& instruments, SnapshotBlob& pool, SnapshotMetaQ& meta,
+                        RequestQ& requests);
+        ~SnapshotService();
+
+        SnapshotService(const SnapshotService&) = delete;
+        SnapshotService& operator=(const SnapshotService&) = delete;
+
+        // delta ring of the next matching thread, the i-th source added feeds the books of shard i. must be
+        // called before start()
+        void add_source(DeltaQ& deltas);
+        // loads the resting orders of a book rebuilt before start (journal replay) into its shadow book
+        void seed(size_t symbol_idx, const ob::BookSnapshot& snap);
+        void start(int cpu_id = -1);
+        void stop();
+        // applies pending deltas and answers the requests whose books sit between two orders
+        bool poll_once();
+
+        // called by the matching thread owning the symbol once it dropped one of its deltas on a full ring,
+        // drops counting them. requests for the symbol wait until a resync carrying the same count is
+        // applied, its shadow book no longer matches the book
+        void mark_stale(size_t symbol_idx, uint64_t drops);
+        // matching thread side of a resync: writes a kResync record for drops followed by the resting orders
+        // of snap (the book's get_snapshot) as one order. nothing may be pending on deltas. returns false,
+        // writing nothing, when the ring has no room for all of it yet
+        static bool write_resync(DeltaQ& deltas, uint16_t symbol_id, uint64_t drops, const ob::BookSnapshot& snap);
+
+    private:
+        struct Source {
+            DeltaQ* deltas{nullptr};
+            // the last delta read did not close its order, the books of this source are mid update
+            bool mid_order{false};
+        };
+
+        void serve(const md::DataRequest& req, size_t symbol_idx);
+        void reject(const md::DataRequest& req);
+        size_t source_of(size_t symbol_idx) const;
+
+        bool stale(size_t symbol_idx) const;
+
+        InstrumentRegistry instruments_;
+        // indexed by the instrument's dense registry index
+        std::vector<std::unique_ptr<ob::ShadowBook>> books_;
+        // dropped delta count per symbol as marked by its matching thread, and as made up for by the last
+        // resync applied
+        std::vector<std::atomic<uint64_t>> dropped_;
+        std::vector<uint64_t> resynced_;
+        std::vector<Source> sources_;
+        // requests waiting for their source to reach an order boundary
+        std::vector<md::DataRequest> pending_;
+        // reused for every request
+        ob::BookSnapshot scratch_{};
+
+        SnapshotBlob& pool_;
+        SnapshotMetaQ& meta_;
+        RequestQ& requests_;
+
+        std::atomic<bool> running_{false};
+        std::thread thread_{};
+    };
+}
@@ -5,65 +5,117 @@
 #include <limits>
 
 namespace jolt::ob {
+    // multi-level occupancy bitmap. levels_[0] holds one bit per index, every level above holds
+    // one summary bit per non-empty word of the level below, up to a single top word.
+    // next_set/prev_set climb the summary words until they hit a set bit, then descend with one
+    // ctz/clz per level, so a lookup is O(levels) regardless of how sparse the range is
     class BitsetIndex {
     public:
         explicit BitsetIndex(std::size_t size_bits = 0) { reset(size_bits); }
 
         void reset(std::size_t size_bits) {
             size_bits_ = size_bits;
-            words_.assign((size_bits + 63) / 64, 0ull);
+            levels_.clear();
+            std::size_t words = (size_bits + 63) / 64;
+            levels_.emplace_back(words, 0ull);
+            while (words > 1) {
+                words = (words + 63) / 64;
+                levels_.emplace_back(words, 0ull);
+            }
         }
 
         std::size_t size() const { return size_bits_; }
 
+        bool any() const { return !levels_.back().empty() && levels_.back()[0] != 0ull; }
+
+        // sets the leaf bit, propagating up only while the touched word was previously empty
         inline void set(std::size_t idx) {
-            auto [w, m] = mask(idx);
-            words_[w] |= m;
+            for (auto& words : levels_) {
+                auto [w, m] = mask(idx);
+                const bool was_empty = words[w] == 0ull;
+                words[w] |= m;
+                if (!was_empty) {
+                    return;
+                }
+                idx = w;
+            }
         }
 
+        // clears the leaf bit, propagating up only while the touched word became empty
         inline void clear(std::size_t idx) {
-            auto [w, m] = mask(idx);
-            words_[w] &= ~m;
+            for (auto& words : levels_) {
+                auto [w, m] = mask(idx);
+                words[w] &= ~m;
+                if (words[w] != 0ull) {
+                    return;
+                }
+                idx = w;
+            }
         }
 
         inline bool test(std::size_t idx) const {
             auto [w, m] = mask(idx);
-            return (words_[w] & m) != 0ull;
+            return (levels_[0][w] & m) != 0ull;
         }
 
+        // first set index >= start
         std::size_t next_set(std::size_t start) const {
             if (start >= size_bits_) {
                 return npos;
             }
-            std::size_t wi = start / 64;
-            uint64_t w = words_[wi] & (~0ull << (start % 64));
+            std::size_t lvl = 0;
+            std::size_t idx = start;
             while (true) {
+                const auto& words = levels_[lvl];
+                const std::size_t wi = idx / 64;
+                if (wi >= words.size()) {
+                    return npos;
+                }
+                const uint64_t w = words[wi] & (~0ull << (idx % 64));
                 if (w) {
-                    return wi * 64 + ctz(w);
+                    idx = wi * 64 + ctz(w);
+                    break;
+                }
+                if (lvl + 1 == levels_.size()) {
+                    return npos;
                 }
-                ++wi;
-                if (wi >= words_.size()) break;
-                w = words_[wi];
+                ++lvl;
+                idx = wi + 1;
             }
-            return npos;
+            while (lvl > 0) {
+                --lvl;
+                idx = idx * 64 + ctz(levels_[lvl][idx]);
+            }
+            return idx;
         }
 
+        // last set index <= start
         std::size_t prev_set(std::size_t start) const {
             if (size_bits_ == 0) {
                 return npos;
             }
             if (start >= size_bits_) start = size_bits_ - 1;
-            std::size_t wi = start / 64;
-            uint64_t w = words_[wi] & (~0ull >> (63 - (start % 64)));
+            std::size_t lvl = 0;
+            std::size_t idx = start;
             while (true) {
+                const auto& words = levels_[lvl];
+                const std::size_t wi = idx / 64;
+                const uint64_t w = words[wi] & (~0ull >> (63 - (idx % 64)));
                 if (w) {
-                    return wi * 64 + (63 - clz(w));
+                    idx = wi * 64 + (63 - clz(w));
+                    break;
+                }
+                if (wi == 0 || lvl + 1 == levels_.size()) {
+                    return npos;
                 }
-                if (wi == 0) break;
-                --wi;
-                w = words_[wi];
+                ++lvl;
+                idx = wi - 1;
+            }
+            while (lvl > 0) {
+                --lvl;
+                idx = idx * 64 + (63 - clz(levels_[lvl][idx]));
             }
-            return npos;
+            return idx;
         }
 
         static constexpr std::size_t npos = std::numeric_limits<std::size_t>::max();
@@ -82,6 +134,6 @@ namespace jolt::ob {
         }
 
         std::size_t size_bits_{};
-        std::vector<uint64_t> words_;
+        std::vector<std::vector<uint64_t>> levels_;
     };
 }
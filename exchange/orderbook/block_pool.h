@@ -4,6 +4,7 @@
 #include <cstdint>
 #include <vector>
 #include <cstdlib>
+#include <new>
 
 namespace jolt::ob {
     template <typename BlockT>
@@ -21,64 +22,64 @@ namespace jolt::ob {
             if (free_list_) {
                 BlockT* b = free_list_;
                 free_list_ = free_list_->pool_next;
+                const uint32_t idx = b->pool_idx;
                 *b = BlockT{};
+                b->pool_idx = idx;
+                ++in_use_;
                 return b;
             }
 
-            if (cursor_ + stride_ > end_) {
+            if (carved_ == pages_.size() * kPerPage) {
                 new_page();
             }
-
-            // compensate for misaligned blocks
-            std::uintptr_t addr = reinterpret_cast<std::uintptr_t>(cursor_);
-            std::size_t mis = addr % alignment_;
-            if (mis) {
-                cursor_ += (alignment_ - mis);
-            }
-            BlockT* blk = reinterpret_cast<BlockT*>(cursor_);
-            cursor_ += stride_;
+            const auto idx = static_cast<uint32_t>(carved_++);
+            BlockT* blk = at(idx);
             *blk = BlockT{};
+            blk->pool_idx = idx;
+            ++in_use_;
             return blk;
         }
 
+        // block with the given pool_idx. blocks never move, so an index stays valid for the pool's life
+        BlockT* at(uint32_t idx) const {
+            auto* page = static_cast<std::byte*>(pages_[idx / kPerPage]);
+            return reinterpret_cast<BlockT*>(page + (idx % kPerPage) * stride_);
+        }
+
         void release(BlockT* blk) {
             blk->pool_next = free_list_;
             free_list_ = blk;
+            --in_use_;
         }
 
+        // blocks handed out and not yet released
+        std::size_t in_use() const { return in_use_; }
+
         BlockPool(const BlockPool&) = delete;
         BlockPool& operator=(const BlockPool&) = delete;
 
     private:
         void new_page() {
-            constexpr std::size_t PAGE_SIZE = 1 << 20;
-            const std::size_t page_bytes = (PAGE_SIZE + alignment_ - 1) / alignment_ * alignment_;
             void* mem = nullptr;
             const std::size_t palign = alignment_ < sizeof(void*) ? sizeof(void*) : alignment_;
 
-            int rc = posix_memalign(&mem, palign, page_bytes);
+            int rc = posix_memalign(&mem, palign, kPageBytes);
             if (rc != 0 || mem == nullptr) {
                 throw std::bad_alloc();
             }
-
             pages_.push_back(mem);
-            cursor_ = static_cast<std::byte*>(mem);
-            end_ = cursor_ + page_bytes;
-
-            std::uintptr_t addr = reinterpret_cast<std::uintptr_t>(cursor_);
-            std::size_t mis = addr % alignment_;
-            if (mis) {
-                cursor_ += (alignment_ - mis);
-            }
         }
 
         std::vector<void*> pages_{};
-        std::byte* cursor_{nullptr};
-        std::byte* end_{nullptr};
+        std::size_t carved_{0};
         BlockT* free_list_{nullptr};
+        std::size_t in_use_{0};
 
         static constexpr std::size_t alignment_ = alignof(BlockT);
         static constexpr std::size_t stride_ = (sizeof(BlockT) + alignment_ - 1) / alignment_ * alignment_;
         static_assert(stride_ % alignment_ == 0, "Stride must be multiple of alignment");
+        // pages start aligned, so blocks are carved back to back at stride_
+        static constexpr std::size_t kPageBytes = stride_ > (1 << 20) ? stride_ : ((1 << 20) / stride_) * stride_;
+        static constexpr std::size_t kPerPage = kPageBytes / stride_;
     };
 }
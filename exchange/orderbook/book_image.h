@@ -0,0 +1,152 @@
+#pragma once
+
+#include <cstdint>
+#include <span>
+#include <type_traits>
+#include <vector>
+#include "ob_types.h"
+#include "level.h"
+#include "robin_map.h"
+
+namespace jolt::ob {
+    // consecutive slots of one queue: count slots of kind at (side, px) in fifo order. px is the limit
+    // price for active orders and the trigger for stops and take-profits
+    struct ImageRun {
+        enum class Kind : uint8_t { Active = 0, Stop = 1, TakeProfit = 2 };
+
+        PriceTick px{0};
+        uint32_t count{0};
+        Side side{Side::Buy};
+        Kind kind{Kind::Active};
+    };
+    static_assert(sizeof(ImageRun) == 12, "checkpoint files assume a 12 byte run");
+
+    // scalar state of a book next to its queues
+    struct ImageHeader {
+        uint64_t seq{0};
+        PriceTick min_tick{0};
+        PriceTick max_tick{0};
+        PriceTick last_trade{0};
+        PriceTick prev_trade{0};
+    };
+
+    static_assert(std::is_trivially_copyable_v<OrderSlot> && std::is_trivially_copyable_v<StopSlot> &&
+                  std::is_trivially_copyable_v<TpSlot>, "image slots are copied as bytes");
+
+    // read only view of a book image, the slots of every run stored back to back per kind in run order.
+    // may point into a mapped checkpoint file
+    struct BookImageView {
+        ImageHeader header{};
+        std::span<const ImageRun> runs{};
+        std::span<const OrderSlot> orders{};
+        std::span<const StopSlot> stops{};
+        std::span<const TpSlot> tps{};
+    };
+
+    // the slots of one kind of run, a chunk per run. a chunk stays with its run from capture to capture
+    // and is only recopied when the run's level changed, the chunks of runs that are gone are reused
+    template <typename SlotT>
+    struct ImageChunks {
+        std::vector<std::vector<SlotT>> chunks{};
+        // capture that last kept each chunk
+        std::vector<uint64_t> kept{};
+        std::vector<uint32_t> free{};
+        // slots over the runs of the last capture
+        std::size_t slots{0};
+
+        uint32_t acquire() {
+            if (!free.empty()) {
+                const uint32_t c = free.back();
+                free.pop_back();
+                return c;
+            }
+            chunks.emplace_back();
+            kept.push_back(0);
+            return static_cast<uint32_t>(chunks.size() - 1);
+        }
+
+        void release(uint32_t c) {
+            chunks[c].clear();
+            free.push_back(c);
+        }
+
+        void clear() {
+            for (auto& c : chunks) {
+                c.clear();
+            }
+            free.clear();
+            for (uint32_t c = static_cast<uint32_t>(chunks.size()); c-- > 0;) {
+                free.push_back(c);
+            }
+            slots = 0;
+        }
+    };
+
+    // a book's resting state, filled by MatchingOrderBook::save_image and kept between checkpoints. runs
+    // lists the runs in image order, the slots of each sit in a chunk of their kind's store. a capture
+    // into the image the same book captured into last only recopies the runs of levels that changed
+    // since, so its cost follows the churn and not the size of the book
+    struct BookImage {
+        ImageHeader header{};
+        std::vector<ImageRun> runs{};
+        // per run, its chunk in the store of its kind
+        std::vector<uint32_t> run_chunks{};
+        ImageChunks<OrderSlot> orders{};
+        ImageChunks<StopSlot> stops{};
+        ImageChunks<TpSlot> tps{};
+        // run keys of neighbouring prices are consecutive and a price has up to six of them, the low bits
+        // are mixed so they do not pile up in one probe run
+        struct RunKeyHash {
+            std::size_t operator()(uint64_t key) const noexcept {
+                key ^= key >> 33;
+                key *= 0xff51afd7ed558ccdull;
+                key ^= key >> 33;
+                return static_cast<std::size_t>(key);
+            }
+        };
+
+        // (kind, side, px) of every run of the last capture -> its chunk
+        RobinMap<uint64_t, uint32_t, RunKeyHash> chunk_of{1 << 10};
+        // book and capture count this image was last filled from, anything else starts over
+        const void* book{nullptr};
+        uint64_t capture{0};
+        // runs the last capture copied from the book, the rest were kept
+        std::size_t copied_runs{0};
+
+        static uint64_t run_key(ImageRun::Kind kind, Side side, PriceTick px) {
+            return (static_cast<uint64_t>(kind) << 40) | (static_cast<uint64_t>(side) << 32) | px;
+        }
+
+        void clear() {
+            header = ImageHeader{};
+            runs.clear();
+            run_chunks.clear();
+            orders.clear();
+            stops.clear();
+            tps.clear();
+            chunk_of = RobinMap<uint64_t, uint32_t, RunKeyHash>(1 << 10);
+            book = nullptr;
+            capture = 0;
+            copied_runs = 0;
+        }
+
+        // calls fn(run, slots) for the runs in image order, slots being a span of the run's kind
+        template <typename Fn>
+        void for_each_run(Fn&& fn) const {
+            for (std::size_t i = 0; i < runs.size(); ++i) {
+                const uint32_t c = run_chunks[i];
+                switch (runs[i].kind) {
+                case ImageRun::Kind::Active:
+                    fn(runs[i], std::span<const OrderSlot>(orders.chunks[c]));
+                    break;
+                case ImageRun::Kind::Stop:
+                    fn(runs[i], std::span<const StopSlot>(stops.chunks[c]));
+                    break;
+                case ImageRun::Kind::TakeProfit:
+                    fn(runs[i], std::span<const TpSlot>(tps.chunks[c]));
+                    break;
+                }
+            }
+        }
+    };
+}
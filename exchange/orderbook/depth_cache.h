@@ -0,0 +1,107 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <span>
+#include "ob_types.h"
+
+namespace jolt::ob {
+    // best N levels of each side, aggregated and kept best first. the book calls set() whenever the
+    // open qty of a level changes and clear() when a level empties, so reading the top of the book is a
+    // copy of a few contiguous entries instead of a walk over the ladder. idx is the book's side index
+    // (0 = best possible price on both sides). while a side holds fewer than N levels it holds every
+    // occupied level, so only clearing a level out of a full side has to look past the cached ones
+    template <std::size_t N>
+    class DepthCache {
+        static_assert(N > 0, "depth cache needs at least one level");
+
+        struct SideCache {
+            std::array<DepthLevel, N> levels{};
+            std::array<std::size_t, N> idx{};
+            std::size_t count{0};
+        };
+
+        SideCache sides_[2]{};
+        uint64_t version_{0};
+
+        SideCache& side(Side s) { return sides_[s == Side::Buy ? 0 : 1]; }
+        const SideCache& side(Side s) const { return sides_[s == Side::Buy ? 0 : 1]; }
+
+        static void shift_down(SideCache& c, std::size_t from) {
+            const std::size_t last = c.count < N ? c.count : N - 1;
+            for (std::size_t i = last; i > from; --i) {
+                c.levels[i] = c.levels[i - 1];
+                c.idx[i] = c.idx[i - 1];
+            }
+        }
+
+    public:
+        static constexpr std::size_t kLevels = N;
+        static constexpr std::size_t npos = std::numeric_limits<std::size_t>::max();
+
+        // level idx now holds qty over orders resting orders, qty > 0
+        void set(Side s, std::size_t idx, PriceTick px, Qty qty, uint32_t orders) {
+            SideCache& c = side(s);
+            // worse than everything in a full side, the common case deep in the book
+            if (c.count == N && idx > c.idx[N - 1]) {
+                return;
+            }
+            std::size_t i = 0;
+            while (i < c.count && c.idx[i] < idx) {
+                ++i;
+            }
+            if (i == c.count || c.idx[i] != idx) {
+                shift_down(c, i);
+                if (c.count < N) {
+                    ++c.count;
+                }
+                c.idx[i] = idx;
+            }
+            c.levels[i] = DepthLevel{px, qty, orders};
+            ++version_;
+        }
+
+        // level idx emptied. when the side was full, next(after) must return the side index of the first
+        // occupied level after `after` (npos if none) and load(idx) that level, to refill the last entry
+        template <typename NextFn, typename LoadFn>
+        void clear(Side s, std::size_t idx, NextFn&& next, LoadFn&& load) {
+            SideCache& c = side(s);
+            std::size_t i = 0;
+            while (i < c.count && c.idx[i] < idx) {
+                ++i;
+            }
+            if (i == c.count || c.idx[i] != idx) {
+                return;
+            }
+            const bool was_full = c.count == N;
+            for (; i + 1 < c.count; ++i) {
+                c.levels[i] = c.levels[i + 1];
+                c.idx[i] = c.idx[i + 1];
+            }
+            --c.count;
+            if (was_full) {
+                const std::size_t after = c.count == 0 ? 0 : c.idx[c.count - 1] + 1;
+                const std::size_t nx = next(after);
+                if (nx != npos) {
+                    c.idx[c.count] = nx;
+                    c.levels[c.count] = load(nx);
+                    ++c.count;
+                }
+            }
+            ++version_;
+        }
+
+        // the best min(n, N) levels of a side, best first. valid until the next change to the book
+        std::span<const DepthLevel> top(Side s, std::size_t n) const {
+            const SideCache& c = side(s);
+            return {c.levels.data(), n < c.count ? n : c.count};
+        }
+
+        std::size_t size(Side s) const { return side(s).count; }
+
+        // bumped on every change to the cached levels, readers compare it to skip republishing
+        uint64_t version() const { return version_; }
+    };
+}
@@ -3,6 +3,7 @@
 #include <array>
 #include <cstring>
 #include <new>
+#include <type_traits>
 #include <utility>
 #include "block_pool.h"
 
@@ -17,14 +18,22 @@ namespace jolt::ob {
         uint16_t head{0};
         uint16_t tail{0};
         uint16_t live{0};
+        // position in the owning BlockPool, see BlockPool::at
+        uint32_t pool_idx{0};
         Block* next{nullptr};
+        Block* prev{nullptr};
         Block* pool_next{nullptr};
+
+        void store(uint16_t off, const SlotT& s) { slots[off] = s; }
+        const SlotT& load(uint16_t off) const { return slots[off]; }
+        void copy_slot(uint16_t dst, const Block& src, uint16_t off) { slots[dst] = src.slots[off]; }
     };
 
-    template <typename SlotT, std::size_t K>
+    // BlockT is Block<SlotT, K> or any block with the same bookkeeping fields and store/load/copy_slot
+    template <typename SlotT, std::size_t K, typename BlockT_ = Block<SlotT, K>>
     class Fifo {
     public:
-        using BlockT = Block<SlotT, K>;
+        using BlockT = BlockT_;
 
         explicit Fifo(BlockPool<BlockT>& pool) : pool_(pool) {
         }
@@ -48,7 +57,7 @@ namespace jolt::ob {
             }
 
             uint16_t off = tail_->tail++;
-            tail_->slots[off] = s;
+            tail_->store(off, s);
             set_live(tail_, off);
             ++live_count_;
             return {tail_, off};
@@ -64,14 +73,37 @@ namespace jolt::ob {
                 allocate_block();
             }
             uint16_t off = tail_->tail++;
-            ::new(static_cast<void*>(&tail_->slots[off])) SlotT{std::forward<Args>(args)...};
+            tail_->store(off, SlotT{std::forward<Args>(args)...});
             set_live(tail_, off);
             ++live_count_;
             return {tail_, off};
         }
 
+        // appends n slots in order a block at a time, marking each filled range live in whole mask words.
+        // on_slot(slot, loc) sees every slot stored, for callers that index them
+        template <typename Fn>
+        void append_bulk(const SlotT* src, std::size_t n, Fn&& on_slot) {
+            std::size_t i = 0;
+            while (i < n) {
+                if (!tail_ || tail_->tail == K) {
+                    allocate_block();
+                }
+                BlockT* b = tail_;
+                const uint16_t from = b->tail;
+                const auto take = static_cast<uint16_t>(K - from < n - i ? K - from : n - i);
+                for (uint16_t j = 0; j < take; ++j) {
+                    b->store(static_cast<uint16_t>(from + j), src[i + j]);
+                    on_slot(src[i + j], Loc{b, static_cast<uint16_t>(from + j)});
+                }
+                set_live_range(b, from, take);
+                b->tail = static_cast<uint16_t>(from + take);
+                live_count_ += take;
+                i += take;
+            }
+        }
+
         // returns the first slot in the queue
-        SlotT* head_slot() {
+        SlotT* head_slot() requires std::is_same_v<BlockT, Block<SlotT, K>> {
             skip_dead_slots();
             if (!head_) {
                 return nullptr;
@@ -79,6 +111,15 @@ namespace jolt::ob {
             return &head_->slots[head_->head];
         }
 
+        // location of the first live slot, blk is null when the queue is empty
+        Loc head_loc() {
+            skip_dead_slots();
+            if (!head_) {
+                return {nullptr, 0};
+            }
+            return {head_, head_->head};
+        }
+
         // removes orders starting from head, used for order matching
         void pop_head() {
             skip_dead_slots();
@@ -107,23 +148,88 @@ namespace jolt::ob {
             }
         }
 
+        // tombstone that also compacts the block once it gets sparse. live slots may move, in fifo
+        // order, to lower offsets of the same block or of the block before them; on_move(slot, new_loc)
+        // is called for every slot that moved so the caller can repoint its locators
+        template <typename MoveFn>
+        void tombstone(const Loc& loc, MoveFn&& on_move) {
+            if (!loc.blk) {
+                return;
+            }
+            BlockT* b = loc.blk;
+            clear_live(b, loc.off);
+            if (live_count_ > 0) {
+                --live_count_;
+            }
+            if (b == head_) {
+                drop_empty_head_block();
+                if (head_ != b) {
+                    return;
+                }
+            }
+            if (b->live > kSparse) {
+                return;
+            }
+            if (b->live == 0) {
+                unlink(b);
+                return;
+            }
+            // merge with a neighbour when the pair fits in half a block, otherwise only pack in place
+            // once half the block is dead so a block is not rewritten on every cancel
+            if (b->next && b->live + b->next->live <= K / 2) {
+                pack(b, on_move);
+                absorb(b, b->next, on_move);
+            }
+            else if (b->prev && b->prev->live + b->live <= K / 2) {
+                BlockT* p = b->prev;
+                pack(p, on_move);
+                absorb(p, b, on_move);
+            }
+            else if (static_cast<std::size_t>((b->tail - b->head) - b->live) >= K / 2) {
+                pack(b, on_move);
+            }
+        }
+
         template <typename Fn>
         void copy_live(Fn&& fn) const {
             BlockT* b = head_;
             while (b) {
                 for (uint16_t start = b->head; start < b->tail; ++start) {
                     if (is_live(b, start)) {
-                        fn(static_cast<const SlotT&>(b->slots[start]));
+                        fn(static_cast<const SlotT&>(b->load(start)));
                     }
                 }
                 b = b->next;
             }
         }
 
+        // like copy_live, with each slot's location
+        template <typename Fn>
+        void for_each_live(Fn&& fn) const {
+            for (BlockT* b = head_; b; b = b->next) {
+                for (uint16_t off = b->head; off < b->tail; ++off) {
+                    if (is_live(b, off)) {
+                        fn(static_cast<const SlotT&>(b->load(off)), Loc{b, off});
+                    }
+                }
+            }
+        }
 
         std::size_t blocks() const { return blocks_; }
 
+        // total open qty of the queue, for blocks that can sum it themselves (soa)
+        uint64_t live_qty() const requires requires(const BlockT* b) { b->live_qty(); } {
+            uint64_t total = 0;
+            for (const BlockT* b = head_; b; b = b->next) {
+                total += b->live_qty();
+            }
+            return total;
+        }
+
     private:
+        // a block at or below this many live slots is a compaction candidate
+        static constexpr uint16_t kSparse = K / 4;
+
         void allocate_block() {
             BlockT* nb = pool_.acquire();
             ++blocks_;
@@ -131,11 +237,82 @@ namespace jolt::ob {
                 head_ = tail_ = nb;
             }
             else {
+                nb->prev = tail_;
                 tail_->next = nb;
                 tail_ = nb;
             }
         }
 
+        // slides the live slots of b down to offsets [0, live), keeping their order
+        template <typename MoveFn>
+        void pack(BlockT* b, MoveFn& on_move) {
+            uint16_t dst = 0;
+            for (std::size_t w = 0; w < K / 64; ++w) {
+                uint64_t bits = b->live_mask[w];
+                b->live_mask[w] = 0;
+                while (bits) {
+                    const auto src = static_cast<uint16_t>(w * 64 + __builtin_ctzll(bits));
+                    bits &= bits - 1;
+                    if (src != dst) {
+                        b->copy_slot(dst, *b, src);
+                        on_move(static_cast<const SlotT&>(b->load(dst)), Loc{b, dst});
+                    }
+                    ++dst;
+                }
+            }
+            for (uint16_t i = 0; i < dst; ++i) {
+                b->live_mask[i / 64] |= (1ull << (i % 64));
+            }
+            b->head = 0;
+            b->tail = dst;
+        }
+
+        // appends the live slots of src (the block right after dst) to dst and unlinks src
+        template <typename MoveFn>
+        void absorb(BlockT* dst, BlockT* src, MoveFn& on_move) {
+            for (std::size_t w = 0; w < K / 64; ++w) {
+                uint64_t bits = src->live_mask[w];
+                while (bits) {
+                    const auto off = static_cast<uint16_t>(w * 64 + __builtin_ctzll(bits));
+                    bits &= bits - 1;
+                    const uint16_t to = dst->tail++;
+                    dst->copy_slot(to, *src, off);
+                    set_live(dst, to);
+                    on_move(static_cast<const SlotT&>(dst->load(to)), Loc{dst, to});
+                }
+            }
+            unlink(src);
+        }
+
+        // takes b out of the chain and returns it to the pool
+        void unlink(BlockT* b) {
+            if (b->prev) {
+                b->prev->next = b->next;
+            }
+            else {
+                head_ = b->next;
+            }
+            if (b->next) {
+                b->next->prev = b->prev;
+            }
+            else {
+                tail_ = b->prev;
+            }
+            release_block(b);
+        }
+
+        void release_block(BlockT* b) {
+            b->next = nullptr;
+            b->prev = nullptr;
+            b->head = b->tail = 0;
+            b->live = 0;
+            std::memset(b->live_mask, 0, sizeof(b->live_mask));
+            pool_.release(b);
+            if (blocks_ > 0) {
+                --blocks_;
+            }
+        }
+
         // map the offset slot to the bitmap and set the bit as live (1)
         static void set_live(BlockT* b, uint16_t off) {
             // get the index in the bitmap ary and then set the respective bit
@@ -143,6 +320,20 @@ namespace jolt::ob {
             ++b->live;
         }
 
+        // sets the bits of [from, from + n) a word at a time
+        static void set_live_range(BlockT* b, uint16_t from, uint16_t n) {
+            std::size_t off = from;
+            const std::size_t end = static_cast<std::size_t>(from) + n;
+            while (off < end) {
+                const std::size_t bit = off % 64;
+                const std::size_t span = (64 - bit < end - off) ? 64 - bit : end - off;
+                const uint64_t bits = span == 64 ? ~0ull : ((1ull << span) - 1) << bit;
+                b->live_mask[off / 64] |= bits;
+                off += span;
+            }
+            b->live = static_cast<uint16_t>(b->live + n);
+        }
+
         // map offset to bitmap and clear bit
         static void clear_live(BlockT* b, uint16_t off) {
             const uint64_t bit = (1ull << (off % 64));
@@ -158,14 +349,31 @@ namespace jolt::ob {
             return (b->live_mask[off / 64] >> (off % 64)) & 1ull;
         }
 
+        // first live offset at or after from, K if there is none. scans the mask a word at a time
+        static uint16_t next_live(const BlockT* b, uint16_t from) {
+            std::size_t w = from / 64;
+            uint64_t bits = b->live_mask[w] & (~0ull << (from % 64));
+            while (true) {
+                if (bits) {
+                    return static_cast<uint16_t>(w * 64 + __builtin_ctzll(bits));
+                }
+                if (++w == K / 64) {
+                    return K;
+                }
+                bits = b->live_mask[w];
+            }
+        }
+
         // advance head of the first block til we find a live order
         void skip_dead_slots() {
             while (head_) {
-                while (head_->head < head_->tail && !is_live(head_, head_->head)) {
-                    ++head_->head;
-                }
-                if (head_->head < head_->tail && is_live(head_, head_->head)) {
-                    return;
+                if (head_->head < head_->tail) {
+                    const uint16_t off = next_live(head_, head_->head);
+                    if (off < head_->tail) {
+                        head_->head = off;
+                        return;
+                    }
+                    head_->head = head_->tail;
                 }
                 drop_empty_head_block();
             }
@@ -181,14 +389,10 @@ namespace jolt::ob {
                 if (!head_) {
                     tail_ = nullptr;
                 }
-                old->next = nullptr;
-                old->head = old->tail = 0;
-                old->live = 0;
-                std::memset(old->live_mask, 0, sizeof(old->live_mask));
-                pool_.release(old);
-                if (blocks_ > 0) {
-                    --blocks_;
+                else {
+                    head_->prev = nullptr;
                 }
+                release_block(old);
             }
         }
 
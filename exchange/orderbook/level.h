@@ -1,10 +1,17 @@
 #pragma once
 
 #include <cstdint>
+#include <type_traits>
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
 #include "ob_types.h"
 #include "fifo.h"
 
 namespace jolt::ob {
+    // how active order slots are laid out inside a block: one struct per slot, or one array per field
+    enum class SlotLayout : uint8_t { Aos = 0, Soa = 1 };
+
     struct OrderSlot {
         OrderId id{0};
         UserId owner{0};
@@ -37,9 +44,91 @@ namespace jolt::ob {
         OrderId parent_id{0};
     };
 
-    template <std::size_t BLOCK_K>
+    // order slots stored as one array per field. the match loop only reads remaining and id, so those
+    // sit first and a head advance stays within their cache lines
+    template <std::size_t K>
+    struct alignas(64) SoaOrderBlock {
+        static_assert(K > 0 && (K % 64 == 0), "K must be a multiple of 64 for bitmasks");
+        // hot
+        Qty remaining[K]{};
+        OrderId id[K]{};
+        // cold
+        UserId owner[K]{};
+        uint64_t ts[K]{};
+        Qty og_qty[K]{};
+        PriceTick px[K]{};
+
+        uint64_t live_mask[K / 64]{};
+        uint16_t head{0};
+        uint16_t tail{0};
+        uint16_t live{0};
+        // position in the owning BlockPool, see BlockPool::at
+        uint32_t pool_idx{0};
+        SoaOrderBlock* next{nullptr};
+        SoaOrderBlock* prev{nullptr};
+        SoaOrderBlock* pool_next{nullptr};
+
+        void store(uint16_t off, const OrderSlot& s) {
+            remaining[off] = s.remaining;
+            id[off] = s.id;
+            owner[off] = s.owner;
+            ts[off] = s.ts;
+            og_qty[off] = s.og_qty;
+            px[off] = s.px;
+        }
+
+        OrderSlot load(uint16_t off) const {
+            return OrderSlot{id[off], owner[off], og_qty[off], remaining[off], ts[off], px[off]};
+        }
+
+        void copy_slot(uint16_t dst, const SoaOrderBlock& src, uint16_t off) {
+            remaining[dst] = src.remaining[off];
+            id[dst] = src.id[off];
+            owner[dst] = src.owner[off];
+            ts[dst] = src.ts[off];
+            og_qty[dst] = src.og_qty[off];
+            px[dst] = src.px[off];
+        }
+
+        // sum of remaining over live slots
+        uint64_t live_qty() const {
+#if defined(__AVX2__)
+            // expand 8 mask bits to 8 lanes and add the selected remaining values
+            const __m256i sel = _mm256_setr_epi32(1, 2, 4, 8, 16, 32, 64, 128);
+            __m256i acc = _mm256_setzero_si256();
+            for (std::size_t i = 0; i < K; i += 8) {
+                const auto bits = static_cast<int>((live_mask[i / 64] >> (i % 64)) & 0xFFu);
+                if (bits == 0) {
+                    continue;
+                }
+                const __m256i m = _mm256_cmpeq_epi32(_mm256_and_si256(_mm256_set1_epi32(bits), sel), sel);
+                const __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(&remaining[i]));
+                const __m256i q = _mm256_and_si256(v, m);
+                // widen to 64 bit lanes so a deep level cannot wrap
+                acc = _mm256_add_epi64(acc, _mm256_cvtepu32_epi64(_mm256_castsi256_si128(q)));
+                acc = _mm256_add_epi64(acc, _mm256_cvtepu32_epi64(_mm256_extracti128_si256(q, 1)));
+            }
+            alignas(32) uint64_t lanes[4];
+            _mm256_store_si256(reinterpret_cast<__m256i*>(lanes), acc);
+            return lanes[0] + lanes[1] + lanes[2] + lanes[3];
+#else
+            uint64_t total = 0;
+            for (std::size_t w = 0; w < K / 64; ++w) {
+                uint64_t bits = live_mask[w];
+                while (bits) {
+                    total += remaining[w * 64 + __builtin_ctzll(bits)];
+                    bits &= bits - 1;
+                }
+            }
+            return total;
+#endif
+        }
+    };
+
+    template <std::size_t BLOCK_K, SlotLayout LAYOUT = SlotLayout::Aos>
     struct Level {
-        using OrderBlock = Block<OrderSlot, BLOCK_K>;
+        using OrderBlock = std::conditional_t<LAYOUT == SlotLayout::Aos, Block<OrderSlot, BLOCK_K>,
+                                              SoaOrderBlock<BLOCK_K>>;
         using StopBlock = Block<StopSlot, BLOCK_K>;
         using TpBlock = Block<TpSlot, BLOCK_K>;
 
@@ -47,7 +136,7 @@ namespace jolt::ob {
             : order_fifo(ap), stop_fifo(sp), tp_fifo(tp) {
         }
 
-        Fifo<OrderSlot, BLOCK_K> order_fifo;
+        Fifo<OrderSlot, BLOCK_K, OrderBlock> order_fifo;
         Fifo<StopSlot, BLOCK_K> stop_fifo;
         Fifo<TpSlot, BLOCK_K> tp_fifo;
 
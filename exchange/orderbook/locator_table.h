@@ -0,0 +1,175 @@
+#pragma once
+
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <utility>
+#include <vector>
+#include "ob_types.h"
+#include "robin_map.h"
+
+namespace jolt::ob {
+    // order id -> ValueT. gateway ids are handed out in increasing order, so the live orders of a book
+    // sit in a recent id window: those are direct indexed by the low id bits, a slot holding the rest of
+    // the id (its generation) to tell a hit from a stale or foreign entry. an order still resting when a
+    // newer id claims its slot, and any id that is out of order or too large for a 32 bit generation,
+    // goes to a tombstone free robin hood map
+    template <typename ValueT>
+    class LocatorTable {
+        struct Slot {
+            uint32_t gen{kEmptyGen};
+            ValueT val{};
+        };
+
+        // mixes the low bits, ids that collided in the window share them
+        struct IdHash {
+            std::size_t operator()(OrderId id) const noexcept {
+                id ^= id >> 33;
+                id *= 0xff51afd7ed558ccdull;
+                id ^= id >> 33;
+                return static_cast<std::size_t>(id);
+            }
+        };
+
+        static constexpr uint32_t kEmptyGen = std::numeric_limits<uint32_t>::max();
+
+        std::vector<Slot> window_{};
+        uint64_t mask_{0};
+        unsigned shift_{0};
+        std::size_t direct_{0};
+        RobinMap<OrderId, ValueT, IdHash> overflow_;
+
+    public:
+        explicit LocatorTable(std::size_t window = 1 << 18, std::size_t overflow_capacity = 1 << 10)
+            : window_(round_up_pow2(window)), mask_(window_.size() - 1),
+              shift_(static_cast<unsigned>(__builtin_ctzll(window_.size()))), overflow_(overflow_capacity) {
+        }
+
+        std::size_t size() const noexcept { return direct_ + overflow_.size(); }
+        // orders that fell out of the window
+        std::size_t overflow_size() const noexcept { return overflow_.size(); }
+        std::size_t bytes() const noexcept { return window_.size() * sizeof(Slot) + overflow_.bytes(); }
+
+        // sizes the overflow map for n orders beyond the window, ahead of a bulk insert
+        void reserve(std::size_t n) {
+            if (n > window_.size()) {
+                overflow_.reserve(n - window_.size() + overflow_.size());
+            }
+        }
+
+        // fills an empty table with n distinct ids at once. the window grows to n slots first, so a book
+        // that rests more orders than it covers keeps them direct indexed instead of in the overflow map,
+        // which is also the larger of the two per order. each window slot goes to the newest id that maps
+        // to it and the rest straight to the overflow map, sized up front, so a large load does not evict
+        // and rehash its way in the way n inserts would
+        void build(const std::pair<OrderId, ValueT>* entries, std::size_t n) {
+            assert(size() == 0 && "build needs an empty table");
+            if (n > window_.size()) {
+                window_.assign(round_up_pow2(n), Slot{});
+                mask_ = window_.size() - 1;
+                shift_ = static_cast<unsigned>(__builtin_ctzll(window_.size()));
+            }
+            // ids come in price order, so the slots they hit are random. the ones a few entries ahead are
+            // pulled in while the current one is placed
+            constexpr std::size_t kAhead = 16;
+            std::size_t claimed = 0;
+            for (std::size_t i = 0; i < n; ++i) {
+                if (i + kAhead < n) {
+                    prefetch(entries[i + kAhead].first);
+                }
+                const uint64_t gen = entries[i].first >> shift_;
+                if (gen >= kEmptyGen) {
+                    continue;
+                }
+                Slot& s = window_[entries[i].first & mask_];
+                if (s.gen == kEmptyGen) {
+                    ++claimed;
+                    s.gen = static_cast<uint32_t>(gen);
+                }
+                else if (s.gen < gen) {
+                    s.gen = static_cast<uint32_t>(gen);
+                }
+            }
+            overflow_.reserve(n - claimed);
+            for (std::size_t i = 0; i < n; ++i) {
+                if (i + kAhead < n) {
+                    prefetch(entries[i + kAhead].first);
+                }
+                const auto& [id, value] = entries[i];
+                const uint64_t gen = id >> shift_;
+                Slot& s = window_[id & mask_];
+                if (gen < kEmptyGen && s.gen == gen) {
+                    s.val = value;
+                    ++direct_;
+                }
+                else {
+                    overflow_.insert(id, value);
+                }
+            }
+        }
+
+        void insert(OrderId id, const ValueT& value) {
+            const uint64_t gen = id >> shift_;
+            if (gen >= kEmptyGen) {
+                overflow_.insert(id, value);
+                return;
+            }
+            if (!overflow_.empty()) {
+                overflow_.erase(id);
+            }
+            Slot& s = window_[id & mask_];
+            if (s.gen != gen) {
+                if (s.gen != kEmptyGen) {
+                    if (s.gen > gen) {
+                        // slot already taken by a newer id
+                        overflow_.insert(id, value);
+                        return;
+                    }
+                    overflow_.insert((static_cast<uint64_t>(s.gen) << shift_) | (id & mask_), s.val);
+                    --direct_;
+                }
+                s.gen = static_cast<uint32_t>(gen);
+                ++direct_;
+            }
+            s.val = value;
+        }
+
+        // pulls in the window slot id maps to, ahead of a find
+        void prefetch(OrderId id) const noexcept { __builtin_prefetch(&window_[id & mask_]); }
+
+        // window only lookup, misses orders that overflowed. for hints that must not probe the map
+        const ValueT* find_direct(OrderId id) const noexcept {
+            const Slot& s = window_[id & mask_];
+            return s.gen == (id >> shift_) ? &s.val : nullptr;
+        }
+
+        ValueT* find(OrderId id) noexcept {
+            const uint64_t gen = id >> shift_;
+            if (gen < kEmptyGen) {
+                Slot& s = window_[id & mask_];
+                if (s.gen == gen) {
+                    return &s.val;
+                }
+            }
+            return overflow_.empty() ? nullptr : overflow_.find(id);
+        }
+
+        const ValueT* find(OrderId id) const noexcept {
+            return const_cast<LocatorTable*>(this)->find(id);
+        }
+
+        std::size_t erase(OrderId id) noexcept {
+            const uint64_t gen = id >> shift_;
+            if (gen < kEmptyGen) {
+                Slot& s = window_[id & mask_];
+                if (s.gen == gen) {
+                    s.gen = kEmptyGen;
+                    --direct_;
+                    return 1;
+                }
+            }
+            return overflow_.empty() ? 0 : overflow_.erase(id);
+        }
+    };
+} // namespace jolt::ob
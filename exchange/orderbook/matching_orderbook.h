@@ -4,17 +4,25 @@
 #include <unordered_map>
 #include <functional>
 #include <optional>
+#include <span>
 #include <limits>
 #include <cassert>
 #include <chrono>
 #include <queue>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
 
 #include "ob_types.h"
 #include "block_pool.h"
 #include "level.h"
 #include "level_pool.h"
 #include "flat_map.h"
-#include "ob_types.h"
+#include "locator_table.h"
+#include "bitset_index.h"
+#include "price_ladder.h"
+#include "depth_cache.h"
+#include "book_image.h"
 
 namespace jolt::ob {
 
@@ -25,18 +33,19 @@ namespace jolt::ob {
         Side side;
     };
 
-    template <std::size_t BLOCK_K = 128>
+    template <std::size_t BLOCK_K = 128, LadderKind LADDER = LadderKind::Dense, SlotLayout LAYOUT = SlotLayout::Aos>
     class MatchingOrderBook {
     public:
-        using ActiveBlock = Block<OrderSlot, BLOCK_K>;
+        using LevelT = Level<BLOCK_K, LAYOUT>;
+        using ActiveBlock = typename LevelT::OrderBlock;
         using StopBlock = Block<StopSlot, BLOCK_K>;
         using TpBlock = Block<TpSlot, BLOCK_K>;
-        using LevelT = Level<BLOCK_K>;
+        using LadderT = std::conditional_t<LADDER == LadderKind::Dense, DenseLadder<LevelT>, PagedLadder<LevelT>>;
 
-        // represents order location
+        // represents order location. blk is the pool_idx of the block in the pool for its kind, the level
+        // is looked up again from side and price (the trigger for stops and take-profits)
         struct Locator {
-            LevelT* level{nullptr};
-            void* blk{nullptr};
+            uint32_t blk{0};
             uint16_t off{0};
 
             enum class Kind : uint8_t { Active = 0, Stop = 1, TakeProfit = 2 };
@@ -45,38 +54,102 @@ namespace jolt::ob {
             Side side{Side::Buy};
             PriceTick price{};
         };
+        static_assert(sizeof(Locator) == 12, "locator table slots assume a 12 byte locator");
 
         MatchingOrderBook(PriceTick min_tick, PriceTick max_tick)
             : min_tick_(min_tick), max_tick_(max_tick), range_(static_cast<std::size_t>(max_tick - min_tick + 1)),
-              bids_(range_, nullptr), asks_(range_, nullptr) {
-            locators_.reserve(1 << 20);
+              bids_(range_), asks_(range_), bid_bits_(range_), ask_bits_(range_), buy_stop_bits_(range_),
+              sell_stop_bits_(range_), buy_tp_bits_(range_), sell_tp_bits_(range_), bid_dirty_(range_),
+              ask_dirty_(range_) {
+            triggered_.reserve(1 << 10);
         }
 
         BookEvent submit_order(const OrderParams& p) {
             ++seq;
             match_result.reset();
-            switch (p.action) {
-            case OrderAction::New:
-                switch (p.type) {
-                case OrderType::Limit:
-                    return submit_limit(p);
-                case OrderType::Market:
-                    return submit_market(p);
-                case OrderType::StopMarket:
-                case OrderType::StopLimit:
-                    return submit_stop(p);
-                case OrderType::TakeProfit:
-                    return submit_take_profit(p);
+            const BookEvent ev = dispatch(p);
+            if (!triggered_.empty()) {
+                run_triggered();
+            }
+            release_idle_levels();
+            return ev;
+        }
+
+
+        // how many orders ahead submit_batch starts prefetching, the second stage runs at half the distance
+        static constexpr std::size_t kPrefetchAhead = 8;
+
+        // submits orders in sequence and hands each one's event to on_event(order, event), exactly as
+        // calling submit_order on them one by one would. while order i runs, the locator or ladder lines of
+        // order i + kPrefetchAhead and the block and level lines of order i + kPrefetchAhead / 2 are
+        // prefetched, so their cold misses overlap with matching instead of stalling it
+        template <typename Fn>
+        std::size_t submit_batch(std::span<const OrderParams> orders, Fn&& on_event) {
+            const std::size_t n = orders.size();
+            for (std::size_t i = 0; i < n && i < kPrefetchAhead; ++i) {
+                prefetch(orders[i]);
+            }
+            for (std::size_t i = 0; i < n && i < kPrefetchAhead / 2; ++i) {
+                prefetch_deep(orders[i]);
+            }
+            for (std::size_t i = 0; i < n; ++i) {
+                if (i + kPrefetchAhead < n) {
+                    prefetch(orders[i + kPrefetchAhead]);
+                }
+                if (i + kPrefetchAhead / 2 < n) {
+                    prefetch_deep(orders[i + kPrefetchAhead / 2]);
+                }
+                on_event(orders[i], submit_order(orders[i]));
+            }
+            return n;
+        }
+
+        // first prefetch stage for an order about to be submitted: the locator slot of a cancel/modify,
+        // the ladder slot at the price (or trigger) of a new order. only issues prefetches
+        void prefetch(const OrderParams& p) const {
+            if (p.action == OrderAction::Cancel || p.action == OrderAction::Modify) {
+                locators_.prefetch(p.id);
+                return;
+            }
+            if (p.action == OrderAction::New && p.type != OrderType::Market) {
+                const PriceTick px = p.type == OrderType::Limit ? p.price : p.trigger;
+                if (in_range(px)) {
+                    ladder_of(p.side).prefetch(side_index(p.side, px));
                 }
-                break;
-            case OrderAction::Modify:
-                return modify(p);
-            case OrderAction::Cancel:
-                return cancel(p);
             }
-            return make_reject(p.id, RejectReason::InvalidType, p.ts);
         }
 
+        // second stage, once the first stage lines are in: the block slot of a cancel/modify and the level
+        // of a new order. reads only what the first stage pulled in
+        void prefetch_deep(const OrderParams& p) const {
+            if (p.action == OrderAction::Cancel || p.action == OrderAction::Modify) {
+                const Locator* loc = locators_.find_direct(p.id);
+                if (!loc) {
+                    return;
+                }
+                ladder_of(loc->side).prefetch(side_index(loc->side, loc->price));
+                switch (loc->kind) {
+                case Locator::Kind::Stop:
+                    prefetch_slot(stop_block_of(*loc), loc->off);
+                    break;
+                case Locator::Kind::TakeProfit:
+                    prefetch_slot(tp_block_of(*loc), loc->off);
+                    break;
+                default:
+                    prefetch_slot(active_block_of(*loc), loc->off);
+                    break;
+                }
+                return;
+            }
+            if (p.action == OrderAction::New && p.type != OrderType::Market) {
+                const PriceTick px = p.type == OrderType::Limit ? p.price : p.trigger;
+                if (in_range(px)) {
+                    if (LevelT* lvl = ladder_of(p.side).get(side_index(p.side, px))) {
+                        __builtin_prefetch(lvl);
+                    }
+                }
+            }
+        }
 
         PriceTick best_bid() const {
             if (best_buy_idx_ == npos) {
@@ -92,6 +165,19 @@ namespace jolt::ob {
             return price_from_ask_index(best_ask_idx_);
         }
 
+        // levels per side kept in the depth cache
+        static constexpr std::size_t kDepthLevels = 10;
+
+        // best n (at most kDepthLevels) levels of a side, best first. read from the depth cache the book
+        // keeps up to date as orders rest, fill and cancel, so there is no ladder scan. the span is valid
+        // until the next order
+        std::span<const DepthLevel> book_top(Side side, std::size_t n = kDepthLevels) const {
+            return depth_.top(side, n);
+        }
+
+        // changes whenever book_top would return something different
+        uint64_t depth_version() const { return depth_.version(); }
+
         Qty level_active_qty(Side side, PriceTick px) const {
             LevelT* lvl = level_of(side, px, false);
             if (!lvl || !lvl->active_nonempty) {
@@ -100,6 +186,22 @@ namespace jolt::ob {
             return lvl->active_qty;
         }
 
+        // open qty at a level summed from its slots, level_active_qty is the running total of the same
+        uint64_t level_depth(Side side, PriceTick px) const {
+            LevelT* lvl = level_of(side, px, false);
+            if (!lvl) {
+                return 0;
+            }
+            if constexpr (LAYOUT == SlotLayout::Soa) {
+                return lvl->order_fifo.live_qty();
+            }
+            else {
+                uint64_t total = 0;
+                lvl->order_fifo.copy_live([&](const OrderSlot& slot) { total += slot.remaining; });
+                return total;
+            }
+        }
+
         std::size_t level_order_count(Side side, PriceTick px) const {
             LevelT* lvl = level_of(side, px, false);
             if (!lvl) {
@@ -113,10 +215,13 @@ namespace jolt::ob {
             if (!lvl) {
                 return 0;
             }
-            auto* head = const_cast<LevelT*>(lvl)->order_fifo.head_slot();
-            return head ? head->id : 0;
+            const auto head = const_cast<LevelT*>(lvl)->order_fifo.head_loc();
+            return head.blk ? slot_id(head.blk, head.off) : 0;
         }
 
+        // true while id rests in the book as a limit, stop or take-profit
+        bool contains(OrderId id) const { return locators_.find(id) != nullptr; }
+
         Qty order_qty(OrderId id) const {
             auto* lptr = locators_.find(id);
             if (!lptr) {
@@ -124,15 +229,15 @@ namespace jolt::ob {
             }
             const Locator loc = *lptr;
             if (loc.kind == Locator::Kind::Stop) {
-                auto* blk = reinterpret_cast<typename LevelT::StopBlock*>(loc.blk);
+                auto* blk = stop_block_of(loc);
                 return blk->slots[loc.off].qty;
             }
             if (loc.kind == Locator::Kind::TakeProfit) {
-                auto* blk = reinterpret_cast<typename LevelT::TpBlock*>(loc.blk);
+                auto* blk = tp_block_of(loc);
                 return blk->slots[loc.off].qty;
             }
-            auto* blk = reinterpret_cast<typename LevelT::OrderBlock*>(loc.blk);
-            return blk->slots[loc.off].remaining;
+            auto* blk = active_block_of(loc);
+            return slot_remaining(blk, loc.off);
         }
 
         PriceTick get_best_ask() {
@@ -148,6 +253,13 @@ namespace jolt::ob {
         std::size_t active_limit_buy_count() const { return active_limit_buys_; }
         std::size_t active_limit_sell_count() const { return active_limit_sells_; }
 
+        // with a sink set, fills go to it as they happen and match_result.fills stays empty
+        void set_fill_sink(FillSink sink) { fill_sink_ = sink; }
+        // with a sink set, every change to the resting limit orders is reported to it
+        void set_delta_sink(DeltaSink sink) { delta_sink_ = sink; }
+        // with a sink set, every order that rests and every stop or take-profit that fires is reported to it
+        void set_rest_sink(RestSink sink) { rest_sink_ = sink; }
+
         MatchResult match_result;
         uint64_t seq{0};
 
@@ -157,7 +269,9 @@ namespace jolt::ob {
             out.bid_ct = 0;
             out.ask_ct = 0;
 
-            for (auto l : bids_) {
+            // only visit occupied levels, best to worst
+            for (auto i = bid_bits_.next_set(0); i != npos; i = bid_bits_.next_set(i + 1)) {
+                LevelT* l = bids_.get(i);
                 if (l && l->active_nonempty) {
                     l->order_fifo.copy_live([&](const OrderSlot& slot) -> void {
                        out.orders.push_back(SnapshotOrder{slot.id, slot.remaining, slot.px, Side::Buy});
@@ -166,7 +280,8 @@ namespace jolt::ob {
                 }
             }
 
-            for (auto l : asks_) {
+            for (auto i = ask_bits_.next_set(0); i != npos; i = ask_bits_.next_set(i + 1)) {
+                LevelT* l = asks_.get(i);
                 if (l && l->active_nonempty) {
                     l->order_fifo.copy_live([&](const OrderSlot& slot) -> void {
                         out.orders.push_back(SnapshotOrder{slot.id, slot.remaining, slot.px, Side::Sell});
@@ -177,6 +292,279 @@ namespace jolt::ob {
             out.seq = seq;
         }
 
+        // captures everything resting (limit orders per level, stops and take-profits per trigger, all in
+        // fifo order) and the seq and trade prices into out. an image this book captured into last keeps the
+        // runs of levels nothing changed since and only copies the others again, any other image is filled
+        // from scratch. one pass over the occupied levels either way
+        void save_image(BookImage& out) const {
+            if (out.book != this || out.capture != image_captures_) {
+                out.clear();
+            }
+            const uint64_t epoch = ++image_captures_;
+            out.book = this;
+            out.capture = epoch;
+            out.header = ImageHeader{seq, min_tick_, max_tick_, last_trade_, prev_trade_};
+            out.copied_runs = 0;
+            out.orders.slots = 0;
+            out.stops.slots = 0;
+            out.tps.slots = 0;
+            image_runs_.swap(out.runs);
+            image_chunks_.swap(out.run_chunks);
+            out.runs.clear();
+            out.run_chunks.clear();
+
+            for (const Side side : {Side::Buy, Side::Sell}) {
+                const BitsetIndex& bits = side == Side::Buy ? bid_bits_ : ask_bits_;
+                for (auto i = bits.next_set(0); i != npos; i = bits.next_set(i + 1)) {
+                    const PriceTick px = side == Side::Buy ? price_from_bid_index(i) : price_from_ask_index(i);
+                    capture_run(out, out.orders, ImageRun::Kind::Active, side, px, ladder_of(side).get(i)->order_fifo,
+                                epoch);
+                }
+            }
+            for (const Side side : {Side::Buy, Side::Sell}) {
+                const BitsetIndex& bits = side == Side::Buy ? buy_stop_bits_ : sell_stop_bits_;
+                for (auto i = bits.next_set(0); i != npos; i = bits.next_set(i + 1)) {
+                    const auto px = static_cast<PriceTick>(min_tick_ + i);
+                    capture_run(out, out.stops, ImageRun::Kind::Stop, side, px, level_of(side, px, false)->stop_fifo,
+                                epoch);
+                }
+            }
+            for (const Side side : {Side::Buy, Side::Sell}) {
+                const BitsetIndex& bits = side == Side::Buy ? buy_tp_bits_ : sell_tp_bits_;
+                for (auto i = bits.next_set(0); i != npos; i = bits.next_set(i + 1)) {
+                    const auto px = static_cast<PriceTick>(min_tick_ + i);
+                    capture_run(out, out.tps, ImageRun::Kind::TakeProfit, side, px, level_of(side, px, false)->tp_fifo,
+                                epoch);
+                }
+            }
+
+            // chunks of runs that are gone go back to their store
+            for (std::size_t r = 0; r < image_runs_.size(); ++r) {
+                const ImageRun& run = image_runs_[r];
+                const uint32_t c = image_chunks_[r];
+                const auto drop = [&](auto& store) {
+                    if (store.kept[c] != epoch) {
+                        store.release(c);
+                        out.chunk_of.erase(BookImage::run_key(run.kind, run.side, run.px));
+                    }
+                };
+                switch (run.kind) {
+                case ImageRun::Kind::Active:
+                    drop(out.orders);
+                    break;
+                case ImageRun::Kind::Stop:
+                    drop(out.stops);
+                    break;
+                case ImageRun::Kind::TakeProfit:
+                    drop(out.tps);
+                    break;
+                }
+            }
+            for (BitsetIndex* dirty : {&bid_dirty_, &ask_dirty_}) {
+                for (auto i = dirty->next_set(0); i != npos; i = dirty->next_set(i + 1)) {
+                    dirty->clear(i);
+                }
+            }
+        }
+
+        // rebuilds an empty book from an image taken by save_image on a book with the same tick range.
+        // slots are written straight into fresh blocks a block at a time and every index (locators, owner
+        // lists, level bitsets, trigger bitsets, depth cache) is set from them directly, nothing is matched
+        // and no sink is called. the book then matches exactly like the one the image was taken from, only
+        // cancel_all may report the same cancels in another order since owner lists are rebuilt in book order
+        void load_image(const BookImageView& img) {
+            if (locators_.size() != 0) {
+                throw std::runtime_error("book image can only be loaded into an empty book");
+            }
+            if (img.header.min_tick != min_tick_ || img.header.max_tick != max_tick_) {
+                throw std::runtime_error("book image tick range does not match the book");
+            }
+            std::vector<std::pair<OrderId, Locator>> loaded;
+            loaded.reserve(img.orders.size() + img.stops.size() + img.tps.size());
+            std::size_t next_order = 0;
+            std::size_t next_stop = 0;
+            std::size_t next_tp = 0;
+            for (const ImageRun& run : img.runs) {
+                if (run.px < min_tick_ || run.px > max_tick_) {
+                    throw std::runtime_error("book image price out of range");
+                }
+                if (run.count == 0) {
+                    continue;
+                }
+                const Side side = run.side;
+                const PriceTick px = run.px;
+                LevelT* lvl = level_of(side, px, true);
+                switch (run.kind) {
+                case ImageRun::Kind::Active: {
+                    if (img.orders.size() - next_order < run.count) {
+                        throw std::runtime_error("book image truncated");
+                    }
+                    Qty qty = 0;
+                    lvl->order_fifo.append_bulk(img.orders.data() + next_order, run.count,
+                                                [&](const OrderSlot& s, const auto& loc) {
+                                                    track_loaded(loaded, s.id, s.owner, loc.blk, loc.off,
+                                                                 Locator::Kind::Active, side, px);
+                                                    qty += s.remaining;
+                                                });
+                    next_order += run.count;
+                    lvl->active_qty += qty;
+                    lvl->active_nonempty = true;
+                    on_level_set(side, side_index(side, px));
+                    touch_depth(side, px, lvl);
+                    active_limit_orders_ += run.count;
+                    (side == Side::Buy ? active_limit_buys_ : active_limit_sells_) += run.count;
+                    break;
+                }
+                case ImageRun::Kind::Stop:
+                    if (img.stops.size() - next_stop < run.count) {
+                        throw std::runtime_error("book image truncated");
+                    }
+                    lvl->stop_fifo.append_bulk(img.stops.data() + next_stop, run.count,
+                                               [&](const StopSlot& s, const auto& loc) {
+                                                   track_loaded(loaded, s.id, s.owner, loc.blk, loc.off,
+                                                                Locator::Kind::Stop, side, px);
+                                               });
+                    next_stop += run.count;
+                    mark_stops(lvl, side, px, true);
+                    active_stop_orders_ += run.count;
+                    break;
+                case ImageRun::Kind::TakeProfit:
+                    if (img.tps.size() - next_tp < run.count) {
+                        throw std::runtime_error("book image truncated");
+                    }
+                    lvl->tp_fifo.append_bulk(img.tps.data() + next_tp, run.count,
+                                             [&](const TpSlot& s, const auto& loc) {
+                                                 track_loaded(loaded, s.id, s.owner, loc.blk, loc.off,
+                                                              Locator::Kind::TakeProfit, side, px);
+                                             });
+                    next_tp += run.count;
+                    mark_tps(lvl, side, px, true);
+                    break;
+                default:
+                    throw std::runtime_error("book image has an unknown run kind");
+                }
+            }
+            if (next_order != img.orders.size() || next_stop != img.stops.size() || next_tp != img.tps.size()) {
+                throw std::runtime_error("book image runs do not cover its slots");
+            }
+            locators_.build(loaded.data(), loaded.size());
+            // owner lists were filled without pruning, every entry is live
+            for (auto& oo : owner_orders_) {
+                oo.prune_at = oo.entries.size() * 2 > 64 ? oo.entries.size() * 2 : 64;
+            }
+            seq = img.header.seq;
+            last_trade_ = img.header.last_trade;
+            prev_trade_ = img.header.prev_trade;
+            // no image holds what was just loaded
+            ++image_captures_;
+        }
+
+        // bytes held by the order id -> locator table
+        std::size_t locator_bytes() const { return locators_.bytes(); }
+
+        // bytes held by the bid + ask price ladders (excludes levels and order blocks)
+        std::size_t ladder_bytes() const { return bids_.bytes() + asks_.bytes(); }
+        // pages the ladders hold, 0 for dense ones
+        std::size_t ladder_pages() const {
+            if constexpr (LadderT::kReleasesLevels) {
+                return bids_.pages() + asks_.pages();
+            }
+            else {
+                return 0;
+            }
+        }
+
+        // bytes of order/stop/take-profit blocks currently linked into levels
+        std::size_t block_bytes() const {
+            return active_pool_.in_use() * sizeof(ActiveBlock) + stop_pool_.in_use() * sizeof(StopBlock) +
+                tp_pool_.in_use() * sizeof(TpBlock);
+        }
+
+        // compaction of sparse fifo blocks on cancel, on by default
+        void set_compaction(bool on) { compaction_ = on; }
+
+        // true when every resting slot's locator points back at that slot and no locator is left over,
+        // a check for tests after compaction moved slots. walks the whole book
+        bool locators_consistent() const {
+            std::size_t slots = 0;
+            bool ok = true;
+            const auto check = [&](OrderId id, typename Locator::Kind kind, Side side, PriceTick px, uint32_t blk,
+                                   uint16_t off) {
+                ++slots;
+                const Locator* l = locators_.find(id);
+                ok = ok && l && l->kind == kind && l->side == side && l->price == px && l->blk == blk &&
+                    l->off == off;
+            };
+            for (const Side side : {Side::Buy, Side::Sell}) {
+                const BitsetIndex& bits = side == Side::Buy ? bid_bits_ : ask_bits_;
+                for (auto i = bits.next_set(0); i != npos; i = bits.next_set(i + 1)) {
+                    const PriceTick px = side == Side::Buy ? price_from_bid_index(i) : price_from_ask_index(i);
+                    ladder_of(side).get(i)->order_fifo.for_each_live([&](const OrderSlot& s, auto loc) {
+                        check(s.id, Locator::Kind::Active, side, px, loc.blk->pool_idx, loc.off);
+                    });
+                }
+                const BitsetIndex& stops = side == Side::Buy ? buy_stop_bits_ : sell_stop_bits_;
+                for (auto i = stops.next_set(0); i != npos; i = stops.next_set(i + 1)) {
+                    const auto px = static_cast<PriceTick>(min_tick_ + i);
+                    level_of(side, px, false)->stop_fifo.for_each_live([&](const StopSlot& s, auto loc) {
+                        check(s.id, Locator::Kind::Stop, side, px, loc.blk->pool_idx, loc.off);
+                    });
+                }
+                const BitsetIndex& tps = side == Side::Buy ? buy_tp_bits_ : sell_tp_bits_;
+                for (auto i = tps.next_set(0); i != npos; i = tps.next_set(i + 1)) {
+                    const auto px = static_cast<PriceTick>(min_tick_ + i);
+                    level_of(side, px, false)->tp_fifo.for_each_live([&](const TpSlot& s, auto loc) {
+                        check(s.id, Locator::Kind::TakeProfit, side, px, loc.blk->pool_idx, loc.off);
+                    });
+                }
+            }
+            return ok && slots == locators_.size();
+        }
+
+        // cancels every resting order (limit, stop and take-profit) of owner, only those on side when
+        // one_side is set, in a single pass over the owner's index. on_cancel gets a Cancel BookEvent per order
+        template <typename Fn>
+        std::size_t cancel_all(UserId owner, bool one_side, Side side, uint64_t ts, Fn&& on_cancel) {
+            auto* slot = owner_index_.find(owner);
+            if (!slot) {
+                return 0;
+            }
+            auto& entries = owner_orders_[*slot].entries;
+            std::size_t kept = 0;
+            std::size_t cancelled = 0;
+            // by index, a cancel can compact a block and append fresh entries for the slots it moved
+            for (std::size_t i = 0; i < entries.size(); ++i) {
+                const OwnerEntry oe = entries[i];
+                if (!owner_entry_live(oe)) {
+                    continue;
+                }
+                auto* lptr = locators_.find(oe.id);
+                if (!lptr) {
+                    continue;
+                }
+                const Locator loc = *lptr;
+                if (one_side && loc.side != side) {
+                    entries[kept++] = oe;
+                    continue;
+                }
+
+                BookEvent e{};
+                e.event_type = BookEventType::Cancel;
+                e.id = oe.id;
+                e.owner = owner;
+                e.side = loc.side;
+                e.price = loc.price;
+                e.qty = open_qty_of(loc);
+                e.ts = ts;
+                remove_located(oe.id, loc);
+                on_cancel(e);
+                ++cancelled;
+            }
+            entries.resize(kept);
+            release_idle_levels();
+            return cancelled;
+        }
+
     private:
 
         uint16_t symbol_id_{0};
@@ -184,17 +572,62 @@ namespace jolt::ob {
         PriceTick max_tick_{};
         std::size_t range_{};
 
-        mutable std::vector<LevelT*> bids_{};
-        mutable std::vector<LevelT*> asks_{};
+        mutable LadderT bids_;
+        mutable LadderT asks_;
+
+        // occupancy of levels with live resting orders, indexed like bids_/asks_
+        BitsetIndex bid_bits_{};
+        BitsetIndex ask_bits_{};
 
         mutable BlockPool<ActiveBlock> active_pool_{};
         mutable BlockPool<StopBlock> stop_pool_{};
         mutable BlockPool<TpBlock> tp_pool_{};
         mutable LevelPool<LevelT> level_pool_{};
 
-        FlatMap<OrderId, Locator> locators_{1 << 20};
-        FlatMap<OrderId, Locator> stop_locators_{1 << 20};
-        FlatMap<OrderId, Locator> tp_locators_{1 << 20};
+        LocatorTable<Locator> locators_{};
+        DepthCache<kDepthLevels> depth_{};
+
+        // trigger prices holding resting stops / take-profits per side, indexed by trigger_index. a price
+        // move only visits set bits between the old and new last trade
+        BitsetIndex buy_stop_bits_{};
+        BitsetIndex sell_stop_bits_{};
+        BitsetIndex buy_tp_bits_{};
+        BitsetIndex sell_tp_bits_{};
+        // orders triggered by trades of the current submit, run after it in trigger order
+        std::vector<OrderParams> triggered_{};
+        // levels that lost their last order of a kind during the current call, see release_idle_levels
+        std::vector<std::pair<Side, std::size_t>> idle_levels_{};
+        // levels changed since the last save_image, indexed like bids_/asks_. their runs are copied again
+        mutable BitsetIndex bid_dirty_{};
+        mutable BitsetIndex ask_dirty_{};
+        // save_image calls so far, an image taken before the last one cannot be brought up to date
+        mutable uint64_t image_captures_{0};
+        // runs of the image being captured into as of its previous capture
+        mutable std::vector<ImageRun> image_runs_{};
+        mutable std::vector<uint32_t> image_chunks_{};
+
+        // owner -> slots of its resting orders, for cancel_all. an entry goes stale once its slot is
+        // tombstoned or reused, a requeued order gets a fresh entry
+        struct OwnerEntry {
+            void* blk{nullptr};
+            OrderId id{0};
+            uint16_t off{0};
+            typename Locator::Kind kind{Locator::Kind::Active};
+        };
+        struct OwnerOrders {
+            std::vector<OwnerEntry> entries{};
+            std::size_t prune_at{64};
+        };
+        static constexpr uint32_t kNoOwnerSlot = std::numeric_limits<uint32_t>::max();
+        FlatMap<UserId, uint32_t> owner_index_{1 << 10};
+        std::vector<OwnerOrders> owner_orders_{};
+        UserId last_owner_{0};
+        uint32_t last_owner_slot_{kNoOwnerSlot};
+
+        bool compaction_{true};
+        FillSink fill_sink_{};
+        DeltaSink delta_sink_{};
+        RestSink rest_sink_{};
 
         PriceTick last_trade_{0};
         PriceTick prev_trade_{0};
@@ -208,47 +641,361 @@ namespace jolt::ob {
         std::size_t active_limit_sells_{0};
 
 
+        BookEvent dispatch(const OrderParams& p) {
+            switch (p.action) {
+            case OrderAction::New:
+                // the locator table keeps one entry per id, a second live order would take over the first's
+                if (contains(p.id) || (p.sl_id != 0 && contains(p.sl_id)) || (p.tp_id != 0 && contains(p.tp_id))) {
+                    return make_reject(p.id, RejectReason::DuplicateId, p.ts);
+                }
+                switch (p.type) {
+                case OrderType::Limit:
+                    return submit_limit(p);
+                case OrderType::Market:
+                    return submit_market(p);
+                case OrderType::StopMarket:
+                case OrderType::StopLimit:
+                    return submit_stop(p);
+                case OrderType::TakeProfit:
+                    return submit_take_profit(p);
+                }
+                break;
+            case OrderAction::Modify:
+                return modify(p);
+            case OrderAction::Cancel:
+                return cancel(p);
+            case OrderAction::MassCancel:
+                // bulk, goes through cancel_all
+                break;
+            }
+            return make_reject(p.id, RejectReason::InvalidType, p.ts);
+        }
+
+        // unlinks a located resting order from its level and drops its locator
+        void remove_located(OrderId id, const Locator& loc) {
+            LevelT* lvl = level_at(loc);
+            // if stop order, get the block that holds the stop, tombstone the slot
+            if (loc.kind == Locator::Kind::Stop) {
+                auto* blk = stop_block_of(loc);
+                retire(lvl->stop_fifo, blk, loc.off);
+                mark_dirty(loc.side, loc.price);
+
+                if (lvl->stop_fifo.live_count() == 0) {
+                    mark_stops(lvl, loc.side, loc.price, false);
+                }
+                if (active_stop_orders_ > 0) {
+                    --active_stop_orders_;
+                }
+            }
+            else if (loc.kind == Locator::Kind::TakeProfit) {
+                auto* blk = tp_block_of(loc);
+                retire(lvl->tp_fifo, blk, loc.off);
+                mark_dirty(loc.side, loc.price);
+                if (lvl->tp_fifo.live_count() == 0) {
+                    mark_tps(lvl, loc.side, loc.price, false);
+                }
+            }
+            else {
+                auto* blk = active_block_of(loc);
+                // get quantity of order to be canceled, and subtract from level
+                Qty q = slot_remaining(blk, loc.off);
+                if (lvl->active_qty >= q) {
+                    lvl->active_qty -= q;
+                }
+                else {
+                    lvl->active_qty = 0;
+                }
+                // tombstone the slot, and if last order at level, update best idx
+                retire(lvl->order_fifo, blk, loc.off);
+                emit_delta(DeltaType::Remove, id, loc.side, loc.price, 0);
+                if (lvl->order_fifo.live_count() == 0) {
+                    lvl->active_nonempty = false;
+                    lvl->active_qty = 0;
+                    auto idx = side_index(loc.side, loc.price);
+                    on_level_clear(loc.side, idx);
+                }
+                else {
+                    touch_depth(loc.side, loc.price, lvl);
+                }
+                if (active_limit_orders_ > 0) {
+                    --active_limit_orders_;
+                }
+                if (loc.side == Side::Buy) {
+                    if (active_limit_buys_ > 0) {
+                        --active_limit_buys_;
+                    }
+                }
+                else {
+                    if (active_limit_sells_ > 0) {
+                        --active_limit_sells_;
+                    }
+                }
+            }
+
+            locators_.erase(id);
+        }
+
+        // open qty of a located order, read from its slot
+        Qty open_qty_of(const Locator& loc) const {
+            switch (loc.kind) {
+            case Locator::Kind::Stop:
+                return stop_block_of(loc)->slots[loc.off].qty;
+            case Locator::Kind::TakeProfit:
+                return tp_block_of(loc)->slots[loc.off].qty;
+            default:
+                return slot_remaining(active_block_of(loc), loc.off);
+            }
+        }
+
+        // true while the order an owner entry points at still sits in that slot
+        bool owner_entry_live(const OwnerEntry& e) const {
+            switch (e.kind) {
+            case Locator::Kind::Stop:
+                return slot_live(static_cast<const typename LevelT::StopBlock*>(e.blk), e.off, e.id);
+            case Locator::Kind::TakeProfit:
+                return slot_live(static_cast<const typename LevelT::TpBlock*>(e.blk), e.off, e.id);
+            default:
+                return slot_live(static_cast<const typename LevelT::OrderBlock*>(e.blk), e.off, e.id);
+            }
+        }
+
+        template <typename BlockT>
+        static bool slot_live(const BlockT* blk, uint16_t off, OrderId id) {
+            if (!((blk->live_mask[off / 64] >> (off % 64)) & 1ull)) {
+                return false;
+            }
+            if constexpr (std::is_same_v<BlockT, ActiveBlock>) {
+                return slot_id(blk, off) == id;
+            }
+            else {
+                return blk->slots[off].id == id;
+            }
+        }
+
+        // active slot fields, wherever the layout keeps them
+        static Qty& slot_remaining(ActiveBlock* blk, uint16_t off) {
+            if constexpr (LAYOUT == SlotLayout::Soa) {
+                return blk->remaining[off];
+            }
+            else {
+                return blk->slots[off].remaining;
+            }
+        }
+
+        static OrderId slot_id(const ActiveBlock* blk, uint16_t off) {
+            if constexpr (LAYOUT == SlotLayout::Soa) {
+                return blk->id[off];
+            }
+            else {
+                return blk->slots[off].id;
+            }
+        }
+
+        static UserId slot_owner(const ActiveBlock* blk, uint16_t off) {
+            if constexpr (LAYOUT == SlotLayout::Soa) {
+                return blk->owner[off];
+            }
+            else {
+                return blk->slots[off].owner;
+            }
+        }
+
+        // tombstones a slot and lets the fifo compact the block, repointing locators of moved slots
+        template <typename SlotT, typename BlockT>
+        void retire(Fifo<SlotT, BLOCK_K, BlockT>& fifo, BlockT* blk, uint16_t off) {
+            if (!compaction_) {
+                fifo.tombstone({blk, off});
+                return;
+            }
+            fifo.tombstone({blk, off}, [this](const SlotT& s, const typename Fifo<SlotT, BLOCK_K, BlockT>::Loc& to) {
+                relocated(s.id, s.owner, to.blk, to.off);
+            });
+        }
+
+        // a resting order moved to a new slot during compaction
+        template <typename BlockT>
+        void relocated(OrderId id, UserId owner, BlockT* blk, uint16_t off) {
+            auto* lptr = locators_.find(id);
+            if (!lptr) {
+                return;
+            }
+            lptr->blk = blk->pool_idx;
+            lptr->off = off;
+            // the old owner entry fails its id check from now on, no prune here since cancel_all may be
+            // walking this list
+            owner_orders_[owner_slot(owner)].entries.push_back(OwnerEntry{blk, id, off, lptr->kind});
+        }
+
+        uint32_t owner_slot(UserId owner) {
+            if (owner != last_owner_ || last_owner_slot_ == kNoOwnerSlot) {
+                if (auto* slot = owner_index_.find(owner)) {
+                    last_owner_slot_ = *slot;
+                }
+                else {
+                    last_owner_slot_ = static_cast<uint32_t>(owner_orders_.size());
+                    owner_orders_.emplace_back();
+                    owner_index_.insert(owner, last_owner_slot_);
+                }
+                last_owner_ = owner;
+            }
+            return last_owner_slot_;
+        }
+
+        // appends a resting order's slot to its owner's list. entries are not removed on fill/cancel, the
+        // list is pruned each time it doubles by checking the slots in place, so the hot path only pays a
+        // push_back
+        inline void index_owner(UserId owner, OrderId id, void* blk, uint16_t off, typename Locator::Kind kind) {
+            auto& oo = owner_orders_[owner_slot(owner)];
+            oo.entries.push_back(OwnerEntry{blk, id, off, kind});
+            if (oo.entries.size() >= oo.prune_at) {
+                std::size_t kept = 0;
+                for (const OwnerEntry& e : oo.entries) {
+                    if (owner_entry_live(e)) {
+                        oo.entries[kept++] = e;
+                    }
+                }
+                oo.entries.resize(kept);
+                oo.prune_at = kept * 2 > 64 ? kept * 2 : 64;
+            }
+        }
+
+        // records where a resting order lives, in the locator table and its owner's list
+        template <typename BlockT>
+        inline void track(OrderId id, UserId owner, BlockT* blk, uint16_t off, typename Locator::Kind kind, Side side,
+                          PriceTick px) {
+            locators_.insert(id, Locator{blk->pool_idx, off, kind, side, px});
+            index_owner(owner, id, blk, off, kind);
+        }
+
+        // track() for load_image: the locators go into the table in one build and the owner list is pruned
+        // once after the load instead of as it grows
+        template <typename BlockT>
+        inline void track_loaded(std::vector<std::pair<OrderId, Locator>>& loaded, OrderId id, UserId owner,
+                                 BlockT* blk, uint16_t off, typename Locator::Kind kind, Side side, PriceTick px) {
+            loaded.emplace_back(id, Locator{blk->pool_idx, off, kind, side, px});
+            owner_orders_[owner_slot(owner)].entries.push_back(OwnerEntry{blk, id, off, kind});
+        }
+
+        inline void emit_delta(DeltaType type, OrderId id, Side side, PriceTick px, Qty qty) {
+            if (delta_sink_.on_delta) {
+                delta_sink_.on_delta(delta_sink_.ctx, BookDelta{id, seq, qty, px, side, type});
+            }
+        }
+
+        inline void emit_rest(OrderId id, UserId owner, bool resting) {
+            if (rest_sink_.on_rest) {
+                rest_sink_.on_rest(rest_sink_.ctx, id, owner, resting);
+            }
+        }
+
+        LevelT* level_at(const Locator& loc) const { return level_of(loc.side, loc.price, false); }
+        ActiveBlock* active_block_of(const Locator& loc) const { return active_pool_.at(loc.blk); }
+        StopBlock* stop_block_of(const Locator& loc) const { return stop_pool_.at(loc.blk); }
+        TpBlock* tp_block_of(const Locator& loc) const { return tp_pool_.at(loc.blk); }
+
         // updates best bid/ask idxs when a price level is added to the book
         inline void on_level_set(Side s, std::size_t idx) {
             if (s == Side::Buy) {
+                bid_bits_.set(idx);
                 if (best_buy_idx_ == npos || idx < best_buy_idx_) {
                     best_buy_idx_ = idx;
                 }
             }
             else {
+                ask_bits_.set(idx);
                 if (best_ask_idx_ == npos || idx < best_ask_idx_) {
                     best_ask_idx_ = idx;
                 }
             }
         }
 
-        // updates best bid/ask idxs when a price level is cleared from the book
+        // updates best bid/ask idxs and the depth cache when a price level is cleared from the book
         inline void on_level_clear(Side s, std::size_t idx) {
             if (s == Side::Buy) {
-                if (best_buy_idx_ != idx) {
-                    return;
+                bid_bits_.clear(idx);
+                if (best_buy_idx_ == idx) {
+                    best_buy_idx_ = bid_bits_.next_set(idx + 1);
                 }
-                for (std::size_t i = idx + 1; i < range_; ++i) {
-                    LevelT* lvl = bids_[i];
-                    if (lvl && lvl->active_nonempty && lvl->order_fifo.live_count() > 0) {
-                        best_buy_idx_ = i;
-                        return;
-                    }
+            }
+            else {
+                ask_bits_.clear(idx);
+                if (best_ask_idx_ == idx) {
+                    best_ask_idx_ = ask_bits_.next_set(idx + 1);
                 }
-                best_buy_idx_ = npos;
-                return;
             }
-            if (best_ask_idx_ != idx) {
-                return;
+            depth_.clear(s, idx, [&](std::size_t from) { return next_active_index(s, from); },
+                         [&](std::size_t i) { return depth_level(s, i); });
+            note_idle(s, idx);
+        }
+
+        inline void note_idle(Side s, std::size_t idx) {
+            if constexpr (LadderT::kReleasesLevels) {
+                idle_levels_.emplace_back(s, idx);
             }
-            for (std::size_t i = idx + 1; i < range_; ++i) {
-                LevelT* lvl = asks_[i];
-                if (lvl && lvl->active_nonempty && lvl->order_fifo.live_count() > 0) {
-                    best_ask_idx_ = i;
-                    return;
+        }
+
+        // hands the levels left without any order back to the pool and takes them out of a ladder that frees
+        // its pages, once the call that emptied them is done with them. a dense ladder keeps every level for
+        // the next order at its price
+        void release_idle_levels() {
+            if constexpr (LadderT::kReleasesLevels) {
+                for (const auto& [side, idx] : idle_levels_) {
+                    LadderT& ladder = side == Side::Buy ? bids_ : asks_;
+                    LevelT* lvl = ladder.get(idx);
+                    if (lvl && lvl->order_fifo.empty() && lvl->stop_fifo.empty() && lvl->tp_fifo.empty()) {
+                        ladder.erase(idx);
+                        level_pool_.release(lvl);
+                    }
                 }
+                idle_levels_.clear();
+            }
+        }
+
+        // refreshes the depth entry of a level that still holds resting orders
+        inline void touch_depth(Side s, PriceTick px, const LevelT* lvl) {
+            const std::size_t idx = side_index(s, px);
+            depth_.set(s, idx, px, lvl->active_qty, static_cast<uint32_t>(lvl->order_fifo.live_count()));
+            (s == Side::Buy ? bid_dirty_ : ask_dirty_).set(idx);
+        }
+
+        // the level at px changed in a way the depth cache does not see (its stops or take-profits)
+        inline void mark_dirty(Side s, PriceTick px) {
+            (s == Side::Buy ? bid_dirty_ : ask_dirty_).set(side_index(s, px));
+        }
+
+        // appends a run to the image, copying its slots only when its level changed or it had none
+        template <typename SlotT, typename FifoT>
+        void capture_run(BookImage& out, ImageChunks<SlotT>& store, ImageRun::Kind kind, Side side, PriceTick px,
+                         const FifoT& fifo, uint64_t epoch) const {
+            const uint64_t key = BookImage::run_key(kind, side, px);
+            bool copy = (side == Side::Buy ? bid_dirty_ : ask_dirty_).test(side_index(side, px));
+            uint32_t c = 0;
+            if (const uint32_t* found = out.chunk_of.find(key)) {
+                c = *found;
+            }
+            else {
+                c = store.acquire();
+                out.chunk_of.insert(key, c);
+                copy = true;
+            }
+            std::vector<SlotT>& chunk = store.chunks[c];
+            if (copy) {
+                chunk.clear();
+                chunk.reserve(fifo.live_count());
+                fifo.copy_live([&](const SlotT& s) { chunk.push_back(s); });
+                ++out.copied_runs;
             }
-            best_ask_idx_ = npos;
+            assert(chunk.size() == fifo.live_count() && "kept image run is out of date");
+            store.kept[c] = epoch;
+            store.slots += chunk.size();
+            out.runs.push_back(ImageRun{px, static_cast<uint32_t>(chunk.size()), side, kind});
+            out.run_chunks.push_back(c);
+        }
+
+        DepthLevel depth_level(Side s, std::size_t idx) const {
+            const LevelT* lvl = ladder_of(s).get(idx);
+            const PriceTick px = s == Side::Buy ? price_from_bid_index(idx) : price_from_ask_index(idx);
+            return DepthLevel{px, lvl->active_qty, static_cast<uint32_t>(lvl->order_fifo.live_count())};
         }
 
         // submit a new limit order in the book
@@ -256,10 +1003,13 @@ namespace jolt::ob {
             if (p.qty <= 0) {
                 return make_reject(p.id, RejectReason::InvalidQty, p.ts);
             }
+            if (!in_range(p.price)) {
+                return make_reject(p.id, RejectReason::InvalidPrice, p.ts);
+            }
 
             Qty remaining = p.qty;
             if (crosses(p.side, p.price)) {
-                match_aggressive(p.id, p.side, p.price, remaining, p.ts, true);
+                match_aggressive(p.id, p.client_id, p.side, p.price, remaining, p.ts, true);
                 if (remaining > match_result.qty) {
                     remaining -= match_result.qty;
                 }
@@ -290,13 +1040,16 @@ namespace jolt::ob {
             // get the price level of the order
             LevelT* lvl = level_of(p.side, p.price, true);
             // create an order slot (fix this later to avoid allocation), and append the order
-            auto loc = lvl->order_fifo.emplace(p.id, static_cast<UserId>(0), remaining, remaining, p.ts, p.price);
+            auto loc = lvl->order_fifo.emplace(p.id, static_cast<UserId>(p.client_id), remaining, remaining, p.ts, p.price);
             lvl->active_qty += remaining;
             lvl->active_nonempty = true;
             // maintain best pointers via side-aware index mapping
             on_level_set(p.side, side_index(p.side, p.price));
+            touch_depth(p.side, p.price, lvl);
             // insert locator into lookup (fix later to avoid allocation)
-            locators_.insert(p.id, Locator{lvl, loc.blk, loc.off, Locator::Kind::Active, p.side, p.price});
+            track(p.id, p.client_id, loc.blk, loc.off, Locator::Kind::Active, p.side, p.price);
+            emit_delta(DeltaType::Add, p.id, p.side, p.price, remaining);
+            emit_rest(p.id, p.client_id, true);
             ++active_limit_orders_;
 
 
@@ -312,6 +1065,7 @@ namespace jolt::ob {
             if (p.sl_id != 0 && p.sl_trigger != 0) {
                 OrderParams sp{};
                 sp.action = OrderAction::New;
+                sp.client_id = p.client_id;
                 sp.type = p.sl_post_type;
                 sp.id = p.sl_id;
                 sp.side = opposite(p.side);
@@ -326,6 +1080,7 @@ namespace jolt::ob {
             if (p.tp_id != 0 && p.tp_trigger != 0 && p.tp_limit_px != 0) {
                 OrderParams tp{};
                 tp.action = OrderAction::New;
+                tp.client_id = p.client_id;
                 tp.type = OrderType::TakeProfit;
                 tp.id = p.tp_id;
                 tp.side = opposite(p.side);
@@ -347,6 +1102,7 @@ namespace jolt::ob {
 
             match_aggressive(
                 p.id,
+                p.client_id,
                 p.side,
                 (p.side == Side::Buy ? max_tick_ : min_tick_),
                 p.qty,
@@ -361,6 +1117,7 @@ namespace jolt::ob {
             if (p.sl_id != 0 && p.sl_trigger != 0) {
                 OrderParams sp{};
                 sp.action = OrderAction::New;
+                sp.client_id = p.client_id;
                 sp.type = p.sl_post_type;
                 sp.id = p.sl_id;
                 sp.side = opposite(p.side);
@@ -374,6 +1131,7 @@ namespace jolt::ob {
             if (p.tp_id != 0 && p.tp_trigger != 0 && p.tp_limit_px != 0) {
                 OrderParams tp{};
                 tp.action = OrderAction::New;
+                tp.client_id = p.client_id;
                 tp.type = OrderType::TakeProfit;
                 tp.id = p.tp_id;
                 tp.side = opposite(p.side);
@@ -402,6 +1160,9 @@ namespace jolt::ob {
 
 
         BookEvent modify(const OrderParams& p) {
+            if (p.qty != 0 && !in_range(p.price)) {
+                return make_reject(p.id, RejectReason::InvalidPrice, p.ts);
+            }
             if (modify(p.id, p.qty, p.price, p.tif, p.ts)) {
                 BookEvent e = {};
                 e.event_type = BookEventType::Modify;
@@ -422,61 +1183,8 @@ namespace jolt::ob {
                 return false;
             }
 
-            Locator loc = *lptr;
-
-            // if stop order, get the block that holds the stop, tombstone the slot
-            if (loc.kind == Locator::Kind::Stop) {
-                auto* blk = reinterpret_cast<typename LevelT::StopBlock*>(loc.blk);
-                loc.level->stop_fifo.tombstone({blk, loc.off});
-
-                if (loc.level->stop_fifo.live_count() == 0) {
-                    loc.level->stops_nonempty = false;
-                }
-                if (active_stop_orders_ > 0) {
-                    --active_stop_orders_;
-                }
-            }
-            else if (loc.kind == Locator::Kind::TakeProfit) {
-                auto* blk = reinterpret_cast<typename LevelT::TpBlock*>(loc.blk);
-                loc.level->tp_fifo.tombstone({blk, loc.off});
-                if (loc.level->tp_fifo.live_count() == 0) {
-                    loc.level->tps_nonempty = false;
-                }
-            }
-            else {
-                auto* blk = reinterpret_cast<typename LevelT::OrderBlock*>(loc.blk);
-                // get quantity of order to be canceled, and subtract from level
-                Qty q = blk->slots[loc.off].remaining;
-                if (loc.level->active_qty >= q) {
-                    loc.level->active_qty -= q;
-                }
-                else {
-                    loc.level->active_qty = 0;
-                }
-                // tombstone the slot, and if last order at level, update best idx
-                loc.level->order_fifo.tombstone({blk, loc.off});
-                if (loc.level->order_fifo.live_count() == 0) {
-                    loc.level->active_nonempty = false;
-                    loc.level->active_qty = 0;
-                    auto idx = side_index(loc.side, loc.price);
-                    on_level_clear(loc.side, idx);
-                }
-                if (active_limit_orders_ > 0) {
-                    --active_limit_orders_;
-                }
-                if (loc.side == Side::Buy) {
-                    if (active_limit_buys_ > 0) {
-                        --active_limit_buys_;
-                    }
-                }
-                else {
-                    if (active_limit_sells_ > 0) {
-                        --active_limit_sells_;
-                    }
-                }
-            }
-
-            locators_.erase(id);
+            const Locator loc = *lptr;
+            remove_located(id, loc);
             return true;
         }
 
@@ -493,17 +1201,19 @@ namespace jolt::ob {
                 return false;
             }
 
-            Locator loc = *lptr;
+            const Locator loc = *lptr;
+            LevelT* lvl = level_at(loc);
             if (loc.kind == Locator::Kind::Stop) {
-                auto* stop_block = reinterpret_cast<typename LevelT::StopBlock*>(loc.blk);
+                mark_dirty(loc.side, loc.price);
+                auto* stop_block = stop_block_of(loc);
                 StopSlot og_stop = stop_block->slots[loc.off];
                 Qty old_qty = stop_block->slots[loc.off].qty;
 
                 // if new qty == 0, cancel the order
                 if (new_qty == 0) {
-                    loc.level->stop_fifo.tombstone({stop_block, loc.off});
-                    if (loc.level->stop_fifo.live_count() == 0) {
-                        loc.level->stops_nonempty = false;
+                    retire(lvl->stop_fifo, stop_block, loc.off);
+                    if (lvl->stop_fifo.live_count() == 0) {
+                        mark_stops(lvl, loc.side, loc.price, false);
                     }
                     locators_.erase(id);
                     if (active_stop_orders_ > 0) {
@@ -517,10 +1227,10 @@ namespace jolt::ob {
                 // if price change or qty increase, requeue the order
                 if (new_px != old_px || new_qty > old_qty) {
                     // remove from old price level
-                    loc.level->stop_fifo.tombstone({stop_block, loc.off});
+                    retire(lvl->stop_fifo, stop_block, loc.off);
                     locators_.erase(id);
-                    if (loc.level->stop_fifo.live_count() == 0) {
-                        loc.level->stops_nonempty = false;
+                    if (lvl->stop_fifo.live_count() == 0) {
+                        mark_stops(lvl, loc.side, loc.price, false);
                     }
 
                     // insert into new price level
@@ -529,10 +1239,9 @@ namespace jolt::ob {
                     auto new_lvl = level_of(loc.side, new_px, true);
 
                     auto new_loc = new_lvl->stop_fifo.append(og_stop);
-                    new_lvl->stops_nonempty = true;
-                    locators_.insert(id, Locator{
-                                         new_lvl, new_loc.blk, new_loc.off, Locator::Kind::Stop, loc.side, new_px
-                                     });
+                    mark_dirty(loc.side, new_px);
+                    mark_stops(new_lvl, loc.side, new_px, true);
+                    track(id, og_stop.owner, new_loc.blk, new_loc.off, Locator::Kind::Stop, loc.side, new_px);
                     return true;
                 }
 
@@ -544,14 +1253,15 @@ namespace jolt::ob {
                 return true;
             }
             if (loc.kind == Locator::Kind::TakeProfit) {
-                auto* tp_block = reinterpret_cast<typename LevelT::TpBlock*>(loc.blk);
+                mark_dirty(loc.side, loc.price);
+                auto* tp_block = tp_block_of(loc);
                 TpSlot og_tp = tp_block->slots[loc.off];
                 Qty old_qty = tp_block->slots[loc.off].qty;
 
                 if (new_qty == 0) {
-                    loc.level->tp_fifo.tombstone({tp_block, loc.off});
-                    if (loc.level->tp_fifo.live_count() == 0) {
-                        loc.level->tps_nonempty = false;
+                    retire(lvl->tp_fifo, tp_block, loc.off);
+                    if (lvl->tp_fifo.live_count() == 0) {
+                        mark_tps(lvl, loc.side, loc.price, false);
                     }
                     locators_.erase(id);
                     return true;
@@ -559,20 +1269,19 @@ namespace jolt::ob {
 
                 auto old_px = tp_block->slots[loc.off].trigger;
                 if (new_px != old_px || new_qty > old_qty) {
-                    loc.level->tp_fifo.tombstone({tp_block, loc.off});
+                    retire(lvl->tp_fifo, tp_block, loc.off);
                     locators_.erase(id);
-                    if (loc.level->tp_fifo.live_count() == 0) {
-                        loc.level->tps_nonempty = false;
+                    if (lvl->tp_fifo.live_count() == 0) {
+                        mark_tps(lvl, loc.side, loc.price, false);
                     }
 
                     og_tp.qty = new_qty;
                     og_tp.trigger = new_px;
                     auto new_lvl = level_of(loc.side, new_px, true);
                     auto new_loc = new_lvl->tp_fifo.append(og_tp);
-                    new_lvl->tps_nonempty = true;
-                    locators_.insert(id, Locator{
-                                         new_lvl, new_loc.blk, new_loc.off, Locator::Kind::TakeProfit, loc.side, new_px
-                                     });
+                    mark_dirty(loc.side, new_px);
+                    mark_tps(new_lvl, loc.side, new_px, true);
+                    track(id, og_tp.owner, new_loc.blk, new_loc.off, Locator::Kind::TakeProfit, loc.side, new_px);
                     return true;
                 }
 
@@ -583,22 +1292,26 @@ namespace jolt::ob {
                 return true;
             }
             // get the og order
-            auto* order_block = reinterpret_cast<typename LevelT::OrderBlock*>(loc.blk);
-            OrderSlot og_order = order_block->slots[loc.off];
+            auto* order_block = active_block_of(loc);
+            OrderSlot og_order = order_block->load(loc.off);
             auto old_qty = og_order.remaining;
             auto old_px = og_order.px;
 
             // fifo and level for og order
-            auto og_lvl = loc.level;
+            auto og_lvl = lvl;
             // if new px == 0 or new qty == 0, treat as order cancel
             if (new_px == 0 || new_qty == 0) {
-                og_lvl->order_fifo.tombstone({order_block, loc.off});
+                retire(og_lvl->order_fifo, order_block, loc.off);
+                emit_delta(DeltaType::Remove, id, loc.side, old_px, 0);
                 og_lvl->active_qty -= old_qty;
                 if (og_lvl->active_qty == 0) {
                     og_lvl->active_nonempty = false;
                     auto old_idx = side_index(loc.side, old_px);
                     on_level_clear(loc.side, old_idx);
                 }
+                else {
+                    touch_depth(loc.side, old_px, og_lvl);
+                }
                 locators_.erase(id);
                 if (active_limit_orders_ > 0) {
                     --active_limit_orders_;
@@ -620,19 +1333,23 @@ namespace jolt::ob {
             if (new_px != old_px || new_qty > old_qty) {
                 // remove from old level
                 og_lvl->active_qty -= old_qty;
-                og_lvl->order_fifo.tombstone({order_block, loc.off});
+                retire(og_lvl->order_fifo, order_block, loc.off);
+                emit_delta(DeltaType::Remove, id, loc.side, old_px, 0);
                 locators_.erase(id);
                 if (og_lvl->active_qty == 0) {
                     og_lvl->active_nonempty = false;
                     auto old_idx = side_index(loc.side, old_px);
                     on_level_clear(loc.side, old_idx);
                 }
+                else {
+                    touch_depth(loc.side, old_px, og_lvl);
+                }
 
                 Qty remaining = new_qty;
 
                 // match orders if the new price crosses the book
                 if (crosses(loc.side, new_px)) {
-                    match_aggressive(id, loc.side, new_px, remaining, ts, true);
+                    match_aggressive(id, og_order.owner, loc.side, new_px, remaining, ts, true);
                     if (remaining > match_result.qty) {
                         remaining -= match_result.qty;
                     }
@@ -651,10 +1368,10 @@ namespace jolt::ob {
                     new_lvl->active_nonempty = true;
                     auto new_idx = side_index(loc.side, new_px);
                     on_level_set(loc.side, new_idx);
+                    touch_depth(loc.side, new_px, new_lvl);
                     locators_.erase(id);
-                    locators_.insert(id, Locator{
-                                         new_lvl, new_loc.blk, new_loc.off, Locator::Kind::Active, loc.side, new_px
-                                     });
+                    track(id, og_order.owner, new_loc.blk, new_loc.off, Locator::Kind::Active, loc.side, new_px);
+                    emit_delta(DeltaType::Add, id, loc.side, new_px, remaining);
                 }
                 else {
                     locators_.erase(id);
@@ -680,7 +1397,9 @@ namespace jolt::ob {
             if (new_qty < old_qty) {
                 og_lvl->active_qty -= old_qty;
                 og_lvl->active_qty += new_qty;
-                order_block->slots[loc.off].remaining = new_qty;
+                slot_remaining(order_block, loc.off) = new_qty;
+                touch_depth(loc.side, old_px, og_lvl);
+                emit_delta(DeltaType::Update, id, loc.side, old_px, new_qty);
 
                 return true;
             }
@@ -700,18 +1419,18 @@ namespace jolt::ob {
             prev_trade_ = last_trade_;
             last_trade_ = p;
             if (p > prev_trade_) {
-                drain_stops_range(Side::Buy, prev_trade_ + 1, p, ts);
-                drain_tps_range(Side::Sell, prev_trade_ + 1, p, ts);
+                collect_stops(Side::Buy, prev_trade_ + 1, p, ts);
+                collect_tps(Side::Sell, prev_trade_ + 1, p, ts);
             }
             else if (p < prev_trade_) {
-                drain_stops_range(Side::Sell, p, prev_trade_ - 1, ts);
-                drain_tps_range(Side::Buy, p, prev_trade_ - 1, ts);
+                collect_stops(Side::Sell, p, prev_trade_ - 1, ts);
+                collect_tps(Side::Buy, p, prev_trade_ - 1, ts);
             }
         }
 
 
-        const std::vector<LevelT*>& inspect_bids() const { return bids_; }
-        const std::vector<LevelT*>& inspect_asks() const { return asks_; }
+        const LadderT& inspect_bids() const { return bids_; }
+        const LadderT& inspect_asks() const { return asks_; }
         std::size_t inspect_index(Side side, PriceTick px) const { return side_index(side, px); }
         PriceTick inspect_price_from_bid_index(std::size_t i) const { return price_from_bid_index(i); }
         PriceTick inspect_price_from_ask_index(std::size_t i) const { return price_from_ask_index(i); }
@@ -723,10 +1442,14 @@ namespace jolt::ob {
             }
             OrderType post_type =
                 (p.type == OrderType::StopLimit) ? OrderType::StopLimit : OrderType::StopMarket;
+            // the trigger indexes the stop bitset, the limit price the ladder once it fires
+            if (!in_range(p.trigger) || (post_type == OrderType::StopLimit && !in_range(p.limit_px))) {
+                return make_reject(p.id, RejectReason::InvalidPrice, p.ts);
+            }
             LevelT* lvl = level_of(p.side, p.trigger, true);
             auto loc = lvl->stop_fifo.emplace(
                 p.id,
-                static_cast<UserId>(0),
+                static_cast<UserId>(p.client_id),
                 p.qty,
                 p.trigger,
                 post_type,
@@ -734,8 +1457,10 @@ namespace jolt::ob {
                 p.tif,
                 p.ts
             );
-            lvl->stops_nonempty = true;
-            locators_.insert(p.id, Locator{lvl, loc.blk, loc.off, Locator::Kind::Stop, p.side, p.trigger});
+            mark_stops(lvl, p.side, p.trigger, true);
+            mark_dirty(p.side, p.trigger);
+            track(p.id, p.client_id, loc.blk, loc.off, Locator::Kind::Stop, p.side, p.trigger);
+            emit_rest(p.id, p.client_id, true);
             ++active_stop_orders_;
             return make_new(p.id, p.side, p.trigger, p.qty, p.ts);
         }
@@ -745,26 +1470,30 @@ namespace jolt::ob {
             if (p.qty <= 0) {
                 return make_reject(p.id, RejectReason::InvalidQty, p.ts);
             }
+            if (!in_range(p.trigger) || !in_range(p.limit_px)) {
+                return make_reject(p.id, RejectReason::InvalidPrice, p.ts);
+            }
             LevelT* lvl = level_of(p.side, p.trigger, true);
             auto loc = lvl->tp_fifo.emplace(
                 p.id,
-                static_cast<UserId>(0),
+                static_cast<UserId>(p.client_id),
                 p.qty,
                 p.trigger,
                 p.limit_px,
                 p.tif,
                 p.ts
             );
-            lvl->tps_nonempty = true;
-            locators_.insert(p.id, Locator{lvl, loc.blk, loc.off, Locator::Kind::TakeProfit, p.side, p.trigger});
+            mark_tps(lvl, p.side, p.trigger, true);
+            mark_dirty(p.side, p.trigger);
+            track(p.id, p.client_id, loc.blk, loc.off, Locator::Kind::TakeProfit, p.side, p.trigger);
+            emit_rest(p.id, p.client_id, true);
             return make_new(p.id, p.side, p.trigger, p.qty, p.ts);
         }
 
 
 
-        void match_aggressive(OrderId taker_id, Side side, PriceTick limit_px, Qty qty, uint64_t ts,
-                                     bool is_market = false) {
-            match_result.reset();
+        void match_aggressive(OrderId taker_id, UserId taker_owner, Side side, PriceTick limit_px, Qty qty,
+                              uint64_t ts, bool is_market = false) {
             Qty filled_total = 0;
             PriceTick last_px_exec = 0;
 
@@ -788,11 +1517,12 @@ namespace jolt::ob {
 
                 LevelT* lvl = level_of(opposite(side), best_px, false);
                 assert(lvl && "best index points to null level");
-                auto* head = lvl->order_fifo.head_slot();
-                assert(head && "active level has no head order");
+                const auto head = lvl->order_fifo.head_loc();
+                assert(head.blk && "active level has no head order");
+                Qty& head_remaining = slot_remaining(head.blk, head.off);
 
-                Qty exec_qty = (head->remaining < qty ? head->remaining : qty);
-                head->remaining -= exec_qty;
+                Qty exec_qty = (head_remaining < qty ? head_remaining : qty);
+                head_remaining -= exec_qty;
                 qty -= exec_qty;
                 lvl->active_qty -= exec_qty;
                 filled_total += exec_qty;
@@ -801,15 +1531,26 @@ namespace jolt::ob {
                 match_result.qty += exec_qty;
 
                 BookEvent e{};
-                e.id = head->id;
+                e.id = slot_id(head.blk, head.off);
+                e.owner = slot_owner(head.blk, head.off);
                 e.qty = exec_qty;
+                e.leaves = head_remaining;
                 e.price = last_px_exec;
                 e.ts = ts;
+                e.seq = seq;
+                e.side = opposite(side);
                 e.event_type = BookEventType::Fill;
-                match_result.fills.push_back(e);
+                if (fill_sink_.on_fill) {
+                    fill_sink_.on_fill(fill_sink_.ctx, e, taker_id, taker_owner);
+                }
+                else {
+                    match_result.fills.push_back(e);
+                }
+                emit_delta(head_remaining == 0 ? DeltaType::Remove : DeltaType::Update, e.id, e.side, best_px,
+                           head_remaining);
 
-                if (head->remaining == 0) {
-                    OrderId maker_id = head->id;
+                if (head_remaining == 0) {
+                    OrderId maker_id = e.id;
                     lvl->order_fifo.pop_head();
                     locators_.erase(maker_id);
                     if (active_limit_orders_ > 0) {
@@ -839,6 +1580,9 @@ namespace jolt::ob {
                                   ? price_from_ask_index(opp_idx)
                                   : price_from_bid_index(opp_idx);
                 }
+                else {
+                    touch_depth(opposite(side), best_px, lvl);
+                }
             }
 
             match_result.last_px = last_px_exec;
@@ -851,80 +1595,139 @@ namespace jolt::ob {
 
         }
 
-        void drain_stops_range(Side side, PriceTick from_incl, PriceTick to_incl, uint64_t ts) {
-            if (from_incl > to_incl) {
+        inline std::size_t trigger_index(PriceTick px) const { return px - min_tick_; }
+
+        BitsetIndex& stop_bits(Side side) { return side == Side::Buy ? buy_stop_bits_ : sell_stop_bits_; }
+        BitsetIndex& tp_bits(Side side) { return side == Side::Buy ? buy_tp_bits_ : sell_tp_bits_; }
+
+        inline void mark_stops(LevelT* lvl, Side side, PriceTick px, bool nonempty) {
+            lvl->stops_nonempty = nonempty;
+            if (nonempty) {
+                stop_bits(side).set(trigger_index(px));
+            }
+            else {
+                stop_bits(side).clear(trigger_index(px));
+                note_idle(side, side_index(side, px));
+            }
+        }
+
+        inline void mark_tps(LevelT* lvl, Side side, PriceTick px, bool nonempty) {
+            lvl->tps_nonempty = nonempty;
+            if (nonempty) {
+                tp_bits(side).set(trigger_index(px));
+            }
+            else {
+                tp_bits(side).clear(trigger_index(px));
+                note_idle(side, side_index(side, px));
+            }
+        }
+
+        // calls fn(px) for every set trigger price in [lo, hi], walking away from the previous trade: up
+        // for a rising price, down for a falling one. fn may clear the bit it is given
+        template <typename Fn>
+        void for_each_trigger(const BitsetIndex& bits, PriceTick lo, PriceTick hi, bool rising, Fn&& fn) {
+            if (lo > hi) {
                 return;
             }
-            for (PriceTick px = from_incl; px <= to_incl; ++px) {
+            const std::size_t lo_idx = trigger_index(lo);
+            const std::size_t hi_idx = trigger_index(hi);
+            if (rising) {
+                for (auto i = bits.next_set(lo_idx); i != npos && i <= hi_idx; i = bits.next_set(i + 1)) {
+                    fn(static_cast<PriceTick>(min_tick_ + i));
+                }
+            }
+            else {
+                for (auto i = bits.prev_set(hi_idx); i != npos && i >= lo_idx;
+                     i = i == 0 ? npos : bits.prev_set(i - 1)) {
+                    fn(static_cast<PriceTick>(min_tick_ + i));
+                }
+            }
+        }
+
+        // moves every stop resting on a trigger price in [lo, hi] to triggered_
+        void collect_stops(Side side, PriceTick lo, PriceTick hi, uint64_t ts) {
+            // buy stops sit above the market and fire on a rise, sell stops below and fire on a fall
+            for_each_trigger(stop_bits(side), lo, hi, side == Side::Buy, [&](PriceTick px) {
                 LevelT* lvl = level_of(side, px, false);
-                if (!lvl) continue;
+                mark_dirty(side, px);
                 while (auto* s = lvl->stop_fifo.head_slot()) {
-                    OrderParams lim{};
-                    OrderParams mkt{};
+                    OrderParams op{};
+                    op.id = s->id;
+                    op.client_id = s->owner;
+                    op.side = side;
+                    op.qty = s->qty;
+                    op.ts = ts;
+                    op.action = OrderAction::New;
                     if (s->post_type == OrderType::StopMarket) {
-                        mkt.id = s->id;
-                        mkt.side = side;
-                        mkt.qty = s->qty;
-                        mkt.tif = TIF::IOC;
-                        mkt.ts = ts;
-                        mkt.action = OrderAction::New;
-                        mkt.type = OrderType::Market;
-                        lvl->stop_fifo.pop_head();
-                        locators_.erase(s->id);
-                        if (active_stop_orders_ > 0) {
-                            --active_stop_orders_;
-                        }
-                        submit_market(mkt);
+                        op.tif = TIF::IOC;
+                        op.type = OrderType::Market;
                     }
                     else {
-                        lim.id = s->id;
-                        lim.side = side;
-                        lim.price = s->limit_px;
-                        lim.qty = s->qty;
-                        lim.tif = s->tif;
-                        lim.ts = ts;
-                        lim.action = OrderAction::New;
-                        lim.type = OrderType::Limit;
-                        lvl->stop_fifo.pop_head();
-                        locators_.erase(s->id);
-                        if (active_stop_orders_ > 0) {
-                            --active_stop_orders_;
-                        }
-                        submit_limit(lim);
+                        op.price = s->limit_px;
+                        op.tif = s->tif;
+                        op.type = OrderType::Limit;
                     }
+                    lvl->stop_fifo.pop_head();
+                    locators_.erase(op.id);
+                    emit_rest(op.id, op.client_id, false);
+                    if (active_stop_orders_ > 0) {
+                        --active_stop_orders_;
+                    }
+                    triggered_.push_back(op);
                 }
-                lvl->stops_nonempty = false;
-                if (px == to_incl) {
-                    break;
-                }
-            }
+                mark_stops(lvl, side, px, false);
+            });
         }
 
-        void drain_tps_range(Side side, PriceTick start, PriceTick end, uint64_t ts) {
-            if (start > end) {
-                return;
-            }
-            for (PriceTick px = start; px <= end; ++px) {
+        // moves every take-profit resting on a trigger price in [lo, hi] to triggered_
+        void collect_tps(Side side, PriceTick lo, PriceTick hi, uint64_t ts) {
+            // sell take-profits fire on a rise, buy take-profits on a fall
+            for_each_trigger(tp_bits(side), lo, hi, side == Side::Sell, [&](PriceTick px) {
                 LevelT* lvl = level_of(side, px, false);
-                if (!lvl) {
-                    continue;
-                }
+                mark_dirty(side, px);
                 while (auto* t = lvl->tp_fifo.head_slot()) {
-                    OrderParams lim{};
-                    lim.id = t->id;
-                    lim.side = side;
-                    lim.price = t->limit_px;
-                    lim.qty = t->qty;
-                    lim.tif = t->tif;
-                    lim.ts = ts;
-                    lim.action = OrderAction::New;
-                    lim.type = OrderType::Limit;
+                    OrderParams op{};
+                    op.id = t->id;
+                    op.client_id = t->owner;
+                    op.side = side;
+                    op.price = t->limit_px;
+                    op.qty = t->qty;
+                    op.tif = t->tif;
+                    op.ts = ts;
+                    op.action = OrderAction::New;
+                    op.type = OrderType::Limit;
                     lvl->tp_fifo.pop_head();
-                    locators_.erase(t->id);
-                    submit_limit(lim);
+                    locators_.erase(op.id);
+                    emit_rest(op.id, op.client_id, false);
+                    triggered_.push_back(op);
+                }
+                mark_tps(lvl, side, px, false);
+            });
+        }
+
+        // submits triggered orders in the order they fired. their trades can fire more, which are appended
+        // and run in the same loop, so a cascade never recurses. match_result keeps the submitted order's
+        // totals, fills of the cascade are appended after its own
+        void run_triggered() {
+            const uint64_t fill_count = match_result.fill_count;
+            const Qty qty = match_result.qty;
+            const PriceTick last_px = match_result.last_px;
+            for (std::size_t i = 0; i < triggered_.size(); ++i) {
+                const OrderParams op = triggered_[i];
+                match_result.fill_count = 0;
+                match_result.qty = 0;
+                match_result.last_px = 0;
+                if (op.type == OrderType::Market) {
+                    submit_market(op);
+                }
+                else {
+                    submit_limit(op);
                 }
-                lvl->tps_nonempty = false;
             }
+            triggered_.clear();
+            match_result.fill_count = fill_count;
+            match_result.qty = qty;
+            match_result.last_px = last_px;
         }
 
         inline bool crosses(Side side, PriceTick px) const {
@@ -938,6 +1741,8 @@ namespace jolt::ob {
             }
         }
 
+        // prices outside [min_tick, max_tick] have no ladder or trigger slot and are rejected on entry
+        inline bool in_range(PriceTick px) const { return px >= min_tick_ && px <= max_tick_; }
         inline std::size_t bid_index(PriceTick px) const { return max_tick_ - px; }
         inline std::size_t ask_index(PriceTick px) const { return px - min_tick_; }
 
@@ -948,13 +1753,28 @@ namespace jolt::ob {
         inline PriceTick price_from_bid_index(std::size_t i) const { return static_cast<PriceTick>(max_tick_ - i); }
         inline PriceTick price_from_ask_index(std::size_t i) const { return static_cast<PriceTick>(min_tick_ + i); }
 
+        const LadderT& ladder_of(Side side) const { return side == Side::Buy ? bids_ : asks_; }
+
+        // the slot's fields and the block's live mask, where a cancel or modify touches it first
+        template <typename BlockT>
+        static void prefetch_slot(const BlockT* blk, uint16_t off) {
+            if constexpr (std::is_same_v<BlockT, ActiveBlock> && LAYOUT == SlotLayout::Soa) {
+                __builtin_prefetch(&blk->remaining[off]);
+                __builtin_prefetch(&blk->id[off]);
+            }
+            else {
+                __builtin_prefetch(&blk->slots[off]);
+            }
+            __builtin_prefetch(&blk->live_mask[off / 64]);
+        }
+
         LevelT* level_of(Side side, PriceTick px, bool create) const {
             auto idx = side_index(side, px);
-            auto& vec = (side == Side::Buy) ? bids_ : asks_;
-            LevelT* lvl = vec[idx];
+            auto& ladder = (side == Side::Buy) ? bids_ : asks_;
+            LevelT* lvl = ladder.get(idx);
             if (!lvl && create) {
                 lvl = level_pool_.acquire(active_pool_, stop_pool_, tp_pool_);
-                vec[idx] = lvl;
+                ladder.put(idx, lvl);
             }
             return lvl;
         }
@@ -964,17 +1784,7 @@ namespace jolt::ob {
         }
 
         std::size_t next_active_index(Side s, std::size_t start) const {
-            if (start >= range_) {
-                return npos;
-            }
-            auto const& vec = (s == Side::Buy) ? bids_ : asks_;
-            for (std::size_t i = start; i < range_; ++i) {
-                LevelT* lvl = vec[i];
-                if (lvl && lvl->active_nonempty && lvl->order_fifo.live_count() > 0) {
-                    return i;
-                }
-            }
-            return npos;
+            return (s == Side::Buy) ? bid_bits_.next_set(start) : ask_bits_.next_set(start);
         }
 
         static BookEvent make_reject(OrderId id, RejectReason reason, uint64_t ts) {
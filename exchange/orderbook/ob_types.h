@@ -17,7 +17,7 @@ namespace jolt::ob {
 
     enum class OrderType : uint8_t { Limit = 0, Market = 1, StopMarket = 2, StopLimit = 3, TakeProfit = 4 };
 
-    enum class OrderAction : uint8_t { New = 0, Modify = 1, Cancel = 2 };
+    enum class OrderAction : uint8_t { New = 0, Modify = 1, Cancel = 2, MassCancel = 3 };
 
     enum class BookEventType : uint8_t { New = 0, Cancel = 1, Modify = 2, Trade, Fill = 3, Reject = 4 };
 
@@ -43,6 +43,8 @@ namespace jolt::ob {
         OrderType sl_post_type{OrderType::StopMarket};
         OrderAction action{OrderAction::New};
         OrderType type{OrderType::Limit};
+        bool one_side{false}; // MassCancel: only cancel orders on `side`
+        bool kill{false}; // MassCancel: sent by risk, the client's new orders are refused from then on
     };
 
 
@@ -53,7 +55,8 @@ namespace jolt::ob {
         NonExistent = 3,
         TifExpired = 4,
         NotFillable = 5,
-        InvalidType = 6
+        InvalidType = 6,
+        DuplicateId = 7 // a New whose id, or an attached leg's, is already live in the book
     };
 
     struct Bbo {
@@ -64,19 +67,64 @@ namespace jolt::ob {
         }
     };
 
+    // one aggregated price level: open qty of the resting limit orders at px and how many there are
+    struct DepthLevel {
+        PriceTick px{0};
+        Qty qty{0};
+        uint32_t orders{0};
+    };
+
     struct BookEvent {
         OrderId id{0};
+        UserId owner{0}; // resting order's owner on fills
         uint64_t ts{0};
         uint64_t seq{0};
         Qty qty{0};
         PriceTick price{0};
+        Qty leaves{0}; // resting order's remaining qty after a fill
         Side side{};
         BookEventType event_type{};
         RejectReason reason;
     };
 
+    // receives maker fills straight from the match loop, ctx is the caller's state. taker_id/taker_owner
+    // are the aggressing order, which differs from the submitted one for triggered stops
+    struct FillSink {
+        void* ctx{nullptr};
+        void (*on_fill)(void* ctx, const BookEvent& fill, OrderId taker_id, UserId taker_owner){nullptr};
+    };
+
+    enum class DeltaType : uint8_t { Add = 0, Update = 1, Remove = 2 };
+
+    // change to the resting limit orders of a book: an order rested at the back of its level, its open
+    // qty changed in place (fill or qty decrease), or it left the book. stops and take-profits are not
+    // reported until they trigger and rest
+    struct BookDelta {
+        OrderId id{0};
+        uint64_t seq{0};
+        Qty qty{0};
+        PriceTick price{0};
+        Side side{Side::Buy};
+        DeltaType type{DeltaType::Add};
+    };
+
+    // receives the book's deltas in the order they happen, replaying them rebuilds get_snapshot
+    struct DeltaSink {
+        void* ctx{nullptr};
+        void (*on_delta)(void* ctx, const BookDelta& delta){nullptr};
+    };
+
+    // an order coming to rest in the book, as a limit at its price or a stop / take-profit at its trigger
+    // (attached legs and triggered orders included), or a stop / take-profit leaving its trigger as it fires
+    struct RestSink {
+        void* ctx{nullptr};
+        void (*on_rest)(void* ctx, OrderId id, UserId owner, bool resting){nullptr};
+    };
+
     struct MatchResult {
-        std::vector<BookEvent> fills{1024};
+        MatchResult() { fills.reserve(1024); }
+
+        std::vector<BookEvent> fills;
         uint64_t fill_count{0};
         Qty qty{0};
         PriceTick last_px{0};
@@ -0,0 +1,187 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <new>
+#include <vector>
+
+namespace jolt::ob {
+    enum class LadderKind : uint8_t { Dense = 0, Paged = 1 };
+
+    // one level pointer per tick, allocated up front for the whole range
+    template <typename LevelT>
+    class DenseLadder {
+    public:
+        // levels stay in the ladder once created, see release_idle_levels
+        static constexpr bool kReleasesLevels = false;
+
+        explicit DenseLadder(std::size_t range) : levels_(range, nullptr) {}
+
+        inline LevelT* get(std::size_t idx) const { return levels_[idx]; }
+
+        inline void put(std::size_t idx, LevelT* lvl) { levels_[idx] = lvl; }
+
+        inline void erase(std::size_t idx) { levels_[idx] = nullptr; }
+
+        inline void prefetch(std::size_t idx) const { __builtin_prefetch(&levels_[idx]); }
+
+        std::size_t size() const { return levels_.size(); }
+
+        std::size_t bytes() const { return levels_.capacity() * sizeof(LevelT*); }
+
+    private:
+        std::vector<LevelT*> levels_;
+    };
+
+    // level pointers held in fixed pages that are only allocated once a tick inside them is touched and
+    // freed once the last level in them is erased. the page directory covers a window
+    // [base_page_, base_page_ + dir_.size()) that grows outward on demand, by at least its own size so
+    // a price drifting one way costs amortised O(1) per page, and drops the empty pages at either end,
+    // so only the populated part of the range costs memory
+    template <typename LevelT, std::size_t PAGE_SHIFT = 9>
+    class PagedLadder {
+    public:
+        static constexpr bool kReleasesLevels = true;
+        static constexpr std::size_t PAGE_TICKS = std::size_t{1} << PAGE_SHIFT;
+        static constexpr std::size_t PAGE_MASK = PAGE_TICKS - 1;
+
+        struct Page {
+            LevelT* levels[PAGE_TICKS];
+            // non-null entries of levels
+            std::size_t used;
+        };
+
+        explicit PagedLadder(std::size_t range) : range_(range) {}
+
+        ~PagedLadder() {
+            for (Page* pg : dir_) {
+                std::free(pg);
+            }
+        }
+
+        PagedLadder(const PagedLadder&) = delete;
+        PagedLadder& operator=(const PagedLadder&) = delete;
+
+        inline LevelT* get(std::size_t idx) const {
+            // pages below base_page_ wrap to a huge value and fail the bounds check
+            const std::size_t p = (idx >> PAGE_SHIFT) - base_page_;
+            if (p >= dir_.size()) {
+                return nullptr;
+            }
+            const Page* pg = dir_[p];
+            return pg ? pg->levels[idx & PAGE_MASK] : nullptr;
+        }
+
+        inline void prefetch(std::size_t idx) const {
+            const std::size_t p = (idx >> PAGE_SHIFT) - base_page_;
+            if (p < dir_.size() && dir_[p]) {
+                __builtin_prefetch(&dir_[p]->levels[idx & PAGE_MASK]);
+            }
+        }
+
+        // lvl is non-null and idx holds no level yet
+        inline void put(std::size_t idx, LevelT* lvl) {
+            const std::size_t page = idx >> PAGE_SHIFT;
+            std::size_t p = page - base_page_;
+            if (p >= dir_.size()) {
+                grow_to(page);
+                p = page - base_page_;
+            }
+            Page*& pg = dir_[p];
+            if (!pg) {
+                pg = new_page();
+            }
+            pg->levels[idx & PAGE_MASK] = lvl;
+            ++pg->used;
+        }
+
+        inline void erase(std::size_t idx) {
+            const std::size_t p = (idx >> PAGE_SHIFT) - base_page_;
+            if (p >= dir_.size() || !dir_[p] || !dir_[p]->levels[idx & PAGE_MASK]) {
+                return;
+            }
+            Page*& pg = dir_[p];
+            pg->levels[idx & PAGE_MASK] = nullptr;
+            if (--pg->used == 0) {
+                std::free(pg);
+                pg = nullptr;
+                --pages_;
+                trim();
+            }
+        }
+
+        std::size_t size() const { return range_; }
+
+        std::size_t pages() const { return pages_; }
+
+        std::size_t bytes() const {
+            return dir_.capacity() * sizeof(Page*) + pages_ * sizeof(Page);
+        }
+
+    private:
+        // extends the directory window so it covers page, keeping existing pages in place
+        void grow_to(std::size_t page) {
+            if (dir_.empty()) {
+                base_page_ = page;
+                dir_.assign(1, nullptr);
+                return;
+            }
+            if (page < base_page_) {
+                // room below page for as many pages as the window held, the next pages down are then O(1)
+                const std::size_t need = base_page_ - page;
+                const std::size_t room = std::min(page, dir_.size());
+                dir_.insert(dir_.begin(), need + room, nullptr);
+                base_page_ = page - room;
+            }
+            else {
+                dir_.resize(page - base_page_ + 1, nullptr);
+            }
+        }
+
+        // drops empty pages off both ends of the window. the front is only cut once it is three quarters of
+        // the window, above the half grow_to leaves there, so a page flickering at the low end does not
+        // pay for an O(n) erase and insert each time
+        void trim() {
+            while (!dir_.empty() && !dir_.back()) {
+                dir_.pop_back();
+            }
+            if (dir_.empty()) {
+                base_page_ = 0;
+                dir_.shrink_to_fit();
+                return;
+            }
+            std::size_t lead = 0;
+            while (!dir_[lead]) {
+                ++lead;
+            }
+            if (lead * 4 >= dir_.size() * 3) {
+                dir_.erase(dir_.begin(), dir_.begin() + static_cast<std::ptrdiff_t>(lead));
+                base_page_ += lead;
+            }
+            if (dir_.size() * 4 < dir_.capacity()) {
+                dir_.shrink_to_fit();
+            }
+        }
+
+        Page* new_page() {
+            void* mem = nullptr;
+            if (posix_memalign(&mem, 64, sizeof(Page)) != 0 || !mem) {
+                throw std::bad_alloc{};
+            }
+            auto* pg = static_cast<Page*>(mem);
+            for (auto& l : pg->levels) {
+                l = nullptr;
+            }
+            pg->used = 0;
+            ++pages_;
+            return pg;
+        }
+
+        std::size_t range_{};
+        std::size_t base_page_{0};
+        std::size_t pages_{0};
+        std::vector<Page*> dir_{};
+    };
+}
@@ -0,0 +1,139 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <utility>
+#include <vector>
+#include "flat_map.h"
+
+namespace jolt::ob {
+    // open addressing with robin hood insertion and backward shift deletion. erase leaves no tombstone,
+    // so probe lengths only depend on the live load and a long running map does not degrade the way
+    // FlatMap does under insert/erase churn. no key is reserved as a sentinel
+    template <typename KeyT, typename ValueT, typename HashT = std::hash<KeyT>>
+    class RobinMap {
+        struct Bucket {
+            KeyT key{};
+            ValueT val{};
+            // probe distance + 1, 0 marks an empty bucket
+            uint32_t dist{0};
+        };
+
+        float max_load_{};
+        HashT hasher_{};
+        std::vector<Bucket> buckets_{};
+        std::size_t mask_{0};
+        std::size_t size_{0};
+
+        void rehash(std::size_t new_cap) {
+            std::vector<Bucket> old(round_up_pow2(new_cap));
+            old.swap(buckets_);
+            mask_ = buckets_.size() - 1;
+            size_ = 0;
+            for (const Bucket& b : old) {
+                if (b.dist != 0) {
+                    place(b.key, b.val);
+                }
+            }
+        }
+
+        // key must not be present, returns the bucket it landed in
+        std::size_t place(const KeyT& key, const ValueT& value) {
+            Bucket carry{key, value, 1};
+            std::size_t idx = hasher_(key) & mask_;
+            std::size_t landed = static_cast<std::size_t>(-1);
+            for (;;) {
+                Bucket& b = buckets_[idx];
+                if (b.dist == 0) {
+                    b = carry;
+                    ++size_;
+                    return landed == static_cast<std::size_t>(-1) ? idx : landed;
+                }
+                // take the slot from an entry closer to its home
+                if (b.dist < carry.dist) {
+                    std::swap(b, carry);
+                    if (landed == static_cast<std::size_t>(-1)) {
+                        landed = idx;
+                    }
+                }
+                ++carry.dist;
+                idx = (idx + 1) & mask_;
+            }
+        }
+
+        std::size_t find_index(const KeyT& key) const noexcept {
+            std::size_t idx = hasher_(key) & mask_;
+            for (uint32_t dist = 1;; ++dist) {
+                const Bucket& b = buckets_[idx];
+                // an entry this far from home would have displaced anything poorer
+                if (b.dist < dist) {
+                    return static_cast<std::size_t>(-1);
+                }
+                if (b.dist == dist && b.key == key) {
+                    return idx;
+                }
+                idx = (idx + 1) & mask_;
+            }
+        }
+
+    public:
+        explicit RobinMap(std::size_t capacity = 1 << 10, float max_load = 0.8f)
+            : max_load_(max_load), buckets_(round_up_pow2(capacity)), mask_(buckets_.size() - 1) {
+        }
+
+        bool empty() const noexcept { return size_ == 0; }
+        std::size_t size() const noexcept { return size_; }
+        std::size_t capacity() const noexcept { return buckets_.size(); }
+        std::size_t bytes() const noexcept { return buckets_.size() * sizeof(Bucket); }
+
+        std::pair<ValueT&, bool> insert(const KeyT& key, const ValueT& value) {
+            const std::size_t found = find_index(key);
+            if (found != static_cast<std::size_t>(-1)) {
+                buckets_[found].val = value;
+                return {buckets_[found].val, false};
+            }
+            if (static_cast<float>(size_ + 1) > max_load_ * static_cast<float>(buckets_.size())) {
+                rehash(buckets_.size() << 1);
+            }
+            return {buckets_[place(key, value)].val, true};
+        }
+
+        ValueT* find(const KeyT& key) noexcept {
+            const std::size_t idx = find_index(key);
+            return idx == static_cast<std::size_t>(-1) ? nullptr : &buckets_[idx].val;
+        }
+
+        const ValueT* find(const KeyT& key) const noexcept {
+            const std::size_t idx = find_index(key);
+            return idx == static_cast<std::size_t>(-1) ? nullptr : &buckets_[idx].val;
+        }
+
+        std::size_t erase(const KeyT& key) noexcept {
+            std::size_t idx = find_index(key);
+            if (idx == static_cast<std::size_t>(-1)) {
+                return 0;
+            }
+            // pull the following displaced entries one step back towards home
+            for (;;) {
+                const std::size_t nx = (idx + 1) & mask_;
+                if (buckets_[nx].dist <= 1) {
+                    break;
+                }
+                buckets_[idx] = buckets_[nx];
+                --buckets_[idx].dist;
+                idx = nx;
+            }
+            buckets_[idx].dist = 0;
+            --size_;
+            return 1;
+        }
+
+        void reserve(std::size_t n) {
+            const auto want = static_cast<std::size_t>(static_cast<float>(n) / max_load_) + 1;
+            if (want > buckets_.size()) {
+                rehash(want);
+            }
+        }
+    };
+} // namespace jolt::ob
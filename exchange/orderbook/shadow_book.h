@@ -0,0 +1,194 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <vector>
+#include "bitset_index.h"
+#include "locator_table.h"
+#include "ob_types.h"
+
+namespace jolt::ob {
+    // L3 image of a book's resting limit orders, rebuilt by replaying its DeltaSink stream so snapshots
+    // can be cut away from the matching thread. levels are indexed like the book's ladders and keep their
+    // orders in time priority, so snapshot() yields exactly what MatchingOrderBook::get_snapshot would at
+    // the same seq
+    class ShadowBook {
+        static constexpr uint32_t kNil = std::numeric_limits<uint32_t>::max();
+
+        struct Node {
+            OrderId id{0};
+            Qty qty{0};
+            PriceTick px{0};
+            uint32_t prev{kNil};
+            uint32_t next{kNil};
+            Side side{Side::Buy};
+        };
+
+        struct Level {
+            uint32_t head{kNil};
+            uint32_t tail{kNil};
+        };
+
+        PriceTick min_tick_{};
+        PriceTick max_tick_{};
+        // best price first on both sides, bid index = max_tick - px, ask index = px - min_tick
+        std::vector<Level> bids_;
+        std::vector<Level> asks_;
+        BitsetIndex bid_bits_;
+        BitsetIndex ask_bits_;
+
+        std::vector<Node> nodes_;
+        uint32_t free_head_{kNil};
+        LocatorTable<uint32_t> index_{};
+        std::size_t bid_ct_{0};
+        std::size_t ask_ct_{0};
+        uint64_t seq_{0};
+
+        std::size_t index_of(Side side, PriceTick px) const {
+            return side == Side::Buy ? max_tick_ - px : px - min_tick_;
+        }
+
+        Level& level(Side side, std::size_t idx) { return side == Side::Buy ? bids_[idx] : asks_[idx]; }
+        BitsetIndex& bits(Side side) { return side == Side::Buy ? bid_bits_ : ask_bits_; }
+
+        uint32_t alloc_node() {
+            if (free_head_ != kNil) {
+                const uint32_t n = free_head_;
+                free_head_ = nodes_[n].next;
+                return n;
+            }
+            nodes_.emplace_back();
+            return static_cast<uint32_t>(nodes_.size() - 1);
+        }
+
+        void add(const BookDelta& d) {
+            if (d.price < min_tick_ || d.price > max_tick_ || d.qty == 0) {
+                return;
+            }
+            if (index_.find(d.id)) {
+                remove(d.id);
+            }
+            const uint32_t n = alloc_node();
+            const std::size_t idx = index_of(d.side, d.price);
+            Level& lvl = level(d.side, idx);
+            nodes_[n] = Node{d.id, d.qty, d.price, lvl.tail, kNil, d.side};
+            if (lvl.tail != kNil) {
+                nodes_[lvl.tail].next = n;
+            }
+            else {
+                lvl.head = n;
+                bits(d.side).set(idx);
+            }
+            lvl.tail = n;
+            index_.insert(d.id, n);
+            ++(d.side == Side::Buy ? bid_ct_ : ask_ct_);
+        }
+
+        void remove(OrderId id) {
+            const uint32_t* found = index_.find(id);
+            if (!found) {
+                return;
+            }
+            const uint32_t n = *found;
+            index_.erase(id);
+
+            Node& node = nodes_[n];
+            const std::size_t idx = index_of(node.side, node.px);
+            Level& lvl = level(node.side, idx);
+            if (node.prev != kNil) {
+                nodes_[node.prev].next = node.next;
+            }
+            else {
+                lvl.head = node.next;
+            }
+            if (node.next != kNil) {
+                nodes_[node.next].prev = node.prev;
+            }
+            else {
+                lvl.tail = node.prev;
+            }
+            if (lvl.head == kNil) {
+                bits(node.side).clear(idx);
+            }
+            --(node.side == Side::Buy ? bid_ct_ : ask_ct_);
+
+            node.prev = kNil;
+            node.next = free_head_;
+            free_head_ = n;
+        }
+
+        template <typename Fn>
+        void walk(const std::vector<Level>& levels, const BitsetIndex& occupied, Fn&& fn) const {
+            for (auto i = occupied.next_set(0); i != BitsetIndex::npos; i = occupied.next_set(i + 1)) {
+                for (uint32_t n = levels[i].head; n != kNil; n = nodes_[n].next) {
+                    fn(nodes_[n]);
+                }
+            }
+        }
+
+    public:
+        ShadowBook(PriceTick min_tick, PriceTick max_tick)
+            : min_tick_(min_tick), max_tick_(max_tick), bids_(max_tick - min_tick + 1), asks_(max_tick - min_tick + 1),
+              bid_bits_(max_tick - min_tick + 1), ask_bits_(max_tick - min_tick + 1) {
+            nodes_.reserve(1 << 16);
+        }
+
+        void apply(const BookDelta& d) {
+            switch (d.type) {
+            case DeltaType::Add:
+                add(d);
+                break;
+            case DeltaType::Update:
+                if (d.qty == 0) {
+                    remove(d.id);
+                }
+                else if (const uint32_t* n = index_.find(d.id)) {
+                    nodes_[*n].qty = d.qty;
+                }
+                break;
+            case DeltaType::Remove:
+                remove(d.id);
+                break;
+            }
+            seq_ = d.seq;
+        }
+
+        // drops every order, for a reseed from the book
+        void clear() {
+            for (const Side side : {Side::Buy, Side::Sell}) {
+                std::vector<Level>& levels = side == Side::Buy ? bids_ : asks_;
+                BitsetIndex& occupied = bits(side);
+                for (auto i = occupied.next_set(0); i != BitsetIndex::npos; i = occupied.next_set(i + 1)) {
+                    for (uint32_t n = levels[i].head; n != kNil; n = nodes_[n].next) {
+                        index_.erase(nodes_[n].id);
+                    }
+                    levels[i] = Level{};
+                    occupied.clear(i);
+                }
+            }
+            nodes_.clear();
+            free_head_ = kNil;
+            bid_ct_ = 0;
+            ask_ct_ = 0;
+        }
+
+        // seq of the order behind the last applied delta
+        uint64_t seq() const { return seq_; }
+        std::size_t size() const { return bid_ct_ + ask_ct_; }
+
+        void snapshot(BookSnapshot& out) const {
+            out.orders.clear();
+            out.orders.reserve(bid_ct_ + ask_ct_);
+            walk(bids_, bid_bits_, [&](const Node& n) {
+                out.orders.push_back(SnapshotOrder{n.id, n.qty, n.px, Side::Buy});
+            });
+            walk(asks_, ask_bits_, [&](const Node& n) {
+                out.orders.push_back(SnapshotOrder{n.id, n.qty, n.px, Side::Sell});
+            });
+            out.bid_ct = bid_ct_;
+            out.ask_ct = ask_ct_;
+            out.seq = seq_;
+        }
+    };
+}
@@ -0,0 +1,179 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <limits>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "Types.h"
+
+namespace jolt {
+    struct Instrument {
+        uint16_t symbol_id{0};
+        ob::PriceTick min_tick{0};
+        ob::PriceTick max_tick{0};
+        uint32_t lot_size{1};
+        uint16_t shard{0};
+
+        // whether every price the order carries lies in [min_tick, max_tick], the range the books index
+        // their ladders and trigger sets by: a limit's price, a stop's or take-profit's trigger and limit,
+        // the stop-loss and take-profit legs attached to a new order and a modify's new price
+        bool prices_in_range(const ob::OrderParams& order) const {
+            const auto in_range = [this](ob::PriceTick px) { return px >= min_tick && px <= max_tick; };
+            switch (order.action) {
+            case ob::OrderAction::Cancel:
+            case ob::OrderAction::MassCancel:
+                return true;
+            case ob::OrderAction::Modify:
+                // qty 0 cancels and the price is not used. for stops the new price is the trigger
+                return order.qty == 0 || in_range(order.price);
+            case ob::OrderAction::New:
+                break;
+            }
+            bool ok = true;
+            switch (order.type) {
+            case ob::OrderType::Limit:
+                ok = in_range(order.price);
+                break;
+            case ob::OrderType::Market:
+                break;
+            case ob::OrderType::StopMarket:
+                ok = in_range(order.trigger);
+                break;
+            case ob::OrderType::StopLimit:
+            case ob::OrderType::TakeProfit:
+                ok = in_range(order.trigger) && in_range(order.limit_px);
+                break;
+            }
+            if (order.sl_id != 0 && order.sl_trigger != 0) {
+                ok = ok && in_range(order.sl_trigger) &&
+                    (order.sl_post_type != ob::OrderType::StopLimit || in_range(order.sl_limit_px));
+            }
+            if (order.tp_id != 0 && order.tp_trigger != 0 && order.tp_limit_px != 0) {
+                ok = ok && in_range(order.tp_trigger) && in_range(order.tp_limit_px);
+            }
+            return ok;
+        }
+    };
+
+    // instruments known to the venue, loaded once at startup. every component sizes its per-symbol
+    // state by size() and maps symbol ids to a dense [0, size()) index with index_of, which is a
+    // single array load on the hot path
+    class InstrumentRegistry {
+    public:
+        static constexpr size_t npos = std::numeric_limits<size_t>::max();
+
+        InstrumentRegistry() = default;
+
+        // flat file, one instrument per line: <symbol_id> <min_tick> <max_tick> <lot_size> <shard>
+        // blank lines and lines starting with '#' are ignored
+        static InstrumentRegistry load(const std::string& path) {
+            std::ifstream in(path);
+            if (!in) {
+                throw std::runtime_error("failed to open instrument file: " + path);
+            }
+
+            InstrumentRegistry reg;
+            std::string line;
+            size_t line_no = 0;
+            while (std::getline(in, line)) {
+                ++line_no;
+                const size_t first = line.find_first_not_of(" \t\r");
+                if (first == std::string::npos || line[first] == '#') {
+                    continue;
+                }
+
+                std::istringstream fields(line);
+                uint64_t symbol_id = 0;
+                uint64_t min_tick = 0;
+                uint64_t max_tick = 0;
+                uint64_t lot_size = 0;
+                uint64_t shard = 0;
+                if (!(fields >> symbol_id >> min_tick >> max_tick >> lot_size >> shard)) {
+                    throw std::runtime_error("malformed instrument at " + path + ":" + std::to_string(line_no));
+                }
+                if (symbol_id == 0 || symbol_id > std::numeric_limits<uint16_t>::max() ||
+                    max_tick > std::numeric_limits<ob::PriceTick>::max() || min_tick == 0 || min_tick > max_tick ||
+                    lot_size == 0 || lot_size > std::numeric_limits<uint32_t>::max() ||
+                    shard > std::numeric_limits<uint16_t>::max()) {
+                    throw std::runtime_error("invalid instrument at " + path + ":" + std::to_string(line_no));
+                }
+
+                Instrument inst{};
+                inst.symbol_id = static_cast<uint16_t>(symbol_id);
+                inst.min_tick = static_cast<ob::PriceTick>(min_tick);
+                inst.max_tick = static_cast<ob::PriceTick>(max_tick);
+                inst.lot_size = static_cast<uint32_t>(lot_size);
+                inst.shard = static_cast<uint16_t>(shard);
+                reg.add(inst);
+            }
+
+            if (reg.size() == 0) {
+                throw std::runtime_error("instrument file has no instruments: " + path);
+            }
+            return reg;
+        }
+
+        // kNumSymbols symbols starting at kFirstSymbolId sharing one tick range, round robin over shards
+        static InstrumentRegistry make_default(ob::PriceTick min_tick, ob::PriceTick max_tick, size_t num_shards = 1) {
+            InstrumentRegistry reg;
+            for (size_t i = 0; i < kNumSymbols; ++i) {
+                Instrument inst{};
+                inst.symbol_id = static_cast<uint16_t>(kFirstSymbolId + i);
+                inst.min_tick = min_tick;
+                inst.max_tick = max_tick;
+                inst.lot_size = 1;
+                inst.shard = static_cast<uint16_t>(num_shards <= 1 ? 0 : i % num_shards);
+                reg.add(inst);
+            }
+            return reg;
+        }
+
+        void add(const Instrument& inst) {
+            if (inst.symbol_id >= index_.size()) {
+                index_.resize(static_cast<size_t>(inst.symbol_id) + 1, kNoIndex);
+            }
+            if (instruments_.size() >= kNoIndex) {
+                throw std::runtime_error("too many instruments");
+            }
+            if (index_[inst.symbol_id] != kNoIndex) {
+                throw std::runtime_error("duplicate instrument symbol_id=" + std::to_string(inst.symbol_id));
+            }
+            index_[inst.symbol_id] = static_cast<uint16_t>(instruments_.size());
+            instruments_.push_back(inst);
+            if (static_cast<size_t>(inst.shard) + 1 > num_shards_) {
+                num_shards_ = static_cast<size_t>(inst.shard) + 1;
+            }
+        }
+
+        inline size_t index_of(uint64_t symbol_id) const {
+            if (symbol_id >= index_.size()) {
+                return npos;
+            }
+            const uint16_t idx = index_[symbol_id];
+            return idx == kNoIndex ? npos : idx;
+        }
+
+        inline bool contains(uint64_t symbol_id) const { return index_of(symbol_id) != npos; }
+
+        inline const Instrument& at(size_t idx) const { return instruments_[idx]; }
+
+        size_t size() const { return instruments_.size(); }
+
+        // number of shards referenced by the file (max shard + 1)
+        size_t num_shards() const { return num_shards_; }
+
+        const std::vector<Instrument>& instruments() const { return instruments_; }
+
+    private:
+        static constexpr uint16_t kNoIndex = std::numeric_limits<uint16_t>::max();
+
+        std::vector<Instrument> instruments_{};
+        std::vector<uint16_t> index_{};
+        size_t num_shards_{0};
+    };
+}
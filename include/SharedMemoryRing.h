@@ -386,6 +386,25 @@ public:
         return &(*base_)[curr_tail];
     }
 
+    // batch variant of alloc/push: returns the slot `offset` entries past the tail if there is room for
+    // offset + 1 entries, nothing becomes visible to the reader until push(n)
+    T* alloc(size_t offset) {
+        const size_t curr_tail = header_->writer_.write_index.load(std::memory_order_relaxed);
+        if (((writer_cache_.read_index_cache_ - curr_tail - 1) & kMask) <= offset) {
+            writer_cache_.read_index_cache_ = header_->reader_.read_index.load(std::memory_order_acquire);
+            if (((writer_cache_.read_index_cache_ - curr_tail - 1) & kMask) <= offset) {
+                return nullptr;
+            }
+        }
+
+        return &(*base_)[(curr_tail + offset) & kMask];
+    }
+
+    void push(size_t n) {
+        const size_t curr_tail = header_->writer_.write_index.load(std::memory_order_relaxed);
+        header_->writer_.write_index.store((curr_tail + n) & kMask, std::memory_order_release);
+    }
+
     template <typename Writer>
     bool try_push(Writer writer) {
         T* ptr = alloc();
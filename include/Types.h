@@ -2,16 +2,47 @@
 #include <array>
 #include <cstddef>
 #include <cstdint>
+#include <string>
+#include <string_view>
 
 #include "../exchange/orderbook/ob_types.h"
 
 namespace jolt {
+    // default instrument set used when no instrument file is given, see InstrumentRegistry::make_default
     inline constexpr uint16_t kFirstSymbolId = 1;
     inline constexpr size_t kNumSymbols = 4;
-    inline constexpr uint16_t kLastSymbolId = static_cast<uint16_t>(kFirstSymbolId + kNumSymbols - 1);
 
-    inline constexpr bool is_valid_symbol_id(const uint64_t symbol_id) {
-        return symbol_id >= kFirstSymbolId && symbol_id <= kLastSymbolId;
+    // shared memory name of a shard's private ring, e.g. order_entry_q_2
+    inline std::string shard_queue_name(const std::string& base, const size_t shard) {
+        return base + "_" + std::to_string(shard);
+    }
+
+    // entry gateway workers, each with its own rings to every matching thread
+    inline constexpr size_t kMaxGatewayWorkers = 16;
+
+    // shared memory name of a gateway worker's ring, worker 0 keeps the plain name, e.g. order_entry_q_2_w1
+    inline std::string worker_queue_name(const std::string& base, const size_t worker) {
+        return worker == 0 ? base : base + "_w" + std::to_string(worker);
+    }
+
+    // worker w of n hands out the order ids w + 1, w + 1 + n, ... so responses go back to it by id, and the
+    // ids of one worker keep to their own slots of a book's direct indexed order window
+    inline size_t gateway_worker_of(const uint64_t order_id, const size_t num_workers) {
+        return num_workers <= 1 || order_id == 0 ? 0 : static_cast<size_t>((order_id - 1) % num_workers);
+    }
+
+    // the gateway worker a logical session (its SenderCompID) logs on to, it listens on base port + worker.
+    // fnv-1a, stable across processes so clients can pick the port themselves
+    inline size_t session_worker_of(const std::string_view sender_comp_id, const size_t num_workers) {
+        if (num_workers <= 1) {
+            return 0;
+        }
+        uint64_t hash = 14695981039346656037ull;
+        for (const unsigned char c : sender_comp_id) {
+            hash ^= c;
+            hash *= 1099511628211ull;
+        }
+        return static_cast<size_t>(hash % num_workers);
     }
 
     using Side = ob::Side;
@@ -26,7 +57,7 @@ namespace jolt {
     };
 
     struct ExchToGtwyMsg {
-        enum class Type : uint8_t {Submitted = 0, Rejected = 1, Filled = 2};
+        enum class Type : uint8_t {Submitted = 0, Rejected = 1, Filled = 2, Cancelled = 3};
         uint64_t client_id;
         uint64_t order_id;
         size_t fill_qty;
@@ -40,13 +71,69 @@ namespace jolt {
         uint64_t client_id{0};
     };
 
-    struct ExchangeToRiskMsg {
-        ob::OrderParams order{};
-        std::array<ob::BookEvent, 1024> fill_events_{};
+    // one record per event on the exchange -> risk ring, sized to a single cache line. all fills of one
+    // aggressive order are published back to back with kLastInBatch on the final one, so the reader can
+    // apply a taker's batch before checking limits without a separate header record.
+    // Accept/Cancel describe an order resting in the book or leaving it (a limit, stop or take-profit) and only
+    // use the maker_* fields and symbol_id
+    struct alignas(64) ExchangeToRiskMsg {
+        enum class Type : uint8_t {Fill = 0, Accept = 1, Cancel = 2};
+        static constexpr uint8_t kLastInBatch = 1 << 0;
+        static constexpr uint8_t kMakerDone = 1 << 1;
+
+        uint64_t maker_order_id{0};
+        uint64_t taker_order_id{0};
+        uint64_t maker_client_id{0};
+        uint64_t taker_client_id{0};
+        uint64_t seq{0};
         uint64_t ts{0};
-        uint64_t num_fills{0};
-        uint32_t bid{0};
-        uint32_t ask{0};
+        ob::PriceTick price{0};
+        ob::Qty qty{0};
+        uint16_t symbol_id{0};
+        uint16_t batch_count{0};
+        Side side{Side::Buy}; // taker side on fills
+        Type type{Type::Fill};
+        uint8_t flags{0};
+
+        bool last_in_batch() const { return (flags & kLastInBatch) != 0; }
+        bool maker_done() const { return (flags & kMakerDone) != 0; }
+    };
+    static_assert(sizeof(ExchangeToRiskMsg) == 64, "risk record must fit one cache line");
+
+    // a resting order change from a matching thread to the snapshot service. an order's deltas are
+    // published together with kLastInOrder on the final one, the service only cuts snapshots between them.
+    // a kResync record carries no order: the symbol's shadow book is cleared and the book's resting orders
+    // follow as Adds, id is the count of dropped deltas it makes up for
+    struct SnapshotDeltaMsg {
+        static constexpr uint8_t kLastInOrder = 1 << 0;
+        static constexpr uint8_t kResync = 1 << 1;
+
+        uint64_t id{0};
+        uint64_t seq{0};
+        ob::Qty qty{0};
+        ob::PriceTick price{0};
+        uint16_t symbol_id{0};
+        Side side{Side::Buy};
+        ob::DeltaType type{ob::DeltaType::Add};
+        uint8_t flags{0};
+
+        bool last_in_order() const { return (flags & kLastInOrder) != 0; }
+        bool resync() const { return (flags & kResync) != 0; }
+    };
+    static_assert(sizeof(SnapshotDeltaMsg) == 32, "delta record is half a cache line");
+
+    // levels per side on the L2 channel
+    inline constexpr size_t kL2Levels = 10;
+
+    // top of a book as published on the L2 channel, one per symbol in a SeqlockTable. seq is the book
+    // seq of the order that last changed it, bids and asks are best first
+    struct L2Frame {
+        uint64_t seq{0};
+        uint16_t symbol_id{0};
+        uint8_t bid_ct{0};
+        uint8_t ask_ct{0};
+        std::array<ob::DepthLevel, kL2Levels> bids{};
+        std::array<ob::DepthLevel, kL2Levels> asks{};
     };
 
     struct RiskToExchMsg {
@@ -63,6 +150,8 @@ namespace jolt {
         int64_t net_pos;
         int64_t max_notional;
         float capital;
+        int64_t notional; // sum over symbols of |position| * last fill px
+        bool killed;
     };
 
     struct FillEvent {
@@ -82,6 +171,21 @@ namespace jolt {
         std::array<std::byte,4096> chunk;
     };
 
+    // one entry of a matching thread's input journal: an order exactly as it was handed to its book, or
+    // the day roll that reset the book seqs. lsn counts records from 1 per journal, checksum covers every
+    // other byte of the record so a torn tail is found on replay
+    struct JournalRecord {
+        enum class Kind : uint8_t { Order = 0, DayRoll = 1 };
+
+        uint64_t lsn{0};
+        // DayRoll: the new day id
+        uint64_t day{0};
+        uint32_t checksum{0};
+        Kind kind{Kind::Order};
+        ob::OrderParams order{};
+    };
+    static_assert(sizeof(JournalRecord) == 112, "journal files assume a 112 byte record");
+
     struct L3DiskRecord {
         uint64_t seq;
         uint64_t ts;
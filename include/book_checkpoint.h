@@ -0,0 +1,419 @@
+#pragma once
+
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <mutex>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "input_journal.h"
+#include "../exchange/orderbook/book_image.h"
+
+struct CheckpointOptions {
+    // a checkpoint is taken once the last one is this old, zero turns checkpoints off
+    std::chrono::milliseconds interval{60'000};
+};
+
+// one book of a checkpoint, symbol_id names the instrument it belongs to
+struct CheckpointBook {
+    uint16_t symbol_id{0};
+    jolt::ob::BookImage image{};
+};
+
+namespace checkpoint_detail {
+    inline constexpr uint64_t kMagic = 0x54504B43544C4F4AULL; // "JOLTCKPT"
+    inline constexpr uint32_t kVersion = 1;
+    // every section starts on a cache line, so the slot arrays can be used in place from a mapping
+    inline constexpr size_t kAlign = 64;
+
+    inline constexpr size_t align_up(size_t n) { return (n + kAlign - 1) & ~(kAlign - 1); }
+
+    struct FileHeader {
+        uint64_t magic{0};
+        uint32_t version{0};
+        uint32_t books{0};
+        // the books hold every journal record up to lsn and none after it
+        uint64_t lsn{0};
+        uint64_t day{0};
+        uint64_t bytes{0};
+        uint64_t checksum{0};
+    };
+
+    struct BookHeader {
+        jolt::ob::ImageHeader image{};
+        uint64_t runs{0};
+        uint64_t orders{0};
+        uint64_t stops{0};
+        uint64_t tps{0};
+        uint16_t symbol_id{0};
+    };
+
+    inline uint64_t header_checksum(FileHeader h) {
+        h.checksum = 0;
+        uint64_t words[sizeof(FileHeader) / 8];
+        std::memcpy(words, &h, sizeof(h));
+        uint64_t x = 0x9E3779B97F4A7C15ull;
+        for (const uint64_t w : words) {
+            x = (x ^ w) * 0xFF51AFD7ED558CCDull;
+            x ^= x >> 29;
+        }
+        return x;
+    }
+
+    inline std::runtime_error errno_error(const char* what, const std::string& path) {
+        return std::runtime_error(std::string(what) + ": " + path + ": " + std::strerror(errno));
+    }
+}
+
+// writes checkpoints of a matching thread's books from its own thread. the matching thread fills
+// books() with save_image between two orders, which is the only time it spends on a checkpoint, and
+// hands them over with submit(). the images stay in books() from one checkpoint to the next, so each
+// save_image only copies the levels of its book that changed since. the writer waits until the input journal is durable through the
+// checkpoint's lsn, so a checkpoint never holds input a crash could take out of the journal, then
+// writes a temp file, syncs it and renames it over the last one. a crash mid write leaves the previous
+// checkpoint in place
+class CheckpointWriter {
+    // due() reads the clock once per this many polls
+    static constexpr uint32_t kPollStride = 256;
+
+    std::string path_;
+    CheckpointOptions opts_;
+    const InputJournal* journal_{nullptr};
+    std::vector<CheckpointBook> books_;
+    uint64_t lsn_{0};
+    uint64_t day_{0};
+    uint32_t polls_{0};
+    std::chrono::steady_clock::time_point last_{std::chrono::steady_clock::now()};
+
+    std::mutex mu_;
+    std::condition_variable cv_;
+    bool pending_{false};
+    bool stopping_{false};
+    std::atomic<bool> busy_{false};
+    std::atomic<uint64_t> written_{0};
+    std::atomic<uint64_t> written_lsn_{0};
+    std::atomic<uint64_t> failed_{0};
+    std::thread thread_;
+
+    void run() {
+        for (;;) {
+            {
+                std::unique_lock lk(mu_);
+                cv_.wait(lk, [&] { return pending_ || stopping_; });
+                if (!pending_) {
+                    return;
+                }
+            }
+            bool publish = true;
+            while (journal_ && journal_->durable_lsn() < lsn_) {
+                {
+                    std::lock_guard lk(mu_);
+                    if (stopping_) {
+                        // the journal will not get there any more, keep the previous checkpoint
+                        publish = false;
+                        break;
+                    }
+                }
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            }
+            if (publish) {
+                try {
+                    write_file();
+                    written_lsn_.store(lsn_, std::memory_order_release);
+                    written_.fetch_add(1, std::memory_order_release);
+                }
+                catch (const std::exception& e) {
+                    // the previous checkpoint stays valid, the next interval tries again
+                    std::fprintf(stderr, "[CheckpointWriter] %s\n", e.what());
+                    failed_.fetch_add(1, std::memory_order_release);
+                }
+            }
+            {
+                std::lock_guard lk(mu_);
+                pending_ = false;
+            }
+            busy_.store(false, std::memory_order_release);
+            cv_.notify_all();
+        }
+    }
+
+    static void write_all(int fd, const void* data, size_t bytes, const std::string& path) {
+        auto* p = static_cast<const std::byte*>(data);
+        while (bytes > 0) {
+            const ssize_t n = ::write(fd, p, bytes);
+            if (n < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                throw checkpoint_detail::errno_error("checkpoint write failed", path);
+            }
+            p += n;
+            bytes -= static_cast<size_t>(n);
+        }
+    }
+
+    // writes bytes and pads to the next section boundary
+    static void write_section(int fd, const void* data, size_t bytes, const std::string& path) {
+        static constexpr std::byte kZeros[checkpoint_detail::kAlign]{};
+        write_all(fd, data, bytes, path);
+        write_all(fd, kZeros, checkpoint_detail::align_up(bytes) - bytes, path);
+    }
+
+    // writes the chunks of an image's runs of one kind back to back in run order, as one padded section
+    template <typename SlotT>
+    static void write_chunks(int fd, const jolt::ob::BookImage& image, const jolt::ob::ImageChunks<SlotT>& store,
+                             jolt::ob::ImageRun::Kind kind, const std::string& path) {
+        static constexpr std::byte kZeros[checkpoint_detail::kAlign]{};
+        size_t bytes = 0;
+        for (size_t i = 0; i < image.runs.size(); ++i) {
+            if (image.runs[i].kind != kind) {
+                continue;
+            }
+            const std::vector<SlotT>& chunk = store.chunks[image.run_chunks[i]];
+            write_all(fd, chunk.data(), chunk.size() * sizeof(SlotT), path);
+            bytes += chunk.size() * sizeof(SlotT);
+        }
+        write_all(fd, kZeros, checkpoint_detail::align_up(bytes) - bytes, path);
+    }
+
+    void write_file() {
+        using namespace checkpoint_detail;
+        FileHeader fh{};
+        fh.magic = kMagic;
+        fh.version = kVersion;
+        fh.books = static_cast<uint32_t>(books_.size());
+        fh.lsn = lsn_;
+        fh.day = day_;
+        fh.bytes = align_up(sizeof(FileHeader));
+        for (const CheckpointBook& b : books_) {
+            fh.bytes += align_up(sizeof(BookHeader)) + align_up(b.image.runs.size() * sizeof(jolt::ob::ImageRun)) +
+                align_up(b.image.orders.slots * sizeof(jolt::ob::OrderSlot)) +
+                align_up(b.image.stops.slots * sizeof(jolt::ob::StopSlot)) +
+                align_up(b.image.tps.slots * sizeof(jolt::ob::TpSlot));
+        }
+        fh.checksum = header_checksum(fh);
+
+        const std::string tmp = path_ + ".tmp";
+        const int fd = ::open(tmp.c_str(), O_CREAT | O_TRUNC | O_WRONLY | O_CLOEXEC, 0644);
+        if (fd < 0) {
+            throw errno_error("checkpoint open failed", tmp);
+        }
+        try {
+            write_section(fd, &fh, sizeof(fh), tmp);
+            for (const CheckpointBook& b : books_) {
+                BookHeader bh{};
+                bh.image = b.image.header;
+                bh.runs = b.image.runs.size();
+                bh.orders = b.image.orders.slots;
+                bh.stops = b.image.stops.slots;
+                bh.tps = b.image.tps.slots;
+                bh.symbol_id = b.symbol_id;
+                write_section(fd, &bh, sizeof(bh), tmp);
+                write_section(fd, b.image.runs.data(), bh.runs * sizeof(jolt::ob::ImageRun), tmp);
+                write_chunks(fd, b.image, b.image.orders, jolt::ob::ImageRun::Kind::Active, tmp);
+                write_chunks(fd, b.image, b.image.stops, jolt::ob::ImageRun::Kind::Stop, tmp);
+                write_chunks(fd, b.image, b.image.tps, jolt::ob::ImageRun::Kind::TakeProfit, tmp);
+            }
+            if (::fdatasync(fd) != 0) {
+                throw errno_error("checkpoint fdatasync failed", tmp);
+            }
+        }
+        catch (...) {
+            ::close(fd);
+            throw;
+        }
+        ::close(fd);
+        if (::rename(tmp.c_str(), path_.c_str()) != 0) {
+            throw errno_error("checkpoint rename failed", path_);
+        }
+        // the rename itself is only durable once the directory is
+        const std::filesystem::path parent = std::filesystem::path(path_).parent_path();
+        const int dfd = ::open(parent.empty() ? "." : parent.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+        if (dfd >= 0) {
+            (void)::fsync(dfd);
+            ::close(dfd);
+        }
+    }
+
+public:
+    // journal is the input journal of the same matching thread, null to publish without waiting on one
+    CheckpointWriter(std::string path, const CheckpointOptions& opts, const InputJournal* journal)
+        : path_(std::move(path)), opts_(opts), journal_(journal) {
+        const std::filesystem::path parent = std::filesystem::path(path_).parent_path();
+        if (!parent.empty()) {
+            std::filesystem::create_directories(parent);
+        }
+        thread_ = std::thread([this] { run(); });
+    }
+
+    ~CheckpointWriter() {
+        {
+            std::lock_guard lk(mu_);
+            stopping_ = true;
+        }
+        cv_.notify_all();
+        if (thread_.joinable()) {
+            thread_.join();
+        }
+    }
+
+    CheckpointWriter(const CheckpointWriter&) = delete;
+    CheckpointWriter& operator=(const CheckpointWriter&) = delete;
+
+    const std::string& path() const { return path_; }
+    bool enabled() const { return opts_.interval.count() > 0; }
+    // checkpoints published so far, and the lsn of the newest
+    uint64_t written() const { return written_.load(std::memory_order_acquire); }
+    uint64_t written_lsn() const { return written_lsn_.load(std::memory_order_acquire); }
+    uint64_t failed() const { return failed_.load(std::memory_order_acquire); }
+
+    // matching thread, once per poll: true when the interval has passed and the last checkpoint is out
+    bool due() {
+        if (++polls_ % kPollStride != 0 || !enabled() || busy_.load(std::memory_order_acquire)) {
+            return false;
+        }
+        return std::chrono::steady_clock::now() - last_ >= opts_.interval;
+    }
+
+    // the books of the next checkpoint, only touched by the matching thread while no write is in progress
+    std::vector<CheckpointBook>& books() { return books_; }
+
+    // hands books() to the writer thread. lsn is the last journal record they contain
+    void submit(uint64_t lsn, uint64_t day) {
+        wait_idle();
+        busy_.store(true, std::memory_order_release);
+        {
+            std::lock_guard lk(mu_);
+            lsn_ = lsn;
+            day_ = day;
+            pending_ = true;
+        }
+        last_ = std::chrono::steady_clock::now();
+        cv_.notify_all();
+    }
+
+    // blocks until the last submitted checkpoint is written or dropped
+    void wait_idle() {
+        std::unique_lock lk(mu_);
+        cv_.wait(lk, [&] { return !pending_; });
+    }
+};
+
+// a checkpoint file mapped read only. the book views point into the mapping and stay valid for the
+// object's life, a missing file is an empty checkpoint at lsn 0
+class CheckpointFile {
+public:
+    struct Book {
+        uint16_t symbol_id{0};
+        jolt::ob::BookImageView view{};
+    };
+
+private:
+    void* map_{nullptr};
+    size_t bytes_{0};
+    uint64_t lsn_{0};
+    uint64_t day_{0};
+    std::vector<Book> books_;
+
+    template <typename T>
+    std::span<const T> section(size_t& off, uint64_t count) const {
+        const size_t bytes = count * sizeof(T);
+        if (count > bytes_ / sizeof(T) || off + bytes > bytes_) {
+            throw std::runtime_error("checkpoint file truncated");
+        }
+        const auto* p = reinterpret_cast<const T*>(static_cast<const std::byte*>(map_) + off);
+        off += checkpoint_detail::align_up(bytes);
+        return {p, static_cast<size_t>(count)};
+    }
+
+    void parse(const std::string& path) {
+        using namespace checkpoint_detail;
+        FileHeader fh{};
+        std::memcpy(&fh, map_, sizeof(fh));
+        if (fh.magic != kMagic || fh.version != kVersion || fh.checksum != header_checksum(fh) ||
+            fh.bytes != bytes_) {
+            throw std::runtime_error("checkpoint header invalid: " + path);
+        }
+        lsn_ = fh.lsn;
+        day_ = fh.day;
+        size_t off = align_up(sizeof(FileHeader));
+        books_.reserve(fh.books);
+        for (uint32_t i = 0; i < fh.books; ++i) {
+            const BookHeader bh = section<BookHeader>(off, 1)[0];
+            Book b{};
+            b.symbol_id = bh.symbol_id;
+            b.view.header = bh.image;
+            b.view.runs = section<jolt::ob::ImageRun>(off, bh.runs);
+            b.view.orders = section<jolt::ob::OrderSlot>(off, bh.orders);
+            b.view.stops = section<jolt::ob::StopSlot>(off, bh.stops);
+            b.view.tps = section<jolt::ob::TpSlot>(off, bh.tps);
+            books_.push_back(b);
+        }
+    }
+
+
+public:
+    explicit CheckpointFile(const std::string& path) {
+        using namespace checkpoint_detail;
+        const int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0) {
+            if (errno == ENOENT) {
+                return;
+            }
+            throw errno_error("checkpoint open failed", path);
+        }
+        struct stat st{};
+        if (::fstat(fd, &st) != 0) {
+            ::close(fd);
+            throw errno_error("checkpoint stat failed", path);
+        }
+        bytes_ = static_cast<size_t>(st.st_size);
+        if (bytes_ < sizeof(FileHeader)) {
+            ::close(fd);
+            throw std::runtime_error("checkpoint file too small: " + path);
+        }
+        // populated up front, the loader walks every page once in order
+        map_ = ::mmap(nullptr, bytes_, PROT_READ, MAP_PRIVATE | MAP_POPULATE, fd, 0);
+        ::close(fd);
+        if (map_ == MAP_FAILED) {
+            map_ = nullptr;
+            throw errno_error("checkpoint mmap failed", path);
+        }
+
+        try {
+            parse(path);
+        }
+        catch (...) {
+            ::munmap(map_, bytes_);
+            map_ = nullptr;
+            throw;
+        }
+    }
+
+    ~CheckpointFile() {
+        if (map_) {
+            ::munmap(map_, bytes_);
+        }
+    }
+
+    CheckpointFile(const CheckpointFile&) = delete;
+    CheckpointFile& operator=(const CheckpointFile&) = delete;
+
+    bool empty() const { return map_ == nullptr; }
+    uint64_t lsn() const { return lsn_; }
+    uint64_t day() const { return day_; }
+    const std::vector<Book>& books() const { return books_; }
+};
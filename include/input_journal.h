@@ -0,0 +1,370 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <limits>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <liburing.h>
+#include "Types.h"
+
+struct JournalOptions {
+    // the open batch is committed once its first record is this old, bounding what a crash can lose
+    std::chrono::microseconds window{200};
+    // or as soon as it holds this many records
+    size_t batch_records{1024};
+    // fdatasync linked behind every batch write. off leaves durability to the page cache
+    bool sync{true};
+};
+
+// checksum of every byte of the record except the checksum field
+inline uint32_t journal_checksum(const jolt::JournalRecord& r) noexcept {
+    static_assert(sizeof(jolt::JournalRecord) % 8 == 0);
+    std::array<uint64_t, sizeof(jolt::JournalRecord) / 8> words{};
+    std::memcpy(words.data(), &r, sizeof(r));
+    constexpr size_t kChecksumWord = offsetof(jolt::JournalRecord, checksum) / 8;
+    words[kChecksumWord] &= ~(0xFFFFFFFFull << (offsetof(jolt::JournalRecord, checksum) % 8 * 8));
+    uint64_t h = 0x9E3779B97F4A7C15ull;
+    for (const uint64_t w : words) {
+        h = (h ^ w) * 0xFF51AFD7ED558CCDull;
+        h ^= h >> 29;
+    }
+    return static_cast<uint32_t>(h ^ (h >> 32));
+}
+
+// reads a journal file front to back in large chunks. stops at the first record that is torn, fails its
+// checksum or breaks the lsn sequence, everything before it is the valid journal
+class JournalReader {
+    static constexpr size_t kChunkRecords = 1 << 15;
+
+    int fd_{-1};
+    std::vector<jolt::JournalRecord> buf_;
+
+public:
+    struct Stats {
+        uint64_t records{0};
+        uint64_t last_lsn{0};
+        // byte offset one past the last valid record
+        uint64_t end_offset{0};
+    };
+
+    explicit JournalReader(const std::string& path) : buf_(kChunkRecords) {
+        fd_ = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd_ < 0 && errno != ENOENT) {
+            throw std::runtime_error("journal open failed: " + path + ": " + std::strerror(errno));
+        }
+    }
+
+    ~JournalReader() {
+        if (fd_ >= 0) {
+            ::close(fd_);
+        }
+    }
+
+    JournalReader(const JournalReader&) = delete;
+    JournalReader& operator=(const JournalReader&) = delete;
+
+    // calls fn(record) for every valid record with lsn > after_lsn, in journal order. a missing file is
+    // an empty journal
+    template <typename Fn>
+    Stats replay(uint64_t after_lsn, Fn&& fn) {
+        Stats st{};
+        if (fd_ < 0) {
+            return st;
+        }
+        uint64_t offset = 0;
+        for (;;) {
+            const ssize_t got = ::pread(fd_, buf_.data(), buf_.size() * sizeof(jolt::JournalRecord),
+                                        static_cast<off_t>(offset));
+            if (got < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                throw std::runtime_error(std::string("journal read failed: ") + std::strerror(errno));
+            }
+            const size_t n = static_cast<size_t>(got) / sizeof(jolt::JournalRecord);
+            for (size_t i = 0; i < n; ++i) {
+                const jolt::JournalRecord& r = buf_[i];
+                if (r.lsn != st.last_lsn + 1 || r.checksum != journal_checksum(r)) {
+                    return st;
+                }
+                st.last_lsn = r.lsn;
+                st.end_offset += sizeof(jolt::JournalRecord);
+                if (r.lsn > after_lsn) {
+                    fn(r);
+                    ++st.records;
+                }
+            }
+            if (n < buf_.size()) {
+                return st;
+            }
+            offset += n * sizeof(jolt::JournalRecord);
+        }
+    }
+};
+
+// write-ahead journal of the orders a matching thread applies to its books, in the order it applies
+// them. records are appended into the open batch in memory, a batch is committed as one io_uring write
+// at its file offset, with a linked fdatasync when opts.sync, once it fills or its window passes (see
+// tick). up to kDepth batches are in flight, the matching thread only waits when all of them are.
+// reopening an existing journal drops a torn tail and continues its lsn sequence
+class InputJournal {
+    static constexpr size_t kDepth = 16;
+    static constexpr uint64_t kSyncBit = 1ull << 32;
+
+    struct Batch {
+        std::vector<jolt::JournalRecord> records;
+        uint64_t last_lsn{0};
+        bool in_flight{false};
+        bool written{false};
+        bool synced{false};
+    };
+
+    std::string path_;
+    JournalOptions opts_;
+    int fd_{-1};
+    io_uring ring_{};
+    bool ring_ready_{false};
+
+    std::array<Batch, kDepth> batches_{};
+    // batch being filled, and the oldest batch still in flight
+    size_t open_{0};
+    size_t oldest_{0};
+    size_t in_flight_{0};
+    uint64_t file_offset_{0};
+    uint64_t next_lsn_{1};
+    // read by the checkpoint writer thread
+    std::atomic<uint64_t> durable_lsn_{0};
+    std::chrono::steady_clock::time_point opened_at_{};
+
+    static std::runtime_error make_errno_error(const char* what, int err) {
+        const int code = (err < 0) ? -err : err;
+        return std::runtime_error(std::string(what) + ": " + std::strerror(code));
+    }
+
+    io_uring_sqe* next_sqe() {
+        io_uring_sqe* sqe = io_uring_get_sqe(&ring_);
+        if (!sqe) {
+            const int rc = io_uring_submit(&ring_);
+            if (rc < 0) {
+                throw make_errno_error("io_uring_submit failed", rc);
+            }
+            sqe = io_uring_get_sqe(&ring_);
+            if (!sqe) {
+                throw std::runtime_error("io_uring_get_sqe failed");
+            }
+        }
+        return sqe;
+    }
+
+    void complete(io_uring_cqe* cqe) {
+        const uint64_t data = io_uring_cqe_get_data64(cqe);
+        const int res = cqe->res;
+        io_uring_cqe_seen(&ring_, cqe);
+
+        const size_t idx = static_cast<size_t>(data & (kSyncBit - 1));
+        if (idx >= kDepth || !batches_[idx].in_flight) {
+            throw std::runtime_error("invalid journal completion");
+        }
+        Batch& b = batches_[idx];
+        if (res < 0) {
+            throw make_errno_error((data & kSyncBit) ? "journal fdatasync failed" : "journal write failed", res);
+        }
+        if (data & kSyncBit) {
+            b.synced = true;
+        }
+        else {
+            if (static_cast<size_t>(res) != b.records.size() * sizeof(jolt::JournalRecord)) {
+                throw std::runtime_error("short journal write");
+            }
+            b.written = true;
+        }
+        // batches complete in any order, the durable lsn only moves over a finished prefix
+        while (in_flight_ > 0) {
+            Batch& o = batches_[oldest_];
+            if (!o.written || (opts_.sync && !o.synced)) {
+                break;
+            }
+            durable_lsn_.store(o.last_lsn, std::memory_order_release);
+            o.in_flight = false;
+            o.records.clear();
+            oldest_ = (oldest_ + 1) % kDepth;
+            --in_flight_;
+        }
+    }
+
+    void reap_completions() {
+        io_uring_cqe* cqe = nullptr;
+        while (io_uring_peek_cqe(&ring_, &cqe) == 0 && cqe) {
+            complete(cqe);
+        }
+    }
+
+    void reap_one_blocking() {
+        io_uring_cqe* cqe = nullptr;
+        const int rc = io_uring_wait_cqe(&ring_, &cqe);
+        if (rc < 0) {
+            throw make_errno_error("io_uring_wait_cqe failed", rc);
+        }
+        complete(cqe);
+    }
+
+    jolt::JournalRecord& next_record() {
+        Batch& b = batches_[open_];
+        if (b.records.empty()) {
+            opened_at_ = std::chrono::steady_clock::now();
+        }
+        jolt::JournalRecord& r = b.records.emplace_back();
+        r.lsn = next_lsn_++;
+        return r;
+    }
+
+    void seal(jolt::JournalRecord& r) {
+        r.checksum = journal_checksum(r);
+        if (batches_[open_].records.size() >= opts_.batch_records) {
+            commit();
+        }
+    }
+
+public:
+    InputJournal(std::string path, const JournalOptions& opts = {}) : path_(std::move(path)), opts_(opts) {
+        if (opts_.batch_records == 0) {
+            throw std::runtime_error("journal batch_records must be > 0");
+        }
+        const std::filesystem::path parent = std::filesystem::path(path_).parent_path();
+        if (!parent.empty()) {
+            std::filesystem::create_directories(parent);
+        }
+
+        // continue after the last valid record, a torn tail from a crash is cut off
+        {
+            JournalReader reader(path_);
+            const JournalReader::Stats st = reader.replay(std::numeric_limits<uint64_t>::max(),
+                                                          [](const jolt::JournalRecord&) {});
+            file_offset_ = st.end_offset;
+            next_lsn_ = st.last_lsn + 1;
+            durable_lsn_.store(st.last_lsn, std::memory_order_release);
+        }
+        fd_ = ::open(path_.c_str(), O_CREAT | O_WRONLY | O_CLOEXEC, 0644);
+        if (fd_ < 0) {
+            throw make_errno_error("journal open failed", errno);
+        }
+        if (::ftruncate(fd_, static_cast<off_t>(file_offset_)) != 0) {
+            throw make_errno_error("journal truncate failed", errno);
+        }
+
+        const int rc = io_uring_queue_init(kDepth * 2, &ring_, 0);
+        if (rc < 0) {
+            throw make_errno_error("io_uring_queue_init failed", rc);
+        }
+        ring_ready_ = true;
+        for (auto& b : batches_) {
+            b.records.reserve(opts_.batch_records);
+        }
+    }
+
+    ~InputJournal() noexcept {
+        if (ring_ready_) {
+            try {
+                sync_all();
+            }
+            catch (...) {
+            }
+            io_uring_queue_exit(&ring_);
+        }
+        if (fd_ >= 0) {
+            ::close(fd_);
+        }
+    }
+
+    InputJournal(const InputJournal&) = delete;
+    InputJournal& operator=(const InputJournal&) = delete;
+
+    const std::string& path() const { return path_; }
+    // lsn the next record gets
+    uint64_t next_lsn() const { return next_lsn_; }
+    // every record up to here is on disk (in the page cache without opts.sync). safe from any thread
+    uint64_t durable_lsn() const { return durable_lsn_.load(std::memory_order_acquire); }
+
+    void append(const jolt::ob::OrderParams& order) {
+        jolt::JournalRecord& r = next_record();
+        r.day = 0;
+        r.kind = jolt::JournalRecord::Kind::Order;
+        r.order = order;
+        seal(r);
+    }
+
+    void append_day(uint64_t day) {
+        jolt::JournalRecord& r = next_record();
+        r.day = day;
+        r.kind = jolt::JournalRecord::Kind::DayRoll;
+        r.order = jolt::ob::OrderParams{};
+        seal(r);
+    }
+
+    // reaps finished batches and commits the open one once its window has passed. the matching thread
+    // calls this once per poll, so the clock is read per poll and not per record
+    void tick() {
+        if (in_flight_ > 0) {
+            reap_completions();
+        }
+        if (!batches_[open_].records.empty() &&
+            std::chrono::steady_clock::now() - opened_at_ >= opts_.window) {
+            commit();
+        }
+    }
+
+    // submits the open batch now
+    void commit() {
+        Batch& b = batches_[open_];
+        if (b.records.empty()) {
+            return;
+        }
+        const size_t bytes = b.records.size() * sizeof(jolt::JournalRecord);
+        io_uring_sqe* sqe = next_sqe();
+        io_uring_prep_write(sqe, fd_, b.records.data(), static_cast<unsigned>(bytes), file_offset_);
+        io_uring_sqe_set_data64(sqe, open_);
+        // a buffered write would otherwise be tried inline, copying the batch on the matching thread
+        io_uring_sqe_set_flags(sqe, IOSQE_ASYNC);
+        if (opts_.sync) {
+            io_uring_sqe_set_flags(sqe, IOSQE_ASYNC | IOSQE_IO_LINK);
+            io_uring_sqe* fsync = next_sqe();
+            io_uring_prep_fsync(fsync, fd_, IORING_FSYNC_DATASYNC);
+            io_uring_sqe_set_data64(fsync, open_ | kSyncBit);
+        }
+        b.last_lsn = b.records.back().lsn;
+        b.in_flight = true;
+        b.written = false;
+        b.synced = false;
+        ++in_flight_;
+        file_offset_ += bytes;
+
+        const int rc = io_uring_submit(&ring_);
+        if (rc < 0) {
+            throw make_errno_error("io_uring_submit failed", rc);
+        }
+        open_ = (open_ + 1) % kDepth;
+        // every batch is in flight, wait for the oldest to free the next one
+        while (batches_[open_].in_flight) {
+            reap_one_blocking();
+        }
+    }
+
+    // commits the open batch and waits until everything appended is durable
+    void sync_all() {
+        commit();
+        while (in_flight_ > 0) {
+            reap_one_blocking();
+        }
+    }
+};
@@ -0,0 +1,272 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "Types.h"
+
+enum class HistoryMode : uint8_t { Create = 0, Attach = 1 };
+
+namespace history_detail {
+    inline std::string normalize_shm_name(std::string name) {
+        if (name.empty()) {
+            throw std::runtime_error("l3 history name cannot be empty");
+        }
+        if (name.front() != '/') {
+            name.insert(name.begin(), '/');
+        }
+        return name;
+    }
+}
+
+// the last capacity published l3 records of every symbol in shared memory, one overwriting ring per
+// symbol. a single writer appends whole published batches, any number of readers in any process locate a
+// seq range and read it in place. a record at position p lives in slot p % capacity until the writer
+// reserves position p + capacity, so a reader checks reserved() after using the slots (the same fence
+// pairing as SeqlockTable) to know that what it read was not overwritten underneath it
+class L3History {
+    static constexpr uint64_t kMagic = 0x4C33484953544F52ULL; // "L3HISTOR"
+    static constexpr uint32_t kVersion = 1;
+
+    struct Header {
+        uint64_t magic{0};
+        uint32_t version{0};
+        uint32_t record_bytes{0};
+        uint32_t symbols{0};
+        uint32_t capacity{0};
+        std::atomic<uint8_t> ready{0};
+    };
+
+    struct alignas(64) RingHeader {
+        // positions below published are readable, reserved runs ahead while a batch is being copied in
+        std::atomic<uint64_t> published{0};
+        std::atomic<uint64_t> reserved{0};
+        // position of the first record of the current day. seqs start over each day, locate only
+        // searches from here
+        std::atomic<uint64_t> day_start{0};
+        uint16_t symbol_id{0};
+    };
+
+    int fd_{-1};
+    void* map_{nullptr};
+    size_t mapped_bytes_{0};
+    Header* hdr_{nullptr};
+    RingHeader* rings_{nullptr};
+    jolt::ob::L3Data* records_{nullptr};
+    uint32_t symbols_{0};
+    uint64_t capacity_{0};
+    std::string name_;
+    bool owner_{false};
+
+    static constexpr size_t rings_offset() { return (sizeof(Header) + 63) & ~size_t{63}; }
+
+    static constexpr size_t records_offset(size_t symbols) { return rings_offset() + symbols * sizeof(RingHeader); }
+
+    static constexpr size_t bytes_needed(size_t symbols, size_t capacity) {
+        return records_offset(symbols) + symbols * capacity * sizeof(jolt::ob::L3Data);
+    }
+
+public:
+    // symbol_ids gives the ring order when creating, attach takes it from the mapping. capacity must be a
+    // power of two
+    L3History(const std::string& name, HistoryMode mode, const std::vector<uint16_t>& symbol_ids = {},
+              uint32_t capacity = 1 << 16)
+        : name_(history_detail::normalize_shm_name(name)), owner_(mode == HistoryMode::Create) {
+        if (owner_ && (symbol_ids.empty() || capacity == 0 || (capacity & (capacity - 1)) != 0)) {
+            throw std::runtime_error("l3 history needs symbols and a power of two capacity");
+        }
+        const int oflag = owner_ ? (O_CREAT | O_RDWR) : O_RDWR;
+        fd_ = ::shm_open(name_.c_str(), oflag, 0600);
+        if (fd_ < 0) {
+            throw std::runtime_error("shm_open failed");
+        }
+
+        if (owner_) {
+            mapped_bytes_ = bytes_needed(symbol_ids.size(), capacity);
+            if (::ftruncate(fd_, static_cast<off_t>(mapped_bytes_)) != 0) {
+                throw std::runtime_error("ftruncate failed");
+            }
+        }
+        else {
+            struct stat st{};
+            if (::fstat(fd_, &st) != 0) {
+                throw std::runtime_error("fstat failed");
+            }
+            mapped_bytes_ = static_cast<size_t>(st.st_size);
+            if (mapped_bytes_ < rings_offset()) {
+                throw std::runtime_error("l3 history mapping too small");
+            }
+        }
+
+        map_ = ::mmap(nullptr, mapped_bytes_, PROT_READ | PROT_WRITE, MAP_SHARED, fd_, 0);
+        if (map_ == MAP_FAILED) {
+            throw std::runtime_error("mmap failed");
+        }
+        hdr_ = static_cast<Header*>(map_);
+        rings_ = reinterpret_cast<RingHeader*>(static_cast<std::byte*>(map_) + rings_offset());
+
+        if (owner_) {
+            std::memset(map_, 0, mapped_bytes_);
+            hdr_->magic = kMagic;
+            hdr_->version = kVersion;
+            hdr_->record_bytes = sizeof(jolt::ob::L3Data);
+            hdr_->symbols = static_cast<uint32_t>(symbol_ids.size());
+            hdr_->capacity = capacity;
+            for (size_t i = 0; i < symbol_ids.size(); ++i) {
+                rings_[i].symbol_id = symbol_ids[i];
+            }
+            hdr_->ready.store(1, std::memory_order_release);
+        }
+        else if (hdr_->ready.load(std::memory_order_acquire) == 0 || hdr_->magic != kMagic ||
+                 hdr_->version != kVersion || hdr_->record_bytes != sizeof(jolt::ob::L3Data) ||
+                 bytes_needed(hdr_->symbols, hdr_->capacity) > mapped_bytes_) {
+            throw std::runtime_error("l3 history shape mismatch");
+        }
+        symbols_ = hdr_->symbols;
+        capacity_ = hdr_->capacity;
+        records_ = reinterpret_cast<jolt::ob::L3Data*>(static_cast<std::byte*>(map_) + records_offset(symbols_));
+    }
+
+    ~L3History() {
+        if (map_ && map_ != MAP_FAILED) {
+            ::munmap(map_, mapped_bytes_);
+        }
+        if (fd_ >= 0) {
+            ::close(fd_);
+        }
+        if (owner_) {
+            ::shm_unlink(name_.c_str());
+        }
+    }
+
+    L3History(const L3History&) = delete;
+    L3History& operator=(const L3History&) = delete;
+
+    [[nodiscard]] uint32_t symbols() const { return symbols_; }
+    [[nodiscard]] uint64_t capacity() const { return capacity_; }
+
+    // ring of a symbol id, symbols() when it has none
+    [[nodiscard]] uint32_t ring_of(uint16_t symbol_id) const {
+        for (uint32_t i = 0; i < symbols_; ++i) {
+            if (rings_[i].symbol_id == symbol_id) {
+                return i;
+            }
+        }
+        return symbols_;
+    }
+
+    // writer: appends a published batch of ring r. n <= capacity(). a seq lower than the one before it
+    // starts a new day
+    void append(uint32_t r, const jolt::ob::L3Data* recs, size_t n) {
+        RingHeader& h = rings_[r];
+        const uint64_t pos = h.published.load(std::memory_order_relaxed);
+        uint64_t prev_seq = pos > 0 ? at(r, pos - 1).seq : 0;
+        for (size_t i = 0; i < n; ++i) {
+            if (recs[i].seq < prev_seq) {
+                h.day_start.store(pos + i, std::memory_order_relaxed);
+            }
+            prev_seq = recs[i].seq;
+        }
+        h.reserved.store(pos + n, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        jolt::ob::L3Data* base = records_ + static_cast<size_t>(r) * capacity_;
+        const size_t at = static_cast<size_t>(pos & (capacity_ - 1));
+        const size_t first = std::min<size_t>(n, capacity_ - at);
+        std::memcpy(base + at, recs, first * sizeof(jolt::ob::L3Data));
+        std::memcpy(base, recs + first, (n - first) * sizeof(jolt::ob::L3Data));
+        h.published.store(pos + n, std::memory_order_release);
+    }
+
+    [[nodiscard]] uint64_t published(uint32_t r) const { return rings_[r].published.load(std::memory_order_acquire); }
+
+    // after reading slots: true while position pos has not been overwritten
+    [[nodiscard]] bool still_valid(uint32_t r, uint64_t pos) const {
+        std::atomic_thread_fence(std::memory_order_acquire);
+        const uint64_t reserved = rings_[r].reserved.load(std::memory_order_relaxed);
+        return reserved < capacity_ || pos >= reserved - capacity_;
+    }
+
+    // record at position pos, only meaningful if still_valid(r, pos) holds after it is used
+    [[nodiscard]] const jolt::ob::L3Data& at(uint32_t r, uint64_t pos) const {
+        return records_[static_cast<size_t>(r) * capacity_ + static_cast<size_t>(pos & (capacity_ - 1))];
+    }
+
+    // up to two contiguous spans holding positions [from, to)
+    [[nodiscard]] size_t spans(uint32_t r, uint64_t from, uint64_t to, const jolt::ob::L3Data* (&ptr)[2],
+                               size_t (&count)[2]) const {
+        const size_t n = static_cast<size_t>(to - from);
+        const size_t at_idx = static_cast<size_t>(from & (capacity_ - 1));
+        const size_t first = std::min<size_t>(n, capacity_ - at_idx);
+        ptr[0] = &at(r, from);
+        count[0] = first;
+        if (first == n) {
+            return 1;
+        }
+        ptr[1] = &at(r, from + first);
+        count[1] = n - first;
+        return 2;
+    }
+
+    struct Range {
+        // positions of the records with seq in the requested range that the ring still holds
+        uint64_t from{0};
+        uint64_t to{0};
+        // seq of the oldest record held, records with a seq at or below it may be missing from the ring
+        uint64_t oldest_seq{0};
+        // the ring holds every record of the range
+        bool complete{false};
+    };
+
+    // finds [start_seq, end_seq] of the current day in ring r by binary search over the held positions
+    // (seqs of a symbol never go down within a day). false when a concurrent write got in the way, try
+    // again
+    bool locate(uint32_t r, uint64_t start_seq, uint64_t end_seq, Range& out) const {
+        const uint64_t head = published(r);
+        const uint64_t day_start = rings_[r].day_start.load(std::memory_order_acquire);
+        if (day_start > head) {
+            // a new day began after head was read
+            return false;
+        }
+        const uint64_t tail = std::max(head > capacity_ ? head - capacity_ : 0, day_start);
+        out = Range{head, head, 0, false};
+        if (head == tail) {
+            out.complete = start_seq > end_seq;
+            return true;
+        }
+        const auto lower = [&](uint64_t seq, bool upper) {
+            uint64_t lo = tail;
+            uint64_t hi = head;
+            while (lo < hi) {
+                const uint64_t mid = lo + (hi - lo) / 2;
+                const uint64_t s = at(r, mid).seq;
+                if (upper ? s <= seq : s < seq) {
+                    lo = mid + 1;
+                }
+                else {
+                    hi = mid;
+                }
+            }
+            return lo;
+        };
+        out.oldest_seq = at(r, tail).seq;
+        out.from = lower(start_seq, false);
+        out.to = lower(end_seq, true);
+        if (out.to < out.from) {
+            out.to = out.from;
+        }
+        // nothing of the day was ever dropped, or the range starts past its oldest seq
+        out.complete = tail == day_start || start_seq > out.oldest_seq;
+        return still_valid(r, tail);
+    }
+};
@@ -0,0 +1,395 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "Types.h"
+
+// on-disk l3 format, one file per symbol and day:
+//
+//   FileHeader | block | block | ... | IndexEntry[blocks] | Trailer
+//
+// a block holds up to a writer batch of records as columns: id, seq, ts and price as zigzag varint deltas
+// from the previous record (the first from the block header), qty as a plain varint and one flags byte
+// (side, event type) per record. blocks are self describing, so a file whose writer died before the footer
+// is still read by walking the block headers. the footer is a sparse index, one entry per block with its
+// first seq and ts
+namespace jolt::l3 {
+    inline constexpr uint32_t kFileMagic = 0x46334C4A;  // "JL3F"
+    inline constexpr uint32_t kBlockMagic = 0x42334C4A; // "JL3B"
+    inline constexpr uint32_t kIndexMagic = 0x49334C4A; // "JL3I"
+    inline constexpr uint16_t kVersion = 1;
+
+    enum Column : size_t { kId = 0, kSeq, kTs, kPrice, kQty, kFlags, kNumColumns };
+
+    struct FileHeader {
+        uint32_t magic{kFileMagic};
+        uint16_t version{kVersion};
+        uint16_t symbol_id{0};
+        uint64_t day_id{0};
+    };
+
+    struct BlockHeader {
+        uint32_t magic{kBlockMagic};
+        uint32_t count{0};
+        // bytes of the columns after the header, back to back in Column order
+        std::array<uint32_t, kNumColumns> column_bytes{};
+        uint64_t first_id{0};
+        uint64_t first_seq{0};
+        uint64_t last_seq{0};
+        uint64_t first_ts{0};
+        uint64_t last_ts{0};
+        uint32_t first_price{0};
+        uint32_t checksum{0};
+
+        uint32_t payload_bytes() const {
+            uint32_t n = 0;
+            for (const uint32_t b : column_bytes) {
+                n += b;
+            }
+            return n;
+        }
+    };
+    static_assert(sizeof(BlockHeader) == 80, "l3 files assume an 80 byte block header");
+
+    struct IndexEntry {
+        uint64_t first_seq{0};
+        uint64_t first_ts{0};
+        uint64_t offset{0};
+        uint64_t count{0};
+    };
+
+    struct Trailer {
+        uint64_t index_offset{0};
+        uint32_t index_count{0};
+        uint32_t magic{kIndexMagic};
+    };
+
+    // <root>/<yyyymmdd>/sym_<id>.l3bin, day_id counting days since the epoch in UTC
+    inline std::string day_dir(const std::string& root, uint64_t day_id) {
+        using namespace std::chrono;
+        const year_month_day ymd{sys_days{days{static_cast<int64_t>(day_id)}}};
+        char buf[9];
+        const int wrote = std::snprintf(buf, sizeof(buf), "%04d%02u%02u", static_cast<int>(ymd.year()),
+                                        static_cast<unsigned>(ymd.month()), static_cast<unsigned>(ymd.day()));
+        if (wrote != 8) {
+            throw std::runtime_error("failed to format UTC day");
+        }
+        return root + "/" + std::string(buf, 8);
+    }
+
+    inline std::string file_path(const std::string& root, uint64_t day_id, uint16_t symbol_id) {
+        return day_dir(root, day_id) + "/sym_" + std::to_string(symbol_id) + ".l3bin";
+    }
+
+    // largest varint of a 64 bit value
+    inline constexpr size_t kMaxVarint = 10;
+    // bytes a block of n records can take at most
+    inline constexpr size_t max_block_bytes(size_t n) {
+        return sizeof(BlockHeader) + n * (4 * kMaxVarint + 5 + 1);
+    }
+
+    inline uint64_t zigzag(int64_t v) { return (static_cast<uint64_t>(v) << 1) ^ static_cast<uint64_t>(v >> 63); }
+    inline int64_t unzigzag(uint64_t v) { return static_cast<int64_t>(v >> 1) ^ -static_cast<int64_t>(v & 1); }
+
+    inline std::byte* put_varint(std::byte* p, uint64_t v) {
+        while (v >= 0x80) {
+            *p++ = static_cast<std::byte>(v | 0x80);
+            v >>= 7;
+        }
+        *p++ = static_cast<std::byte>(v);
+        return p;
+    }
+
+    // single byte values, the common small deltas, take the early exit
+    inline const std::byte* get_varint(const std::byte* p, uint64_t& v) {
+        uint64_t b = static_cast<uint64_t>(*p++);
+        if (b < 0x80) {
+            v = b;
+            return p;
+        }
+        v = b & 0x7F;
+        unsigned shift = 7;
+        for (;;) {
+            b = static_cast<uint64_t>(*p++);
+            v |= (b & 0x7F) << shift;
+            if (b < 0x80) {
+                return p;
+            }
+            shift += 7;
+        }
+    }
+
+    inline uint32_t block_checksum(const std::byte* p, size_t n) {
+        uint64_t h = 0x9E3779B97F4A7C15ull;
+        size_t i = 0;
+        for (; i + 8 <= n; i += 8) {
+            uint64_t w;
+            std::memcpy(&w, p + i, 8);
+            h = (h ^ w) * 0xFF51AFD7ED558CCDull;
+            h ^= h >> 29;
+        }
+        uint64_t tail = 0;
+        std::memcpy(&tail, p + i, n - i);
+        h = (h ^ tail ^ n) * 0xFF51AFD7ED558CCDull;
+        return static_cast<uint32_t>(h ^ (h >> 32));
+    }
+
+    // encodes n > 0 records into out, which holds max_block_bytes(n). returns the bytes written
+    inline size_t encode_block(const ob::L3Data* recs, size_t n, std::byte* out) {
+        BlockHeader h{};
+        h.count = static_cast<uint32_t>(n);
+        h.first_id = recs[0].id;
+        h.first_seq = recs[0].seq;
+        h.last_seq = recs[n - 1].seq;
+        h.first_ts = recs[0].ts;
+        h.last_ts = recs[n - 1].ts;
+        h.first_price = recs[0].price;
+
+        // one column at a time, each packed right behind the previous
+        std::byte* const base = out + sizeof(BlockHeader);
+        std::byte* p = base;
+        const auto column = [&](Column c, auto&& value) {
+            std::byte* const start = p;
+            for (size_t i = 0; i < n; ++i) {
+                p = put_varint(p, value(i));
+            }
+            h.column_bytes[c] = static_cast<uint32_t>(p - start);
+        };
+        column(kId, [&](size_t i) {
+            return zigzag(static_cast<int64_t>(recs[i].id - (i ? recs[i - 1].id : h.first_id)));
+        });
+        column(kSeq, [&](size_t i) {
+            return zigzag(static_cast<int64_t>(recs[i].seq - (i ? recs[i - 1].seq : h.first_seq)));
+        });
+        column(kTs, [&](size_t i) {
+            return zigzag(static_cast<int64_t>(recs[i].ts - (i ? recs[i - 1].ts : h.first_ts)));
+        });
+        column(kPrice, [&](size_t i) {
+            return zigzag(static_cast<int64_t>(recs[i].price) -
+                          static_cast<int64_t>(i ? recs[i - 1].price : h.first_price));
+        });
+        column(kQty, [&](size_t i) { return static_cast<uint64_t>(recs[i].qty); });
+        for (size_t i = 0; i < n; ++i) {
+            *p++ = static_cast<std::byte>(static_cast<uint8_t>(recs[i].side) |
+                                          (static_cast<uint8_t>(recs[i].event_type) << 1));
+        }
+        h.column_bytes[kFlags] = static_cast<uint32_t>(n);
+
+        h.checksum = block_checksum(base, static_cast<size_t>(p - base));
+        std::memcpy(out, &h, sizeof(h));
+        return static_cast<size_t>(p - out);
+    }
+
+    // decodes a block whose payload follows h into out (h.count records)
+    inline void decode_block(const BlockHeader& h, const std::byte* payload, uint16_t symbol_id, ob::L3Data* out) {
+        const size_t n = h.count;
+        const std::byte* cols[kNumColumns];
+        const std::byte* p = payload;
+        for (size_t c = 0; c < kNumColumns; ++c) {
+            cols[c] = p;
+            p += h.column_bytes[c];
+        }
+        uint64_t id = h.first_id;
+        uint64_t seq = h.first_seq;
+        uint64_t ts = h.first_ts;
+        int64_t price = h.first_price;
+        for (size_t i = 0; i < n; ++i) {
+            uint64_t v;
+            cols[kId] = get_varint(cols[kId], v);
+            id += static_cast<uint64_t>(unzigzag(v));
+            cols[kSeq] = get_varint(cols[kSeq], v);
+            seq += static_cast<uint64_t>(unzigzag(v));
+            cols[kTs] = get_varint(cols[kTs], v);
+            ts += static_cast<uint64_t>(unzigzag(v));
+            cols[kPrice] = get_varint(cols[kPrice], v);
+            price += unzigzag(v);
+            cols[kQty] = get_varint(cols[kQty], v);
+            const auto flags = static_cast<uint8_t>(cols[kFlags][i]);
+
+            ob::L3Data& r = out[i];
+            r.id = id;
+            r.seq = seq;
+            r.ts = ts;
+            r.price = static_cast<ob::PriceTick>(price);
+            r.qty = static_cast<ob::Qty>(v);
+            r.symbol_id = symbol_id;
+            r.side = static_cast<ob::Side>(flags & 1);
+            r.event_type = static_cast<ob::BookEventType>(flags >> 1);
+        }
+    }
+
+    // a symbol's l3 file mapped read only. the block index comes from the footer, or from walking the block
+    // headers when the file has none yet (still being written, or its writer died): the walk stops at the
+    // first torn or corrupt block, everything before it is the valid file. a file that is still growing is
+    // seen as of the open
+    class Reader {
+        void* map_{nullptr};
+        size_t bytes_{0};
+        FileHeader header_{};
+        std::vector<IndexEntry> index_{};
+        uint64_t records_{0};
+        // one past the last valid block, where a writer continues
+        uint64_t end_offset_{0};
+        bool has_footer_{false};
+
+        static std::runtime_error errno_error(const char* what, const std::string& path) {
+            return std::runtime_error(std::string(what) + ": " + path + ": " + std::strerror(errno));
+        }
+
+        const std::byte* at(uint64_t off) const { return static_cast<const std::byte*>(map_) + off; }
+
+        bool load_footer() {
+            if (bytes_ < sizeof(FileHeader) + sizeof(Trailer)) {
+                return false;
+            }
+            Trailer t{};
+            std::memcpy(&t, at(bytes_ - sizeof(Trailer)), sizeof(t));
+            if (t.magic != kIndexMagic || t.index_offset < sizeof(FileHeader) ||
+                t.index_offset + static_cast<uint64_t>(t.index_count) * sizeof(IndexEntry) + sizeof(Trailer) != bytes_) {
+                return false;
+            }
+            index_.resize(t.index_count);
+            std::memcpy(index_.data(), at(t.index_offset), index_.size() * sizeof(IndexEntry));
+            end_offset_ = t.index_offset;
+            for (const IndexEntry& e : index_) {
+                records_ += e.count;
+            }
+            return true;
+        }
+
+        void walk_blocks() {
+            uint64_t off = sizeof(FileHeader);
+            while (off + sizeof(BlockHeader) <= bytes_) {
+                BlockHeader h{};
+                std::memcpy(&h, at(off), sizeof(h));
+                const uint64_t payload = h.payload_bytes();
+                if (h.magic != kBlockMagic || h.count == 0 || off + sizeof(h) + payload > bytes_ ||
+                    block_checksum(at(off + sizeof(h)), payload) != h.checksum) {
+                    break;
+                }
+                index_.push_back(IndexEntry{h.first_seq, h.first_ts, off, h.count});
+                records_ += h.count;
+                off += sizeof(h) + payload;
+            }
+            end_offset_ = off;
+        }
+
+    public:
+        // a missing or empty file reads as no records
+        explicit Reader(const std::string& path) {
+            const int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+            if (fd < 0) {
+                if (errno == ENOENT) {
+                    return;
+                }
+                throw errno_error("l3 open failed", path);
+            }
+            struct stat st{};
+            if (::fstat(fd, &st) != 0) {
+                ::close(fd);
+                throw errno_error("l3 stat failed", path);
+            }
+            bytes_ = static_cast<size_t>(st.st_size);
+            if (bytes_ == 0) {
+                ::close(fd);
+                return;
+            }
+            map_ = ::mmap(nullptr, bytes_, PROT_READ, MAP_SHARED, fd, 0);
+            ::close(fd);
+            if (map_ == MAP_FAILED) {
+                map_ = nullptr;
+                throw errno_error("l3 mmap failed", path);
+            }
+            if (bytes_ < sizeof(FileHeader)) {
+                bytes_ = 0;
+                return;
+            }
+            std::memcpy(&header_, map_, sizeof(header_));
+            if (header_.magic != kFileMagic || header_.version != kVersion) {
+                ::munmap(map_, bytes_);
+                map_ = nullptr;
+                throw std::runtime_error("l3 file header invalid: " + path);
+            }
+            has_footer_ = load_footer();
+            if (!has_footer_) {
+                walk_blocks();
+            }
+            // decode runs front to back
+            (void)::madvise(map_, bytes_, MADV_SEQUENTIAL);
+        }
+
+        ~Reader() {
+            if (map_) {
+                ::munmap(map_, bytes_);
+            }
+        }
+
+        Reader(const Reader&) = delete;
+        Reader& operator=(const Reader&) = delete;
+
+        uint16_t symbol_id() const { return header_.symbol_id; }
+        uint64_t day_id() const { return header_.day_id; }
+        bool has_footer() const { return has_footer_; }
+        uint64_t end_offset() const { return end_offset_; }
+        uint64_t records() const { return records_; }
+        const std::vector<IndexEntry>& index() const { return index_; }
+        size_t blocks() const { return index_.size(); }
+
+        // first block that can hold seq: the last one starting before it. an order's events share its seq,
+        // so a block can end with the seq the next one starts with. O(log blocks)
+        size_t seek_seq(uint64_t seq) const {
+            const auto it = std::lower_bound(index_.begin(), index_.end(), seq,
+                                             [](const IndexEntry& e, uint64_t s) { return e.first_seq < s; });
+            return it == index_.begin() ? 0 : static_cast<size_t>(it - index_.begin()) - 1;
+        }
+
+        size_t seek_ts(uint64_t ts) const {
+            const auto it = std::upper_bound(index_.begin(), index_.end(), ts,
+                                             [](uint64_t t, const IndexEntry& e) { return t < e.first_ts; });
+            return it == index_.begin() ? 0 : static_cast<size_t>(it - index_.begin()) - 1;
+        }
+
+        // decodes block i into out, which holds index()[i].count records
+        size_t decode(size_t i, ob::L3Data* out) const {
+            const IndexEntry& e = index_[i];
+            BlockHeader h{};
+            std::memcpy(&h, at(e.offset), sizeof(h));
+            decode_block(h, at(e.offset + sizeof(h)), header_.symbol_id, out);
+            return h.count;
+        }
+
+        // calls fn(const L3Data&) for every record with from_seq <= seq <= to_seq in file order, returns how
+        // many. decodes a block at a time into buf
+        template <typename Fn>
+        uint64_t scan_seq(uint64_t from_seq, uint64_t to_seq, std::vector<ob::L3Data>& buf, Fn&& fn) const {
+            uint64_t n = 0;
+            for (size_t i = seek_seq(from_seq); i < index_.size() && index_[i].first_seq <= to_seq; ++i) {
+                buf.resize(index_[i].count);
+                decode(i, buf.data());
+                for (const ob::L3Data& r : buf) {
+                    if (r.seq > to_seq) {
+                        return n;
+                    }
+                    if (r.seq >= from_seq) {
+                        fn(r);
+                        ++n;
+                    }
+                }
+            }
+            return n;
+        }
+    };
+}
@@ -1,119 +1,261 @@
 #pragma once
 
-#include <array>
 #include <cerrno>
 #include <chrono>
 #include <cstdint>
-#include <cstdio>
+#include <cstdlib>
 #include <cstring>
 #include <filesystem>
+#include <new>
 #include <stdexcept>
 #include <string>
 #include <vector>
 #include <fcntl.h>
+#include <sys/uio.h>
 #include <unistd.h>
 #include <liburing.h>
 #include "Types.h"
-
+#include "InstrumentRegistry.h"
+#include "l3_store.h"
+
+// appends every symbol's l3 records to <root>/<yyyymmdd>/sym_<id>.l3bin in the l3_store.h format. records
+// are copied straight into a batch buffer of the symbol, carved out of one arena that is registered with the
+// ring. a full batch is encoded into a column block next to it in the arena and becomes a write_fixed at the
+// end of the symbol's registered file. writes are queued and go out together on the next tick(), so the
+// matching thread makes at most one submit per poll. a batch of a quiet symbol that has been open for
+// max_age is written as it is on a tick, so the file never lags the feed by more than that. the day comes
+// from the caller (roll_day), the writer never reads the clock on the write path, only once per tick. the
+// footer index goes on at the day roll and on close
 class L3DataWriter {
+public:
+    static constexpr size_t kBatchRecords = 1 << 10;
+
+private:
     static constexpr size_t kDepth = 64;
-    static constexpr size_t kMaxRecordsPerBatch = 1 << 20;
-    static constexpr size_t kNumSymbols = jolt::kNumSymbols;
+    static constexpr size_t kBatchBytes = kBatchRecords * sizeof(jolt::ob::L3Data);
+    static constexpr size_t kBlockBytes = jolt::l3::max_block_bytes(kBatchRecords);
+    static constexpr size_t kArenaAlign = 4096;
+    static constexpr uint32_t kNoBatch = UINT32_MAX;
+
+    struct Batch {
+        jolt::ob::L3Data* data{nullptr};
+        // encoded block of data, what is written
+        std::byte* block{nullptr};
+        uint32_t count{0};
+        uint32_t block_bytes{0};
+        bool in_flight{false};
+        // tick time when the batch got its first record
+        std::chrono::steady_clock::time_point opened{};
+    };
+
+    struct SymbolFile {
+        int fd{-1};
+        // where the next block goes, writes carry explicit offsets so they may complete in any order
+        uint64_t end{0};
+        std::vector<jolt::l3::IndexEntry> index{};
+    };
 
     std::string root_;
-    std::string day_;
-    std::array<int, kNumSymbols> symbol_fds_{};
+    uint64_t day_id_{0};
+    jolt::InstrumentRegistry instruments_;
+    // one file per instrument, indexed by registry index. the fds are registered with the ring at the
+    // same index
+    std::vector<SymbolFile> files_{};
+    std::vector<int> symbol_fds_{};
+    // batch each symbol is filling, kNoBatch until its first record
+    std::vector<uint32_t> open_{};
+    // symbols that opened a batch since the tick that last saw them, each once
+    std::vector<uint32_t> aging_{};
+    std::vector<uint8_t> aging_listed_{};
+    std::chrono::nanoseconds max_age_{};
+    // clock as of the last tick, what new batches are stamped with
+    std::chrono::steady_clock::time_point now_{std::chrono::steady_clock::now()};
 
     io_uring ring_{};
     bool ring_ready_{false};
-
-    std::array<std::vector<jolt::ob::L3Data>, kDepth> slot_bufs_{};
-    std::array<bool, kDepth> slot_in_flight_{};
-    std::array<size_t, kDepth> slot_expected_bytes_{};
-    size_t next_slot_{0};
+    bool fixed_bufs_{false};
+    bool fixed_files_{false};
+
+    // every symbol can hold a batch open while kDepth more are in flight. records of all batches first,
+    // then their blocks
+    std::byte* arena_{nullptr};
+    size_t arena_bytes_{0};
+    std::vector<Batch> batches_{};
+    std::vector<uint32_t> free_{};
     size_t in_flight_{0};
+    size_t queued_{0};
+    uint64_t records_written_{0};
 
+    static std::runtime_error make_errno_error(const char* what, int err) {
+        const int code = (err < 0) ? -err : err;
+        return std::runtime_error(std::string(what) + ": " + std::strerror(code));
+    }
 
-    struct DayHeader {
-        uint64_t symbol_id;
-        uint64_t day_id;
-        uint64_t max_seq;
-        uint64_t bytes;
-    };
-
-    static std::string today_yyyymmdd_utc() {
-        using namespace std::chrono;
-        const auto now = system_clock::now();
-        const auto tt = system_clock::to_time_t(now);
-        std::tm tm{};
-        gmtime_r(&tt, &tm);
+    static void pwrite_all(int fd, const void* data, size_t bytes, uint64_t off) {
+        auto* p = static_cast<const std::byte*>(data);
+        while (bytes > 0) {
+            const ssize_t n = ::pwrite(fd, p, bytes, static_cast<off_t>(off));
+            if (n < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                throw make_errno_error("l3 write failed", errno);
+            }
+            p += n;
+            off += static_cast<uint64_t>(n);
+            bytes -= static_cast<size_t>(n);
+        }
+    }
 
-        char buf[9];
-        const int wrote = std::snprintf(buf, sizeof(buf), "%04d%02d%02d",
-                                        tm.tm_year + 1900,
-                                        tm.tm_mon + 1,
-                                        tm.tm_mday);
-        if (wrote != 8) {
-            throw std::runtime_error("failed to format UTC day");
+    void close_all_fds() noexcept {
+        for (size_t i = 0; i < files_.size(); ++i) {
+            if (files_[i].fd >= 0) {
+                ::close(files_[i].fd);
+            }
+            files_[i].fd = -1;
+            symbol_fds_[i] = -1;
         }
-        return std::string(buf, 8);
     }
 
-    static std::runtime_error make_errno_error(const char* what, int err) {
-        const int code = (err < 0) ? -err : err;
-        return std::runtime_error(std::string(what) + ": " + std::strerror(code));
+    // opens every symbol's file for day_id_. a file already there from an earlier run of the day keeps its
+    // blocks and index, its footer and any torn tail are cut off and blocks are appended after them
+    void open_day() {
+        std::filesystem::create_directories(jolt::l3::day_dir(root_, day_id_));
+        for (size_t i = 0; i < files_.size(); ++i) {
+            const uint16_t symbol_id = instruments_.at(i).symbol_id;
+            const std::string path = jolt::l3::file_path(root_, day_id_, symbol_id);
+            SymbolFile& f = files_[i];
+            f.index.clear();
+            {
+                const jolt::l3::Reader existing(path);
+                f.index = existing.index();
+                f.end = existing.end_offset();
+            }
+            f.fd = ::open(path.c_str(), O_CREAT | O_WRONLY | O_CLOEXEC, 0644);
+            if (f.fd < 0) {
+                throw make_errno_error("open failed", errno);
+            }
+            symbol_fds_[i] = f.fd;
+            if (f.end == 0) {
+                jolt::l3::FileHeader h{};
+                h.symbol_id = symbol_id;
+                h.day_id = day_id_;
+                pwrite_all(f.fd, &h, sizeof(h), 0);
+                f.end = sizeof(h);
+            }
+            if (::ftruncate(f.fd, static_cast<off_t>(f.end)) != 0) {
+                throw make_errno_error("l3 truncate failed", errno);
+            }
+        }
     }
 
-    void close_all_fds() noexcept {
-        for (int& fd : symbol_fds_) {
-            if (fd >= 0) {
-                ::close(fd);
-                fd = -1;
+    // appends every file's index and trailer, once all its blocks are written
+    void write_footers() {
+        for (SymbolFile& f : files_) {
+            if (f.fd < 0) {
+                continue;
             }
+            jolt::l3::Trailer t{};
+            t.index_offset = f.end;
+            t.index_count = static_cast<uint32_t>(f.index.size());
+            pwrite_all(f.fd, f.index.data(), f.index.size() * sizeof(jolt::l3::IndexEntry), f.end);
+            pwrite_all(f.fd, &t, sizeof(t), f.end + f.index.size() * sizeof(jolt::l3::IndexEntry));
         }
     }
 
-    void ensure_open(uint16_t symbol_id) {
-        if (!jolt::is_valid_symbol_id(symbol_id)) {
-            throw std::runtime_error("invalid symbol id");
+    io_uring_sqe* next_sqe() {
+        io_uring_sqe* sqe = io_uring_get_sqe(&ring_);
+        if (!sqe) {
+            submit_queued();
+            sqe = io_uring_get_sqe(&ring_);
+            if (!sqe) {
+                throw std::runtime_error("io_uring_get_sqe failed");
+            }
         }
-        const size_t symbol_idx = static_cast<size_t>(symbol_id - jolt::kFirstSymbolId);
+        return sqe;
+    }
 
-        const std::string day = today_yyyymmdd_utc();
-        if (day != day_) {
-            close_all_fds();
-            day_ = day;
+    void submit_queued() {
+        const int rc = io_uring_submit(&ring_);
+        if (rc < 0) {
+            throw make_errno_error("io_uring_submit failed", rc);
         }
+        queued_ = 0;
+    }
 
-        int& fd = symbol_fds_[symbol_idx];
-        if (fd >= 0) {
-            return;
+    uint32_t acquire_batch() {
+        while (free_.empty()) {
+            if (queued_ > 0) {
+                submit_queued();
+            }
+            reap_one_blocking();
         }
+        const uint32_t idx = free_.back();
+        free_.pop_back();
+        return idx;
+    }
 
-        std::filesystem::create_directories(root_ + "/" + day_);
-        const std::string path = root_ + "/" + day_ + "/sym_" + std::to_string(symbol_id) + ".l3bin";
+    // encodes a symbol's open batch and queues its write, it goes out with the next submit
+    void queue_batch(size_t symbol_idx) {
+        const uint32_t idx = open_[symbol_idx];
+        open_[symbol_idx] = kNoBatch;
+        Batch& b = batches_[idx];
+        b.block_bytes = static_cast<uint32_t>(jolt::l3::encode_block(b.data, b.count, b.block));
+        SymbolFile& f = files_[symbol_idx];
+        f.index.push_back(jolt::l3::IndexEntry{b.data[0].seq, b.data[0].ts, f.end, b.count});
+        const uint64_t off = f.end;
+        f.end += b.block_bytes;
+
+        io_uring_sqe* sqe = next_sqe();
+        const int fd = fixed_files_ ? static_cast<int>(symbol_idx) : f.fd;
+        if (fixed_bufs_) {
+            io_uring_prep_write_fixed(sqe, fd, b.block, b.block_bytes, off, 0);
+        }
+        else {
+            io_uring_prep_write(sqe, fd, b.block, b.block_bytes, off);
+        }
+        if (fixed_files_) {
+            io_uring_sqe_set_flags(sqe, IOSQE_FIXED_FILE);
+        }
+        io_uring_sqe_set_data64(sqe, idx);
+        b.in_flight = true;
+        ++in_flight_;
+        ++queued_;
+    }
 
-        fd = ::open(path.c_str(), O_CREAT | O_WRONLY | O_APPEND | O_CLOEXEC, 0644);
-        if (fd < 0) {
-            throw make_errno_error("open failed", errno);
+    // queues the open batches that reached max_age, the symbols whose batch is still young stay listed
+    void queue_aged() {
+        size_t kept = 0;
+        for (const uint32_t symbol_idx : aging_) {
+            const uint32_t idx = open_[symbol_idx];
+            if (idx != kNoBatch && now_ - batches_[idx].opened >= max_age_) {
+                queue_batch(symbol_idx);
+            }
+            if (open_[symbol_idx] != kNoBatch) {
+                aging_[kept++] = symbol_idx;
+            }
+            else {
+                aging_listed_[symbol_idx] = 0;
+            }
         }
+        aging_.resize(kept);
     }
 
-    void complete_slot_from_cqe(io_uring_cqe* cqe) {
-        const size_t slot = io_uring_cqe_get_data64(cqe);
+    void complete(io_uring_cqe* cqe) {
+        const size_t idx = io_uring_cqe_get_data64(cqe);
         const int res = cqe->res;
         io_uring_cqe_seen(&ring_, cqe);
 
-        if (slot >= kDepth || !slot_in_flight_[slot]) {
+        if (idx >= batches_.size() || !batches_[idx].in_flight) {
             throw std::runtime_error("invalid completion slot");
         }
-
-        const size_t expected = slot_expected_bytes_[slot];
-        slot_in_flight_[slot] = false;
-        slot_expected_bytes_[slot] = 0;
-        if (in_flight_ > 0) {
-            --in_flight_;
-        }
+        Batch& b = batches_[idx];
+        const size_t expected = b.block_bytes;
+        records_written_ += b.count;
+        b.in_flight = false;
+        b.count = 0;
+        free_.push_back(static_cast<uint32_t>(idx));
+        --in_flight_;
 
         if (res < 0) {
             throw make_errno_error("async write failed", res);
@@ -123,124 +265,152 @@ class L3DataWriter {
         }
     }
 
+    void reap_one_blocking() {
+        io_uring_cqe* cqe = nullptr;
+        const int rc = io_uring_wait_cqe(&ring_, &cqe);
+        if (rc < 0) {
+            throw make_errno_error("io_uring_wait_cqe failed", rc);
+        }
+        complete(cqe);
+    }
+
+    void reap_completions() {
+        io_uring_cqe* cqe = nullptr;
+        while (io_uring_peek_cqe(&ring_, &cqe) == 0 && cqe) {
+            complete(cqe);
+        }
+    }
+
 public:
-    explicit L3DataWriter(std::string root) : root_(std::move(root)) {
-        symbol_fds_.fill(-1);
-        slot_in_flight_.fill(false);
-        slot_expected_bytes_.fill(0);
+    L3DataWriter(std::string root, const jolt::InstrumentRegistry& instruments,
+                 std::chrono::nanoseconds max_age = std::chrono::milliseconds(100))
+        : root_(std::move(root)),
+          day_id_(static_cast<uint64_t>(std::chrono::floor<std::chrono::days>(std::chrono::system_clock::now())
+                                            .time_since_epoch().count())),
+          instruments_(instruments), files_(instruments.size()), symbol_fds_(instruments.size(), -1),
+          open_(instruments.size(), kNoBatch), aging_listed_(instruments.size(), 0), max_age_(max_age) {
+        const size_t num_batches = instruments_.size() + kDepth;
+        const size_t blocks_at = num_batches * kBatchBytes;
+        arena_bytes_ = (blocks_at + num_batches * kBlockBytes + kArenaAlign - 1) / kArenaAlign * kArenaAlign;
+        arena_ = static_cast<std::byte*>(std::aligned_alloc(kArenaAlign, arena_bytes_));
+        if (!arena_) {
+            throw std::bad_alloc();
+        }
+        batches_.resize(num_batches);
+        free_.reserve(num_batches);
+        for (size_t i = num_batches; i-- > 0;) {
+            batches_[i].data = reinterpret_cast<jolt::ob::L3Data*>(arena_ + i * kBatchBytes);
+            batches_[i].block = arena_ + blocks_at + i * kBlockBytes;
+            free_.push_back(static_cast<uint32_t>(i));
+        }
 
-        const int rc = io_uring_queue_init(kDepth, &ring_, 0);
+        const int rc = io_uring_queue_init(kDepth * 2, &ring_, 0);
         if (rc < 0) {
+            std::free(arena_);
             throw make_errno_error("io_uring_queue_init failed", rc);
         }
         ring_ready_ = true;
 
-        for (size_t i = 0; i < symbol_fds_.size(); ++i) {
-            ensure_open(static_cast<uint16_t>(jolt::kFirstSymbolId + i));
-        }
+        open_day();
 
-        for (auto& b : slot_bufs_) {
-            b.reserve(kMaxRecordsPerBatch);
-        }
+        // the arena is one registered buffer. registration pins it and counts against RLIMIT_MEMLOCK, when
+        // that is refused the same batches go out as plain writes
+        const iovec iov{arena_, arena_bytes_};
+        fixed_bufs_ = io_uring_register_buffers(&ring_, &iov, 1) == 0;
+        fixed_files_ = !symbol_fds_.empty() &&
+            io_uring_register_files(&ring_, symbol_fds_.data(), static_cast<unsigned>(symbol_fds_.size())) == 0;
     }
 
     ~L3DataWriter() noexcept {
         if (ring_ready_) {
-            (void)io_uring_submit(&ring_);
-            while (in_flight_ > 0) {
-                reap_one_blocking();
+            try {
+                flush();
+                write_footers();
+            }
+            catch (...) {
             }
             io_uring_queue_exit(&ring_);
         }
-
-
         close_all_fds();
+        std::free(arena_);
     }
 
-    size_t acquire_free_slot_blocking() {
-        for (;;) {
-            if (in_flight_ < kDepth) {
-                for (size_t i = 0; i < kDepth; ++i) {
-                    const size_t slot = (next_slot_ + i) % kDepth;
-                    if (!slot_in_flight_[slot]) {
-                        next_slot_ = (slot + 1) % kDepth;
-                        return slot;
-                    }
-                }
+    L3DataWriter(const L3DataWriter&) = delete;
+    L3DataWriter& operator=(const L3DataWriter&) = delete;
+
+    bool fixed_buffers() const { return fixed_bufs_; }
+    bool fixed_files() const { return fixed_files_; }
+    uint64_t day_id() const { return day_id_; }
+    // records whose write has completed
+    uint64_t records_written() const { return records_written_; }
+
+    // copies one record of the symbol at registry index symbol_idx into its batch buffer, the only copy
+    // it gets on the way to disk. a full batch is queued for the next tick
+    void append(size_t symbol_idx, const jolt::ob::L3Data& data) {
+        uint32_t idx = open_[symbol_idx];
+        if (idx == kNoBatch) {
+            idx = acquire_batch();
+            open_[symbol_idx] = idx;
+            batches_[idx].opened = now_;
+            if (!aging_listed_[symbol_idx]) {
+                aging_listed_[symbol_idx] = 1;
+                aging_.push_back(static_cast<uint32_t>(symbol_idx));
             }
-
-            const int rc = io_uring_submit(&ring_);
-            if (rc < 0) {
-                throw make_errno_error("io_uring_submit failed", rc);
-            }
-            reap_one_blocking();
+        }
+        Batch& b = batches_[idx];
+        b.data[b.count] = data;
+        if (++b.count == kBatchRecords) {
+            queue_batch(symbol_idx);
         }
     }
 
-    void write_batch(uint16_t symbol_id, const jolt::ob::L3Data* data, size_t n) {
-        if (n == 0) {
-            return;
+    // matching thread, once per poll: queues the batches older than max_age, then one submit for every
+    // batch queued since the last tick
+    void tick() {
+        now_ = std::chrono::steady_clock::now();
+        if (!aging_.empty()) {
+            queue_aged();
         }
-
-        ensure_open(symbol_id);
-        const size_t symbol_idx = static_cast<size_t>(symbol_id - jolt::kFirstSymbolId);
-
-        reap_completions();
-
-        const size_t slot = acquire_free_slot_blocking();
-
-        auto& buf = slot_bufs_[slot];
-        buf.assign(data, data + n);
-        const size_t bytes = buf.size() * sizeof(jolt::ob::L3Data);
-
-        io_uring_sqe* sqe = io_uring_get_sqe(&ring_);
-        if (!sqe) {
-            const int s = io_uring_submit(&ring_);
-            if (s < 0) {
-                throw make_errno_error("io_uring_submit failed", s);
-            }
-            reap_one_blocking();
-
-            sqe = io_uring_get_sqe(&ring_);
-            if (!sqe) {
-                throw std::runtime_error("io_uring_get_sqe failed");
-            }
+        if (queued_ > 0) {
+            submit_queued();
         }
-
-        io_uring_prep_write(sqe,
-                            symbol_fds_[symbol_idx],
-                            buf.data(),
-                            static_cast<unsigned>(bytes),
-                            static_cast<__u64>(-1));
-
-        io_uring_sqe_set_data64(sqe, slot);
-
-        slot_expected_bytes_[slot] = bytes;
-        slot_in_flight_[slot] = true;
-        ++in_flight_;
-
-        const int ret = io_uring_submit(&ring_);
-        if (ret < 0) {
-            slot_in_flight_[slot] = false;
-            slot_expected_bytes_[slot] = 0;
-            --in_flight_;
-            throw make_errno_error("io_uring_submit failed", ret);
+        if (in_flight_ > 0) {
+            reap_completions();
         }
     }
 
-    void reap_one_blocking() {
-        io_uring_cqe* cqe = nullptr;
-        const int rc = io_uring_wait_cqe(&ring_, &cqe);
-        if (rc < 0) {
-            throw make_errno_error("io_uring_wait_cqe failed", rc);
+    // writes every partly filled batch and waits for all writes
+    void flush() {
+        for (size_t i = 0; i < open_.size(); ++i) {
+            if (open_[i] != kNoBatch) {
+                queue_batch(i);
+            }
+        }
+        if (queued_ > 0) {
+            submit_queued();
+        }
+        while (in_flight_ > 0) {
+            reap_one_blocking();
         }
-        complete_slot_from_cqe(cqe);
     }
 
-    void reap_completions() {
-        io_uring_cqe* cqe = nullptr;
-        while (io_uring_peek_cqe(&ring_, &cqe) == 0 && cqe) {
-            complete_slot_from_cqe(cqe);
+    // moves to the files of day_id once everything of the old day is written. DayTicker's day, so the
+    // writer follows the same roll as the books
+    void roll_day(uint64_t day_id) {
+        if (day_id == day_id_) {
+            return;
+        }
+        flush();
+        write_footers();
+        close_all_fds();
+        day_id_ = day_id;
+        open_day();
+        if (fixed_files_) {
+            const int rc = io_uring_register_files_update(&ring_, 0, symbol_fds_.data(),
+                                                          static_cast<unsigned>(symbol_fds_.size()));
+            if (rc < 0) {
+                throw make_errno_error("io_uring_register_files_update failed", rc);
+            }
         }
     }
 };
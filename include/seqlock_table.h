@@ -0,0 +1,179 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <xmmintrin.h>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+enum class SeqlockMode : uint8_t { Create = 0, Attach = 1 };
+
+namespace seqlock_detail {
+    inline std::string normalize_shm_name(std::string name) {
+        if (name.empty()) {
+            throw std::runtime_error("seqlock table name cannot be empty");
+        }
+        if (name.front() != '/') {
+            name.insert(name.begin(), '/');
+        }
+        return name;
+    }
+}
+
+// fixed array of T in shared memory, each slot guarded by its own seqlock. one writer per slot
+// overwrites it in place, any number of readers in any process copy it out and retry if a write
+// overlapped the copy. readers never block the writer and never touch a line the writer reads
+template <typename T>
+class SeqlockTable {
+    static_assert(std::is_trivially_copyable_v<T>, "T must be trivially copyable");
+    static_assert(std::is_trivially_destructible_v<T>, "T must be trivially destructible");
+
+    static constexpr uint64_t kMagic = 0x5345514C4F434B54ULL; // "SEQLOCKT"
+    static constexpr uint32_t kVersion = 1;
+
+    struct Header {
+        uint64_t magic{0};
+        uint32_t version{0};
+        uint32_t slot_bytes{0};
+        uint32_t slots{0};
+        std::atomic<uint8_t> ready{0};
+    };
+
+    // odd seq while a write is in progress
+    struct alignas(64) Slot {
+        std::atomic<uint64_t> seq{0};
+        T value{};
+    };
+
+    int fd_{-1};
+    void* map_{nullptr};
+    size_t mapped_bytes_{0};
+    Header* hdr_{nullptr};
+    Slot* slots_{nullptr};
+    uint32_t count_{0};
+    std::string name_;
+    bool owner_{false};
+
+    static constexpr size_t slots_offset() {
+        return (sizeof(Header) + alignof(Slot) - 1) & ~(alignof(Slot) - 1);
+    }
+
+    static constexpr size_t bytes_needed(const size_t slot_count) {
+        return slots_offset() + slot_count * sizeof(Slot);
+    }
+
+public:
+    SeqlockTable(const std::string& name, const SeqlockMode mode, const uint32_t slots = 0)
+        : name_(seqlock_detail::normalize_shm_name(name)), owner_(mode == SeqlockMode::Create) {
+        if (owner_ && slots == 0) {
+            throw std::runtime_error("seqlock table needs at least one slot");
+        }
+        const int oflag = owner_ ? (O_CREAT | O_RDWR) : O_RDWR;
+        fd_ = ::shm_open(name_.c_str(), oflag, 0600);
+        if (fd_ < 0) {
+            throw std::runtime_error("shm_open failed");
+        }
+
+        if (owner_) {
+            mapped_bytes_ = bytes_needed(slots);
+            if (::ftruncate(fd_, static_cast<off_t>(mapped_bytes_)) != 0) {
+                throw std::runtime_error("ftruncate failed");
+            }
+        }
+        else {
+            struct stat st{};
+            if (::fstat(fd_, &st) != 0) {
+                throw std::runtime_error("fstat failed");
+            }
+            mapped_bytes_ = static_cast<size_t>(st.st_size);
+            if (mapped_bytes_ < bytes_needed(1)) {
+                throw std::runtime_error("seqlock table mapping too small");
+            }
+        }
+
+        map_ = ::mmap(nullptr, mapped_bytes_, PROT_READ | PROT_WRITE, MAP_SHARED, fd_, 0);
+        if (map_ == MAP_FAILED) {
+            throw std::runtime_error("mmap failed");
+        }
+        hdr_ = static_cast<Header*>(map_);
+        slots_ = reinterpret_cast<Slot*>(static_cast<std::byte*>(map_) + slots_offset());
+
+        if (owner_) {
+            std::memset(map_, 0, mapped_bytes_);
+            hdr_->magic = kMagic;
+            hdr_->version = kVersion;
+            hdr_->slot_bytes = sizeof(T);
+            hdr_->slots = slots;
+            count_ = slots;
+            hdr_->ready.store(1, std::memory_order_release);
+        }
+        else {
+            if (hdr_->ready.load(std::memory_order_acquire) == 0 || hdr_->magic != kMagic ||
+                hdr_->version != kVersion || hdr_->slot_bytes != sizeof(T) ||
+                bytes_needed(hdr_->slots) > mapped_bytes_) {
+                throw std::runtime_error("seqlock table shape mismatch");
+            }
+            count_ = hdr_->slots;
+        }
+    }
+
+    ~SeqlockTable() {
+        if (map_ && map_ != MAP_FAILED) {
+            ::munmap(map_, mapped_bytes_);
+        }
+        if (fd_ >= 0) {
+            ::close(fd_);
+        }
+        if (owner_) {
+            ::shm_unlink(name_.c_str());
+        }
+    }
+
+    SeqlockTable(const SeqlockTable&) = delete;
+    SeqlockTable& operator=(const SeqlockTable&) = delete;
+
+    [[nodiscard]] uint32_t size() const { return count_; }
+
+    // writer(T&) fills the slot in place. only the slot's single writer may call this
+    template <typename Fn>
+    void write(const uint32_t idx, Fn&& writer) {
+        Slot& s = slots_[idx];
+        const uint64_t seq = s.seq.load(std::memory_order_relaxed);
+        s.seq.store(seq + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        writer(s.value);
+        s.seq.store(seq + 2, std::memory_order_release);
+    }
+
+    // one attempt at a consistent copy, false if a write was in progress or overlapped it
+    bool try_read(const uint32_t idx, T& out) const {
+        const Slot& s = slots_[idx];
+        const uint64_t before = s.seq.load(std::memory_order_acquire);
+        if (before & 1) {
+            return false;
+        }
+        std::memcpy(&out, &s.value, sizeof(T));
+        std::atomic_thread_fence(std::memory_order_acquire);
+        return s.seq.load(std::memory_order_relaxed) == before;
+    }
+
+    // retries until a consistent copy is taken, writes are short so this rarely spins
+    void read(const uint32_t idx, T& out) const {
+        while (!try_read(idx, out)) {
+            _mm_pause();
+        }
+    }
+
+    // number of completed writes to the slot, lets a poller skip slots that did not change
+    [[nodiscard]] uint64_t writes(const uint32_t idx) const {
+        return slots_[idx].seq.load(std::memory_order_acquire) / 2;
+    }
+};
@@ -251,12 +251,14 @@ namespace {
 }
 
 namespace jolt::md {
-    MarketDataGateway::MarketDataGateway() : event_loop_(make_listen_socket(80))
+    MarketDataGateway::MarketDataGateway(const InstrumentRegistry& instruments)
+        : instruments_(instruments), symbol_buffers_(instruments.size()), batch_sizes_(instruments.size(), 0),
+          event_loop_(make_listen_socket(80))
     {
         event_loop_.set_gateway(this);
 
-        for (size_t i = 0; i < jolt::kNumSymbols; ++i) {
-            const uint16_t symbol_id = static_cast<uint16_t>(jolt::kFirstSymbolId + i);
+        for (size_t i = 0; i < instruments_.size(); ++i) {
+            const uint16_t symbol_id = instruments_.at(i).symbol_id;
             const std::string symbol = std::to_string(symbol_id);
             add_symbol_channel(symbol, kDefaultMdGroup, static_cast<uint16_t>(kDefaultUdpBasePort + i));
             symbol_to_id_[symbol] = symbol_id;
@@ -15,17 +15,18 @@
 #include "exchange/orderbook/flat_map.h"
 #include "include/shared_mem_blob.h"
 #include "include/Types.h"
+#include "include/InstrumentRegistry.h"
 
 namespace jolt::md {
     class MarketDataGateway {
 
-        static constexpr size_t NUM_SYMBOLS = 10;
         static constexpr size_t BATCH_SZ = 38;
 
 
-
-        std::vector<std::array<ob::L3Data, BATCH_SZ>> symbol_buffers_{NUM_SYMBOLS};
-        std::vector<size_t> batch_sizes_{NUM_SYMBOLS};
+        InstrumentRegistry instruments_;
+        // indexed by registry index
+        std::vector<std::array<ob::L3Data, BATCH_SZ>> symbol_buffers_;
+        std::vector<size_t> batch_sizes_;
         ControlEventLoop event_loop_;
 
 
@@ -55,7 +56,7 @@ namespace jolt::md {
 
     public:
 
-        MarketDataGateway();
+        explicit MarketDataGateway(const InstrumentRegistry& instruments);
         void setup();
         void poll();
         void poll_io();
@@ -57,6 +57,16 @@ namespace jolt::md {
         uint64_t end_seq{0};
     };
 
+    // precedes the records of a retransmission, count L3Data records with start_seq <= seq <= end_seq
+    struct RetransmissionMeta {
+        uint64_t request_id{0};
+        uint64_t session_id{0};
+        uint64_t start_seq{0};
+        uint64_t end_seq{0};
+        uint32_t count{0};
+        uint16_t symbol_id{0};
+    };
+
     struct Response {
         uint64_t request_id{0};
         uint16_t symbol_id{0};
@@ -5,11 +5,15 @@
 #include "RecoverySever.h"
 
 #include <cerrno>
+#include <chrono>
 #include <cstring>
 #include <stdexcept>
 
+#include "include/l3_store.h"
+
 #include <fcntl.h>
 #include <netdb.h>
+#include <sys/uio.h>
 #include <netinet/in.h>
 #include <sys/socket.h>
 #include <unistd.h>
@@ -17,6 +21,10 @@
 namespace jolt::md {
     namespace {
         constexpr uint64_t kListenId = 1ull << 63;
+        // iovecs gathered into one writev, a history frame takes two when it wraps
+        constexpr size_t kMaxIov = 16;
+        // a history lookup that keeps racing the writer falls back to the file
+        constexpr int kLocateAttempts = 4;
 
         int make_listen_socket(const std::string& host, uint16_t port) {
             addrinfo hints{};
@@ -59,11 +67,15 @@ namespace jolt::md {
     }
 
     RecoverySever::RecoverySever(const std::string& host, uint16_t port, const std::string& blob_name,
-                                 const std::string& meta_name, const std::string& request_name)
+                                 const std::string& meta_name, const std::string& request_name,
+                                 const std::string& data_root, const std::string& history_name)
         : snapshot_pool_(blob_name, PoolMode::Attach), snapshot_meta_q_(meta_name, SharedRingMode::Attach),
           snapshot_request_q_(request_name, SharedRingMode::Create),
           listen_host_(host),
-          listen_port_(port) {
+          listen_port_(port), data_root_(data_root) {
+        if (!history_name.empty()) {
+            history_ = std::make_unique<L3History>(history_name, HistoryMode::Attach);
+        }
         listen_fd_ = make_listen_socket(host, port);
         if (listen_fd_ < 0) {
             throw std::runtime_error("failed to bind recovery server listen socket");
@@ -160,6 +172,84 @@ namespace jolt::md {
         req.start_seq = start_seq;
         req.end_seq = end_seq;
 
+        auto* session = lookup(session_id);
+        if (!session || session->closed_ || start_seq > end_seq) {
+            return;
+        }
+
+        // the recent part of the range comes from the history ring, whatever it no longer holds from the
+        // file. ring records with seq above disk_to go out from the ring, the file covers up to disk_to
+        uint64_t disk_to = end_seq;
+        uint64_t disk_from = start_seq;
+        L3History::Range ring{};
+        const uint32_t r = history_ ? history_->ring_of(static_cast<uint16_t>(symbol_id)) : 0;
+        if (history_ && r < history_->symbols()) {
+            for (int attempt = 0; attempt < kLocateAttempts; ++attempt) {
+                L3History::Range first{};
+                if (!history_->locate(r, start_seq, end_seq, first)) {
+                    continue;
+                }
+                if (first.complete) {
+                    ring = first;
+                    disk_from = 1;
+                    disk_to = 0;
+                    break;
+                }
+                // seqs repeat across the events of one order, so the oldest seq held may be partly gone
+                // from the ring: the file serves it whole and the ring starts after it
+                L3History::Range rest{};
+                if (!history_->locate(r, first.oldest_seq + 1, end_seq, rest) || rest.oldest_seq != first.oldest_seq) {
+                    continue;
+                }
+                ring = rest;
+                disk_to = std::min(end_seq, first.oldest_seq);
+                break;
+            }
+        }
+
+        DataSession::TxItem body{};
+        body.kind = DataSession::TxItem::Kind::L3;
+        body.offset = 0;
+        uint64_t disk_count = 0;
+        if (disk_from <= disk_to) {
+            // the block index finds disk_from in O(log n), only the blocks covering the range are decoded
+            const auto day = std::chrono::floor<std::chrono::days>(std::chrono::system_clock::now());
+            const l3::Reader reader(l3::file_path(data_root_, static_cast<uint64_t>(day.time_since_epoch().count()),
+                                                  static_cast<uint16_t>(req.symbol_id)));
+            disk_count = reader.scan_seq(disk_from, disk_to, decode_buf_, [&](const ob::L3Data& rec) {
+                const auto* p = reinterpret_cast<const char*>(&rec);
+                body.payload.insert(body.payload.end(), p, p + sizeof(rec));
+            });
+        }
+
+        RetransmissionMeta meta{};
+        meta.request_id = req.request_id;
+        meta.session_id = req.session_id;
+        meta.start_seq = req.start_seq;
+        meta.end_seq = req.end_seq;
+        meta.count = static_cast<uint32_t>(disk_count + (ring.to - ring.from));
+        meta.symbol_id = static_cast<uint16_t>(req.symbol_id);
+        DataSession::TxItem hdr{};
+        hdr.kind = DataSession::TxItem::Kind::Header;
+        hdr.offset = 0;
+        hdr.payload.resize(sizeof(meta));
+        std::memcpy(hdr.payload.data(), &meta, sizeof(meta));
+
+        session->tx_buf_.push_back(std::move(hdr));
+        if (disk_count > 0) {
+            session->tx_buf_.push_back(std::move(body));
+        }
+        if (ring.to > ring.from) {
+            DataSession::TxItem tail{};
+            tail.kind = DataSession::TxItem::Kind::HistoryL3;
+            tail.offset = 0;
+            tail.bytes = static_cast<uint32_t>((ring.to - ring.from) * sizeof(ob::L3Data));
+            tail.history_ring = r;
+            tail.history_from = ring.from;
+            tail.history_to = ring.to;
+            session->tx_buf_.push_back(std::move(tail));
+        }
+        update_interest(session->fd_, session_id, true);
     }
 
     void RecoverySever::handle_snapshot_response() {
@@ -211,29 +301,84 @@ namespace jolt::md {
                 (void)snapshot_pool_.release(handle);
                 session.tx_buf_.pop_front();
             }
-            else {
-                const size_t remaining = frame.payload.size() - frame.offset;
-                const ssize_t n = ::write(session.fd_, frame.payload.data() + frame.offset, remaining);
-                if (n < 0) {
-                    if (errno == EAGAIN || errno == EWOULDBLOCK) {
-                        return true;
-                    }
-                    return false;
-                }
-                if (n == 0) {
-                    return false;
-                }
+            else if (!send_gathered(session)) {
+                return false;
+            }
+            else if (!session.tx_buf_.empty() && session.tx_buf_.front().kind != DataSession::TxItem::Kind::Snapshot) {
+                // the socket took less than was gathered
+                return true;
+            }
+        }
 
-                if (static_cast<size_t>(n) == remaining) {
-                    session.tx_buf_.pop_front();
+        return true;
+    }
+
+    // one writev over the leading payload and history frames, each sent straight from its buffer. a history
+    // frame whose records the writer lapped before or while they were sent fails the session, the bytes on
+    // the wire can no longer be trusted. the ring holds far more than a socket buffer, so this needs a
+    // client that stalls for a whole ring's worth of publishing
+    bool RecoverySever::send_gathered(DataSession& session) {
+        using Kind = DataSession::TxItem::Kind;
+        const auto frame_bytes = [](const DataSession::TxItem& f) {
+            return f.kind == Kind::HistoryL3 ? static_cast<size_t>(f.bytes) : f.payload.size();
+        };
+        const auto history_pos = [](const DataSession::TxItem& f) {
+            return f.history_from + f.offset / sizeof(ob::L3Data);
+        };
+
+        std::array<iovec, kMaxIov> iov{};
+        size_t n = 0;
+        for (auto& f : session.tx_buf_) {
+            if (f.kind == Kind::Snapshot || n + 2 > kMaxIov) {
+                break;
+            }
+            if (f.kind == Kind::HistoryL3) {
+                if (!history_ || !history_->still_valid(f.history_ring, history_pos(f))) {
+                    return false;
                 }
-                else {
-                    frame.offset += static_cast<size_t>(n);
-                    return true;
+                const ob::L3Data* ptr[2];
+                size_t count[2];
+                const size_t spans = history_->spans(f.history_ring, f.history_from, f.history_to, ptr, count);
+                size_t skip = f.offset;
+                for (size_t i = 0; i < spans; ++i) {
+                    const size_t len = count[i] * sizeof(ob::L3Data);
+                    if (skip >= len) {
+                        skip -= len;
+                        continue;
+                    }
+                    iov[n++] = iovec{const_cast<char*>(reinterpret_cast<const char*>(ptr[i])) + skip, len - skip};
+                    skip = 0;
                 }
             }
+            else {
+                iov[n++] = iovec{f.payload.data() + f.offset, f.payload.size() - f.offset};
+            }
+        }
+        if (n == 0) {
+            return true;
+        }
+
+        const ssize_t wrote = ::writev(session.fd_, iov.data(), static_cast<int>(n));
+        if (wrote < 0) {
+            return errno == EAGAIN || errno == EWOULDBLOCK;
+        }
+        if (wrote == 0) {
+            return false;
         }
 
+        size_t left = static_cast<size_t>(wrote);
+        while (left > 0) {
+            auto& f = session.tx_buf_.front();
+            if (f.kind == Kind::HistoryL3 && !history_->still_valid(f.history_ring, history_pos(f))) {
+                return false;
+            }
+            const size_t take = std::min(left, frame_bytes(f) - f.offset);
+            f.offset += take;
+            left -= take;
+            if (f.offset == frame_bytes(f)) {
+                session.tx_buf_.pop_front();
+            }
+        }
         return true;
     }
 
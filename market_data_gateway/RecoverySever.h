@@ -16,6 +16,7 @@
 #include <unordered_map>
 #include <vector>
 #include "../include/shared_mem_blob.h"
+#include "../include/l3_history.h"
 
 #include <sys/epoll.h>
 
@@ -37,7 +38,7 @@ namespace jolt::md {
             explicit DataSession(int fd, uint64_t id) : fd_(fd), session_id_(id) {}
 
             struct TxItem {
-                enum class Kind : uint8_t {Snapshot = 0, L3 = 1, Header = 2};
+                enum class Kind : uint8_t {Snapshot = 0, L3 = 1, Header = 2, HistoryL3 = 3};
 
                 size_t offset;
                 Kind kind;
@@ -45,6 +46,10 @@ namespace jolt::md {
                 uint16_t slot_idx;
                 uint32_t slot_gen{0};
                 std::vector<char> payload;
+                // HistoryL3: positions [history_from, history_to) of a history ring, sent from the ring itself
+                uint32_t history_ring{0};
+                uint64_t history_from{0};
+                uint64_t history_to{0};
             };
 
             int fd_{-1};
@@ -60,6 +65,7 @@ namespace jolt::md {
         void update_interest(int fd, uint64_t id, bool want_write);
         DataSession* lookup(uint64_t id);
         bool send_pending(DataSession& session);
+        bool send_gathered(DataSession& session);
         void recv_pending(DataSession& session);
         void on_readable(DataSession& session);
         void handle_read(DataSession& session);
@@ -78,12 +84,19 @@ namespace jolt::md {
         uint64_t session_id_assign_{0};
         std::unordered_map<uint64_t, std::unique_ptr<DataSession>> sessions_{};
         std::vector<epoll_event> events_{};
+        // retransmissions come from the gateway's history ring and, for what it no longer holds, from
+        // today's l3 file under data_root_
+        std::unique_ptr<L3History> history_{};
+        std::string data_root_{};
+        std::vector<ob::L3Data> decode_buf_{};
 
         SnapshotRequestQ snapshot_request_q_;
         SnapshotMetaQ snapshot_meta_q_;
 
     public:
-        RecoverySever(const std::string& host, uint16_t port, const std::string& blob_name, const std::string& meta_name, const std::string& request_name);
+        // an empty history_name serves retransmissions from the l3 files only
+        RecoverySever(const std::string& host, uint16_t port, const std::string& blob_name, const std::string& meta_name, const std::string& request_name,
+                      const std::string& data_root = "../data", const std::string& history_name = "");
         virtual ~RecoverySever();
 
         RecoverySever(const RecoverySever&) = delete;
@@ -22,15 +22,24 @@ namespace jolt::md {
         return dst;
     }
 
-    bool symbol_id_to_index(const uint16_t symbol_id, size_t& out_idx) {
-        if (!jolt::is_valid_symbol_id(symbol_id)) {
-            return false;
+    UdpSever::UdpSever(const std::string& queue_name, const InstrumentRegistry& instruments, size_t num_shards,
+                       const std::string& history_name, uint32_t history_records)
+        : instruments_(instruments), symbol_buffers_(instruments.size()) {
+        if (!history_name.empty()) {
+            std::vector<uint16_t> symbol_ids;
+            for (const auto& inst : instruments_.instruments()) {
+                symbol_ids.push_back(inst.symbol_id);
+            }
+            history_ = std::make_unique<L3History>(history_name, HistoryMode::Create, symbol_ids, history_records);
+        }
+        if (num_shards == 0) {
+            mkt_data_qs_.push_back(std::make_unique<MktDataQ>(queue_name, SharedRingMode::Attach));
+        }
+        for (size_t i = 0; i < num_shards; ++i) {
+            mkt_data_qs_.push_back(std::make_unique<MktDataQ>(jolt::shard_queue_name(queue_name, i),
+                                                              SharedRingMode::Attach));
         }
-        out_idx = static_cast<size_t>(symbol_id - jolt::kFirstSymbolId);
-        return true;
-    }
 
-    UdpSever::UdpSever(const std::string& queue_name) : mkt_data_q_(queue_name, SharedRingMode::Attach) {
         fd_ = ::socket(AF_INET, SOCK_DGRAM, 0);
         if (fd_ < 0) {
             throw std::runtime_error("err creating udp socket");
@@ -67,12 +76,10 @@ namespace jolt::md {
     }
 
 
-    void UdpSever::configure_default_channels(const size_t num_symbols,
-                                              const std::string& multicast_ip,
-                                              const uint16_t base_port) {
+    void UdpSever::configure_default_channels(const std::string& multicast_ip, const uint16_t base_port) {
         channels_.clear();
-        for (size_t i = 0; i < num_symbols; ++i) {
-            add_symbol_channel(static_cast<uint16_t>(jolt::kFirstSymbolId + i),
+        for (size_t i = 0; i < instruments_.size(); ++i) {
+            add_symbol_channel(instruments_.at(i).symbol_id,
                                multicast_ip,
                                static_cast<uint16_t>(base_port + i));
         }
@@ -122,17 +129,25 @@ namespace jolt::md {
 
     void UdpSever::poll_mkt_data() {
         for (;;) {
-            auto msg = mkt_data_q_.dequeue();
-            if (msg) {
+            // each symbol lives on exactly one shard ring, so per-symbol order is preserved
+            for (auto& q : mkt_data_qs_) {
+                auto msg = q->dequeue();
+                if (!msg) {
+                    continue;
+                }
                 const uint16_t symbol_id = msg->symbol_id;
-                size_t symbol_idx = 0;
-                if (!symbol_id_to_index(symbol_id, symbol_idx)) {
+                const size_t symbol_idx = instruments_.index_of(symbol_id);
+                if (symbol_idx == InstrumentRegistry::npos) {
                     continue;
                 }
                 auto& buf = symbol_buffers_[symbol_idx];
                 buf.push_back(*msg);
                 if (buf.size() == BUFFER_SIZE) {
                     send_batch(symbol_id, buf.data(), buf.size());
+                    // kept whether or not the datagram made it out, a subscriber that missed it asks for it
+                    if (history_) {
+                        history_->append(static_cast<uint32_t>(symbol_idx), buf.data(), buf.size());
+                    }
                     buf.clear();
                 }
             }
@@ -8,6 +8,7 @@
 #include <array>
 #include <cstddef>
 #include <cstdint>
+#include <memory>
 #include <string>
 #include <unordered_map>
 #include <vector>
@@ -16,7 +17,9 @@
 #include "MarketDataTypes.h"
 #include "../exchange/orderbook/ob_types.h"
 #include "../include/SharedMemoryRing.h"
+#include "../include/l3_history.h"
 #include "include/Types.h"
+#include "include/InstrumentRegistry.h"
 
 
 namespace jolt::md {
@@ -31,7 +34,8 @@ namespace jolt::md {
             uint8_t version;
         };
 
-        using MktDataQ = SharedSpscQueue<ob::L3Data, 1 << 20>;
+        // must match Exchange::MktDataQueue
+        using MktDataQ = SharedSpscQueue<ob::L3Data, 1 << 15>;
 
 
 
@@ -44,11 +48,20 @@ namespace jolt::md {
         int fd_{-1};
         std::array<char, kMaxDatagram> buf_{};
         std::unordered_map<uint16_t, sockaddr_in> channels_{};
-        std::array<std::vector<ob::L3Data>, jolt::kNumSymbols> symbol_buffers_{};
-        MktDataQ mkt_data_q_;
+        InstrumentRegistry instruments_;
+        // indexed by registry index
+        std::vector<std::vector<ob::L3Data>> symbol_buffers_{};
+        // one book event ring per exchange shard
+        std::vector<std::unique_ptr<MktDataQ>> mkt_data_qs_;
+        // every published batch, ring i is registry index i. the recovery server fills gaps from it
+        std::unique_ptr<L3History> history_;
 
     public:
-        UdpSever(const std::string& queue_name);
+        // num_shards == 0 attaches the unsharded ring, otherwise <queue_name>_<shard> for every shard.
+        // a non empty history_name creates the shared history ring of the last history_records records
+        // published per symbol
+        UdpSever(const std::string& queue_name, const InstrumentRegistry& instruments, size_t num_shards = 0,
+                 const std::string& history_name = "", uint32_t history_records = 1 << 16);
         ~UdpSever();
 
         UdpSever(const UdpSever&) = delete;
@@ -58,7 +71,8 @@ namespace jolt::md {
 
 
         void poll_mkt_data();
-        void configure_default_channels(size_t num_symbols, const std::string& multicast_ip, uint16_t base_port);
+        // one channel per instrument on base_port + registry index
+        void configure_default_channels(const std::string& multicast_ip, uint16_t base_port);
         void add_symbol_channel(uint16_t symbol_id, const std::string& ip, uint16_t port);
         bool send_batch(uint16_t symbol_id, const ob::L3Data* batch, size_t count);
     };
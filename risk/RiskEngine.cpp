@@ -4,8 +4,28 @@
 
 #include "RiskEngine.h"
 
+#include <cstdlib>
+
 namespace jolt::exchange {
 
+RiskEngine::RiskEngine(const InstrumentRegistry& instruments, size_t max_clients, size_t max_open_orders,
+                       const ClientInfo& default_limits)
+    : instruments_(instruments), num_symbols_(instruments.size()), max_clients_(max_clients),
+      default_limits_(default_limits), client_index_(max_clients * 2), order_index_(max_open_orders * 2) {
+    clients_.reserve(max_clients);
+    positions_.assign(max_clients * num_symbols_, 0);
+    exposures_.assign(max_clients * num_symbols_, 0);
+    open_head_.assign(max_clients, kNil);
+    kill_queue_.reserve(max_clients);
+
+    // thread the free list through the order pool
+    orders_.resize(max_open_orders);
+    for (size_t i = 0; i < max_open_orders; ++i) {
+        orders_[i].next = (i + 1 < max_open_orders) ? static_cast<uint32_t>(i + 1) : kNil;
+    }
+    free_head_ = max_open_orders > 0 ? 0 : kNil;
+}
+
 bool RiskEngine::check(const ClientInfo& client, const ob::OrderParams& order, ob::RejectReason& reason) const {
     if (order.qty == 0) {
         reason = ob::RejectReason::InvalidQty;
@@ -15,22 +35,197 @@ bool RiskEngine::check(const ClientInfo& client, const ob::OrderParams& order, o
         reason = ob::RejectReason::InvalidQty;
         return false;
     }
+    if (client.killed) {
+        reason = ob::RejectReason::NotFillable;
+        return false;
+    }
     reason = ob::RejectReason::NotApplicable;
     return true;
 }
 
-void RiskEngine::on_accept(ClientInfo& client, const ob::OrderParams& order) {
-    (void)order;
-    if (client.open_orders < client.max_open_orders) {
-        ++client.open_orders;
+void RiskEngine::load_clients(const std::vector<ClientInfo>& clients) {
+    for (const auto& c : clients) {
+        const uint32_t slot = slot_of(c.client_id);
+        if (slot == kNil) {
+            return;
+        }
+        ClientInfo& info = clients_[slot];
+        info.max_qty = c.max_qty;
+        info.max_open_orders = c.max_open_orders;
+        info.max_pos = c.max_pos;
+        info.max_notional = c.max_notional;
+        info.capital = c.capital;
+    }
+}
+
+void RiskEngine::on_event(const ExchangeToRiskMsg& msg) {
+    const size_t symbol_idx = instruments_.index_of(msg.symbol_id);
+    if (symbol_idx == InstrumentRegistry::npos) {
+        ++dropped_;
+        return;
+    }
+
+    switch (msg.type) {
+    case ExchangeToRiskMsg::Type::Fill: {
+        const uint32_t maker = slot_of(msg.maker_client_id);
+        const uint32_t taker = slot_of(msg.taker_client_id);
+        if (maker == kNil || taker == kNil) {
+            ++dropped_;
+            break;
+        }
+        const int64_t qty = static_cast<int64_t>(msg.qty);
+        const int64_t taker_qty = msg.side == Side::Buy ? qty : -qty;
+        if (batch_taker_ != kNil && batch_taker_ != taker) {
+            check_limits(batch_taker_);
+        }
+        batch_taker_ = taker;
+        apply_fill(taker, symbol_idx, taker_qty, msg.price);
+        apply_fill(maker, symbol_idx, -taker_qty, msg.price);
+        if (msg.maker_done()) {
+            remove_open(msg.maker_order_id);
+        }
+        // makers differ per fill, a taker keeps taking until the batch ends or an order it triggered
+        // starts taking for another client
+        check_limits(maker);
+        break;
+    }
+    case ExchangeToRiskMsg::Type::Accept: {
+        const uint32_t slot = slot_of(msg.maker_client_id);
+        if (slot == kNil) {
+            ++dropped_;
+            break;
+        }
+        add_open(slot, msg.maker_order_id, msg.symbol_id);
+        break;
+    }
+    case ExchangeToRiskMsg::Type::Cancel:
+        remove_open(msg.maker_order_id);
+        break;
+    }
+    // rests and fired stops travel in the same batch as the fills around them
+    if (msg.last_in_batch() && batch_taker_ != kNil) {
+        check_limits(batch_taker_);
+        batch_taker_ = kNil;
+    }
+}
+
+const ClientInfo* RiskEngine::client(uint64_t client_id) const {
+    const uint32_t* slot = client_index_.find(client_id);
+    return slot ? &clients_[*slot] : nullptr;
+}
+
+int64_t RiskEngine::position(uint64_t client_id, uint16_t symbol_id) const {
+    const uint32_t* slot = client_index_.find(client_id);
+    const size_t symbol_idx = instruments_.index_of(symbol_id);
+    if (!slot || symbol_idx == InstrumentRegistry::npos) {
+        return 0;
+    }
+    return positions_[*slot * num_symbols_ + symbol_idx];
+}
+
+uint32_t RiskEngine::slot_of(uint64_t client_id) {
+    if (const uint32_t* slot = client_index_.find(client_id)) {
+        return *slot;
+    }
+    if (clients_.size() >= max_clients_) {
+        return kNil;
+    }
+    const auto slot = static_cast<uint32_t>(clients_.size());
+    ClientInfo info = default_limits_;
+    info.client_id = client_id;
+    info.open_orders = 0;
+    info.net_pos = 0;
+    info.notional = 0;
+    info.killed = false;
+    clients_.push_back(info);
+    client_index_.insert(client_id, slot);
+    return slot;
+}
+
+void RiskEngine::apply_fill(uint32_t slot, size_t symbol_idx, int64_t qty, ob::PriceTick px) {
+    ClientInfo& info = clients_[slot];
+    const size_t i = slot * num_symbols_ + symbol_idx;
+    positions_[i] += qty;
+    info.net_pos += qty;
+    // exposure of a symbol is marked at the client's last fill price on it
+    const int64_t exposure = std::llabs(positions_[i]) * static_cast<int64_t>(px);
+    info.notional += exposure - exposures_[i];
+    exposures_[i] = exposure;
+}
+
+void RiskEngine::check_limits(uint32_t slot) {
+    ClientInfo& info = clients_[slot];
+    if (info.killed) {
+        return;
+    }
+    bool breach = info.max_notional > 0 && info.notional > info.max_notional;
+    if (!breach && info.max_pos > 0) {
+        const int64_t* pos = &positions_[slot * num_symbols_];
+        for (size_t s = 0; s < num_symbols_; ++s) {
+            if (std::llabs(pos[s]) > info.max_pos) {
+                breach = true;
+                break;
+            }
+        }
+    }
+    if (!breach) {
+        return;
+    }
+    info.killed = true;
+    kill_queue_.push_back(slot);
+}
+
+void RiskEngine::add_open(uint32_t slot, uint64_t order_id, uint16_t symbol_id) {
+    if (free_head_ == kNil || order_index_.find(order_id)) {
+        ++dropped_;
+        return;
+    }
+    const uint32_t n = free_head_;
+    OpenOrder& o = orders_[n];
+    free_head_ = o.next;
+
+    o.order_id = order_id;
+    o.client = slot;
+    o.symbol_id = symbol_id;
+    o.prev = kNil;
+    o.next = open_head_[slot];
+    if (o.next != kNil) {
+        orders_[o.next].prev = n;
     }
+    open_head_[slot] = n;
+    order_index_.insert(order_id, n);
+
+    ++clients_[slot].open_orders;
 }
 
-void RiskEngine::on_book_event(ClientInfo& client, const ob::BookEvent& event) {
-    (void)event;
-    if (client.open_orders > 0) {
-        --client.open_orders;
+void RiskEngine::remove_open(uint64_t order_id) {
+    const uint32_t* found = order_index_.find(order_id);
+    if (!found) {
+        return;
+    }
+    const uint32_t n = *found;
+    order_index_.erase(order_id);
+
+    OpenOrder& o = orders_[n];
+    if (o.prev != kNil) {
+        orders_[o.prev].next = o.next;
     }
+    else {
+        open_head_[o.client] = o.next;
+    }
+    if (o.next != kNil) {
+        orders_[o.next].prev = o.prev;
+    }
+
+    ClientInfo& info = clients_[o.client];
+    if (info.open_orders > 0) {
+        --info.open_orders;
+    }
+
+    o.client = kNil;
+    o.prev = kNil;
+    o.next = free_head_;
+    free_head_ = n;
 }
 
 } // namespace jolt::exchange
@@ -2,17 +2,99 @@
 // Created by djaiswal on 1/16/26.
 //
 #pragma once
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <vector>
+
 #include "../include/Types.h"
+#include "../include/InstrumentRegistry.h"
+#include "../exchange/orderbook/flat_map.h"
 
 namespace jolt::exchange {
 
+// post-trade risk state built from the exchange -> risk record stream. per client net position and
+// notional, per (client, symbol) positions and the list of resting orders (limits, stops and
+// take-profits) all live in arrays sized at construction, so applying a record never allocates while
+// the client and open order counts stay within capacity. a client that crosses max_pos or max_notional
+// is killed: kill_pending hands it out once, for one owner wide mass cancel that also makes the
+// exchange refuse its new orders
 class RiskEngine {
 public:
+    static constexpr uint32_t kNil = std::numeric_limits<uint32_t>::max();
+
+    RiskEngine(const InstrumentRegistry& instruments, size_t max_clients, size_t max_open_orders,
+               const ClientInfo& default_limits);
+
     bool check(const ClientInfo& client, const ob::OrderParams& order, ob::RejectReason& reason) const;
-    void on_accept(ClientInfo& client, const ob::OrderParams& order);
-    void on_book_event(ClientInfo& client, const ob::BookEvent& event);
+
+    void load_clients(const std::vector<ClientInfo>& clients);
+
+    void on_event(const ExchangeToRiskMsg& msg);
+
+    // calls send(client_id) once for every client killed since the last call. stops early when send
+    // returns false (ring full) and resumes on the next call
+    template <typename SendFn>
+    size_t kill_pending(SendFn&& send);
+
+    const ClientInfo* client(uint64_t client_id) const;
+    int64_t position(uint64_t client_id, uint16_t symbol_id) const;
+
+    size_t open_orders() const { return order_index_.size(); }
+    // records that could not be tracked because a capacity was exhausted
+    uint64_t dropped() const { return dropped_; }
+
+private:
+    struct OpenOrder {
+        uint64_t order_id{0};
+        uint32_t client{kNil};
+        uint32_t prev{kNil};
+        uint32_t next{kNil};
+        uint16_t symbol_id{0};
+    };
+
+    uint32_t slot_of(uint64_t client_id);
+    void apply_fill(uint32_t slot, size_t symbol_idx, int64_t qty, ob::PriceTick px);
+    void check_limits(uint32_t slot);
+    void add_open(uint32_t slot, uint64_t order_id, uint16_t symbol_id);
+    void remove_open(uint64_t order_id);
+
+    InstrumentRegistry instruments_;
+    size_t num_symbols_{0};
+    size_t max_clients_{0};
+    ClientInfo default_limits_{};
+
+    std::vector<ClientInfo> clients_;
+    ob::FlatMap<uint64_t, uint32_t> client_index_;
+    // [slot * num_symbols_ + symbol_idx]
+    std::vector<int64_t> positions_;
+    std::vector<int64_t> exposures_;
+    // head of each client's open order list
+    std::vector<uint32_t> open_head_;
+
+    std::vector<OpenOrder> orders_;
+    ob::FlatMap<uint64_t, uint32_t> order_index_;
+    uint32_t free_head_{kNil};
+
+    // killed clients whose mass cancel has not been sent yet
+    std::vector<uint32_t> kill_queue_;
+    // taker of the fills applied since the last end of a batch, its limits are checked when that ends or
+    // a triggered order of another client takes over
+    uint32_t batch_taker_{kNil};
+    uint64_t dropped_{0};
 };
 
+template <typename SendFn>
+size_t RiskEngine::kill_pending(SendFn&& send) {
+    size_t sent = 0;
+    while (!kill_queue_.empty()) {
+        if (!send(clients_[kill_queue_.back()].client_id)) {
+            return sent;
+        }
+        kill_queue_.pop_back();
+        ++sent;
+    }
+    return sent;
 }
 
-
+}
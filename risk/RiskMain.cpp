@@ -0,0 +1,164 @@
+//
+// Created by djaiswal on 1/16/26.
+//
+
+#include "RiskEngine.h"
+#include "RiskTypes.h"
+#include "../include/thread_affinity.h"
+
+#include <atomic>
+#include <charconv>
+#include <csignal>
+#include <cstdint>
+#include <iostream>
+#include <limits>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <xmmintrin.h>
+
+namespace {
+    std::atomic<bool> g_run{true};
+
+    void on_signal(int) {
+        g_run.store(false, std::memory_order_release);
+    }
+
+    bool parse_i64(std::string_view s, int64_t& out) {
+        auto [ptr, ec] = std::from_chars(s.data(), s.data() + s.size(), out);
+        return ec == std::errc{} && ptr == s.data() + s.size();
+    }
+
+    uint64_t fnv1a_64(std::string_view s) {
+        constexpr uint64_t kOffset = 14695981039346656037ull;
+        constexpr uint64_t kPrime = 1099511628211ull;
+        uint64_t hash = kOffset;
+        for (unsigned char c : s) {
+            hash ^= c;
+            hash *= kPrime;
+        }
+        return hash;
+    }
+
+    // same account -> client id mapping the gateway uses
+    uint64_t to_client_id(const std::string& account) {
+        uint64_t numeric = 0;
+        auto [ptr, ec] = std::from_chars(account.data(), account.data() + account.size(), numeric);
+        if (!account.empty() && ec == std::errc{} && ptr == account.data() + account.size()) {
+            return numeric;
+        }
+        return fnv1a_64(account);
+    }
+}
+
+// usage: risk [--instruments FILE] [--shards N] [--cpu C] [--max-pos Q] [--max-notional N]
+// --instruments and --shards must match what the exchange was started with. the exchange must be
+// running first, it creates the rings
+int main(int argc, char** argv) {
+    int64_t num_shards = 0;
+    int64_t cpu = -1;
+    int64_t max_pos = std::numeric_limits<int64_t>::max() / 4;
+    int64_t max_notional = std::numeric_limits<int64_t>::max() / 4;
+    std::string instruments_path;
+    for (int i = 1; i + 1 < argc; i += 2) {
+        const std::string_view arg(argv[i]);
+        bool ok = (arg == "--shards" && parse_i64(argv[i + 1], num_shards)) ||
+                  (arg == "--cpu" && parse_i64(argv[i + 1], cpu)) ||
+                  (arg == "--max-pos" && parse_i64(argv[i + 1], max_pos)) ||
+                  (arg == "--max-notional" && parse_i64(argv[i + 1], max_notional));
+        if (arg == "--instruments") {
+            instruments_path = argv[i + 1];
+            ok = true;
+        }
+        if (!ok) {
+            std::cerr << "usage: " << argv[0]
+                      << " [--instruments FILE] [--shards N] [--cpu C] [--max-pos Q] [--max-notional N]\n";
+            return 1;
+        }
+    }
+
+    if (cpu >= 0) {
+        (void)jolt::threading::pin_current_thread_to_cpu(static_cast<int>(cpu), "risk-main");
+    }
+
+    std::signal(SIGINT, on_signal);
+    std::signal(SIGTERM, on_signal);
+
+    constexpr jolt::ob::PriceTick kMinTick = 20'000;
+    constexpr jolt::ob::PriceTick kMaxTick = 100'000;
+    const jolt::InstrumentRegistry instruments = instruments_path.empty()
+        ? jolt::InstrumentRegistry::make_default(kMinTick, kMaxTick, static_cast<size_t>(num_shards))
+        : jolt::InstrumentRegistry::load(instruments_path);
+
+    // one ring pair per shard, or the single unsharded pair
+    std::vector<std::unique_ptr<jolt::exchange::ExchToRisk>> from_exch;
+    std::vector<std::unique_ptr<jolt::exchange::RiskToExch>> to_exch;
+    if (num_shards > 0) {
+        for (size_t i = 0; i < static_cast<size_t>(num_shards); ++i) {
+            from_exch.push_back(std::make_unique<jolt::exchange::ExchToRisk>(
+                jolt::shard_queue_name("exch_to_risk_q", i), SharedRingMode::Attach));
+            to_exch.push_back(std::make_unique<jolt::exchange::RiskToExch>(
+                jolt::shard_queue_name("risk_to_exch_q", i), SharedRingMode::Attach));
+        }
+    }
+    else {
+        from_exch.push_back(std::make_unique<jolt::exchange::ExchToRisk>("exch_to_risk_q", SharedRingMode::Attach));
+        to_exch.push_back(std::make_unique<jolt::exchange::RiskToExch>("risk_to_exch_q", SharedRingMode::Attach));
+    }
+
+    jolt::ClientInfo limits{};
+    limits.max_qty = 1'000'000;
+    limits.max_open_orders = 1'000'000;
+    limits.max_pos = max_pos;
+    limits.max_notional = max_notional;
+    limits.capital = 1e9f;
+
+    constexpr size_t kMaxClients = 1 << 12;
+    constexpr size_t kMaxOpenOrders = 1 << 22;
+    jolt::exchange::RiskEngine engine(instruments, kMaxClients, kMaxOpenOrders, limits);
+
+    std::vector<jolt::ClientInfo> clients;
+    clients.reserve(1024);
+    for (size_t i = 1; i <= 1024; ++i) {
+        jolt::ClientInfo info = limits;
+        info.client_id = to_client_id("CLIENT_" + std::to_string(i));
+        clients.push_back(info);
+    }
+    engine.load_clients(clients);
+
+    // a kill is one owner wide mass cancel on every ring, sent only once each ring has room for it
+    auto send_kill = [&](uint64_t client_id) {
+        for (auto& ring : to_exch) {
+            if (!ring->alloc()) {
+                return false;
+            }
+        }
+        for (auto& ring : to_exch) {
+            auto* msg = ring->alloc();
+            msg->order = jolt::ob::OrderParams{};
+            msg->order.client_id = client_id;
+            msg->order.action = jolt::ob::OrderAction::MassCancel;
+            msg->order.kill = true;
+            msg->ts = 0;
+            ring->push();
+        }
+        return true;
+    };
+
+    // bounded drain per ring so one busy shard cannot starve the others or the kill switch
+    constexpr size_t kBurst = 4096;
+    while (g_run.load(std::memory_order_acquire)) {
+        size_t work = 0;
+        for (auto& ring : from_exch) {
+            work += ring->drain([&](const jolt::ExchangeToRiskMsg& msg) {
+                engine.on_event(msg);
+            }, kBurst);
+        }
+        work += engine.kill_pending(send_kill);
+        if (work == 0) {
+            _mm_pause();
+        }
+    }
+    return 0;
+}
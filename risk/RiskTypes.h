@@ -0,0 +1,15 @@
+//
+// Created by djaiswal on 1/16/26.
+//
+#pragma once
+#include <cstdint>
+#include "../include/Types.h"
+#include "../include/SharedMemoryRing.h"
+
+namespace jolt::exchange {
+
+    // must match the exchange side of the rings
+    using ExchToRisk = SharedSpscQueue<ExchangeToRiskMsg, 1 << 16>;
+    using RiskToExch = SharedSpscQueue<RiskToExchMsg, 1 << 15>;
+
+}
@@ -0,0 +1,216 @@
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "test_harness.h"
+#include "../entry_gateway/FixSession.h"
+
+using namespace jolt;
+using namespace jolt::gateway;
+
+namespace {
+    template <typename Msg>
+    std::string bytes_of(const Msg& msg) {
+        return std::string(reinterpret_cast<const char*>(&msg), sizeof(Msg));
+    }
+
+    std::string login(const char* session) {
+        boe::Login m{boe::header_of(boe::MsgType::Login), {}, 7};
+        std::strncpy(m.session, session, boe::kSessionNameLen);
+        return bytes_of(m);
+    }
+
+    std::string new_order(uint64_t cl_ord_id) {
+        return bytes_of(boe::NewOrder{boe::header_of(boe::MsgType::NewOrder), cl_ord_id, 5, 100, 0, 0,
+                                      kFirstSymbolId, ob::Side::Buy, ob::OrderType::Limit, ob::TIF::GTC});
+    }
+
+    std::string cancel(uint64_t cl_ord_id, uint64_t order_id) {
+        return bytes_of(boe::Cancel{boe::header_of(boe::MsgType::Cancel), cl_ord_id, order_id});
+    }
+
+    std::string replace(uint64_t cl_ord_id, uint64_t order_id) {
+        return bytes_of(boe::Replace{boe::header_of(boe::MsgType::Replace), cl_ord_id, order_id, 3, 101, 0, 0});
+    }
+
+    // body is the fields after BodyLength, the header and trailer are added around it
+    std::string fix_msg(const std::string& body) {
+        std::string msg = "8=FIX.4.4\x01" "9=" + std::to_string(body.size()) + "\x01" + body;
+        uint32_t sum = 0;
+        for (const char ch : msg) {
+            sum += static_cast<unsigned char>(ch);
+        }
+        char trailer[8];
+        std::snprintf(trailer, sizeof(trailer), "10=%03u\x01", sum % 256);
+        return msg + trailer;
+    }
+
+    // a session on its own segment pool, fed the way EventLoop::feed_session feeds it from provided
+    // buffers. dispatch would hand the framed messages to the gateway, here they are copied out
+    struct Feed {
+        RxSegmentPool pool;
+        FixSession session{"", "", -1};
+        std::vector<std::string> framed;
+
+        explicit Feed(bool binary) {
+            session.rx_pool_ = &pool;
+            session.binary_ = binary;
+        }
+
+        void drain() {
+            if (session.rx_seg_ == RxSegmentPool::kNone) {
+                return;
+            }
+            for (;;) {
+                const size_t before = session.rx_off_;
+                size_t off = 0;
+                size_t len = 0;
+                if (!session.extract_message(off, len)) {
+                    if (session.rx_off_ != before && session.rx_off_ < session.rx_len_) {
+                        continue;
+                    }
+                    break;
+                }
+                framed.emplace_back(pool.data(session.rx_seg_) + off, len);
+            }
+            session.release_rx();
+        }
+
+        // one receive of bytes into a buffer of its own
+        void recv(std::string_view bytes) {
+            uint32_t seg = 0;
+            EXPECT_TRUE(pool.acquire(seg));
+            std::memcpy(pool.data(seg), bytes.data(), bytes.size());
+            size_t off = 0;
+            while (off < bytes.size() && !session.protocol_error_) {
+                const size_t took = session.take_rx(seg, off, bytes.size() - off);
+                EXPECT_TRUE(took > 0);
+                if (took == 0) {
+                    break;
+                }
+                off += took;
+                drain();
+            }
+            pool.drop(seg);
+        }
+
+        // the stream cut into receives of chunk bytes
+        void recv_chunked(std::string_view stream, size_t chunk) {
+            for (size_t at = 0; at < stream.size(); at += chunk) {
+                recv(stream.substr(at, chunk));
+            }
+        }
+    };
+} // namespace
+
+// a message arriving a byte at a time is framed once, on its last byte
+TEST(Boe_Partial_Frames) {
+    const std::string msg = new_order(1);
+    Feed feed(true);
+    for (size_t i = 0; i + 1 < msg.size(); ++i) {
+        feed.recv(std::string_view(msg).substr(i, 1));
+        EXPECT_TRUE(feed.framed.empty());
+    }
+    feed.recv(std::string_view(msg).substr(msg.size() - 1));
+    EXPECT_EQ(feed.framed.size(), 1u);
+    EXPECT_TRUE(feed.framed.size() == 1 && feed.framed[0] == msg);
+    EXPECT_TRUE(!feed.session.protocol_error_);
+}
+
+// several messages in one receive, and a stream cut at every chunk size, come out whole and in order
+TEST(Boe_Coalesced_Frames) {
+    const std::vector<std::string> msgs = {login("TRADER1"), new_order(1), cancel(2, 1001), replace(3, 1002),
+                                           new_order(4)};
+    std::string stream;
+    for (const std::string& m : msgs) {
+        stream += m;
+    }
+    for (size_t chunk = 1; chunk <= stream.size(); ++chunk) {
+        Feed feed(true);
+        feed.recv_chunked(stream, chunk);
+        EXPECT_TRUE(feed.framed == msgs);
+        EXPECT_TRUE(!feed.session.protocol_error_);
+    }
+}
+
+// more than a segment of back to back orders, whose receives end inside messages, moves the unframed
+// tail along to the next segment
+TEST(Boe_Frames_Across_Segments) {
+    std::vector<std::string> msgs;
+    std::string stream;
+    for (uint64_t i = 1; stream.size() < 3 * RxSegmentPool::kSegmentBytes; ++i) {
+        msgs.push_back(i % 3 ? new_order(i) : cancel(i, 1000 + i));
+        stream += msgs.back();
+    }
+    Feed feed(true);
+    feed.recv_chunked(stream, 1000);
+    EXPECT_TRUE(feed.framed == msgs);
+}
+
+// a length that does not match the type cannot be resynced past, the session is failed after the
+// messages before it
+TEST(Boe_Bad_Length) {
+    std::string bad = new_order(2);
+    const auto wrong = static_cast<uint16_t>(bad.size() + 4);
+    std::memcpy(bad.data(), &wrong, sizeof(wrong));
+    Feed feed(true);
+    feed.recv(new_order(1) + bad + new_order(3));
+    EXPECT_EQ(feed.framed.size(), 1u);
+    EXPECT_TRUE(feed.session.protocol_error_);
+
+    // a short length, split so the header arrives on its own
+    std::string short_len = cancel(4, 5);
+    const uint16_t two = 2;
+    std::memcpy(short_len.data(), &two, sizeof(two));
+    Feed split(true);
+    split.recv(std::string_view(short_len).substr(0, 3));
+    EXPECT_TRUE(!split.session.protocol_error_);
+    split.recv(std::string_view(short_len).substr(3));
+    EXPECT_TRUE(split.framed.empty());
+    EXPECT_TRUE(split.session.protocol_error_);
+}
+
+// a type or version the framer does not know fails the session the same way
+TEST(Boe_Unknown_Message_Type) {
+    std::string unknown = new_order(2);
+    unknown[offsetof(boe::Header, type)] = 'Z';
+    Feed feed(true);
+    feed.recv(new_order(1) + unknown);
+    EXPECT_EQ(feed.framed.size(), 1u);
+    EXPECT_TRUE(feed.session.protocol_error_);
+
+    std::string version = new_order(2);
+    version[offsetof(boe::Header, version)] = static_cast<char>(boe::kVersion + 1);
+    Feed other(true);
+    other.recv(version);
+    EXPECT_TRUE(other.framed.empty());
+    EXPECT_TRUE(other.session.protocol_error_);
+}
+
+// the FIX framer on the same feed: split and coalesced messages, garbage in front of one is skipped
+TEST(Fix_Partial_And_Coalesced_Frames) {
+    const std::vector<std::string> msgs = {fix_msg("35=A\x01" "49=TRADER1\x01" "56=JOLT\x01"),
+                                           fix_msg("35=D\x01" "11=1\x01" "55=1\x01" "54=1\x01" "38=5\x01" "44=100\x01"),
+                                           fix_msg("35=F\x01" "11=2\x01" "41=1\x01")};
+    std::string stream;
+    for (const std::string& m : msgs) {
+        stream += m;
+    }
+    for (const size_t chunk : {size_t{1}, size_t{7}, size_t{64}, stream.size()}) {
+        Feed feed(false);
+        feed.recv_chunked(stream, chunk);
+        EXPECT_TRUE(feed.framed == msgs);
+    }
+    Feed feed(false);
+    feed.recv("xx9=junk" + stream);
+    EXPECT_TRUE(feed.framed == msgs);
+    EXPECT_TRUE(!feed.session.protocol_error_);
+}
+
+int main() {
+    return ::mini_test::run_all();
+}
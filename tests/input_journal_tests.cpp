@@ -0,0 +1,260 @@
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <string>
+#include <thread>
+#include <vector>
+#include <unistd.h>
+
+#include "test_harness.h"
+#include "../include/input_journal.h"
+#include "../exchange/orderbook/matching_orderbook.h"
+
+using namespace jolt;
+
+namespace {
+    constexpr ob::PriceTick kMinTick = 50;
+    constexpr ob::PriceTick kMaxTick = 200;
+
+    // a directory of its own per test, removed with it
+    struct TempDir {
+        std::filesystem::path dir;
+
+        explicit TempDir(const char* what)
+            : dir(std::filesystem::temp_directory_path() /
+                  ("jolt_journal_test_" + std::to_string(::getpid()) + "_" + what)) {
+            std::filesystem::remove_all(dir);
+        }
+
+        ~TempDir() { std::filesystem::remove_all(dir); }
+
+        std::string file(const char* name) const { return (dir / name).string(); }
+    };
+
+    ob::OrderParams limit(ob::OrderId id, ob::Side side, ob::PriceTick px, ob::Qty qty) {
+        ob::OrderParams p{};
+        p.action = ob::OrderAction::New;
+        p.type = ob::OrderType::Limit;
+        p.id = id;
+        p.client_id = 1 + id % 3;
+        p.side = side;
+        p.price = px;
+        p.qty = qty;
+        return p;
+    }
+
+    // every valid record of the journal, as replay hands them out
+    std::vector<JournalRecord> read_all(const std::string& path, uint64_t after_lsn = 0) {
+        std::vector<JournalRecord> out;
+        JournalReader reader(path);
+        reader.replay(after_lsn, [&](const JournalRecord& r) { out.push_back(r); });
+        return out;
+    }
+
+    bool lsns_from(const std::vector<JournalRecord>& records, uint64_t first) {
+        for (size_t i = 0; i < records.size(); ++i) {
+            if (records[i].lsn != first + i) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    bool same_book(const ob::BookSnapshot& a, const ob::BookSnapshot& b) {
+        if (a.orders.size() != b.orders.size() || a.bid_ct != b.bid_ct || a.ask_ct != b.ask_ct || a.seq != b.seq) {
+            return false;
+        }
+        for (size_t i = 0; i < a.orders.size(); ++i) {
+            if (a.orders[i].id != b.orders[i].id || a.orders[i].qty != b.orders[i].qty ||
+                a.orders[i].px != b.orders[i].px || a.orders[i].side != b.orders[i].side) {
+                return false;
+            }
+        }
+        return true;
+    }
+} // namespace
+
+TEST(Journal_Reopen_Cuts_Torn_Tail) {
+    TempDir tmp("torn");
+    const std::string path = tmp.file("exchange.wal");
+    constexpr uint64_t n = 100;
+    {
+        InputJournal journal(path);
+        for (uint64_t i = 1; i <= n; ++i) {
+            journal.append(limit(i, ob::Side::Buy, 100, 1));
+        }
+        journal.sync_all();
+        EXPECT_EQ(journal.durable_lsn(), n);
+    }
+    EXPECT_EQ(std::filesystem::file_size(path), n * sizeof(JournalRecord));
+
+    // a crash in the middle of the last record's write
+    std::filesystem::resize_file(path, (n - 1) * sizeof(JournalRecord) + sizeof(JournalRecord) / 2);
+    EXPECT_EQ(read_all(path).size(), n - 1);
+
+    {
+        InputJournal journal(path);
+        EXPECT_EQ(journal.next_lsn(), n);
+        EXPECT_EQ(journal.durable_lsn(), n - 1);
+        EXPECT_EQ(std::filesystem::file_size(path), (n - 1) * sizeof(JournalRecord));
+        journal.append(limit(1000, ob::Side::Sell, 120, 2));
+        journal.sync_all();
+    }
+    const std::vector<JournalRecord> records = read_all(path);
+    EXPECT_EQ(records.size(), n);
+    EXPECT_TRUE(lsns_from(records, 1));
+    EXPECT_EQ(records.back().order.id, 1000u);
+}
+
+TEST(Journal_Reader_Stops_At_Bad_Checksum) {
+    TempDir tmp("checksum");
+    const std::string path = tmp.file("exchange.wal");
+    {
+        InputJournal journal(path);
+        for (uint64_t i = 1; i <= 10; ++i) {
+            journal.append(limit(i, ob::Side::Buy, 100, 1));
+        }
+    }
+    // one flipped byte in the seventh record's order
+    {
+        const int fd = ::open(path.c_str(), O_RDWR);
+        const off_t at = static_cast<off_t>(6 * sizeof(JournalRecord) + offsetof(JournalRecord, order));
+        char byte = 0;
+        EXPECT_EQ(::pread(fd, &byte, 1, at), 1);
+        byte = static_cast<char>(byte ^ 0x5a);
+        EXPECT_EQ(::pwrite(fd, &byte, 1, at), 1);
+        ::close(fd);
+    }
+    EXPECT_EQ(read_all(path).size(), 6u);
+
+    // reopening keeps the valid prefix and writes over the rest
+    InputJournal journal(path);
+    EXPECT_EQ(journal.next_lsn(), 7u);
+}
+
+TEST(Journal_Next_Lsn_Continues_Across_Opens) {
+    TempDir tmp("lsn");
+    const std::string path = tmp.file("exchange.wal");
+    {
+        InputJournal journal(path);
+        EXPECT_EQ(journal.next_lsn(), 1u);
+        for (uint64_t i = 1; i <= 10; ++i) {
+            journal.append(limit(i, ob::Side::Buy, 100, 1));
+        }
+        journal.append_day(3);
+    }
+    {
+        InputJournal journal(path);
+        EXPECT_EQ(journal.next_lsn(), 12u);
+        for (uint64_t i = 11; i <= 15; ++i) {
+            journal.append(limit(i, ob::Side::Sell, 150, 1));
+        }
+    }
+    const std::vector<JournalRecord> records = read_all(path);
+    EXPECT_EQ(records.size(), 16u);
+    EXPECT_TRUE(lsns_from(records, 1));
+    EXPECT_TRUE(records[10].kind == JournalRecord::Kind::DayRoll);
+    EXPECT_EQ(records[10].day, 3u);
+
+    // what a checkpoint at lsn 11 leaves to replay
+    const std::vector<JournalRecord> tail = read_all(path, 11);
+    EXPECT_EQ(tail.size(), 5u);
+    EXPECT_TRUE(lsns_from(tail, 12));
+    EXPECT_EQ(tail.front().order.id, 11u);
+}
+
+TEST(Journal_Durable_Prefix_Follows_Group_Commit) {
+    TempDir tmp("group");
+    const std::string path = tmp.file("exchange.wal");
+    JournalOptions opts{};
+    opts.window = std::chrono::hours(1);
+    opts.batch_records = 4;
+    InputJournal journal(path, opts);
+
+    // two full batches are committed as they fill, the open one waits for its window
+    for (uint64_t i = 1; i <= 10; ++i) {
+        journal.append(limit(i, ob::Side::Buy, 100, 1));
+    }
+    const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+    while (journal.durable_lsn() < 8 && std::chrono::steady_clock::now() < deadline) {
+        journal.tick();
+        std::this_thread::sleep_for(std::chrono::microseconds(100));
+    }
+    EXPECT_EQ(journal.durable_lsn(), 8u);
+    EXPECT_EQ(read_all(path).size(), 8u);
+
+    journal.sync_all();
+    EXPECT_EQ(journal.durable_lsn(), 10u);
+    EXPECT_EQ(read_all(path).size(), 10u);
+}
+
+// the book a journal replays into is the one the orders built live, including what the book rejected
+TEST(Journal_Replay_Rebuilds_Live_Book) {
+    TempDir tmp("replay");
+    const std::string path = tmp.file("exchange.wal");
+    ob::MatchingOrderBook<> live(kMinTick, kMaxTick);
+    {
+        InputJournal journal(path);
+        uint64_t x = 0x9E3779B97F4A7C15ull;
+        const auto next = [&] {
+            x ^= x << 13;
+            x ^= x >> 7;
+            x ^= x << 17;
+            return x;
+        };
+        for (ob::OrderId id = 1; id <= 5000; ++id) {
+            ob::OrderParams p{};
+            const uint64_t r = next();
+            const ob::OrderId target = 1 + r % id;
+            switch (r % 10) {
+            case 0:
+                p.action = ob::OrderAction::Cancel;
+                p.id = target;
+                break;
+            case 1:
+                p.action = ob::OrderAction::Modify;
+                p.id = target;
+                p.price = static_cast<ob::PriceTick>(90 + (r >> 8) % 30);
+                p.qty = static_cast<ob::Qty>(1 + (r >> 16) % 20);
+                break;
+            case 2:
+                p = limit(id, ob::Side::Buy, 0, static_cast<ob::Qty>(1 + (r >> 8) % 30));
+                p.type = ob::OrderType::Market;
+                p.tif = ob::TIF::IOC;
+                break;
+            case 3:
+                // an id that is already live, rejected by the book and by its replay alike
+                p = limit(target, ob::Side::Sell, 130, 1);
+                break;
+            default:
+                {
+                    const bool buy = (r >> 4) & 1;
+                    p = limit(id, buy ? ob::Side::Buy : ob::Side::Sell,
+                              static_cast<ob::PriceTick>(buy ? 85 + (r >> 8) % 20 : 100 + (r >> 8) % 20),
+                              static_cast<ob::Qty>(1 + (r >> 16) % 20));
+                }
+                break;
+            }
+            p.ts = id;
+            journal.append(p);
+            live.submit_order(p);
+        }
+    }
+
+    ob::MatchingOrderBook<> replayed(kMinTick, kMaxTick);
+    const std::vector<JournalRecord> records = read_all(path);
+    EXPECT_EQ(records.size(), 5000u);
+    for (const JournalRecord& r : records) {
+        replayed.submit_order(r.order);
+    }
+    ob::BookSnapshot a{};
+    ob::BookSnapshot b{};
+    live.get_snapshot(a);
+    replayed.get_snapshot(b);
+    EXPECT_TRUE(a.orders.size() > 100);
+    EXPECT_TRUE(same_book(a, b));
+}
+
+int main() {
+    return ::mini_test::run_all();
+}
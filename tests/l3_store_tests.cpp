@@ -0,0 +1,267 @@
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <string>
+#include <thread>
+#include <vector>
+#include <unistd.h>
+
+#include "test_harness.h"
+#include "../include/mkt_data_writer.h"
+#include "../include/l3_history.h"
+
+using namespace jolt;
+
+namespace {
+    constexpr ob::PriceTick kMinTick = 50;
+    constexpr ob::PriceTick kMaxTick = 200;
+    constexpr size_t kBlock = L3DataWriter::kBatchRecords;
+
+    // a directory of its own per test, removed with it
+    struct TempDir {
+        std::filesystem::path dir;
+
+        explicit TempDir(const char* what)
+            : dir(std::filesystem::temp_directory_path() /
+                  ("jolt_l3_test_" + std::to_string(::getpid()) + "_" + what)) {
+            std::filesystem::remove_all(dir);
+        }
+
+        ~TempDir() { std::filesystem::remove_all(dir); }
+    };
+
+    // the i-th record of a symbol's stream, seqs repeat per group of records like the events of one order
+    ob::L3Data record(uint16_t symbol_id, uint64_t i, uint64_t per_seq) {
+        ob::L3Data d{};
+        d.id = 1000 + i;
+        d.ts = 5'000'000 + i * 3;
+        d.seq = 1 + i / per_seq;
+        d.qty = static_cast<ob::Qty>(1 + i % 17);
+        d.price = static_cast<ob::PriceTick>(kMinTick + i % 100);
+        d.symbol_id = symbol_id;
+        d.side = i % 2 ? ob::Side::Sell : ob::Side::Buy;
+        d.event_type = i % per_seq ? ob::BookEventType::Fill : ob::BookEventType::New;
+        return d;
+    }
+
+    bool same_record(const ob::L3Data& a, const ob::L3Data& b) {
+        return a.id == b.id && a.ts == b.ts && a.seq == b.seq && a.qty == b.qty && a.price == b.price &&
+            a.symbol_id == b.symbol_id && a.side == b.side && a.event_type == b.event_type;
+    }
+
+    std::vector<ob::L3Data> scan(const l3::Reader& reader, uint64_t from_seq, uint64_t to_seq) {
+        std::vector<ob::L3Data> buf;
+        std::vector<ob::L3Data> out;
+        reader.scan_seq(from_seq, to_seq, buf, [&](const ob::L3Data& r) { out.push_back(r); });
+        return out;
+    }
+
+    std::vector<ob::L3Data> batch(uint64_t first_seq, size_t n) {
+        std::vector<ob::L3Data> out(n);
+        for (size_t i = 0; i < n; ++i) {
+            out[i].seq = first_seq + i;
+            out[i].id = first_seq + i;
+        }
+        return out;
+    }
+
+    // records i in [from, to) of a symbol's stream, as scan should return them
+    std::vector<ob::L3Data> expected(uint16_t symbol_id, uint64_t from, uint64_t to, uint64_t per_seq) {
+        std::vector<ob::L3Data> out;
+        for (uint64_t i = from; i < to; ++i) {
+            out.push_back(record(symbol_id, i, per_seq));
+        }
+        return out;
+    }
+
+    bool same_records(const std::vector<ob::L3Data>& a, const std::vector<ob::L3Data>& b) {
+        if (a.size() != b.size()) {
+            return false;
+        }
+        for (size_t i = 0; i < a.size(); ++i) {
+            if (!same_record(a[i], b[i])) {
+                return false;
+            }
+        }
+        return true;
+    }
+} // namespace
+
+// an order's fills and its own event share a seq, a seq whose records straddle a block boundary comes
+// back whole
+TEST(L3_Scan_Seq_Split_Across_Blocks) {
+    TempDir tmp("split");
+    const InstrumentRegistry instruments = InstrumentRegistry::make_default(kMinTick, kMaxTick);
+    const uint16_t symbol_id = instruments.at(0).symbol_id;
+    constexpr uint64_t per_seq = 10;
+    constexpr uint64_t n = 2 * kBlock + 100;
+    uint64_t day = 0;
+    {
+        L3DataWriter writer(tmp.dir.string(), instruments);
+        day = writer.day_id();
+        for (uint64_t i = 0; i < n; ++i) {
+            writer.append(0, record(symbol_id, i, per_seq));
+        }
+    }
+    const l3::Reader reader(l3::file_path(tmp.dir.string(), day, symbol_id));
+    EXPECT_EQ(reader.records(), n);
+    EXPECT_EQ(reader.blocks(), 3u);
+
+    // kBlock is not a multiple of per_seq, the seq holding record kBlock starts in the first block
+    const uint64_t split = 1 + kBlock / per_seq;
+    EXPECT_TRUE(reader.index()[1].first_seq == split);
+    const std::vector<ob::L3Data> got = scan(reader, split, split);
+    EXPECT_EQ(got.size(), per_seq);
+    bool same = got.size() == per_seq;
+    for (uint64_t k = 0; same && k < per_seq; ++k) {
+        same = same_record(got[k], record(symbol_id, (split - 1) * per_seq + k, per_seq));
+    }
+    EXPECT_TRUE(same);
+}
+
+// two symbols written over two opens of the same day, then read back by seq from the middle of the file,
+// with the footer whole, torn and gone
+TEST(L3_Reopen_Seek_Mid_File) {
+    TempDir tmp("reopen");
+    const InstrumentRegistry instruments = InstrumentRegistry::make_default(kMinTick, kMaxTick);
+    const uint16_t a = instruments.at(0).symbol_id;
+    const uint16_t b = instruments.at(1).symbol_id;
+    constexpr uint64_t per_seq = 3;
+    constexpr uint64_t n_a = 3 * kBlock + kBlock / 2;
+    constexpr uint64_t n_b = 2 * kBlock + 300;
+    uint64_t day = 0;
+    {
+        L3DataWriter writer(tmp.dir.string(), instruments);
+        day = writer.day_id();
+        for (uint64_t i = 0; i < n_a; ++i) {
+            writer.append(0, record(a, i, per_seq));
+            if (i < n_b / 2) {
+                writer.append(1, record(b, i, per_seq));
+            }
+        }
+    }
+    // a restart later in the day appends after the footer it cuts off
+    {
+        L3DataWriter writer(tmp.dir.string(), instruments);
+        EXPECT_EQ(writer.day_id(), day);
+        for (uint64_t i = n_b / 2; i < n_b; ++i) {
+            writer.append(1, record(b, i, per_seq));
+        }
+    }
+    const std::string path_a = l3::file_path(tmp.dir.string(), day, a);
+    const std::string path_b = l3::file_path(tmp.dir.string(), day, b);
+
+    // the seqs looked up are mid way through the third block of each file
+    const auto check = [&](const std::string& path, uint16_t symbol_id, uint64_t n, size_t blocks) {
+        const uint64_t mid = symbol_id == a ? 900 : 500;
+        const l3::Reader reader(path);
+        EXPECT_EQ(reader.records(), n);
+        EXPECT_EQ(reader.blocks(), blocks);
+        EXPECT_TRUE(reader.index()[reader.seek_seq(mid)].first_seq <= mid);
+        const uint64_t last = (n - 1) / per_seq + 1;
+        EXPECT_TRUE(same_records(scan(reader, mid, mid + 40),
+                                 expected(symbol_id, (mid - 1) * per_seq, (mid + 40) * per_seq, per_seq)));
+        EXPECT_TRUE(same_records(scan(reader, mid, last), expected(symbol_id, (mid - 1) * per_seq, n, per_seq)));
+        EXPECT_TRUE(same_records(scan(reader, 1, last), expected(symbol_id, 0, n, per_seq)));
+        return reader.has_footer();
+    };
+    EXPECT_TRUE(check(path_a, a, n_a, 4));
+    // b's first open left a partial block, its second starts a new one at record n_b / 2
+    EXPECT_TRUE(check(path_b, b, n_b, 4));
+
+    // a footer torn mid trailer, and one that never got written, are found by walking the blocks
+    const uint64_t end_a = l3::Reader(path_a).end_offset();
+    std::filesystem::resize_file(path_a, std::filesystem::file_size(path_a) - 5);
+    EXPECT_TRUE(!check(path_a, a, n_a, 4));
+    std::filesystem::resize_file(path_a, end_a);
+    EXPECT_TRUE(!check(path_a, a, n_a, 4));
+
+    // a last block torn mid write is dropped, the writer's next open continues after the block before it
+    const uint64_t last_block_b = l3::Reader(path_b).index().back().offset;
+    std::filesystem::resize_file(path_b, last_block_b + 100);
+    EXPECT_TRUE(!check(path_b, b, n_b - (n_b - n_b / 2 - kBlock), 3));
+    {
+        L3DataWriter writer(tmp.dir.string(), instruments);
+        for (uint64_t i = n_b - (n_b - n_b / 2 - kBlock); i < n_b; ++i) {
+            writer.append(1, record(b, i, per_seq));
+        }
+    }
+    EXPECT_TRUE(check(path_b, b, n_b, 4));
+    EXPECT_TRUE(check(path_a, a, n_a, 4));
+}
+
+// a quiet symbol's partial batch reaches the file once it is max_age old, without waiting for it to fill
+TEST(L3_Partial_Batch_Written_Once_Old) {
+    TempDir tmp("aged");
+    const InstrumentRegistry instruments = InstrumentRegistry::make_default(kMinTick, kMaxTick);
+    const uint16_t symbol_id = instruments.at(0).symbol_id;
+    L3DataWriter writer(tmp.dir.string(), instruments, std::chrono::milliseconds(50));
+    const std::string path = l3::file_path(tmp.dir.string(), writer.day_id(), symbol_id);
+    for (uint64_t i = 0; i < 10; ++i) {
+        writer.append(0, record(symbol_id, i, 1));
+    }
+    // a tick inside max_age leaves the batch open
+    writer.tick();
+    EXPECT_EQ(writer.records_written(), 0u);
+
+    const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+    while (writer.records_written() < 10 && std::chrono::steady_clock::now() < deadline) {
+        writer.tick();
+        std::this_thread::sleep_for(std::chrono::microseconds(100));
+    }
+    EXPECT_EQ(writer.records_written(), 10u);
+    {
+        // no footer yet, the block is found by walking the file
+        const l3::Reader reader(path);
+        EXPECT_EQ(reader.blocks(), 1u);
+        EXPECT_EQ(scan(reader, 1, 10).size(), 10u);
+    }
+
+    // the next record opens a batch of its own
+    writer.append(0, record(symbol_id, 10, 1));
+    writer.flush();
+    const l3::Reader reader(path);
+    EXPECT_EQ(reader.blocks(), 2u);
+    EXPECT_EQ(reader.records(), 11u);
+}
+
+// seqs start over each day, a lookup only ever finds the current day's records
+TEST(L3_History_Locate_After_Day_Roll) {
+    const std::string name = "/jolt_l3_history_test_" + std::to_string(::getpid());
+    L3History history(name, HistoryMode::Create, {kFirstSymbolId}, 64);
+
+    // a day that ran past the ring, then a new one that starts inside a batch
+    const std::vector<ob::L3Data> old_day = batch(1, 40);
+    history.append(0, old_day.data(), old_day.size());
+    const std::vector<ob::L3Data> late = batch(41, 40);
+    history.append(0, late.data(), late.size());
+    std::vector<ob::L3Data> rolled = batch(81, 4);
+    const std::vector<ob::L3Data> today = batch(1, 12);
+    rolled.insert(rolled.end(), today.begin(), today.end());
+    history.append(0, rolled.data(), rolled.size());
+
+    L3History::Range range{};
+    EXPECT_TRUE(history.locate(0, 5, 9, range));
+    EXPECT_EQ(range.to - range.from, 5u);
+    EXPECT_EQ(history.at(0, range.from).seq, 5u);
+    EXPECT_EQ(history.at(0, range.to - 1).seq, 9u);
+    // every record of the day is still held, no need for the file
+    EXPECT_TRUE(range.complete);
+    EXPECT_EQ(range.oldest_seq, 1u);
+
+    // yesterday's seqs are not found, however high
+    EXPECT_TRUE(history.locate(0, 60, 90, range));
+    EXPECT_EQ(range.to - range.from, 0u);
+
+    // once the day itself wraps the ring, its oldest records are left to the file
+    const std::vector<ob::L3Data> more = batch(13, 60);
+    history.append(0, more.data(), more.size());
+    EXPECT_TRUE(history.locate(0, 1, 72, range));
+    EXPECT_TRUE(!range.complete);
+    EXPECT_EQ(range.oldest_seq, 72u - 63u);
+    EXPECT_EQ(range.to - range.from, 64u);
+}
+
+int main() {
+    return ::mini_test::run_all();
+}
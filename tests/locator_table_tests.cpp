@@ -0,0 +1,202 @@
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+#include "test_harness.h"
+#include "../exchange/orderbook/locator_table.h"
+
+using namespace jolt::ob;
+
+namespace {
+    // a 16 slot window, ids 16 apart share a slot and differ by one generation
+    constexpr std::size_t kWindow = 16;
+
+    using Table = LocatorTable<uint64_t>;
+
+    // value stored for an id, distinct from the id so a hit on the wrong slot shows
+    uint64_t val(OrderId id) { return id * 10 + 3; }
+
+    bool holds(const Table& t, OrderId id) {
+        const uint64_t* v = t.find(id);
+        return v && *v == val(id);
+    }
+} // namespace
+
+TEST(LocatorTable_Direct_Hits) {
+    Table t(kWindow);
+    for (OrderId id = 1; id <= kWindow; ++id) {
+        t.insert(id, val(id));
+    }
+    EXPECT_EQ(t.size(), kWindow);
+    EXPECT_EQ(t.overflow_size(), 0u);
+    for (OrderId id = 1; id <= kWindow; ++id) {
+        EXPECT_TRUE(holds(t, id));
+        EXPECT_TRUE(t.find_direct(id) != nullptr);
+    }
+    // same slot as id 1, a generation later, never inserted
+    EXPECT_TRUE(t.find(1 + kWindow) == nullptr);
+
+    // overwriting a live id keeps one entry
+    t.insert(3, 7);
+    EXPECT_EQ(t.size(), kWindow);
+    EXPECT_EQ(*t.find(3), 7u);
+}
+
+TEST(LocatorTable_Window_Wrap_Evicts_Older_Generation) {
+    Table t(kWindow);
+    // 40 live ids wrap the window twice and a half, each slot keeps its newest id
+    for (OrderId id = 1; id <= 40; ++id) {
+        t.insert(id, val(id));
+    }
+    EXPECT_EQ(t.size(), 40u);
+    EXPECT_EQ(t.overflow_size(), 40u - kWindow);
+    for (OrderId id = 1; id <= 40; ++id) {
+        EXPECT_TRUE(holds(t, id));
+        // only the newest generation of a slot is direct, the evicted ones are found in the map
+        EXPECT_EQ(t.find_direct(id) != nullptr, id + kWindow > 40);
+    }
+}
+
+TEST(LocatorTable_Older_Id_After_Newer_Goes_To_Overflow) {
+    Table t(kWindow);
+    t.insert(1 + 2 * kWindow, val(1 + 2 * kWindow));
+    // out of order: the slot already holds a newer generation
+    t.insert(1, val(1));
+    EXPECT_EQ(t.size(), 2u);
+    EXPECT_EQ(t.overflow_size(), 1u);
+    EXPECT_TRUE(holds(t, 1));
+    EXPECT_TRUE(holds(t, 1 + 2 * kWindow));
+    EXPECT_TRUE(t.find_direct(1) == nullptr);
+}
+
+TEST(LocatorTable_Erase_From_Either_Tier) {
+    Table t(kWindow);
+    for (OrderId id = 1; id <= 2 * kWindow; ++id) {
+        t.insert(id, val(id));
+    }
+    const OrderId evicted = 5;
+    const OrderId direct = 5 + kWindow;
+    EXPECT_TRUE(t.find_direct(evicted) == nullptr);
+    EXPECT_TRUE(t.find_direct(direct) != nullptr);
+
+    EXPECT_EQ(t.erase(evicted), 1u);
+    EXPECT_TRUE(t.find(evicted) == nullptr);
+    EXPECT_TRUE(holds(t, direct));
+    EXPECT_EQ(t.overflow_size(), kWindow - 1);
+
+    EXPECT_EQ(t.erase(direct), 1u);
+    EXPECT_TRUE(t.find(direct) == nullptr);
+    EXPECT_EQ(t.size(), 2 * kWindow - 2);
+
+    // gone from both tiers, erasing again or an id never seen is a no-op
+    EXPECT_EQ(t.erase(evicted), 0u);
+    EXPECT_EQ(t.erase(direct), 0u);
+    EXPECT_EQ(t.erase(1000), 0u);
+    EXPECT_EQ(t.size(), 2 * kWindow - 2);
+
+    // the freed slot takes an older id again, which leaves the map if it was there
+    const OrderId older = 6;
+    EXPECT_EQ(t.erase(older + kWindow), 1u);
+    t.insert(older, val(older) + 1);
+    EXPECT_TRUE(t.find_direct(older) != nullptr);
+    EXPECT_EQ(*t.find(older), val(older) + 1);
+    EXPECT_EQ(t.overflow_size(), kWindow - 2);
+    EXPECT_EQ(t.size(), 2 * kWindow - 3);
+}
+
+TEST(LocatorTable_Ids_Beyond_32_Bit_Generation) {
+    Table t(kWindow);
+    // the generation does not fit the slot, the id can only live in the map
+    const OrderId huge = (uint64_t{1} << 36) + 5;
+    t.insert(5, val(5));
+    t.insert(huge, val(huge));
+    EXPECT_EQ(t.size(), 2u);
+    EXPECT_EQ(t.overflow_size(), 1u);
+    EXPECT_TRUE(holds(t, huge));
+    EXPECT_TRUE(holds(t, 5));
+    EXPECT_EQ(t.erase(huge), 1u);
+    EXPECT_TRUE(t.find(huge) == nullptr);
+    EXPECT_TRUE(holds(t, 5));
+}
+
+TEST(LocatorTable_Reserve_Before_Bulk_Load) {
+    Table t(kWindow, 4);
+    constexpr std::size_t n = 1000;
+    t.reserve(n);
+    const std::size_t reserved = t.bytes();
+    EXPECT_TRUE(reserved > kWindow * sizeof(uint64_t) * 2);
+
+    // a load far past the window, most ids end up evicted into the map without it growing again
+    for (OrderId id = 1; id <= n; ++id) {
+        t.insert(id, val(id));
+    }
+    EXPECT_EQ(t.bytes(), reserved);
+    EXPECT_EQ(t.size(), n);
+    EXPECT_EQ(t.overflow_size(), n - kWindow);
+    bool all = true;
+    for (OrderId id = 1; id <= n; ++id) {
+        all = all && holds(t, id);
+    }
+    EXPECT_TRUE(all);
+
+    // a reserve that fits the window leaves the map alone
+    Table small(kWindow, 4);
+    const std::size_t before = small.bytes();
+    small.reserve(kWindow);
+    EXPECT_EQ(small.bytes(), before);
+}
+
+TEST(LocatorTable_Build_Matches_Inserts) {
+    // ids in no particular order, three of them on slot 1 and one whose generation does not fit the slot
+    const OrderId huge = (uint64_t{1} << 36) + 2;
+    const std::vector<std::pair<OrderId, uint64_t>> entries = {
+        {17, val(17)}, {3, val(3)}, {33, val(33)}, {huge, val(huge)}, {1, val(1)}, {4, val(4)}};
+    Table t(kWindow);
+    t.build(entries.data(), entries.size());
+    EXPECT_EQ(t.size(), entries.size());
+    // the newest id of slot 1 is direct, the two older ones and the huge one are in the map
+    EXPECT_EQ(t.overflow_size(), 3u);
+    EXPECT_TRUE(t.find_direct(33) != nullptr);
+    EXPECT_TRUE(t.find_direct(17) == nullptr);
+    bool all = true;
+    for (const auto& [id, v] : entries) {
+        all = all && holds(t, id);
+    }
+    EXPECT_TRUE(all);
+
+    // the table goes on as if the ids had been inserted
+    t.insert(49, val(49));
+    EXPECT_EQ(t.overflow_size(), 4u);
+    EXPECT_TRUE(holds(t, 33));
+    EXPECT_EQ(t.erase(17), 1u);
+    EXPECT_EQ(t.erase(49), 1u);
+    EXPECT_EQ(t.size(), entries.size() - 1);
+}
+
+TEST(LocatorTable_Build_Grows_Window) {
+    Table t(kWindow, 4);
+    constexpr std::size_t n = 1000;
+    std::vector<std::pair<OrderId, uint64_t>> entries;
+    for (OrderId id = n; id >= 1; --id) {
+        entries.emplace_back(id, val(id));
+    }
+    t.build(entries.data(), entries.size());
+    // a window of 1024 covers every id, none overflows
+    EXPECT_EQ(t.size(), n);
+    EXPECT_EQ(t.overflow_size(), 0u);
+    bool all = true;
+    for (OrderId id = 1; id <= n; ++id) {
+        all = all && holds(t, id) && t.find_direct(id) != nullptr;
+    }
+    EXPECT_TRUE(all);
+
+    // ids past it wrap the grown window
+    t.insert(n + 1024, val(n + 1024));
+    EXPECT_TRUE(holds(t, n + 1024));
+    EXPECT_TRUE(holds(t, n));
+    EXPECT_EQ(t.overflow_size(), 1u);
+}
+
+int main() {
+    return ::mini_test::run_all();
+}
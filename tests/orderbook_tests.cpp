@@ -579,3 +579,1160 @@
 // int main() {
 //     return ::mini_test::run_all();
 // }
+
+#include <algorithm>
+#include <cstdint>
+#include <map>
+#include <span>
+#include <utility>
+#include <vector>
+
+#include "test_harness.h"
+#include "../exchange/orderbook/matching_orderbook.h"
+
+using namespace jolt::ob;
+
+namespace {
+    constexpr PriceTick kMinTick = 50;
+    constexpr PriceTick kMaxTick = 200;
+
+    OrderParams limit(OrderId id, Side side, PriceTick px, Qty qty, uint64_t owner = 1) {
+        OrderParams p{};
+        p.action = OrderAction::New;
+        p.type = OrderType::Limit;
+        p.id = id;
+        p.client_id = owner;
+        p.side = side;
+        p.price = px;
+        p.qty = qty;
+        return p;
+    }
+
+    OrderParams market(OrderId id, Side side, Qty qty) {
+        OrderParams p{};
+        p.action = OrderAction::New;
+        p.type = OrderType::Market;
+        p.id = id;
+        p.client_id = 99;
+        p.side = side;
+        p.qty = qty;
+        p.tif = TIF::IOC;
+        return p;
+    }
+
+    OrderParams cancel(OrderId id) {
+        OrderParams p{};
+        p.action = OrderAction::Cancel;
+        p.id = id;
+        return p;
+    }
+
+    OrderParams modify(OrderId id, PriceTick px, Qty qty) {
+        OrderParams p{};
+        p.action = OrderAction::Modify;
+        p.id = id;
+        p.price = px;
+        p.qty = qty;
+        return p;
+    }
+
+    OrderParams stop(OrderId id, Side side, PriceTick trigger, Qty qty, OrderType post = OrderType::StopMarket,
+                     PriceTick limit_px = 0) {
+        OrderParams p{};
+        p.action = OrderAction::New;
+        p.type = post;
+        p.id = id;
+        p.client_id = 3;
+        p.side = side;
+        p.trigger = trigger;
+        p.limit_px = limit_px;
+        p.qty = qty;
+        return p;
+    }
+
+    struct Resting {
+        OrderId id;
+        Qty qty;
+        uint64_t owner;
+    };
+
+    // what the book should hold, resting limit orders per level in fifo order
+    struct Model {
+        std::map<PriceTick, std::vector<Resting>> bids;
+        std::map<PriceTick, std::vector<Resting>> asks;
+
+        std::map<PriceTick, std::vector<Resting>>& side(Side s) { return s == Side::Buy ? bids : asks; }
+
+        void add(Side s, PriceTick px, OrderId id, Qty qty, uint64_t owner) { side(s)[px].push_back({id, qty, owner}); }
+
+        // returns the order, qty 0 if not resting
+        Resting remove(Side s, PriceTick px, OrderId id) {
+            auto& lvl = side(s)[px];
+            for (auto it = lvl.begin(); it != lvl.end(); ++it) {
+                if (it->id == id) {
+                    const Resting r = *it;
+                    lvl.erase(it);
+                    if (lvl.empty()) {
+                        side(s).erase(px);
+                    }
+                    return r;
+                }
+            }
+            return {id, 0, 0};
+        }
+
+        // snapshot order: bids best to worst, then asks best to worst
+        std::vector<SnapshotOrder> expected() const {
+            std::vector<SnapshotOrder> out;
+            for (auto it = bids.rbegin(); it != bids.rend(); ++it) {
+                for (const auto& r : it->second) {
+                    out.push_back({r.id, r.qty, it->first, Side::Buy});
+                }
+            }
+            for (const auto& [px, lvl] : asks) {
+                for (const auto& r : lvl) {
+                    out.push_back({r.id, r.qty, px, Side::Sell});
+                }
+            }
+            return out;
+        }
+    };
+
+    template <typename Book>
+    void expect_book_matches(Book& ob, const Model& m) {
+        BookSnapshot snap{};
+        ob.get_snapshot(snap);
+        const auto want = m.expected();
+        EXPECT_EQ(snap.orders.size(), want.size());
+        bool same = snap.orders.size() == want.size();
+        for (std::size_t i = 0; same && i < want.size(); ++i) {
+            same = snap.orders[i].id == want[i].id && snap.orders[i].qty == want[i].qty &&
+                snap.orders[i].px == want[i].px && snap.orders[i].side == want[i].side;
+        }
+        EXPECT_TRUE(same);
+
+        for (const Side s : {Side::Buy, Side::Sell}) {
+            const auto& levels = s == Side::Buy ? m.bids : m.asks;
+            for (const auto& [px, lvl] : levels) {
+                uint64_t qty = 0;
+                for (const auto& r : lvl) {
+                    qty += r.qty;
+                    EXPECT_EQ(ob.order_qty(r.id), r.qty);
+                }
+                EXPECT_EQ(ob.level_active_qty(s, px), qty);
+                EXPECT_EQ(ob.level_depth(s, px), qty);
+                EXPECT_EQ(ob.level_order_count(s, px), lvl.size());
+                EXPECT_EQ(ob.level_head_order_id(s, px), lvl.front().id);
+            }
+        }
+        EXPECT_TRUE(ob.locators_consistent());
+    }
+
+    // small deterministic generator so runs are repeatable
+    struct Lcg {
+        uint64_t state;
+        uint64_t next(uint64_t bound) {
+            state = state * 6364136223846793005ull + 1442695040888963407ull;
+            return (state >> 33) % bound;
+        }
+    };
+
+    // rounds of adds followed by cancelling most of them (plus in place qty cuts and moves to another
+    // level), then market sweeps of both sides and a mass cancel. prices stay on their own side of 100 so
+    // nothing crosses until the sweeps. checks the book against the model after every round
+    template <typename Book>
+    void run_cancel_heavy(Book& ob, Model& m, uint64_t seed) {
+        Lcg rng{seed};
+        OrderId next_id = 1;
+        std::vector<std::pair<OrderId, std::pair<Side, PriceTick>>> live;
+        for (int round = 0; round < 8; ++round) {
+            for (int i = 0; i < 700; ++i) {
+                const Side side = rng.next(2) ? Side::Buy : Side::Sell;
+                const auto px = static_cast<PriceTick>(side == Side::Buy ? 90 + rng.next(4) : 106 + rng.next(4));
+                const auto qty = static_cast<Qty>(1 + rng.next(50));
+                const uint64_t owner = 1 + rng.next(4);
+                const OrderId id = next_id++;
+                ob.submit_order(limit(id, side, px, qty, owner));
+                m.add(side, px, id, qty, owner);
+                live.push_back({id, {side, px}});
+            }
+            // leave about one in eight orders resting so most blocks go sparse
+            while (live.size() > 90u * (round + 1)) {
+                const std::size_t pick = rng.next(live.size());
+                const auto [id, where] = live[pick];
+                const auto [side, px] = where;
+                const uint64_t action = rng.next(10);
+                if (action < 8) {
+                    ob.submit_order(cancel(id));
+                    m.remove(side, px, id);
+                    live[pick] = live.back();
+                    live.pop_back();
+                }
+                else if (action == 8) {
+                    // qty cut keeps the order's place
+                    auto& lvl = m.side(side)[px];
+                    for (auto& r : lvl) {
+                        if (r.id == id && r.qty > 1) {
+                            r.qty -= 1;
+                            ob.submit_order(modify(id, px, r.qty));
+                        }
+                    }
+                }
+                else {
+                    // a move goes to the back of the other level
+                    const auto to = static_cast<PriceTick>(side == Side::Buy ? 90 + rng.next(4) : 106 + rng.next(4));
+                    if (to != px) {
+                        const Resting r = m.remove(side, px, id);
+                        ob.submit_order(modify(id, to, r.qty));
+                        m.add(side, to, id, r.qty, r.owner);
+                        live[pick].second.second = to;
+                    }
+                }
+            }
+            expect_book_matches(ob, m);
+        }
+
+        // sweep half of each side, the fills have to come out in model fifo order
+        for (const Side taker : {Side::Sell, Side::Buy}) {
+            auto& book_side = m.side(taker == Side::Buy ? Side::Sell : Side::Buy);
+            uint64_t total = 0;
+            for (const auto& [px, lvl] : book_side) {
+                for (const auto& r : lvl) {
+                    total += r.qty;
+                }
+            }
+            const auto sweep = static_cast<Qty>(total / 2);
+            ob.submit_order(market(next_id++, taker, sweep));
+
+            std::vector<std::pair<OrderId, Qty>> want;
+            Qty left = sweep;
+            while (left > 0) {
+                auto lvl_it = taker == Side::Sell ? std::prev(book_side.end()) : book_side.begin();
+                auto& front = lvl_it->second.front();
+                const Qty take = front.qty < left ? front.qty : left;
+                want.push_back({front.id, take});
+                left -= take;
+                front.qty -= take;
+                if (front.qty == 0) {
+                    lvl_it->second.erase(lvl_it->second.begin());
+                    if (lvl_it->second.empty()) {
+                        book_side.erase(lvl_it);
+                    }
+                }
+            }
+            const auto& fills = ob.match_result.fills;
+            EXPECT_EQ(fills.size(), want.size());
+            bool in_order = fills.size() == want.size();
+            for (std::size_t i = 0; in_order && i < want.size(); ++i) {
+                in_order = fills[i].id == want[i].first && fills[i].qty == want[i].second;
+            }
+            EXPECT_TRUE(in_order);
+            expect_book_matches(ob, m);
+        }
+
+        // owner 2's index has entries appended by every relocation, cancel_all must still find each order once
+        std::size_t owned = 0;
+        for (auto* levels : {&m.bids, &m.asks}) {
+            for (auto it = levels->begin(); it != levels->end();) {
+                auto& lvl = it->second;
+                for (auto r = lvl.begin(); r != lvl.end();) {
+                    if (r->owner == 2) {
+                        r = lvl.erase(r);
+                        ++owned;
+                    }
+                    else {
+                        ++r;
+                    }
+                }
+                it = lvl.empty() ? levels->erase(it) : std::next(it);
+            }
+        }
+        const std::size_t cancelled = ob.cancel_all(2, false, Side::Buy, 0, [](const BookEvent&) {});
+        EXPECT_EQ(cancelled, owned);
+        expect_book_matches(ob, m);
+    }
+
+    template <typename Book>
+    void cancel_heavy_on_and_off() {
+        Book on(kMinTick, kMaxTick);
+        Book off(kMinTick, kMaxTick);
+        off.set_compaction(false);
+        Model m_on;
+        Model m_off;
+        run_cancel_heavy(on, m_on, 7);
+        run_cancel_heavy(off, m_off, 7);
+
+        // compaction changes where slots sit, never what the book holds
+        BookSnapshot a{};
+        BookSnapshot b{};
+        on.get_snapshot(a);
+        off.get_snapshot(b);
+        EXPECT_EQ(a.orders.size(), b.orders.size());
+        bool same = a.orders.size() == b.orders.size();
+        for (std::size_t i = 0; same && i < a.orders.size(); ++i) {
+            same = a.orders[i].id == b.orders[i].id && a.orders[i].qty == b.orders[i].qty;
+        }
+        EXPECT_TRUE(same);
+        EXPECT_TRUE(on.block_bytes() <= off.block_bytes());
+    }
+
+    // a book image laid out the way a checkpoint file holds it, the slots of each kind back to back in
+    // run order, for load_image
+    struct FlatImage {
+        ImageHeader header{};
+        std::vector<ImageRun> runs;
+        std::vector<OrderSlot> orders;
+        std::vector<StopSlot> stops;
+        std::vector<TpSlot> tps;
+
+        struct Append {
+            FlatImage* f;
+            void operator()(const ImageRun&, std::span<const OrderSlot> s) {
+                f->orders.insert(f->orders.end(), s.begin(), s.end());
+            }
+            void operator()(const ImageRun&, std::span<const StopSlot> s) {
+                f->stops.insert(f->stops.end(), s.begin(), s.end());
+            }
+            void operator()(const ImageRun&, std::span<const TpSlot> s) {
+                f->tps.insert(f->tps.end(), s.begin(), s.end());
+            }
+        };
+
+        explicit FlatImage(const BookImage& img) : header(img.header), runs(img.runs) {
+            img.for_each_run(Append{this});
+        }
+
+        BookImageView view() const { return BookImageView{header, runs, orders, stops, tps}; }
+    };
+
+    template <typename Book>
+    void expect_same_book(Book& a, Book& b) {
+        BookSnapshot sa{};
+        BookSnapshot sb{};
+        a.get_snapshot(sa);
+        b.get_snapshot(sb);
+        EXPECT_EQ(sa.seq, sb.seq);
+        EXPECT_EQ(sa.orders.size(), sb.orders.size());
+        bool same = sa.orders.size() == sb.orders.size();
+        for (std::size_t i = 0; same && i < sa.orders.size(); ++i) {
+            same = sa.orders[i].id == sb.orders[i].id && sa.orders[i].qty == sb.orders[i].qty &&
+                sa.orders[i].px == sb.orders[i].px && sa.orders[i].side == sb.orders[i].side;
+        }
+        EXPECT_TRUE(same);
+        EXPECT_EQ(a.active_stop_order_count(), b.active_stop_order_count());
+        EXPECT_TRUE(b.locators_consistent());
+    }
+
+    // submits p to both books and checks they fill it the same way
+    template <typename Book>
+    void expect_same_fills(Book& a, Book& b, const OrderParams& p) {
+        a.submit_order(p);
+        b.submit_order(p);
+        const auto& fa = a.match_result.fills;
+        const auto& fb = b.match_result.fills;
+        EXPECT_EQ(fa.size(), fb.size());
+        bool same = fa.size() == fb.size();
+        for (std::size_t i = 0; same && i < fa.size(); ++i) {
+            same = fa[i].id == fb[i].id && fa[i].qty == fb[i].qty && fa[i].price == fb[i].price &&
+                fa[i].seq == fb[i].seq;
+        }
+        EXPECT_TRUE(same);
+    }
+
+    // a book with a trade behind it, partly filled and modified levels, stops and a take-profit
+    template <typename Book>
+    void fill_for_image(Book& ob) {
+        ob.submit_order(limit(1, Side::Sell, 100, 5, 4));
+        ob.submit_order(market(2, Side::Buy, 2));
+        for (const OrderParams& p : {limit(10, Side::Buy, 95, 4, 1), limit(11, Side::Buy, 95, 6, 2),
+                                     limit(12, Side::Buy, 94, 5, 1), limit(13, Side::Buy, 90, 7, 3),
+                                     limit(20, Side::Sell, 101, 2, 2), limit(21, Side::Sell, 101, 3, 1),
+                                     limit(22, Side::Sell, 103, 4, 2), limit(23, Side::Sell, 105, 9, 1)}) {
+            ob.submit_order(p);
+        }
+        ob.submit_order(stop(30, Side::Buy, 101, 2));
+        ob.submit_order(stop(31, Side::Buy, 101, 1));
+        ob.submit_order(stop(32, Side::Sell, 94, 3, OrderType::StopLimit, 93));
+        ob.submit_order(stop(33, Side::Sell, 103, 2, OrderType::TakeProfit, 103));
+        ob.submit_order(modify(11, 95, 3));
+        ob.submit_order(cancel(12));
+    }
+
+    // save_image into a fresh image, load it into an empty book, then drive both books the same way
+    template <typename Book>
+    void image_round_trip() {
+        Book live(kMinTick, kMaxTick);
+        fill_for_image(live);
+        BookImage img{};
+        live.save_image(img);
+        EXPECT_EQ(img.copied_runs, img.runs.size());
+
+        Book loaded(kMinTick, kMaxTick);
+        loaded.load_image(FlatImage(img).view());
+        expect_same_book(live, loaded);
+        for (const OrderId id : {1, 10, 11, 13, 20, 21, 22, 23, 30, 31, 32, 33}) {
+            EXPECT_TRUE(loaded.contains(id));
+            EXPECT_EQ(loaded.order_qty(id), live.order_qty(id));
+        }
+        EXPECT_TRUE(!loaded.contains(12));
+
+        // 40 takes what is left at 100 and all of 101, the stops fire in arrival order on the 101 trade
+        // and lift 103, which fires the take-profit behind 22. 41 sweeps 95 down into 90, the stop at 94
+        // fires and rests its limit at 93
+        expect_same_fills(live, loaded, market(40, Side::Buy, 8));
+        EXPECT_TRUE(!loaded.contains(30) && !loaded.contains(31));
+        EXPECT_EQ(loaded.level_order_count(Side::Sell, 103), 2u);
+        EXPECT_EQ(loaded.level_head_order_id(Side::Sell, 103), 22u);
+        expect_same_fills(live, loaded, market(41, Side::Sell, 8));
+        EXPECT_EQ(loaded.level_active_qty(Side::Sell, 93), 3u);
+        expect_same_book(live, loaded);
+        expect_same_fills(live, loaded, limit(42, Side::Buy, 105, 20, 5));
+        expect_same_book(live, loaded);
+    }
+
+    // later captures into the same image copy only the levels that changed since the one before
+    template <typename Book>
+    void image_recapture() {
+        Book live(kMinTick, kMaxTick);
+        fill_for_image(live);
+        BookImage img{};
+        live.save_image(img);
+        const std::size_t runs = img.runs.size();
+
+        live.save_image(img);
+        EXPECT_EQ(img.copied_runs, 0u);
+        EXPECT_EQ(img.runs.size(), runs);
+
+        // one active level and one stop level change, 90 empties and its run goes
+        live.submit_order(cancel(21));
+        live.submit_order(modify(32, 92, 3));
+        live.submit_order(cancel(13));
+        live.save_image(img);
+        EXPECT_EQ(img.copied_runs, 2u);
+        EXPECT_EQ(img.runs.size(), runs - 1);
+        Book loaded(kMinTick, kMaxTick);
+        loaded.load_image(FlatImage(img).view());
+        expect_same_book(live, loaded);
+
+        // fills and triggers change levels as well
+        live.submit_order(market(40, Side::Buy, 4));
+        live.submit_order(stop(34, Side::Sell, 60, 1));
+        live.save_image(img);
+        EXPECT_TRUE(img.copied_runs > 0 && img.copied_runs < img.runs.size());
+        Book again(kMinTick, kMaxTick);
+        again.load_image(FlatImage(img).view());
+        expect_same_book(live, again);
+        expect_same_fills(live, again, market(41, Side::Sell, 30));
+        expect_same_book(live, again);
+
+        // an image another book filled last starts over
+        Book other(kMinTick, kMaxTick);
+        other.submit_order(limit(1, Side::Buy, 80, 1));
+        other.save_image(img);
+        EXPECT_EQ(img.runs.size(), 1u);
+        live.save_image(img);
+        EXPECT_EQ(img.copied_runs, img.runs.size());
+        Book last(kMinTick, kMaxTick);
+        last.load_image(FlatImage(img).view());
+        expect_same_book(live, last);
+    }
+
+    bool same_event(const BookEvent& a, const BookEvent& b) {
+        return a.id == b.id && a.owner == b.owner && a.ts == b.ts && a.seq == b.seq && a.qty == b.qty &&
+            a.price == b.price && a.leaves == b.leaves && a.side == b.side && a.event_type == b.event_type &&
+            a.reason == b.reason;
+    }
+
+    // what one order got back from the book, its own event and the fills it caused
+    struct Outcome {
+        BookEvent ev{};
+        std::vector<BookEvent> fills;
+    };
+
+    bool same_outcome(const Outcome& a, const Outcome& b) {
+        if (!same_event(a.ev, b.ev) || a.fills.size() != b.fills.size()) {
+            return false;
+        }
+        for (std::size_t i = 0; i < a.fills.size(); ++i) {
+            if (!same_event(a.fills[i], b.fills[i])) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // news that cross around 100, markets, cancels and modifies of live and unknown ids, stops, stop-limits
+    // and take-profits, so fills, triggers and rejects all show up in the stream
+    std::vector<OrderParams> mixed_stream(uint64_t seed, std::size_t n) {
+        Lcg rng{seed};
+        std::vector<OrderParams> out;
+        out.reserve(n);
+        for (OrderId id = 1; id <= n; ++id) {
+            const Side side = rng.next(2) ? Side::Buy : Side::Sell;
+            const auto px = static_cast<PriceTick>(92 + rng.next(17));
+            const auto qty = static_cast<Qty>(1 + rng.next(20));
+            const OrderId target = 1 + rng.next(id + 16);
+            OrderParams p{};
+            switch (rng.next(12)) {
+            case 0:
+            case 1:
+                p = cancel(target);
+                break;
+            case 2:
+            case 3:
+                p = modify(target, px, qty);
+                break;
+            case 4:
+                p = market(id, side, qty);
+                break;
+            case 5:
+                p = stop(id, side, static_cast<PriceTick>(side == Side::Buy ? px + 3 : px - 3), qty);
+                break;
+            case 6:
+                p = stop(id, side, static_cast<PriceTick>(side == Side::Buy ? px + 2 : px - 2), qty,
+                         OrderType::StopLimit, px);
+                break;
+            case 7:
+                p = stop(id, side, static_cast<PriceTick>(side == Side::Buy ? px - 3 : px + 3), qty,
+                         OrderType::TakeProfit, px);
+                break;
+            default:
+                p = limit(id, side, px, qty, 1 + rng.next(4));
+                break;
+            }
+            p.ts = id;
+            out.push_back(p);
+        }
+        return out;
+    }
+
+    // an owner's resting limit orders as cancel_all should report them, by id
+    std::vector<std::pair<OrderId, Qty>> owned_by(const Model& m, uint64_t owner, bool one_side, Side side) {
+        std::vector<std::pair<OrderId, Qty>> out;
+        for (const Side s : {Side::Buy, Side::Sell}) {
+            if (one_side && s != side) {
+                continue;
+            }
+            for (const auto& [px, lvl] : s == Side::Buy ? m.bids : m.asks) {
+                for (const Resting& r : lvl) {
+                    if (r.owner == owner) {
+                        out.push_back({r.id, r.qty});
+                    }
+                }
+            }
+        }
+        std::sort(out.begin(), out.end());
+        return out;
+    }
+
+    // runs cancel_all and drops what it cancelled from the model, returns the cancels sorted by id
+    template <typename Book>
+    std::vector<std::pair<OrderId, Qty>> cancel_all_of(Book& ob, Model& m, uint64_t owner, bool one_side, Side side) {
+        std::vector<std::pair<OrderId, Qty>> got;
+        std::vector<BookEvent> events;
+        ob.cancel_all(owner, one_side, side, 0, [&](const BookEvent& e) { events.push_back(e); });
+        for (const BookEvent& e : events) {
+            EXPECT_TRUE(e.event_type == BookEventType::Cancel && e.owner == owner);
+            got.push_back({e.id, e.qty});
+            m.remove(e.side, e.price, e.id);
+        }
+        std::sort(got.begin(), got.end());
+        return got;
+    }
+
+    // submit_batch hands out the events, fills and seqs submit_order would, whatever the chunking, and
+    // leaves the same book
+    template <typename Book>
+    void batch_matches_serial() {
+        const std::vector<OrderParams> orders = mixed_stream(11, 6000);
+
+        Book serial(kMinTick, kMaxTick);
+        std::vector<Outcome> want;
+        want.reserve(orders.size());
+        for (const OrderParams& p : orders) {
+            const BookEvent ev = serial.submit_order(p);
+            want.push_back({ev, serial.match_result.fills});
+        }
+
+        Book batched(kMinTick, kMaxTick);
+        std::vector<Outcome> got;
+        got.reserve(orders.size());
+        Lcg rng{5};
+        for (std::size_t at = 0; at < orders.size();) {
+            const std::size_t len = std::min<std::size_t>(1 + rng.next(64), orders.size() - at);
+            batched.submit_batch(std::span<const OrderParams>(orders.data() + at, len),
+                                 [&](const OrderParams&, const BookEvent& ev) {
+                                     got.push_back({ev, batched.match_result.fills});
+                                 });
+            at += len;
+        }
+
+        EXPECT_EQ(got.size(), want.size());
+        std::size_t fills = 0;
+        std::size_t rejects = 0;
+        bool same = got.size() == want.size();
+        for (std::size_t i = 0; same && i < want.size(); ++i) {
+            same = same_outcome(got[i], want[i]);
+            fills += want[i].fills.size();
+            rejects += want[i].ev.event_type == BookEventType::Reject;
+        }
+        EXPECT_TRUE(same);
+        // the stream has to exercise matching and rejects for the comparison to mean anything
+        EXPECT_TRUE(fills > 500 && rejects > 100);
+        EXPECT_EQ(batched.seq, serial.seq);
+        EXPECT_EQ(batched.best_bid(), serial.best_bid());
+        EXPECT_EQ(batched.best_ask(), serial.best_ask());
+        expect_same_book(serial, batched);
+    }
+
+    // book_top of both sides against the model's levels, best first and cut at the cache depth
+    template <typename Book>
+    void expect_depth_matches(const Book& ob, const Model& m) {
+        for (const Side s : {Side::Buy, Side::Sell}) {
+            std::vector<DepthLevel> want;
+            const auto add = [&](PriceTick px, const std::vector<Resting>& lvl) {
+                Qty qty = 0;
+                for (const Resting& r : lvl) {
+                    qty += r.qty;
+                }
+                want.push_back({px, qty, static_cast<uint32_t>(lvl.size())});
+            };
+            if (s == Side::Buy) {
+                for (auto it = m.bids.rbegin(); it != m.bids.rend() && want.size() < Book::kDepthLevels; ++it) {
+                    add(it->first, it->second);
+                }
+            }
+            else {
+                for (auto it = m.asks.begin(); it != m.asks.end() && want.size() < Book::kDepthLevels; ++it) {
+                    add(it->first, it->second);
+                }
+            }
+            const auto got = ob.book_top(s);
+            EXPECT_EQ(got.size(), want.size());
+            bool same = got.size() == want.size();
+            for (std::size_t i = 0; same && i < want.size(); ++i) {
+                same = got[i].px == want[i].px && got[i].qty == want[i].qty && got[i].orders == want[i].orders;
+            }
+            EXPECT_TRUE(same);
+            EXPECT_EQ(ob.book_top(s, 3).size(), std::min<std::size_t>(3, want.size()));
+            EXPECT_EQ(s == Side::Buy ? ob.best_bid() : ob.best_ask(), want.empty() ? 0 : want.front().px);
+        }
+    }
+
+    // the depth cache through adds, partial and whole fills, cancels, qty cuts and levels emptying out of
+    // a full side, with levels step ticks apart around mid
+    template <typename Book>
+    void depth_follows_book(PriceTick min_tick, PriceTick max_tick, PriceTick mid, PriceTick step) {
+        Book ob(min_tick, max_tick);
+        Model m;
+        const auto bid_px = [&](PriceTick k) { return static_cast<PriceTick>(mid - step * (k + 1)); };
+        const auto ask_px = [&](PriceTick k) { return static_cast<PriceTick>(mid + step * (k + 1)); };
+        OrderId id = 1;
+        // 12 levels a side, two orders each, more than the cache holds
+        for (PriceTick k = 0; k < 12; ++k) {
+            for (const Qty qty : {Qty{4}, Qty{6}}) {
+                ob.submit_order(limit(id, Side::Buy, bid_px(k), qty));
+                m.add(Side::Buy, bid_px(k), id++, qty, 1);
+                ob.submit_order(limit(id, Side::Sell, ask_px(k), qty));
+                m.add(Side::Sell, ask_px(k), id++, qty, 1);
+            }
+        }
+        expect_depth_matches(ob, m);
+
+        // a stop adds no depth
+        uint64_t version = ob.depth_version();
+        ob.submit_order(stop(900, Side::Buy, ask_px(11), 5));
+        EXPECT_EQ(ob.depth_version(), version);
+
+        // partial fill of the best ask's head order, then the rest of its level and part of the next, the
+        // eleventh level slides into the cache
+        ob.submit_order(market(901, Side::Buy, 3));
+        m.asks.begin()->second.front().qty -= 3;
+        expect_depth_matches(ob, m);
+        ob.submit_order(market(902, Side::Buy, 1 + 6 + 2));
+        m.remove(Side::Sell, ask_px(0), 2);
+        m.remove(Side::Sell, ask_px(0), 4);
+        m.asks.begin()->second.front().qty -= 2;
+        expect_depth_matches(ob, m);
+
+        // a cancel at the best bid keeps the level, the second one empties it
+        ob.submit_order(cancel(1));
+        m.remove(Side::Buy, bid_px(0), 1);
+        expect_depth_matches(ob, m);
+        ob.submit_order(cancel(3));
+        m.remove(Side::Buy, bid_px(0), 3);
+        expect_depth_matches(ob, m);
+
+        // a qty cut in the cache changes its level, a cancel below the cached levels changes nothing read
+        ob.submit_order(modify(7, bid_px(1), 1));
+        m.side(Side::Buy)[bid_px(1)].back().qty = 1;
+        expect_depth_matches(ob, m);
+        version = ob.depth_version();
+        ob.submit_order(cancel(45));
+        m.remove(Side::Buy, bid_px(11), 45);
+        EXPECT_EQ(ob.depth_version(), version);
+        expect_depth_matches(ob, m);
+
+        // sweeping bids down to fewer levels than the cache holds
+        Qty total = 0;
+        auto level = m.bids.rbegin();
+        for (int k = 0; k < 5; ++k, ++level) {
+            for (const Resting& r : level->second) {
+                total += r.qty;
+            }
+        }
+        ob.submit_order(market(903, Side::Sell, total));
+        for (int k = 0; k < 5; ++k) {
+            m.bids.erase(std::prev(m.bids.end()));
+        }
+        expect_depth_matches(ob, m);
+        EXPECT_TRUE(ob.book_top(Side::Buy).size() < Book::kDepthLevels);
+
+        // and back, a new best level goes on top
+        ob.submit_order(limit(904, Side::Buy, static_cast<PriceTick>(mid - 1), 8));
+        m.add(Side::Buy, static_cast<PriceTick>(mid - 1), 904, 8, 1);
+        expect_depth_matches(ob, m);
+    }
+} // namespace
+
+TEST(Submit_Batch_Matches_Submit_Order) {
+    batch_matches_serial<MatchingOrderBook<>>();
+}
+
+TEST(Submit_Batch_Matches_Submit_Order_Paged) {
+    batch_matches_serial<MatchingOrderBook<128, LadderKind::Paged>>();
+}
+
+TEST(Compaction_CancelHeavy_Aos) {
+    cancel_heavy_on_and_off<MatchingOrderBook<>>();
+}
+
+TEST(Compaction_CancelHeavy_Soa) {
+    cancel_heavy_on_and_off<MatchingOrderBook<128, LadderKind::Dense, SlotLayout::Soa>>();
+}
+
+TEST(Compaction_CancelHeavy_Paged) {
+    cancel_heavy_on_and_off<MatchingOrderBook<128, LadderKind::Paged>>();
+}
+
+TEST(Compaction_CancelHeavy_SmallBlocks) {
+    cancel_heavy_on_and_off<MatchingOrderBook<64>>();
+}
+
+// four full blocks at one level, then cancels that hit each compaction path in turn
+TEST(Compaction_Unlink_Pack_Absorb) {
+    MatchingOrderBook<> ob(kMinTick, kMaxTick);
+    Model m;
+    for (OrderId id = 1; id <= 512; ++id) {
+        ob.submit_order(limit(id, Side::Buy, 100, static_cast<Qty>(id)));
+        m.add(Side::Buy, 100, id, static_cast<Qty>(id), 1);
+    }
+    const std::size_t block = ob.block_bytes() / 4;
+    const auto cancel_range = [&](OrderId from, OrderId to, OrderId keep_every) {
+        for (OrderId id = from; id <= to; ++id) {
+            if (id % keep_every != 0) {
+                ob.submit_order(cancel(id));
+                m.remove(Side::Buy, 100, id);
+            }
+        }
+    };
+
+    // second block cancelled out between two full ones: packed once sparse, then unlinked
+    cancel_range(129, 256, 1000);
+    expect_book_matches(ob, m);
+    EXPECT_EQ(ob.block_bytes(), 3 * block);
+
+    // third block down to 10 live, its neighbours are full: packed in place
+    cancel_range(257, 384, 13);
+    expect_book_matches(ob, m);
+    EXPECT_EQ(ob.block_bytes(), 3 * block);
+
+    // head block down to 19 live, fits with the packed one after it: that one is absorbed
+    cancel_range(2, 128, 7);
+    expect_book_matches(ob, m);
+    EXPECT_EQ(ob.block_bytes(), 2 * block);
+
+    // the survivors still fill oldest first
+    ob.submit_order(market(1000, Side::Sell, 1 + 7));
+    EXPECT_EQ(ob.match_result.fills.size(), 2u);
+    EXPECT_EQ(ob.match_result.fills[0].id, 1u);
+    EXPECT_EQ(ob.match_result.fills[1].id, 7u);
+    m.remove(Side::Buy, 100, 1);
+    m.remove(Side::Buy, 100, 7);
+    expect_book_matches(ob, m);
+}
+
+// one side of one owner, then the rest of it, stops and take-profits included, nobody else's orders
+TEST(Cancel_All_By_Owner_And_Side) {
+    MatchingOrderBook<> ob(kMinTick, kMaxTick);
+    Model m;
+    OrderId id = 1;
+    for (const uint64_t owner : {1, 2}) {
+        for (const PriceTick px : {90, 95, 99}) {
+            ob.submit_order(limit(id, Side::Buy, px, 5, owner));
+            m.add(Side::Buy, px, id++, 5, owner);
+            ob.submit_order(limit(id, Side::Sell, static_cast<PriceTick>(px + 12), 4, owner));
+            m.add(Side::Sell, static_cast<PriceTick>(px + 12), id++, 4, owner);
+        }
+    }
+    ob.submit_order(stop(50, Side::Buy, 120, 2));
+    ob.submit_order(stop(51, Side::Sell, 80, 2, OrderType::StopLimit, 79));
+    ob.submit_order(stop(52, Side::Sell, 115, 2, OrderType::TakeProfit, 115));
+    EXPECT_EQ(ob.active_stop_order_count(), 2u);
+
+    const auto want_buys = owned_by(m, 2, true, Side::Buy);
+    EXPECT_EQ(want_buys.size(), 3u);
+    EXPECT_TRUE(cancel_all_of(ob, m, 2, true, Side::Buy) == want_buys);
+    expect_book_matches(ob, m);
+
+    const auto want_rest = owned_by(m, 2, false, Side::Buy);
+    EXPECT_EQ(want_rest.size(), 3u);
+    EXPECT_TRUE(cancel_all_of(ob, m, 2, false, Side::Buy) == want_rest);
+    expect_book_matches(ob, m);
+    EXPECT_EQ(ob.cancel_all(2, false, Side::Buy, 0, [](const BookEvent&) {}), 0u);
+    EXPECT_EQ(ob.cancel_all(77, false, Side::Buy, 0, [](const BookEvent&) {}), 0u);
+
+    // the stop owner's sell side holds a stop-limit and the take-profit, its buy side a stop
+    EXPECT_EQ(ob.cancel_all(3, true, Side::Sell, 0, [](const BookEvent&) {}), 2u);
+    EXPECT_TRUE(ob.contains(50) && !ob.contains(51) && !ob.contains(52));
+    EXPECT_EQ(ob.cancel_all(3, false, Side::Buy, 0, [](const BookEvent&) {}), 1u);
+    EXPECT_EQ(ob.active_stop_order_count(), 0u);
+    EXPECT_EQ(owned_by(m, 1, false, Side::Buy).size(), 6u);
+    expect_book_matches(ob, m);
+}
+
+// a book only cancels its own orders, the owner's orders of another symbol stay
+TEST(Cancel_All_Leaves_Other_Symbols) {
+    MatchingOrderBook<> a(kMinTick, kMaxTick);
+    MatchingOrderBook<> b(kMinTick, kMaxTick);
+    Model ma;
+    Model mb;
+    for (OrderId id = 1; id <= 20; ++id) {
+        const Side side = id % 2 ? Side::Buy : Side::Sell;
+        const auto px = static_cast<PriceTick>(side == Side::Buy ? 90 + id % 5 : 110 + id % 5);
+        a.submit_order(limit(id, side, px, 3, 1 + id % 2));
+        ma.add(side, px, id, 3, 1 + id % 2);
+        b.submit_order(limit(id + 100, side, px, 3, 1 + id % 2));
+        mb.add(side, px, id + 100, 3, 1 + id % 2);
+    }
+    const auto want = owned_by(ma, 2, false, Side::Buy);
+    EXPECT_EQ(want.size(), 10u);
+    EXPECT_TRUE(cancel_all_of(a, ma, 2, false, Side::Buy) == want);
+    expect_book_matches(a, ma);
+    expect_book_matches(b, mb);
+    EXPECT_EQ(owned_by(mb, 2, false, Side::Buy).size(), 10u);
+}
+
+// fills, modifies and compaction move or end an owner's orders, cancel_all still finds each live one once
+// with its open qty
+TEST(Cancel_All_Owner_Index_After_Fills_Modifies_Compaction) {
+    MatchingOrderBook<> ob(kMinTick, kMaxTick);
+    Model m;
+    // one order in eight is owner 2's, spread over the levels between owner 1's runs
+    const auto px_of = [](OrderId id) { return static_cast<PriceTick>(96 + id / 8 % 4); };
+    const auto owner_of = [](OrderId id) { return id % 8 == 1 ? uint64_t{2} : uint64_t{1}; };
+    for (OrderId id = 1; id <= 1200; ++id) {
+        ob.submit_order(limit(id, Side::Buy, px_of(id), 10, owner_of(id)));
+        m.add(Side::Buy, px_of(id), id, 10, owner_of(id));
+    }
+
+    // a sweep of 99 fills its first 16 orders whole, owner 2's 25 and 57 among them, and the next one partly
+    ob.submit_order(market(5000, Side::Sell, 16 * 10 + 4));
+    Qty left = 16 * 10 + 4;
+    while (left > 0) {
+        auto& front = m.bids.rbegin()->second.front();
+        const Qty take = front.qty < left ? front.qty : left;
+        left -= take;
+        front.qty -= take;
+        if (front.qty == 0) {
+            m.remove(Side::Buy, 99, front.id);
+        }
+    }
+    EXPECT_TRUE(!ob.contains(25) && !ob.contains(57));
+    expect_book_matches(ob, m);
+
+    // owner 2's qty cuts stay in place, its price moves requeue at the back of 95
+    for (OrderId id = 201; id < 700; id += 8) {
+        const PriceTick px = px_of(id);
+        if (id / 8 % 2) {
+            for (Resting& r : m.side(Side::Buy)[px]) {
+                if (r.id == id) {
+                    r.qty -= 3;
+                    ob.submit_order(modify(id, px, r.qty));
+                }
+            }
+        }
+        else {
+            const Resting r = m.remove(Side::Buy, px, id);
+            ob.submit_order(modify(id, 95, r.qty));
+            m.add(Side::Buy, 95, id, r.qty, r.owner);
+        }
+    }
+    expect_book_matches(ob, m);
+
+    // cancelling most of owner 1 packs and absorbs the blocks owner 2 lives in
+    const std::size_t bytes = ob.block_bytes();
+    for (OrderId id = 1; id <= 1200; ++id) {
+        if (owner_of(id) == 1 && id % 10 != 0 && ob.contains(id)) {
+            m.remove(Side::Buy, px_of(id), id);
+            ob.submit_order(cancel(id));
+        }
+    }
+    expect_book_matches(ob, m);
+    EXPECT_TRUE(ob.block_bytes() < bytes);
+
+    const auto want = owned_by(m, 2, false, Side::Buy);
+    EXPECT_EQ(want.size(), 148u);
+    EXPECT_TRUE(cancel_all_of(ob, m, 2, false, Side::Buy) == want);
+    expect_book_matches(ob, m);
+    EXPECT_TRUE(owned_by(m, 1, false, Side::Buy).size() > 100);
+    EXPECT_EQ(ob.cancel_all(2, false, Side::Buy, 0, [](const BookEvent&) {}), 0u);
+}
+
+TEST(Depth_Follows_Book) {
+    depth_follows_book<MatchingOrderBook<>>(kMinTick, kMaxTick, 120, 3);
+}
+
+// levels on pages of their own, the refill after a level empties walks past released pages
+TEST(Depth_Follows_Book_Paged) {
+    depth_follows_book<MatchingOrderBook<128, LadderKind::Paged>>(1, 1'000'000, 500'000, 700);
+}
+
+// prices outside [min_tick, max_tick] have no level to rest on and are rejected, not indexed
+TEST(Limit_Price_Out_Of_Range_Rejected) {
+    MatchingOrderBook<> ob(kMinTick, kMaxTick);
+    Model m;
+    for (const PriceTick px : {PriceTick{0}, kMinTick - 1, kMaxTick + 1}) {
+        const BookEvent e = ob.submit_order(limit(1, Side::Buy, px, 5));
+        EXPECT_TRUE(e.event_type == BookEventType::Reject);
+        EXPECT_TRUE(e.reason == RejectReason::InvalidPrice);
+    }
+    expect_book_matches(ob, m);
+
+    // the edges rest, a modify off the ladder leaves the order where it was
+    ob.submit_order(limit(2, Side::Buy, kMinTick, 5));
+    ob.submit_order(limit(3, Side::Sell, kMaxTick, 5));
+    m.add(Side::Buy, kMinTick, 2, 5, 1);
+    m.add(Side::Sell, kMaxTick, 3, 5, 1);
+    const BookEvent e = ob.submit_order(modify(3, kMaxTick + 1, 5));
+    EXPECT_TRUE(e.event_type == BookEventType::Reject);
+    EXPECT_TRUE(e.reason == RejectReason::InvalidPrice);
+    expect_book_matches(ob, m);
+}
+
+// one trade walks the asks up a level at a time, each step firing the stops resting at the new price
+TEST(Stop_Cascade_Fills_In_Order) {
+    MatchingOrderBook<> ob(kMinTick, kMaxTick);
+    Model m;
+    // a first trade at 100 sets the reference the stops fire against
+    ob.submit_order(limit(1, Side::Sell, 100, 1));
+    ob.submit_order(market(2, Side::Buy, 1));
+
+    ob.submit_order(limit(10, Side::Sell, 101, 1));
+    ob.submit_order(limit(11, Side::Sell, 102, 1));
+    ob.submit_order(limit(12, Side::Sell, 103, 2));
+    ob.submit_order(limit(13, Side::Sell, 104, 5));
+    ob.submit_order(stop(20, Side::Buy, 101, 1));
+    ob.submit_order(stop(21, Side::Buy, 102, 1));
+    ob.submit_order(stop(22, Side::Buy, 102, 2));
+    ob.submit_order(stop(23, Side::Buy, 104, 2, OrderType::StopLimit, 104));
+
+    // 30 lifts 101 -> 20 lifts 102 -> 21 and 22 fire in arrival order and reach 104 -> 23 rests its limit
+    // against what is left there
+    ob.submit_order(market(30, Side::Buy, 1));
+    const std::vector<std::pair<OrderId, PriceTick>> expected = {
+        {10, 101}, {11, 102}, {12, 103}, {12, 103}, {13, 104}, {13, 104},
+    };
+    EXPECT_EQ(ob.match_result.fills.size(), expected.size());
+    for (std::size_t i = 0; i < expected.size() && i < ob.match_result.fills.size(); ++i) {
+        EXPECT_EQ(ob.match_result.fills[i].id, expected[i].first);
+        EXPECT_EQ(ob.match_result.fills[i].price, expected[i].second);
+    }
+    // the submitted order's own totals, not the cascade's
+    EXPECT_EQ(ob.match_result.qty, 1);
+    EXPECT_EQ(ob.match_result.last_px, 101u);
+
+    m.add(Side::Sell, 104, 13, 2, 1);
+    expect_book_matches(ob, m);
+    EXPECT_EQ(ob.order_qty(20) + ob.order_qty(21) + ob.order_qty(22) + ob.order_qty(23), 0);
+}
+
+// every order that rests is reported with its owner, a stop as it fires and again if its limit rests
+TEST(Rest_Sink_Reports_Stops_Legs_And_Triggered_Rests) {
+    struct Rest {
+        OrderId id;
+        UserId owner;
+        bool resting;
+    };
+    std::vector<Rest> rests;
+    MatchingOrderBook<> ob(kMinTick, kMaxTick);
+    ob.set_rest_sink({&rests, [](void* ctx, OrderId id, UserId owner, bool resting) {
+                          static_cast<std::vector<Rest>*>(ctx)->push_back(Rest{id, owner, resting});
+                      }});
+    ob.submit_order(limit(1, Side::Sell, 100, 1));
+    ob.submit_order(market(2, Side::Buy, 1));
+    OrderParams with_legs = limit(3, Side::Buy, 90, 4, 7);
+    with_legs.sl_id = 4;
+    with_legs.sl_trigger = 80;
+    with_legs.tp_id = 5;
+    with_legs.tp_trigger = 120;
+    with_legs.tp_limit_px = 121;
+    ob.submit_order(with_legs);
+    ob.submit_order(limit(6, Side::Sell, 101, 3));
+    ob.submit_order(stop(7, Side::Buy, 101, 5, OrderType::StopLimit, 101));
+    // lifts 101, the stop fires and rests what is left of its limit there
+    ob.submit_order(market(8, Side::Buy, 1));
+
+    const std::vector<Rest> expected = {
+        {1, 1, true}, {3, 7, true}, {4, 7, true}, {5, 7, true}, {6, 1, true}, {7, 3, true}, {7, 3, false},
+        {7, 3, true},
+    };
+    EXPECT_EQ(rests.size(), expected.size());
+    for (std::size_t i = 0; i < expected.size() && i < rests.size(); ++i) {
+        EXPECT_EQ(rests[i].id, expected[i].id);
+        EXPECT_EQ(rests[i].owner, expected[i].owner);
+        EXPECT_EQ(rests[i].resting, expected[i].resting);
+    }
+    EXPECT_EQ(ob.order_qty(7), 3);
+
+    // the legs carry their parent's owner, so an owner wide cancel takes them too
+    EXPECT_EQ(ob.cancel_all(7, false, Side::Buy, 0, [](const BookEvent&) {}), 3u);
+    EXPECT_TRUE(!ob.contains(4) && !ob.contains(5));
+}
+
+// triggers and the limit prices they post at are range checked like any other price
+TEST(Stop_Trigger_Out_Of_Range_Rejected) {
+    MatchingOrderBook<> ob(kMinTick, kMaxTick);
+    const OrderParams bad[] = {
+        stop(1, Side::Buy, kMaxTick + 1, 1),
+        stop(2, Side::Sell, kMinTick - 1, 1),
+        stop(3, Side::Buy, 120, 1, OrderType::StopLimit, kMaxTick + 1),
+        stop(4, Side::Sell, 80, 1, OrderType::TakeProfit, 0),
+        stop(5, Side::Sell, 0, 1, OrderType::TakeProfit, 90),
+    };
+    for (const OrderParams& p : bad) {
+        const BookEvent e = ob.submit_order(p);
+        EXPECT_TRUE(e.event_type == BookEventType::Reject);
+        EXPECT_TRUE(e.reason == RejectReason::InvalidPrice);
+    }
+    expect_book_matches(ob, Model{});
+}
+
+// a second live order under one id would take over the first's locator
+TEST(New_With_Live_Id_Rejected) {
+    MatchingOrderBook<> ob(kMinTick, kMaxTick);
+    Model m;
+    ob.submit_order(limit(1, Side::Buy, 100, 5));
+    ob.submit_order(stop(2, Side::Buy, 150, 5));
+    m.add(Side::Buy, 100, 1, 5, 1);
+    for (const OrderParams& p : {limit(1, Side::Sell, 120, 3), limit(2, Side::Buy, 90, 3), stop(1, Side::Sell, 60, 3)}) {
+        const BookEvent e = ob.submit_order(p);
+        EXPECT_TRUE(e.event_type == BookEventType::Reject);
+        EXPECT_TRUE(e.reason == RejectReason::DuplicateId);
+    }
+    OrderParams leg = limit(3, Side::Buy, 99, 2);
+    leg.sl_id = 1;
+    leg.sl_trigger = 90;
+    EXPECT_TRUE(ob.submit_order(leg).reason == RejectReason::DuplicateId);
+    expect_book_matches(ob, m);
+    EXPECT_EQ(ob.order_qty(1), 5);
+    EXPECT_EQ(ob.order_qty(2), 5);
+
+    // once it left the book the id may be used again
+    ob.submit_order(cancel(1));
+    m.remove(Side::Buy, 100, 1);
+    EXPECT_TRUE(ob.submit_order(limit(1, Side::Sell, 120, 3)).event_type != BookEventType::Reject);
+    m.add(Side::Sell, 120, 1, 3, 1);
+    expect_book_matches(ob, m);
+}
+
+// a wide band book only holds pages around its orders, and gives them back as the orders leave
+TEST(Paged_Ladder_Frees_Pages_As_Levels_Empty) {
+    using Paged = MatchingOrderBook<128, LadderKind::Paged>;
+    Paged ob(1, 1'000'000);
+    // a first trade sets the price the stop fires against, its level is released with it
+    ob.submit_order(limit(10, Side::Sell, 500'000, 1));
+    ob.submit_order(market(11, Side::Buy, 1));
+    EXPECT_EQ(ob.ladder_pages(), 0u);
+    ob.submit_order(limit(1, Side::Buy, 1'000, 5));
+    ob.submit_order(limit(2, Side::Buy, 1'001, 5));
+    ob.submit_order(limit(3, Side::Buy, 200'000, 5));
+    ob.submit_order(limit(4, Side::Sell, 600'000, 5));
+    ob.submit_order(limit(5, Side::Sell, 600'050, 5));
+    ob.submit_order(stop(6, Side::Buy, 600'050, 5));
+    EXPECT_EQ(ob.ladder_pages(), 4u);
+
+    // one of two levels on a page goes, the page stays
+    ob.submit_order(cancel(1));
+    EXPECT_EQ(ob.ladder_pages(), 4u);
+    ob.submit_order(cancel(2));
+    EXPECT_EQ(ob.ladder_pages(), 3u);
+
+    // emptied by fills: the sweep takes the page of both asks, its trade at 600050 fires the stop that
+    // sits on a bid page of its own, and the stop's market order finds nothing left to fill
+    ob.submit_order(limit(7, Side::Buy, 900'000, 10));
+    EXPECT_EQ(ob.order_qty(6), 0);
+    EXPECT_EQ(ob.ladder_pages(), 1u);
+
+    ob.submit_order(cancel(3));
+    EXPECT_EQ(ob.ladder_pages(), 0u);
+    EXPECT_EQ(ob.ladder_bytes(), 0u);
+    EXPECT_TRUE(ob.locators_consistent());
+
+    // and a level rebuilt where one was released matches like any other
+    ob.submit_order(limit(8, Side::Sell, 600'000, 3));
+    ob.submit_order(market(9, Side::Buy, 2));
+    EXPECT_EQ(ob.match_result.fills.size(), 1u);
+    EXPECT_EQ(ob.order_qty(8), 1);
+}
+
+// a price walking down a page at a time keeps one page and a directory of bounded size
+TEST(Paged_Ladder_Directory_Follows_Drifting_Price) {
+    int level = 0;
+    PagedLadder<int> ladder(1 << 30);
+    constexpr std::size_t kPage = PagedLadder<int>::PAGE_TICKS;
+    std::size_t peak = 0;
+    for (std::size_t page = 100'000; page-- > 0;) {
+        ladder.put(page * kPage, &level);
+        ladder.erase((page + 1) * kPage);
+        EXPECT_EQ(ladder.pages(), 1u);
+        peak = std::max(peak, ladder.bytes());
+    }
+    EXPECT_TRUE(peak <= sizeof(PagedLadder<int>::Page) + 64 * sizeof(void*));
+    EXPECT_TRUE(ladder.get(0) == &level);
+    ladder.erase(0);
+    EXPECT_EQ(ladder.bytes(), 0u);
+
+    // and walking up
+    for (std::size_t page = 0; page < 100'000; ++page) {
+        ladder.put(page * kPage + 7, &level);
+        if (page > 0) {
+            ladder.erase((page - 1) * kPage + 7);
+        }
+        peak = std::max(peak, ladder.bytes());
+    }
+    EXPECT_EQ(ladder.pages(), 1u);
+    EXPECT_TRUE(peak <= sizeof(PagedLadder<int>::Page) + 64 * sizeof(void*));
+}
+
+// a loaded book holds the same orders in the same fifo order, stops and take-profits included, with the
+// seq and last trade it was saved with, so it fills what comes next exactly like the live one
+TEST(Image_Round_Trip) {
+    image_round_trip<MatchingOrderBook<>>();
+}
+
+TEST(Image_Round_Trip_Paged) {
+    image_round_trip<MatchingOrderBook<128, LadderKind::Paged>>();
+}
+
+TEST(Image_Recapture_Copies_Changed_Levels) {
+    image_recapture<MatchingOrderBook<>>();
+}
+
+TEST(Image_Recapture_Copies_Changed_Levels_Paged) {
+    image_recapture<MatchingOrderBook<128, LadderKind::Paged>>();
+}
+
+int main() {
+    return ::mini_test::run_all();
+}
@@ -0,0 +1,148 @@
+#include <cstdint>
+#include <vector>
+
+#include "test_harness.h"
+#include "../risk/RiskEngine.h"
+
+using namespace jolt;
+using jolt::exchange::RiskEngine;
+
+namespace {
+    constexpr uint16_t kSymA = kFirstSymbolId;
+    constexpr uint16_t kSymB = kFirstSymbolId + 1;
+    constexpr uint64_t kTrader = 11;
+    constexpr uint64_t kMaker = 22;
+
+    ClientInfo limits(int64_t max_pos) {
+        ClientInfo c{};
+        c.max_qty = 1000;
+        c.max_open_orders = 1000;
+        c.max_pos = max_pos;
+        c.max_notional = 0;
+        return c;
+    }
+
+    RiskEngine make_engine(int64_t max_pos = 10) {
+        return RiskEngine(InstrumentRegistry::make_default(50, 200), 16, 64, limits(max_pos));
+    }
+
+    ExchangeToRiskMsg accept(uint64_t id, uint64_t client, uint16_t symbol = kSymA) {
+        ExchangeToRiskMsg m{};
+        m.type = ExchangeToRiskMsg::Type::Accept;
+        m.maker_order_id = id;
+        m.maker_client_id = client;
+        m.symbol_id = symbol;
+        m.flags = ExchangeToRiskMsg::kLastInBatch;
+        return m;
+    }
+
+    ExchangeToRiskMsg cancel(uint64_t id, uint16_t symbol = kSymA) {
+        ExchangeToRiskMsg m = accept(id, 0, symbol);
+        m.type = ExchangeToRiskMsg::Type::Cancel;
+        return m;
+    }
+
+    // taker buys qty from the maker's resting order
+    ExchangeToRiskMsg fill(uint64_t maker_id, uint64_t maker, uint64_t taker, ob::Qty qty, bool last,
+                           bool maker_done = false) {
+        ExchangeToRiskMsg m{};
+        m.type = ExchangeToRiskMsg::Type::Fill;
+        m.maker_order_id = maker_id;
+        m.maker_client_id = maker;
+        m.taker_client_id = taker;
+        m.symbol_id = kSymA;
+        m.price = 100;
+        m.qty = qty;
+        m.side = Side::Buy;
+        m.flags = static_cast<uint8_t>((last ? ExchangeToRiskMsg::kLastInBatch : 0) |
+                                       (maker_done ? ExchangeToRiskMsg::kMakerDone : 0));
+        return m;
+    }
+
+    std::vector<uint64_t> drain_kills(RiskEngine& engine) {
+        std::vector<uint64_t> killed;
+        engine.kill_pending([&](uint64_t client_id) {
+            killed.push_back(client_id);
+            return true;
+        });
+        return killed;
+    }
+} // namespace
+
+// a breach kills the client once, its mass cancel clears every order it rested, stops included
+TEST(Risk_Breach_Kills_And_Mass_Cancels) {
+    RiskEngine engine = make_engine();
+    engine.on_event(accept(1, kTrader));
+    engine.on_event(accept(2, kTrader, kSymB)); // a stop on another symbol
+    engine.on_event(accept(3, kMaker));
+    engine.on_event(accept(4, kMaker));
+    EXPECT_EQ(engine.open_orders(), 4u);
+    EXPECT_TRUE(drain_kills(engine).empty());
+
+    // the trader's buy takes 12 over two fills, past its max_pos of 10
+    engine.on_event(fill(3, kMaker, kTrader, 8, false, true));
+    EXPECT_TRUE(!engine.client(kTrader)->killed);
+    engine.on_event(fill(4, kMaker, kTrader, 4, true));
+    EXPECT_EQ(engine.position(kTrader, kSymA), 12);
+    EXPECT_TRUE(engine.client(kTrader)->killed);
+    // the maker is short 12 as well
+    EXPECT_TRUE(engine.client(kMaker)->killed);
+
+    std::vector<uint64_t> killed = drain_kills(engine);
+    EXPECT_EQ(killed.size(), 2u);
+    EXPECT_TRUE(drain_kills(engine).empty());
+
+    ob::RejectReason reason{};
+    ob::OrderParams next{};
+    next.qty = 1;
+    EXPECT_TRUE(!engine.check(*engine.client(kTrader), next, reason));
+    EXPECT_TRUE(reason == ob::RejectReason::NotFillable);
+
+    // what the exchange's mass cancel took out of the books comes back as cancels
+    engine.on_event(cancel(1));
+    engine.on_event(cancel(2, kSymB));
+    engine.on_event(cancel(4));
+    EXPECT_EQ(engine.client(kTrader)->open_orders, 0u);
+    EXPECT_EQ(engine.client(kMaker)->open_orders, 0u);
+    EXPECT_EQ(engine.open_orders(), 0u);
+    EXPECT_EQ(engine.dropped(), 0u);
+}
+
+// a kill that finds the ring full goes out on a later call, and only once
+TEST(Risk_Kill_Resumes_After_Full_Ring) {
+    RiskEngine engine = make_engine();
+    engine.on_event(accept(1, kMaker));
+    engine.on_event(fill(1, kMaker, kTrader, 11, true));
+    EXPECT_EQ(engine.kill_pending([](uint64_t) { return false; }), 0u);
+    std::vector<uint64_t> killed = drain_kills(engine);
+    EXPECT_EQ(killed.size(), 2u);
+    EXPECT_TRUE(drain_kills(engine).empty());
+}
+
+// fills of an order the taker's trade triggered belong to another taker, each is checked on its own
+TEST(Risk_Triggered_Taker_Checked_Separately) {
+    RiskEngine engine = make_engine(100);
+    engine.on_event(accept(1, kMaker));
+    engine.on_event(accept(2, kMaker));
+    // the trader's stop rests and fires in the same batch as the trade that triggers it
+    ExchangeToRiskMsg stop = accept(9, kTrader);
+    stop.flags = 0;
+    engine.on_event(stop);
+    EXPECT_EQ(engine.client(kTrader)->open_orders, 1u);
+
+    ExchangeToRiskMsg big = fill(1, kMaker, 33, 150, false, true);
+    engine.on_event(big);
+    ExchangeToRiskMsg fired = cancel(9);
+    fired.flags = 0;
+    engine.on_event(fired);
+    engine.on_event(fill(2, kMaker, kTrader, 5, true));
+
+    EXPECT_TRUE(engine.client(33)->killed);
+    EXPECT_TRUE(!engine.client(kTrader)->killed);
+    EXPECT_EQ(engine.client(kTrader)->open_orders, 0u);
+    EXPECT_EQ(engine.position(kTrader, kSymA), 5);
+}
+
+int main() {
+    return ::mini_test::run_all();
+}
@@ -0,0 +1,241 @@
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include "test_harness.h"
+#include "../exchange/SnapshotService.h"
+#include "../exchange/orderbook/matching_orderbook.h"
+
+using namespace jolt;
+using namespace jolt::exchange;
+
+namespace {
+    constexpr uint16_t kSymbol = 7;
+    constexpr ob::PriceTick kMinTick = 50;
+    constexpr ob::PriceTick kMaxTick = 200;
+
+    std::string shm_name(const char* what) {
+        return "/jolt_resync_test_" + std::to_string(::getpid()) + "_" + what;
+    }
+
+    // the snapshot service of one symbol and its rings, the test drives both threads' sides
+    struct Rig {
+        SharedRingOptions unlink{true};
+        InstrumentRegistry registry;
+        SnapshotService::DeltaQ deltas{shm_name("deltas"), SharedRingMode::Create, unlink};
+        SnapshotService::SnapshotMetaQ meta{shm_name("meta"), SharedRingMode::Create, unlink};
+        SnapshotService::RequestQ requests{shm_name("requests"), SharedRingMode::Create, unlink};
+        SnapshotService::SnapshotBlob pool{shm_name("blob"), PoolMode::Create, {1, 0}};
+        std::unique_ptr<SnapshotService> service;
+        uint64_t next_request{1};
+
+        Rig() {
+            registry.add(Instrument{kSymbol, kMinTick, kMaxTick, 1, 0});
+            service = std::make_unique<SnapshotService>(registry, pool, meta, requests);
+            service->add_source(deltas);
+        }
+
+        ~Rig() {
+            service.reset();
+            ::shm_unlink(shm_name("blob").c_str());
+        }
+
+        void request() { requests.enqueue(md::DataRequest{1, kSymbol, next_request++}); }
+
+        // the snapshot the service answered with, false if it has not answered
+        bool answer(ob::BookSnapshot& out) {
+            auto m = meta.dequeue();
+            if (!m || !m->accepted) {
+                return false;
+            }
+            const BlobHandle handle{m->slot_id, m->slot_gen};
+            const auto& slot = pool.reader_slot(handle);
+            out.orders.resize(m->bytes / sizeof(ob::SnapshotOrder));
+            std::memcpy(out.orders.data(), slot.payload.data(), m->bytes);
+            out.bid_ct = m->bid_ct;
+            out.ask_ct = m->ask_ct;
+            out.seq = m->snapshot_seq;
+            pool.release(handle);
+            return true;
+        }
+    };
+
+    // the matching thread's delta stream as the exchange runs it: deltas written in place, published per
+    // order, and none for the book once one was dropped until it is resynced
+    struct Stream {
+        SnapshotService::DeltaQ* q;
+        size_t pending{0};
+        bool dropped{false};
+
+        static void on_delta(void* ctx, const ob::BookDelta& d) {
+            auto& s = *static_cast<Stream*>(ctx);
+            auto* rec = s.q->alloc(s.pending);
+            if (!rec && s.pending > 0) {
+                s.q->push(s.pending);
+                s.pending = 0;
+                rec = s.q->alloc(0);
+            }
+            if (!rec) {
+                s.dropped = true;
+                return;
+            }
+            *rec = SnapshotDeltaMsg{d.id, d.seq, d.qty, d.price, kSymbol, d.side, d.type, 0};
+            ++s.pending;
+        }
+
+        void flush() {
+            if (pending > 0) {
+                q->alloc(pending - 1)->flags = SnapshotDeltaMsg::kLastInOrder;
+                q->push(pending);
+                pending = 0;
+            }
+        }
+    };
+
+    ob::OrderParams limit(ob::OrderId id, ob::Side side, ob::PriceTick px, ob::Qty qty) {
+        ob::OrderParams p{};
+        p.id = id;
+        p.client_id = 1;
+        p.side = side;
+        p.price = px;
+        p.qty = qty;
+        return p;
+    }
+
+    ob::OrderParams cancel(ob::OrderId id) {
+        ob::OrderParams p{};
+        p.action = ob::OrderAction::Cancel;
+        p.id = id;
+        return p;
+    }
+
+    bool same_orders(const ob::BookSnapshot& a, const ob::BookSnapshot& b) {
+        if (a.orders.size() != b.orders.size() || a.bid_ct != b.bid_ct || a.ask_ct != b.ask_ct) {
+            return false;
+        }
+        for (size_t i = 0; i < a.orders.size(); ++i) {
+            if (a.orders[i].id != b.orders[i].id || a.orders[i].qty != b.orders[i].qty ||
+                a.orders[i].px != b.orders[i].px || a.orders[i].side != b.orders[i].side) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // resting orders around 100 that never cross, with a cancel for every other add so the stream
+    // carries adds and removes
+    void churn(ob::MatchingOrderBook<>& book, Stream& stream, ob::OrderId& next_id, size_t orders) {
+        for (size_t i = 0; i < orders; ++i) {
+            const ob::OrderId id = next_id++;
+            const bool buy = (id & 1) != 0;
+            book.submit_order(limit(id, buy ? ob::Side::Buy : ob::Side::Sell,
+                                    static_cast<ob::PriceTick>(buy ? 90 + id % 7 : 110 + id % 7),
+                                    static_cast<ob::Qty>(1 + id % 13)));
+            if (id % 2 == 0) {
+                book.submit_order(cancel(id - 1));
+            }
+            stream.flush();
+            if (stream.dropped) {
+                book.set_delta_sink({});
+            }
+        }
+    }
+} // namespace
+
+TEST(Shadow_Book_Follows_Book) {
+    Rig rig;
+    ob::MatchingOrderBook<> book(kMinTick, kMaxTick);
+    Stream stream{&rig.deltas};
+    book.set_delta_sink({&stream, &Stream::on_delta});
+    ob::OrderId next_id = 1;
+    churn(book, stream, next_id, 2000);
+    EXPECT_TRUE(!stream.dropped);
+
+    rig.request();
+    rig.service->poll_once();
+    ob::BookSnapshot served{};
+    ob::BookSnapshot live{};
+    book.get_snapshot(live);
+    EXPECT_TRUE(rig.answer(served));
+    EXPECT_TRUE(same_orders(served, live));
+    EXPECT_EQ(served.seq, live.seq);
+}
+
+TEST(Shadow_Book_Resynced_After_Delta_Overflow) {
+    Rig rig;
+    ob::MatchingOrderBook<> book(kMinTick, kMaxTick);
+    Stream stream{&rig.deltas};
+    book.set_delta_sink({&stream, &Stream::on_delta});
+    ob::OrderId next_id = 1;
+
+    // the service does not poll while twice the ring's worth of deltas is streamed
+    churn(book, stream, next_id, rig.deltas.capacity());
+    EXPECT_TRUE(stream.dropped);
+    rig.service->mark_stale(0, 1);
+
+    // everything that made it is applied, but the shadow book missed deltas: the request is held
+    rig.request();
+    rig.service->poll_once();
+    rig.service->poll_once();
+    ob::BookSnapshot served{};
+    EXPECT_TRUE(!rig.answer(served));
+
+    // the next poll of the matching thread reseeds it from the book
+    ob::BookSnapshot live{};
+    book.get_snapshot(live);
+    EXPECT_TRUE(SnapshotService::write_resync(rig.deltas, kSymbol, 1, live));
+    rig.service->poll_once();
+    EXPECT_TRUE(rig.answer(served));
+    EXPECT_TRUE(same_orders(served, live));
+    EXPECT_EQ(served.seq, live.seq);
+
+    // and deltas stream on top of the reseeded book
+    stream.dropped = false;
+    book.set_delta_sink({&stream, &Stream::on_delta});
+    churn(book, stream, next_id, 500);
+    EXPECT_TRUE(!stream.dropped);
+    rig.request();
+    rig.service->poll_once();
+    book.get_snapshot(live);
+    EXPECT_TRUE(rig.answer(served));
+    EXPECT_TRUE(same_orders(served, live));
+}
+
+TEST(Shadow_Book_Resync_Waits_For_Room) {
+    Rig rig;
+    ob::MatchingOrderBook<> book(kMinTick, kMaxTick);
+    Stream stream{&rig.deltas};
+    book.set_delta_sink({&stream, &Stream::on_delta});
+    ob::OrderId next_id = 1;
+    churn(book, stream, next_id, rig.deltas.capacity());
+    EXPECT_TRUE(stream.dropped);
+    rig.service->mark_stale(0, 1);
+
+    // the ring is still full, nothing of the resync is written
+    ob::BookSnapshot live{};
+    book.get_snapshot(live);
+    const size_t queued = rig.deltas.size();
+    EXPECT_TRUE(!SnapshotService::write_resync(rig.deltas, kSymbol, 1, live));
+    EXPECT_EQ(rig.deltas.size(), queued);
+
+    // a second drop before the first resync lands keeps the symbol stale until its own resync
+    rig.service->poll_once();
+    EXPECT_TRUE(SnapshotService::write_resync(rig.deltas, kSymbol, 1, live));
+    rig.service->mark_stale(0, 2);
+    rig.request();
+    rig.service->poll_once();
+    ob::BookSnapshot served{};
+    EXPECT_TRUE(!rig.answer(served));
+
+    EXPECT_TRUE(SnapshotService::write_resync(rig.deltas, kSymbol, 2, live));
+    rig.service->poll_once();
+    EXPECT_TRUE(rig.answer(served));
+    EXPECT_TRUE(same_orders(served, live));
+}
+
+int main() {
+    return ::mini_test::run_all();
+}